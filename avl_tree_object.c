@@ -58,8 +58,6 @@ set_child (avl_node_t *child, avl_node_t *parent,
         parent->right = child;
 }
 
-#if 0
-
 static inline avl_node_t *
 get_last (avl_node_t *node)
 {
@@ -99,8 +97,6 @@ avl_tree_prev (avl_node_t *node)
     return parent;
 }
 
-#endif // 0
-
 static inline void 
 rotate_left (avl_node_t *node, avl_tree_t *tree)
 {
@@ -172,6 +168,31 @@ avl_lookup_engine (avl_tree_t *tree,
     return NULL;
 }
 
+/*
+ * first node whose data is equal to or bigger than 'low',
+ * the leftmost node if 'low' is NULL
+ */
+static avl_node_t *
+avl_lower_bound (avl_tree_t *tree, void *low)
+{
+    avl_node_t *node = tree->root_node;
+    avl_node_t *candidate = NULL;
+    int res;
+
+    if (NULL == low) return node ? get_first(node) : NULL;
+    while (node) {
+        res = (tree->cmpf)(low, node->user_data);
+        if (res == 0) return node;
+        if (res < 0) {
+            candidate = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return candidate;
+}
+
 static inline void
 free_avl_node (avl_tree_t *tree, avl_node_t *node)
 {
@@ -559,6 +580,27 @@ thread_unsafe_avl_tree_morris_traverse (avl_tree_t *tree, avl_node_t *root,
 /*
  * Very similar to morris traversal.
  */
+static int
+thread_unsafe_avl_tree_range_traverse (avl_tree_t *tree,
+        void *low, void *high,
+        traverse_function_pointer tfn,
+        void *p0, void *p1, void *p2, void *p3)
+{
+    avl_node_t *node;
+    int failed = 0;
+
+    tree->should_not_be_modified = true;
+    node = avl_lower_bound(tree, low);
+    while (node) {
+        if (high && ((tree->cmpf)(node->user_data, high) > 0)) break;
+        failed = tfn(tree, node, node->user_data, p0, p1, p2, p3);
+        if (failed) break;
+        node = avl_tree_next(node);
+    }
+    tree->should_not_be_modified = false;
+    return failed;
+}
+
 static int
 thread_unsafe_avl_tree_iterate (avl_tree_t *tree, avl_node_t *root,
         traverse_function_pointer tfn,
@@ -644,6 +686,101 @@ thread_unsafe_iterative_destroy (avl_tree_t *tree, avl_node_t *root,
     return delete_count;
 }
 
+/* height of a tree of 'n' nodes as built by 'avl_build_balanced' */
+static inline int
+avl_balanced_height (int n)
+{
+    int height = 0;
+
+    while (n) {
+        height++;
+        n >>= 1;
+    }
+    return height;
+}
+
+/*
+ * Builds a balanced tree from the first 'n' nodes of a sorted list,
+ * linked thru their 'left' pointers, advancing '*list' past them.
+ * Recursion is only as deep as the resulting tree.
+ */
+static avl_node_t *
+avl_build_balanced (avl_node_t **list, int n, avl_node_t *parent)
+{
+    avl_node_t *node, *left;
+    int n_left, n_right;
+
+    if (n <= 0) return NULL;
+    n_left = (n - 1) / 2;
+    n_right = n - 1 - n_left;
+    left = avl_build_balanced(list, n_left, NULL);
+    node = *list;
+    *list = node->left;
+    node->left = left;
+    if (left) left->parent = node;
+    node->parent = parent;
+    node->left_visited = node->right_visited = false;
+    node->right = avl_build_balanced(list, n_right, node);
+    node->balance = avl_balanced_height(n_right) - avl_balanced_height(n_left);
+    return node;
+}
+
+/*
+ * Goes over the nodes in order, putting aside the ones to be removed,
+ * and links the rest into a sorted list to rebuild the tree from.
+ * Finding the next node only ever reads the 'left' pointers of nodes
+ * which come later & the 'right' & 'parent' pointers of the earlier
+ * ones, so the lists are linked thru the 'left' pointers & no node is
+ * freed till the end.
+ */
+static int
+thread_unsafe_avl_tree_remove_matching (avl_tree_t *tree,
+        two_parameter_function_pointer match, void *arg,
+        destruction_handler_t dh_fptr, void *extra_arg)
+{
+    avl_node_t *node, *next, *kept, *removed;
+    avl_node_t **kept_tail = &kept;
+    int n_kept = 0, n_removed = 0;
+
+    if (NULL == tree->root_node) return 0;
+    tree->should_not_be_modified = true;
+    removed = NULL;
+    node = get_first(tree->root_node);
+    while (node) {
+        next = avl_tree_next(node);
+        if (match(node->user_data, arg)) {
+            node->left = removed;
+            removed = node;
+            n_removed++;
+        } else {
+            *kept_tail = node;
+            kept_tail = &node->left;
+            n_kept++;
+        }
+        node = next;
+    }
+    *kept_tail = NULL;
+
+    /* even if nothing is removed, the left pointers are gone */
+    tree->root_node = avl_build_balanced(&kept, n_kept, NULL);
+    while ((node = removed)) {
+        removed = node->left;
+        if (dh_fptr) dh_fptr(node->user_data, extra_arg);
+        free_avl_node(tree, node);
+    }
+    tree->should_not_be_modified = false;
+    return n_removed;
+}
+
+/* moves the cursor onto 'node' & hands out its user data */
+static inline int
+avl_cursor_move (avl_cursor_t *cursor, avl_node_t *node, void **data)
+{
+    cursor->node = node;
+    safe_pointer_set(data, node ? node->user_data : NULL);
+    return node ? 0 : ENODATA;
+}
+
 /**************************** Initialize *************************************/
 
 PUBLIC int
@@ -745,6 +882,20 @@ avl_tree_remove (avl_tree_t *tree,
     return failed;
 }
 
+PUBLIC int
+avl_tree_remove_matching (avl_tree_t *tree,
+        two_parameter_function_pointer match, void *arg,
+        destruction_handler_t dh_fptr, void *extra_arg)
+{
+    int removed;
+
+    OBJ_WRITE_LOCK(tree);
+    removed = thread_unsafe_avl_tree_remove_matching(tree,
+                match, arg, dh_fptr, extra_arg);
+    OBJ_WRITE_UNLOCK(tree);
+    return removed;
+}
+
 /**************************** Traverse ***************************************/
 
 PUBLIC int
@@ -761,6 +912,21 @@ avl_tree_morris_traverse (avl_tree_t *tree, avl_node_t *root,
     return failed;
 }
 
+PUBLIC int
+avl_tree_range_traverse (avl_tree_t *tree,
+        void *low, void *high,
+        traverse_function_pointer tfn,
+        void *p0, void *p1, void *p2, void *p3)
+{
+    int failed;
+
+    OBJ_READ_LOCK(tree);
+    failed = thread_unsafe_avl_tree_range_traverse(tree, low, high,
+                tfn, p0, p1, p2, p3);
+    OBJ_READ_UNLOCK(tree);
+    return failed;
+}
+
 PUBLIC int
 avl_tree_iterate (avl_tree_t *tree, avl_node_t *root,
         traverse_function_pointer tfn,
@@ -777,6 +943,69 @@ avl_tree_iterate (avl_tree_t *tree, avl_node_t *root,
 
 /**************************** Destroy ****************************************/
 
+PUBLIC int
+avl_cursor_first (avl_tree_t *tree, avl_cursor_t *cursor, void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(tree);
+    cursor->tree = tree;
+    failed = avl_cursor_move(cursor,
+                tree->root_node ? get_first(tree->root_node) : NULL, data);
+    OBJ_READ_UNLOCK(tree);
+    return failed;
+}
+
+PUBLIC int
+avl_cursor_last (avl_tree_t *tree, avl_cursor_t *cursor, void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(tree);
+    cursor->tree = tree;
+    failed = avl_cursor_move(cursor,
+                tree->root_node ? get_last(tree->root_node) : NULL, data);
+    OBJ_READ_UNLOCK(tree);
+    return failed;
+}
+
+PUBLIC int
+avl_cursor_seek (avl_tree_t *tree, avl_cursor_t *cursor,
+        void *key, void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(tree);
+    cursor->tree = tree;
+    failed = avl_cursor_move(cursor, avl_lower_bound(tree, key), data);
+    OBJ_READ_UNLOCK(tree);
+    return failed;
+}
+
+PUBLIC int
+avl_cursor_next (avl_cursor_t *cursor, void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(cursor->tree);
+    failed = avl_cursor_move(cursor,
+                cursor->node ? avl_tree_next(cursor->node) : NULL, data);
+    OBJ_READ_UNLOCK(cursor->tree);
+    return failed;
+}
+
+PUBLIC int
+avl_cursor_prev (avl_cursor_t *cursor, void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(cursor->tree);
+    failed = avl_cursor_move(cursor,
+                cursor->node ? avl_tree_prev(cursor->node) : NULL, data);
+    OBJ_READ_UNLOCK(cursor->tree);
+    return failed;
+}
+
 PUBLIC void
 avl_tree_destroy (avl_tree_t *tree,
         destruction_handler_t dh_fptr, void *extra_arg)
@@ -69,6 +69,26 @@ static inline int
 avl_tree_size (avl_tree_t *tree)
 { return tree->n; }
 
+/*
+ * A cursor walks the tree one user data at a time in sorted order, in
+ * either direction.  Unlike a traverse function, the loop is the
+ * caller's own, so it can stop whenever it likes, walk two trees side
+ * by side (as in a merge join) & have its body inlined.
+ *
+ * A cursor simply points at a node.  Nodes are only ever relinked by
+ * insertions & removals, never moved or copied, so a cursor stays
+ * valid thru any change to the tree EXCEPT the removal of the user
+ * data it is on, which frees its node.  It must be positioned again
+ * (first, last or seek) before being used after that.  Every call
+ * takes the lock of the tree by itself, nothing is held in between.
+ */
+typedef struct avl_cursor_s {
+
+    avl_tree_t *tree;
+    avl_node_t *node;
+
+} avl_cursor_t;
+
 extern int 
 avl_tree_init (avl_tree_t *tree,
         boolean make_it_thread_safe,
@@ -101,6 +121,20 @@ avl_tree_remove (avl_tree_t *tree,
         void *data_to_be_removed,
         void **data_actually_removed);
 
+/*
+ * Removes every user data for which 'match(user_data, arg)' returns
+ * non zero, calling 'dcbf' (if not NULL) for each one.  Instead of
+ * removing & rebalancing one node at a time, it goes over the tree
+ * once & rebuilds it, perfectly balanced, from the nodes which are
+ * left.  So it takes O(n) regardless of how many are removed, which
+ * is much faster than removing them one by one when many are removed.
+ * Returns how many were removed.
+ */
+extern int
+avl_tree_remove_matching (avl_tree_t *tree,
+        two_parameter_function_pointer match, void *arg,
+        destruction_handler_t dcbf, void *extra_arg);
+
 /*
  * Morris traverses the tree down from the specified 'root' parameter.
  * If 'root' is NULL, the entire tree will be traversed.
@@ -127,6 +161,21 @@ avl_tree_morris_traverse (avl_tree_t *tree, avl_node_t *root,
         traverse_function_pointer tfn,
         void *p0, void *p1, void *p2, void *p3);
 
+/*
+ * Calls 'tfn' (with the same parameters as above) in sorted order for
+ * every user data which is >= 'low' and <= 'high', as decided by the
+ * compare function of the tree.  A NULL 'low' or 'high' means the
+ * range is unbounded at that end.  Neither needs to be in the tree.
+ * Without recursion or extra storage, it takes O(log n + k) for
+ * k user data in the range.  Unlike the morris traversal, it stops
+ * as soon as 'tfn' returns non zero, which is then returned.
+ */
+extern int
+avl_tree_range_traverse (avl_tree_t *tree,
+        void *low, void *high,
+        traverse_function_pointer tfn,
+        void *p0, void *p1, void *p2, void *p3);
+
 /*
  * This is a similar iterative way of traversing the tree,
  * always starting from the leftmost nodes.
@@ -136,6 +185,31 @@ avl_tree_iterate (avl_tree_t *tree, avl_node_t *root,
         traverse_function_pointer tfn,
         void *p0, void *p1, void *p2, void *p3);
 
+/*
+ * Cursor calls return 0 & place the user data the cursor moved onto
+ * into 'data', or return ENODATA (& set 'data' to NULL) when there is
+ * none.  Once past either end, 'next' & 'prev' keep returning ENODATA.
+ *
+ * 'seek' positions the cursor on the first user data which is >= 'key'
+ * as decided by the compare function of the tree, 'key' itself need
+ * not be in the tree.  A NULL 'key' is the same as 'first'.
+ */
+extern int
+avl_cursor_first (avl_tree_t *tree, avl_cursor_t *cursor, void **data);
+
+extern int
+avl_cursor_last (avl_tree_t *tree, avl_cursor_t *cursor, void **data);
+
+extern int
+avl_cursor_seek (avl_tree_t *tree, avl_cursor_t *cursor,
+        void *key, void **data);
+
+extern int
+avl_cursor_next (avl_cursor_t *cursor, void **data);
+
+extern int
+avl_cursor_prev (avl_cursor_t *cursor, void **data);
+
 /*
  * Note that this destroys ONLY the contents of the object, NOT
  * the object itself, since it is not known whether this object
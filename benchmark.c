@@ -0,0 +1,599 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Benchmark driver, runs the cases registered in benchmark_cases.c
+**
+** usage: benchmark [-l] [-c case[,case..]] [-t threads[,threads..]]
+**                  [-n ops per thread] [-r repetitions] [-w warm ups]
+**                  [-p] [-a allocator] [-f table|csv|json] [-L label]
+**
+**      -l      list all the cases and exit
+**      -c      run only the cases whose names contain any of these
+**      -t      thread counts to run every case with (default 1,2,4,8)
+**      -n      operations performed by each thread (default per case)
+**      -r      timed repetitions of each run (default 5)
+**      -w      untimed warm up runs before the repetitions (default 1)
+**      -p      pin every thread to its own cpu
+**      -a      malloc, chunk, buffer, slab, arena or hugepage: all the
+**              containers share one parent mem monitor allocating
+**              from this (default is every container on its own)
+**      -f      output format (default table)
+**      -L      label stamped on every result, typically the version
+**              of the library, to tell runs apart when comparing them
+**
+** Besides the times of the repetitions, the p50, p99 & p99.9 latencies
+** of the operations are reported for the cases which time them, and
+** the mean of every metric the case reported over the repetitions.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/* for cpu pinning */
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "timer_object.h"
+#include "mem_allocators.h"
+#include "benchmark.h"
+
+#define BENCHMARK_MAX_THREADS           256
+#define BENCHMARK_MAX_THREAD_COUNTS     16
+#define BENCHMARK_MAX_REPETITIONS       1000
+#define BENCHMARK_DEFAULT_OPS           100000
+#define BENCHMARK_MAX_METRICS           8
+
+typedef enum { FORMAT_TABLE, FORMAT_CSV, FORMAT_JSON } output_format_t;
+
+/* all the command line options */
+static struct {
+
+    char *case_filter;
+    int thread_counts [BENCHMARK_MAX_THREAD_COUNTS];
+    int n_thread_counts;
+    int ops_per_thread;
+    int repetitions;
+    int warm_ups;
+    int pin;
+    char *allocator;
+    output_format_t format;
+    char *label;
+
+} options;
+
+/* one timed run of a case */
+typedef struct benchmark_thread_s {
+
+    benchmark_case_t *bcp;
+    void *context;
+    int thread;
+    int ops;
+    nano_seconds_t end;
+
+} benchmark_thread_t;
+
+/* a metric reported by a case, added up over the repetitions */
+typedef struct benchmark_metric_s {
+
+    char *name;
+    double sum;
+    int count;
+
+} benchmark_metric_t;
+
+/* the parent mem monitor & the pools/arena it may be allocating from */
+PUBLIC mem_monitor_t *benchmark_parent_mem_monitor = NULL;
+static mem_monitor_t parent_mem_monitor;
+static mem_allocator_t allocator;
+static chunk_manager_t allocator_chunks;
+static buffer_manager_t allocator_buffers;
+static mem_arena_t allocator_arena;
+static slab_allocator_t allocator_slabs;
+
+static size_count_tuple_t allocator_buffer_pools [] = {
+    { 32, 200000 }, { 64, 200000 }, { 128, 100000 },
+    { 256, 50000 }, { 1024, 10000 }, { -1, -1 }
+};
+
+/* latency of the operations, only recorded during the latency run */
+PUBLIC histogram_t *benchmark_latency = NULL;
+static histogram_t latency;
+
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static benchmark_metric_t metrics [BENCHMARK_MAX_METRICS];
+static int n_metrics;
+static volatile int metrics_wanted;
+static volatile int run_failure;
+
+static volatile int threads_ready;
+static volatile int threads_go;
+static int n_cpus;
+
+static void
+pin_to_cpu (int thread)
+{
+#ifdef __linux__
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(thread % n_cpus, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+static void *
+benchmark_thread (void *arg)
+{
+    benchmark_thread_t *btp = (benchmark_thread_t*) arg;
+
+    if (options.pin) pin_to_cpu(btp->thread);
+    __sync_fetch_and_add(&threads_ready, 1);
+    while (0 == threads_go);
+    btp->bcp->run(btp->context, btp->thread, btp->ops);
+    btp->end = time_now();
+
+    return NULL;
+}
+
+PUBLIC void
+benchmark_metric (char *name, double value)
+{
+    int m;
+
+    if (!metrics_wanted) return;
+    pthread_mutex_lock(&metrics_lock);
+    for (m = 0; (m < n_metrics) && strcmp(metrics[m].name, name); m++);
+    if (m < BENCHMARK_MAX_METRICS) {
+        if (m == n_metrics) {
+            metrics[m].name = name;
+            metrics[m].sum = 0;
+            metrics[m].count = 0;
+            n_metrics++;
+        }
+        metrics[m].sum += value;
+        metrics[m].count++;
+    }
+    pthread_mutex_unlock(&metrics_lock);
+}
+
+PUBLIC void
+benchmark_failed (int error)
+{
+    __sync_bool_compare_and_swap(&run_failure, 0, error);
+}
+
+/*
+ * Sets up the parent mem monitor allocating from the named allocator.
+ */
+static int
+benchmark_allocator_init (char *name)
+{
+    int failed = mem_monitor_init(&parent_mem_monitor, MEM_MONITOR_SHARDED);
+
+    if (failed) return failed;
+    if (0 == strcmp(name, "chunk")) {
+        failed = chunk_manager_init(&allocator_chunks, true,
+            MAX_CHUNK_SIZE, 1024, NULL);
+        mem_allocator_chunk_manager_init(&allocator, &allocator_chunks);
+    } else if (0 == strcmp(name, "buffer")) {
+        failed = buffer_manager_initialize(&allocator_buffers, true,
+            allocator_buffer_pools, NULL);
+        mem_allocator_buffer_manager_init(&allocator, &allocator_buffers);
+    } else if (0 == strcmp(name, "slab")) {
+        failed = slab_allocator_init(&allocator_slabs, true, NULL);
+        mem_allocator_slab_allocator_init(&allocator, &allocator_slabs);
+    } else if ((0 == strcmp(name, "arena")) ||
+               (0 == strcmp(name, "hugepage"))) {
+        failed = mem_arena_init(&allocator_arena, true, 0,
+            0 == strcmp(name, "hugepage"));
+        mem_allocator_arena_init(&allocator, &allocator_arena);
+    } else if (strcmp(name, "malloc")) {
+        return EINVAL;
+    }
+    if (failed) return failed;
+    if (strcmp(name, "malloc")) {
+        mem_monitor_set_allocator(&parent_mem_monitor, &allocator);
+    }
+    benchmark_parent_mem_monitor = &parent_mem_monitor;
+
+    return 0;
+}
+
+/*
+ * An arena never gives anything back, so it is started afresh
+ * once a run has freed everything it allocated from it.
+ */
+static void
+benchmark_allocator_recycle (void)
+{
+    boolean huge;
+
+    if ((benchmark_parent_mem_monitor != &parent_mem_monitor) ||
+        (allocator.context != &allocator_arena) ||
+        (mem_monitor_bytes_used(&parent_mem_monitor) != 0))
+            return;
+    huge = allocator_arena.use_huge_pages;
+    mem_arena_destroy(&allocator_arena);
+    mem_arena_init(&allocator_arena, true, 0, huge);
+}
+
+/*
+ * Runs a case once with all the threads released at the same time.
+ * Returns 0 and how long it took for all of them to finish, or an errno.
+ */
+static int
+benchmark_run_once (benchmark_case_t *bcp, int n_threads, int ops,
+    nano_seconds_t *elapsed)
+{
+    benchmark_thread_t threads [BENCHMARK_MAX_THREADS];
+    pthread_t tids [BENCHMARK_MAX_THREADS];
+    nano_seconds_t start, end;
+    void *context;
+    int t, created, failed = 0;
+
+    context = bcp->setup(n_threads, ops);
+    if (NULL == context) return ENOMEM;
+
+    run_failure = 0;
+
+    threads_ready = threads_go = 0;
+    for (created = 0; created < n_threads; created++) {
+        threads[created].bcp = bcp;
+        threads[created].context = context;
+        threads[created].thread = created;
+        threads[created].ops = ops;
+        failed = pthread_create(&tids[created], NULL,
+                    benchmark_thread, &threads[created]);
+        if (failed) break;
+    }
+    while (threads_ready < created) sched_yield();
+    start = time_now();
+    threads_go = 1;
+
+    end = start;
+    for (t = 0; t < created; t++) {
+        pthread_join(tids[t], NULL);
+        if (threads[t].end > end) end = threads[t].end;
+    }
+    bcp->teardown(context);
+    benchmark_allocator_recycle();
+    *elapsed = end - start;
+
+    return failed ? failed : run_failure;
+}
+
+static int
+compare_times (const void *t1, const void *t2)
+{
+    nano_seconds_t n1 = *((nano_seconds_t*) t1);
+    nano_seconds_t n2 = *((nano_seconds_t*) t2);
+
+    return (n1 > n2) ? 1 : ((n1 < n2) ? -1 : 0);
+}
+
+static bool
+case_selected (benchmark_case_t *bcp)
+{
+    char filter [256], *name, *save;
+
+    if (NULL == options.case_filter) return true;
+    strncpy(filter, options.case_filter, sizeof(filter) - 1);
+    filter[sizeof(filter) - 1] = 0;
+    for (name = strtok_r(filter, ",", &save); name;
+         name = strtok_r(NULL, ",", &save)) {
+            if (strstr(bcp->name, name)) return true;
+    }
+    return false;
+}
+
+static void
+report_header (void)
+{
+    char host [64] = "unknown";
+
+    gethostname(host, sizeof(host) - 1);
+    switch (options.format) {
+    case FORMAT_TABLE:
+        printf("\n%s: %d cpus, %d repetitions, %d warm ups%s%s%s\n\n",
+            options.label, n_cpus, options.repetitions, options.warm_ups,
+            options.pin ? ", pinned" : "",
+            options.allocator ? ", allocator " : "",
+            options.allocator ? options.allocator : "");
+        printf("%-20s %7s %9s %10s %10s %10s %10s %10s\n",
+            "case", "threads", "ops", "min ns", "median ns", "mean ns",
+            "max ns", "Mops/s");
+        break;
+    case FORMAT_CSV:
+        printf("label,host,cpus,pinned,allocator,case,threads,ops_per_thread,"
+            "repetitions,min_ns,median_ns,mean_ns,max_ns,mops_per_sec,"
+            "p50_ns,p99_ns,p999_ns,metrics\n");
+        break;
+    case FORMAT_JSON:
+        printf("{\n  \"label\": \"%s\",\n  \"host\": \"%s\",\n"
+            "  \"started\": %lld,\n  \"cpus\": %d,\n  \"pinned\": %s,\n"
+            "  \"allocator\": \"%s\",\n"
+            "  \"repetitions\": %d,\n  \"warm_ups\": %d,\n"
+            "  \"results\": [",
+            options.label, host, (long long int) time(NULL), n_cpus,
+            options.pin ? "true" : "false",
+            options.allocator ? options.allocator : "none",
+            options.repetitions, options.warm_ups);
+        break;
+    }
+}
+
+/*
+ * All the times are per operation as seen by one thread, ie. the
+ * elapsed time divided by the operations each thread performed.
+ * The latencies are left out if the case does not time its operations.
+ */
+static void
+report_result (benchmark_case_t *bcp, int n_threads, int ops,
+    nano_seconds_t *elapsed, int count)
+{
+    static int reported = 0;
+    char host [64] = "unknown";
+    double min, median, mean = 0, max, mops;
+    unsigned long long int p50 = 0, p99 = 0, p999 = 0;
+    boolean timed = histogram_count(&latency) > 0;
+    int r, m;
+
+    qsort(elapsed, count, sizeof(nano_seconds_t), compare_times);
+    for (r = 0; r < count; r++) mean += elapsed[r];
+    mean /= (double) count * ops;
+    min = (double) elapsed[0] / ops;
+    max = (double) elapsed[count - 1] / ops;
+    median = (count & 1) ? (double) elapsed[count / 2] / ops :
+        (double) (elapsed[(count / 2) - 1] + elapsed[count / 2]) / (2.0 * ops);
+    mops = (median > 0) ? ((double) n_threads * 1000.0 / median) : 0;
+    if (timed) {
+        p50 = histogram_percentile(&latency, 50.0);
+        p99 = histogram_percentile(&latency, 99.0);
+        p999 = histogram_percentile(&latency, 99.9);
+    }
+
+    switch (options.format) {
+    case FORMAT_TABLE:
+        printf("%-20s %7d %9d %10.2lf %10.2lf %10.2lf %10.2lf %10.3lf\n",
+            bcp->name, n_threads, ops, min, median, mean, max, mops);
+        if (timed) {
+            printf("%-20s latency ns p50 %llu p99 %llu p99.9 %llu\n",
+                "", p50, p99, p999);
+        }
+        for (m = 0; m < n_metrics; m++) {
+            printf("%-20s %s %.2lf\n", "", metrics[m].name,
+                metrics[m].sum / metrics[m].count);
+        }
+        break;
+    case FORMAT_CSV:
+        gethostname(host, sizeof(host) - 1);
+        printf("%s,%s,%d,%d,%s,%s,%d,%d,%d,%.3lf,%.3lf,%.3lf,%.3lf,%.4lf,",
+            options.label, host, n_cpus, options.pin,
+            options.allocator ? options.allocator : "none", bcp->name,
+            n_threads, ops, count, min, median, mean, max, mops);
+        if (timed) printf("%llu,%llu,%llu,", p50, p99, p999);
+        else printf(",,,");
+        for (m = 0; m < n_metrics; m++) {
+            printf("%s%s=%.3lf", m ? ";" : "", metrics[m].name,
+                metrics[m].sum / metrics[m].count);
+        }
+        printf("\n");
+        break;
+    case FORMAT_JSON:
+        printf("%s\n    { \"case\": \"%s\", \"threads\": %d, "
+            "\"ops_per_thread\": %d, \"min_ns\": %.3lf, \"median_ns\": %.3lf, "
+            "\"mean_ns\": %.3lf, \"max_ns\": %.3lf, \"mops_per_sec\": %.4lf",
+            reported ? "," : "", bcp->name, n_threads, ops,
+            min, median, mean, max, mops);
+        if (timed) {
+            printf(", \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu",
+                p50, p99, p999);
+        }
+        for (m = 0; m < n_metrics; m++) {
+            printf(", \"%s\": %.3lf", metrics[m].name,
+                metrics[m].sum / metrics[m].count);
+        }
+        printf(" }");
+        break;
+    }
+    reported++;
+    fflush(stdout);
+}
+
+static void
+report_trailer (void)
+{
+    if (options.format == FORMAT_JSON) printf("\n  ]\n}\n");
+}
+
+static int
+benchmark_case (benchmark_case_t *bcp)
+{
+    nano_seconds_t elapsed [BENCHMARK_MAX_REPETITIONS], ignored;
+    boolean timed = true;
+    int i, r, n_threads, ops, failed = 0;
+
+    ops = options.ops_per_thread ? options.ops_per_thread :
+        (bcp->default_ops ? bcp->default_ops : BENCHMARK_DEFAULT_OPS);
+    for (i = 0; i < options.n_thread_counts; i++) {
+        n_threads = options.thread_counts[i];
+        if (n_threads > bcp->max_threads) continue;
+        for (r = 0; r < options.warm_ups; r++) {
+            failed = benchmark_run_once(bcp, n_threads, ops, &ignored);
+            if (failed) return failed;
+        }
+        n_metrics = 0;
+        metrics_wanted = 1;
+        for (r = 0; r < options.repetitions; r++) {
+            failed = benchmark_run_once(bcp, n_threads, ops, &elapsed[r]);
+            if (failed) break;
+        }
+        metrics_wanted = 0;
+        if (failed) return failed;
+
+        /* no more latency runs once a case turns out not to time anything */
+        histogram_reset(&latency);
+        if (timed) {
+            benchmark_latency = &latency;
+            failed = benchmark_run_once(bcp, n_threads, ops, &ignored);
+            benchmark_latency = NULL;
+            if (failed) return failed;
+            timed = histogram_count(&latency) > 0;
+        }
+        report_result(bcp, n_threads, ops, elapsed, options.repetitions);
+    }
+    return 0;
+}
+
+static int
+parse_thread_counts (char *list)
+{
+    char *count, *save;
+    int n;
+
+    options.n_thread_counts = 0;
+    for (count = strtok_r(list, ",", &save); count;
+         count = strtok_r(NULL, ",", &save)) {
+            n = atoi(count);
+            if ((n < 1) || (n > BENCHMARK_MAX_THREADS) ||
+                (options.n_thread_counts >= BENCHMARK_MAX_THREAD_COUNTS))
+                    return EINVAL;
+            options.thread_counts[options.n_thread_counts++] = n;
+    }
+    return options.n_thread_counts ? 0 : EINVAL;
+}
+
+static void
+usage (char *program)
+{
+    fprintf(stderr,
+        "usage: %s [-l] [-c case[,case..]] [-t threads[,threads..]]\n"
+        "        [-n ops per thread] [-r repetitions] [-w warm ups]\n"
+        "        [-p] [-a malloc|chunk|buffer|slab|arena|hugepage]\n"
+        "        [-f table|csv|json] [-L label]\n", program);
+    exit(1);
+}
+
+int main (int argc, char *argv[])
+{
+    benchmark_case_t *bcp;
+    char default_threads [] = "1,2,4,8";
+    int c, failed;
+
+    n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_cpus < 1) n_cpus = 1;
+    options.repetitions = 5;
+    options.warm_ups = 1;
+    options.format = FORMAT_TABLE;
+    options.label = "utils_lib";
+    parse_thread_counts(default_threads);
+
+    while ((c = getopt(argc, argv, "lc:t:n:r:w:pa:f:L:")) != -1) {
+        switch (c) {
+        case 'l':
+            for (bcp = benchmark_cases; bcp->name; bcp++) {
+                printf("%-20s %s\n", bcp->name, bcp->description);
+            }
+            return 0;
+        case 'c': options.case_filter = optarg; break;
+        case 't': if (parse_thread_counts(optarg)) usage(argv[0]); break;
+        case 'n': options.ops_per_thread = atoi(optarg); break;
+        case 'r': options.repetitions = atoi(optarg); break;
+        case 'w': options.warm_ups = atoi(optarg); break;
+        case 'p': options.pin = 1; break;
+        case 'a': options.allocator = optarg; break;
+        case 'f':
+            if (0 == strcmp(optarg, "table")) {
+                options.format = FORMAT_TABLE;
+            } else if (0 == strcmp(optarg, "csv")) {
+                options.format = FORMAT_CSV;
+            } else if (0 == strcmp(optarg, "json")) {
+                options.format = FORMAT_JSON;
+            } else {
+                usage(argv[0]);
+            }
+            break;
+        case 'L': options.label = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if ((options.ops_per_thread < 0) ||
+        (options.repetitions < 1) ||
+        (options.repetitions > BENCHMARK_MAX_REPETITIONS) ||
+        (options.warm_ups < 0))
+            usage(argv[0]);
+    if (options.allocator) {
+        failed = benchmark_allocator_init(options.allocator);
+        if (failed) {
+            fprintf(stderr, "allocator %s could not be set up: %s\n",
+                options.allocator, strerror(failed));
+            usage(argv[0]);
+        }
+    }
+
+    failed = histogram_init(&latency, "latency", true);
+    if (failed) {
+        fprintf(stderr, "latency histogram could not be set up: %s\n",
+            strerror(failed));
+        return 1;
+    }
+
+    report_header();
+    for (bcp = benchmark_cases; bcp->name; bcp++) {
+        if (!case_selected(bcp)) continue;
+        failed = benchmark_case(bcp);
+        if (failed) {
+            fprintf(stderr, "case %s failed: %s\n",
+                bcp->name, strerror(failed));
+            return 1;
+        }
+    }
+    report_trailer();
+    histogram_destroy(&latency);
+
+    return 0;
+}
+
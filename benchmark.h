@@ -0,0 +1,156 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Benchmark harness.
+**
+** Every benchmark is a 'benchmark_case_t' registered in the
+** 'benchmark_cases' table.  The driver ('benchmark' in the Makefile)
+** runs the selected cases for every requested thread count, with
+** warm up runs & repetitions, optionally pinning each thread to its
+** own cpu, and reports the results as a table, CSV or JSON so that
+** results of different runs/machines/library versions can be compared.
+**
+** For every repetition, a case is set up (which is NOT timed), then all
+** the threads are released at the same time to each perform the same
+** number of operations on the shared context, and then it is torn down.
+** The time measured is from when the threads are released until the
+** last one finishes.
+**
+** After the repetitions, one more run is made with 'benchmark_latency'
+** set, for the cases which time their individual operations to report
+** the p50, p99 & p99.9 latencies.  Cases can also report figures other
+** than time, such as the memory used per object, as metrics.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+#include "mem_monitor_object.h"
+#include "timer_object.h"
+
+typedef struct benchmark_case_s {
+
+    /* short unique name, used for selecting & reporting */
+    char *name;
+    char *description;
+
+    /*
+     * how many threads can run this case at the same time,
+     * 1 if the case is not meant to be run concurrently.
+     */
+    int max_threads;
+
+    /* operations per thread if not specified, 0 for the driver default */
+    int default_ops;
+
+    /*
+     * Called before every repetition with the thread count and the
+     * number of operations each thread will perform.  Prepares &
+     * returns the context shared by all the threads, NULL on failure.
+     */
+    void *(*setup)(int n_threads, int ops_per_thread);
+
+    /* performs 'ops' operations as the thread numbered 'thread' */
+    void (*run)(void *context, int thread, int ops);
+
+    void (*teardown)(void *context);
+
+} benchmark_case_t;
+
+/* all the registered cases, terminated by an entry with a NULL name */
+extern benchmark_case_t benchmark_cases [];
+
+/*
+ * Parent mem monitor every container created by a case must use,
+ * NULL unless an allocator is selected on the command line.
+ */
+extern mem_monitor_t *benchmark_parent_mem_monitor;
+
+/*
+ * Histogram every timed operation is recorded into, only set during
+ * the latency run & NULL at all other times so that the repetitions
+ * are not slowed down by the timing.
+ */
+extern histogram_t *benchmark_latency;
+
+/* performs 'operation' recording how long it took if latency is wanted */
+#define BENCHMARK_TIMED(operation) \
+    do { \
+        if (benchmark_latency) { \
+            cycles_t __start = cycles_now(); \
+            operation; \
+            histogram_record(benchmark_latency, cycles_now() - __start); \
+        } else { \
+            operation; \
+        } \
+    } while (0)
+
+/*
+ * Reports a figure of the current repetition which is not its time,
+ * from 'run' or 'teardown'.  The driver reports the mean of every
+ * metric over all the repetitions & ignores them in the other runs.
+ */
+extern void
+benchmark_metric (char *name, double value);
+
+/*
+ * Called by a case finding out that its run did not do what it
+ * should have.  The driver reports the case as failed with 'error'.
+ */
+extern void
+benchmark_failed (int error);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif /* __BENCHMARK_H__ */
+
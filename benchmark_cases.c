@@ -0,0 +1,1824 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** All the registered benchmark cases, see benchmark.h
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "benchmark.h"
+#include "debug_framework.h"
+#include "lock_object.h"
+#include "avl_tree_object.h"
+#include "index_object.h"
+#include "radix_tree_object.h"
+#include "ordered_list.h"
+#include "lifo.h"
+#include "list.h"
+#include "chunk_manager.h"
+#include "buffer_manager.h"
+#include "slab_allocator.h"
+#include "tlv_manager.h"
+#include "line_counters.h"
+#include "ez_sprintf.h"
+#include "object_manager.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Every thread works on its own set of keys.  Key numbers are scrambled
+ * so that containers are not always fed in ascending order, but are
+ * still unique and never 0 (a NULL user data).
+ */
+static inline long long int
+key_number (int thread, int ops_per_thread, int i)
+{
+    unsigned int n = (unsigned int) ((thread * ops_per_thread) + i);
+
+    return ((long long int) (n * 2654435761u)) + 1;
+}
+
+#define KEY(thread, ops, i)     pointer_from_integer(key_number(thread, ops, i))
+
+static int
+compare_keys (void *k1, void *k2)
+{
+    long long int n1 = integer_from_pointer(k1);
+    long long int n2 = integer_from_pointer(k2);
+
+    return (n1 > n2) ? 1 : ((n1 < n2) ? -1 : 0);
+}
+
+/*
+ * Most cases need nothing more than one object, the thread
+ * count and how many operations each thread will perform.
+ */
+typedef struct benchmark_context_s {
+
+    int n_threads;
+    int ops_per_thread;
+    union {
+        avl_tree_t avl;
+        index_obj_t index;
+        radix_tree_t radix;
+        ordered_list_t olist;
+        lifo_t lifo;
+        list_t list;
+        chunk_manager_t chunks;
+        buffer_manager_t buffers;
+        slab_allocator_t slabs;
+        lock_obj_t lock;
+        object_manager_t om;
+    } u;
+
+} benchmark_context_t;
+
+static benchmark_context_t *
+context_create (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = calloc(1, sizeof(benchmark_context_t));
+
+    if (ctx) {
+        ctx->n_threads = n_threads;
+        ctx->ops_per_thread = ops_per_thread;
+    }
+    return ctx;
+}
+
+/* inserts every key which all the threads will be using */
+#define PRELOAD(ctx, insert_call) \
+    do { \
+        int __t, __i; \
+        void *key; \
+        for (__t = 0; __t < (ctx)->n_threads; __t++) { \
+            for (__i = 0; __i < (ctx)->ops_per_thread; __i++) { \
+                key = KEY(__t, (ctx)->ops_per_thread, __i); \
+                if (insert_call) { \
+                    free(ctx); \
+                    return NULL; \
+                } \
+            } \
+        } \
+    } while (0)
+
+/******************************************************************************
+ *
+ * avl tree
+ */
+
+static void *
+avl_setup (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    avl_tree_init(&ctx->u.avl, n_threads > 1, false, compare_keys,
+        benchmark_parent_mem_monitor);
+    return ctx;
+}
+
+static void *
+avl_setup_loaded (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = avl_setup(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    PRELOAD(ctx, avl_tree_insert(&ctx->u.avl, key, NULL, false));
+    return ctx;
+}
+
+static void
+avl_insert_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        BENCHMARK_TIMED(
+            avl_tree_insert(&ctx->u.avl, KEY(thread, ops, i), NULL, false));
+    }
+}
+
+static void
+avl_search_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    void *found;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        BENCHMARK_TIMED(
+            avl_tree_search(&ctx->u.avl, KEY(thread, ops, i), &found));
+    }
+}
+
+static void
+avl_remove_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    void *removed;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        BENCHMARK_TIMED(
+            avl_tree_remove(&ctx->u.avl, KEY(thread, ops, i), &removed));
+    }
+}
+
+/*
+ * Walks visit 'ops' user data in order, from the smallest, one
+ * through the traversal callback & the other through a cursor.
+ */
+static int
+avl_walk_tfn (void *tree, void *node, void *data,
+    void *count, void *limit, void *p2, void *p3)
+{
+    return ++*((int*) count) >= *((int*) limit);
+}
+
+static void
+avl_walk_callback_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int count = 0;
+
+    avl_tree_range_traverse(&ctx->u.avl, NULL, NULL, avl_walk_tfn,
+        &count, &ops, NULL, NULL);
+}
+
+static void
+avl_walk_cursor_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    avl_cursor_t cursor;
+    void *data;
+    int count = 0;
+
+    if (avl_cursor_first(&ctx->u.avl, &cursor, &data)) return;
+    while ((++count < ops) && (0 == avl_cursor_next(&cursor, &data)));
+}
+
+static void
+avl_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+
+    avl_tree_destroy(&ctx->u.avl, NULL, NULL);
+    free(ctx);
+}
+
+/******************************************************************************
+ *
+ * index object
+ */
+
+static void *
+index_setup (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    index_obj_init(&ctx->u.index, n_threads > 1, false, compare_keys,
+        n_threads * ops_per_thread, 0, benchmark_parent_mem_monitor);
+    return ctx;
+}
+
+static void *
+index_setup_loaded (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = index_setup(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    PRELOAD(ctx, index_obj_insert(&ctx->u.index, key, NULL, false));
+    return ctx;
+}
+
+static void
+index_insert_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        BENCHMARK_TIMED(
+            index_obj_insert(&ctx->u.index, KEY(thread, ops, i), NULL, false));
+    }
+}
+
+static void
+index_search_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    void *found;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        BENCHMARK_TIMED(index_obj_search(&ctx->u.index,
+            KEY(thread, ops, i), &found, NULL));
+    }
+}
+
+static void
+index_walk_cursor_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    index_obj_cursor_t cursor;
+    void *data;
+    int count = 0;
+
+    if (index_obj_cursor_first(&ctx->u.index, &cursor, &data)) return;
+    while ((++count < ops) && (0 == index_obj_cursor_next(&cursor, &data)));
+}
+
+static void
+index_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+
+    index_obj_destroy(&ctx->u.index, NULL, NULL);
+    free(ctx);
+}
+
+/******************************************************************************
+ *
+ * radix tree, keyed by the bytes of the key numbers
+ */
+
+static void *
+radix_setup (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    radix_tree_init(&ctx->u.radix, n_threads > 1, false,
+        benchmark_parent_mem_monitor);
+    return ctx;
+}
+
+static void *
+radix_setup_loaded (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = radix_setup(n_threads, ops_per_thread);
+    long long int n;
+
+    if (NULL == ctx) return NULL;
+    PRELOAD(ctx, ((n = integer_from_pointer(key)),
+        radix_tree_insert(&ctx->u.radix, &n, sizeof(n), key, NULL)));
+    return ctx;
+}
+
+static void
+radix_insert_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    long long int n;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        n = key_number(thread, ops, i);
+        BENCHMARK_TIMED(radix_tree_insert(&ctx->u.radix, &n, sizeof(n),
+            pointer_from_integer(n), NULL));
+    }
+}
+
+static void
+radix_search_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    long long int n;
+    void *found;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        n = key_number(thread, ops, i);
+        BENCHMARK_TIMED(
+            radix_tree_search(&ctx->u.radix, &n, sizeof(n), &found));
+    }
+}
+
+/*
+ * The callback traversal cannot stop early & marks the nodes as it
+ * goes, so both walks visit the whole tree & only one thread can.
+ */
+static int
+radix_walk_tfn (void *rtp, void *node, void *data,
+    void *key, void *key_length, void *count, void *p6)
+{
+    (*((int*) count))++;
+    return 0;
+}
+
+static void
+radix_walk_callback_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int count = 0;
+
+    radix_tree_traverse(&ctx->u.radix, radix_walk_tfn, &count, NULL);
+}
+
+static void
+radix_walk_cursor_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    radix_tree_cursor_t cursor;
+    void *data;
+    int failed;
+
+    failed = radix_tree_cursor_first(&ctx->u.radix, &cursor, &data);
+    while (0 == failed) failed = radix_tree_cursor_next(&cursor, &data);
+}
+
+static void
+radix_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+
+    radix_tree_destroy(&ctx->u.radix);
+    free(ctx);
+}
+
+/******************************************************************************
+ *
+ * ordered list
+ */
+
+static void *
+olist_setup (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    ordered_list_init(&ctx->u.olist, n_threads > 1, false, compare_keys,
+        benchmark_parent_mem_monitor);
+    return ctx;
+}
+
+static void *
+olist_setup_loaded (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = olist_setup(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    PRELOAD(ctx, ordered_list_add(&ctx->u.olist, key));
+    return ctx;
+}
+
+static void
+olist_add_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        ordered_list_add(&ctx->u.olist, KEY(thread, ops, i));
+    }
+}
+
+static void
+olist_search_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    void *found;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        ordered_list_search(&ctx->u.olist, KEY(thread, ops, i), &found);
+    }
+}
+
+static void
+olist_walk_cursor_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    ordered_list_cursor_t cursor;
+    void *data;
+    int count = 0;
+
+    if (ordered_list_cursor_first(&ctx->u.olist, &cursor, &data)) return;
+    while ((++count < ops) &&
+        (0 == ordered_list_cursor_next(&cursor, &data)));
+}
+
+static void
+olist_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+
+    ordered_list_destroy(&ctx->u.olist, NULL, NULL);
+    free(ctx);
+}
+
+/******************************************************************************
+ *
+ * lifo & list, one operation is an addition followed by a removal
+ */
+
+static void *
+lifo_setup (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    lifo_init(&ctx->u.lifo, n_threads > 1, false, 0,
+        benchmark_parent_mem_monitor);
+    return ctx;
+}
+
+static void
+lifo_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    lifo_node_t *node;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        if (0 == lifo_add_data(&ctx->u.lifo, KEY(thread, ops, i), &node)) {
+            lifo_remove_data(&ctx->u.lifo, KEY(thread, ops, i));
+        }
+    }
+}
+
+static void
+lifo_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+
+    lifo_destroy(&ctx->u.lifo);
+    free(ctx);
+}
+
+static void *
+list_setup (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    list_init(&ctx->u.list, n_threads > 1, false, 0,
+        benchmark_parent_mem_monitor);
+    return ctx;
+}
+
+static void
+list_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    list_node_t *node;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        if (0 == list_append_data(&ctx->u.list, KEY(thread, ops, i), &node)) {
+            list_remove_data(&ctx->u.list, KEY(thread, ops, i));
+        }
+    }
+}
+
+static void
+list_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+
+    list_destroy(&ctx->u.list);
+    free(ctx);
+}
+
+/******************************************************************************
+ *
+ * chunk & buffer managers, one operation is an allocation and a free
+ */
+
+#define BENCHMARK_CHUNK_SIZE            64
+#define BENCHMARK_CHUNKS_PER_GROUP      1024
+#define BENCHMARK_BURST                 64
+
+static void *
+chunk_setup (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    if (chunk_manager_init(&ctx->u.chunks, n_threads > 1,
+            BENCHMARK_CHUNK_SIZE, BENCHMARK_CHUNKS_PER_GROUP, NULL)) {
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+/* allocates bursts of chunks and frees them all, like a real user would */
+static void
+chunk_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    void *chunks [BENCHMARK_BURST];
+    int i, b;
+
+    for (i = 0; i < ops; i += BENCHMARK_BURST) {
+        for (b = 0; (b < BENCHMARK_BURST) && ((i + b) < ops); b++) {
+            BENCHMARK_TIMED(chunks[b] = chunk_alloc(&ctx->u.chunks));
+        }
+        while (b-- > 0) {
+            if (chunks[b]) chunk_free(chunks[b]);
+        }
+    }
+}
+
+static void
+chunk_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+
+    chunk_manager_destroy(&ctx->u.chunks);
+    free(ctx);
+}
+
+static void *
+buffer_setup (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+    size_count_tuple_t tuples [] = {
+        { 32, 64 * 1024 }, { 128, 64 * 1024 }, { 512, 64 * 1024 },
+        { 2048, 16 * 1024 }, { -1, -1 } };
+
+    if (NULL == ctx) return NULL;
+    if (buffer_manager_initialize(&ctx->u.buffers, n_threads > 1,
+            tuples, NULL)) {
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+static void
+buffer_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    void *buffers [BENCHMARK_BURST];
+    int i, b;
+
+    for (i = 0; i < ops; i += BENCHMARK_BURST) {
+        for (b = 0; (b < BENCHMARK_BURST) && ((i + b) < ops); b++) {
+            BENCHMARK_TIMED(buffers[b] =
+                buffer_allocate(&ctx->u.buffers, 16 + ((b * 37) % 2000)));
+        }
+        while (b-- > 0) {
+            if (buffers[b]) buffer_free(buffers[b]);
+        }
+    }
+}
+
+static void
+buffer_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+
+    buffer_manager_destroy(&ctx->u.buffers);
+    free(ctx);
+}
+
+/*
+ * The same mixed sizes as the buffer manager, from a slab
+ * allocator and from glibc malloc to compare against.
+ */
+static void *
+slab_setup (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    slab_allocator_init(&ctx->u.slabs, n_threads > 1, NULL);
+    return ctx;
+}
+
+static void
+slab_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    void *blocks [BENCHMARK_BURST];
+    int i, b;
+
+    for (i = 0; i < ops; i += BENCHMARK_BURST) {
+        for (b = 0; (b < BENCHMARK_BURST) && ((i + b) < ops); b++) {
+            BENCHMARK_TIMED(blocks[b] =
+                slab_allocate(&ctx->u.slabs, 16 + ((b * 37) % 2000)));
+        }
+        while (b-- > 0) slab_free(blocks[b]);
+    }
+}
+
+static void
+slab_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+
+    slab_allocator_destroy(&ctx->u.slabs);
+    free(ctx);
+}
+
+static void *
+malloc_setup (int n_threads, int ops_per_thread)
+{
+    return context_create(n_threads, ops_per_thread);
+}
+
+static void
+malloc_run (void *context, int thread, int ops)
+{
+    void *blocks [BENCHMARK_BURST];
+    int i, b;
+
+    for (i = 0; i < ops; i += BENCHMARK_BURST) {
+        for (b = 0; (b < BENCHMARK_BURST) && ((i + b) < ops); b++) {
+            BENCHMARK_TIMED(blocks[b] = malloc(16 + ((b * 37) % 2000)));
+        }
+        while (b-- > 0) free(blocks[b]);
+    }
+}
+
+/******************************************************************************
+ *
+ * locks, one operation is a grab & release of the same lock by all threads
+ */
+
+static void *
+lock_setup (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+
+    if (NULL == ctx) return NULL;
+    lock_obj_init(&ctx->u.lock);
+    return ctx;
+}
+
+static void
+lock_write_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        grab_write_lock(&ctx->u.lock);
+        release_write_lock(&ctx->u.lock);
+    }
+}
+
+static void
+lock_read_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        grab_read_lock(&ctx->u.lock);
+        release_read_lock(&ctx->u.lock);
+    }
+}
+
+static void
+lock_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+
+    lock_obj_destroy(&ctx->u.lock);
+    free(ctx);
+}
+
+/******************************************************************************
+ *
+ * tlv manager, every thread builds & parses its own buffer.  One operation
+ * is appending BENCHMARK_TLVS tlvs and parsing them all back.
+ */
+
+#define BENCHMARK_TLVS                  16
+#define BENCHMARK_TLV_SIZE              24
+#define BENCHMARK_TLV_BUFFER_SIZE       4096
+
+static void *
+tlv_setup (int n_threads, int ops_per_thread)
+{
+    return context_create(n_threads, ops_per_thread);
+}
+
+static void
+tlv_run (void *context, int thread, int ops)
+{
+    byte buffer [BENCHMARK_TLV_BUFFER_SIZE];
+    byte value [BENCHMARK_TLV_SIZE];
+    tlvm_t tlvm;
+    int i, t;
+
+    memset(value, thread, sizeof(value));
+    for (i = 0; i < ops; i++) {
+        tlvm_attach(&tlvm, buffer, sizeof(buffer), false);
+        for (t = 0; t < BENCHMARK_TLVS; t++) {
+            tlvm_append(&tlvm, t, sizeof(value), value);
+        }
+        tlvm_reset(&tlvm);
+        tlvm_parse(&tlvm);
+        tlvm_detach(&tlvm);
+    }
+}
+
+static void
+context_free (void *context)
+{
+    free(context);
+}
+
+/*
+ * A message of BENCHMARK_TLVS tlvs with a header in front, handed over
+ * to BENCHMARK_FANOUT consumers (handlers, I/O threads etc).  With plain
+ * buffers, the tlvs are copied behind the header & every consumer gets
+ * its own copy.  With message buffers, the tlvs are built in place, the
+ * header goes into the headroom & every consumer gets a reference.
+ */
+
+#define BENCHMARK_FANOUT                4
+#define BENCHMARK_HEADER_SIZE           16
+#define BENCHMARK_MESSAGE_SIZE          512
+
+static void *
+fanout_setup (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+    buffer_pool_spec_t specs [] = {
+        { BENCHMARK_MESSAGE_SIZE, 64, 64 * 1024 }, { -1, -1, -1 } };
+
+    if (NULL == ctx) return NULL;
+    if (buffer_manager_initialize_growable(&ctx->u.buffers, n_threads > 1,
+            specs, NULL)) {
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+/* a consumer only looks at the message */
+static volatile byte fanout_sink;
+
+static void
+fanout_copy_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    byte tlvs [BENCHMARK_MESSAGE_SIZE];
+    byte value [BENCHMARK_TLV_SIZE];
+    byte *message, *copies [BENCHMARK_FANOUT];
+    tlvm_t tlvm;
+    int i, t, size;
+
+    memset(value, thread, sizeof(value));
+    for (i = 0; i < ops; i++) {
+        tlvm_attach(&tlvm, tlvs, sizeof(tlvs), false);
+        for (t = 0; t < BENCHMARK_TLVS; t++) {
+            tlvm_append(&tlvm, t, sizeof(value), value);
+        }
+        size = BENCHMARK_HEADER_SIZE + tlvm.idx + sizeof(unsigned int);
+        message = buffer_allocate(&ctx->u.buffers, size);
+        memset(message, 0, BENCHMARK_HEADER_SIZE);
+        memcpy(message + BENCHMARK_HEADER_SIZE, tlvs,
+            size - BENCHMARK_HEADER_SIZE);
+        for (t = 0; t < BENCHMARK_FANOUT; t++) {
+            copies[t] = buffer_allocate(&ctx->u.buffers, size);
+            memcpy(copies[t], message, size);
+        }
+        buffer_free(message);
+        for (t = 0; t < BENCHMARK_FANOUT; t++) {
+            fanout_sink = copies[t][BENCHMARK_HEADER_SIZE];
+            buffer_free(copies[t]);
+        }
+        tlvm_detach(&tlvm);
+    }
+}
+
+static void
+fanout_msgbuf_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    byte value [BENCHMARK_TLV_SIZE];
+    msgbuf_t message, views [BENCHMARK_FANOUT];
+    tlvm_t tlvm;
+    int i, t;
+
+    memset(value, thread, sizeof(value));
+    for (i = 0; i < ops; i++) {
+        msgbuf_allocate(&ctx->u.buffers, &message, BENCHMARK_HEADER_SIZE,
+            BENCHMARK_MESSAGE_SIZE / 2);
+        tlvm_attach_msgbuf(&tlvm, &message);
+        for (t = 0; t < BENCHMARK_TLVS; t++) {
+            tlvm_append(&tlvm, t, sizeof(value), value);
+        }
+        tlvm_msgbuf_commit(&tlvm, &message);
+        memset(msgbuf_prepend(&message, BENCHMARK_HEADER_SIZE), 0,
+            BENCHMARK_HEADER_SIZE);
+        for (t = 0; t < BENCHMARK_FANOUT; t++) {
+            msgbuf_clone(&views[t], &message);
+        }
+        msgbuf_release(&message);
+        for (t = 0; t < BENCHMARK_FANOUT; t++) {
+            fanout_sink = views[t].data[BENCHMARK_HEADER_SIZE];
+            msgbuf_release(&views[t]);
+        }
+    }
+}
+
+/******************************************************************************
+ *
+ * debug framework, cost of a call site whose level is NOT reported
+ */
+
+static debug_module_block_t benchmark_debug;
+
+static void *
+debug_setup (int n_threads, int ops_per_thread)
+{
+    debug_module_block_init(&benchmark_debug, false, ERROR_DEBUG_LEVEL,
+        "BENCHMARK", NULL);
+    return context_create(n_threads, ops_per_thread);
+}
+
+static void
+debug_disabled_run (void *context, int thread, int ops)
+{
+    volatile int i;
+
+    for (i = 0; i < ops; i++) {
+        TRACE(&benchmark_debug, "never reported %d\n", i);
+    }
+}
+
+/******************************************************************************
+ *
+ * line counters, per call site sharded hits vs the hashed counter block
+ */
+
+static void *
+line_counter_setup (int n_threads, int ops_per_thread)
+{
+    line_counters_reset();
+    return context_create(n_threads, ops_per_thread);
+}
+
+static void
+line_counter_hit_run (void *context, int thread, int ops)
+{
+    volatile int i;
+
+    for (i = 0; i < ops; i++) {
+        LINE_COUNTER_HIT();
+    }
+}
+
+static line_counter_block_t benchmark_line_counters;
+
+static void *
+line_counter_block_setup (int n_threads, int ops_per_thread)
+{
+    init_line_counter_block(&benchmark_line_counters);
+    return context_create(n_threads, ops_per_thread);
+}
+
+static void
+line_counter_block_run (void *context, int thread, int ops)
+{
+    volatile int i;
+
+    for (i = 0; i < ops; i++) {
+        increment_line_counter(&benchmark_line_counters,
+            __LINE__, __FUNCTION__);
+    }
+}
+
+/******************************************************************************
+ *
+ * mem monitor, allocations & frees accounted in one shared mem monitor
+ */
+
+#define BENCHMARK_ALLOCATION_SIZE       64
+
+static mem_monitor_t benchmark_mem_monitor;
+
+static void *
+mem_monitor_setup (int mode, int n_threads, int ops_per_thread)
+{
+    if (mem_monitor_init(&benchmark_mem_monitor, mode)) return NULL;
+    return context_create(n_threads, ops_per_thread);
+}
+
+static void *
+mem_monitor_unsynchronized_setup (int n_threads, int ops_per_thread)
+{
+    return
+        mem_monitor_setup(MEM_MONITOR_UNSYNCHRONIZED,
+            n_threads, ops_per_thread);
+}
+
+static void *
+mem_monitor_atomic_setup (int n_threads, int ops_per_thread)
+{
+    return
+        mem_monitor_setup(MEM_MONITOR_ATOMIC, n_threads, ops_per_thread);
+}
+
+static void *
+mem_monitor_sharded_setup (int n_threads, int ops_per_thread)
+{
+    return
+        mem_monitor_setup(MEM_MONITOR_SHARDED, n_threads, ops_per_thread);
+}
+
+static void
+mem_monitor_run (void *context, int thread, int ops)
+{
+    int i;
+
+    for (i = 0; i < ops; i++) {
+        mem_monitor_free(mem_monitor_allocate(&benchmark_mem_monitor,
+            BENCHMARK_ALLOCATION_SIZE, false));
+    }
+}
+
+static void
+mem_monitor_teardown (void *context)
+{
+    mem_monitor_destroy(&benchmark_mem_monitor);
+    free(context);
+}
+
+/******************************************************************************
+ *
+ * ez_sprintf, one typical dump line through vsnprintf vs the typed appends
+ */
+
+#define BENCHMARK_EZ_SPRINTF_SIZE       4096
+
+static void *
+ez_sprintf_setup (int n_threads, int ops_per_thread)
+{
+    return context_create(n_threads, ops_per_thread);
+}
+
+static void
+ez_sprintf_format_run (void *context, int thread, int ops)
+{
+    char buffer [BENCHMARK_EZ_SPRINTF_SIZE];
+    ez_sprintf_t ezs;
+    int i;
+
+    ez_sprintf_init_with_external_buffer(&ezs, buffer, sizeof(buffer), 4);
+    for (i = 0; i < ops; i++) {
+        if (ezs.remaining_size < 128) ez_sprintf_reset(&ezs);
+        ez_sprintf_append(&ezs, "object %8lld type %4d at 0x%llx %s\n",
+            key_number(thread, ops, i), i & 0xFF,
+            (unsigned long long int) key_number(thread, ops, i), "name");
+    }
+}
+
+static void
+ez_sprintf_typed_run (void *context, int thread, int ops)
+{
+    char buffer [BENCHMARK_EZ_SPRINTF_SIZE];
+    ez_sprintf_t ezs;
+    int i;
+
+    ez_sprintf_init_with_external_buffer(&ezs, buffer, sizeof(buffer), 4);
+    for (i = 0; i < ops; i++) {
+        if (ezs.remaining_size < 128) ez_sprintf_reset(&ezs);
+        ez_sprintf_append_string(&ezs, "object ");
+        ez_sprintf_append_int(&ezs, key_number(thread, ops, i), 8);
+        ez_sprintf_append_string(&ezs, " type ");
+        ez_sprintf_append_int(&ezs, i & 0xFF, 4);
+        ez_sprintf_append_string(&ezs, " at 0x");
+        ez_sprintf_append_hex(&ezs, key_number(thread, ops, i), 0);
+        ez_sprintf_append_padding(&ezs, ' ', 1);
+        ez_sprintf_append_string(&ezs, "name");
+        ez_sprintf_append_bytes(&ezs, "\n", 1);
+    }
+}
+
+/******************************************************************************
+ *
+ * object manager.  Every thread has a parent object of its own under the
+ * root and works on the children of it, which are all of a type of their
+ * own, so the threads never touch the same objects.  Loaded object
+ * managers have BENCHMARK_OM_ATTRIBUTES integer attributes per object,
+ * the value of attribute 'id' being the instance plus 'id'.
+ */
+
+#define BENCHMARK_OM_ID                 77000
+#define BENCHMARK_OM_PARENT_TYPE        1000000
+#define BENCHMARK_OM_TYPE(thread)       ((thread) + 1)
+#define BENCHMARK_OM_ATTRIBUTES         6
+#define BENCHMARK_OM_BATCH              64
+#define BENCHMARK_OM_FOUND              16
+#define BENCHMARK_OM_SHARED_SIZE        256
+#define BENCHMARK_OM_BRANCHING          4
+
+static om_shared_t benchmark_om_shared, benchmark_om_reader;
+
+/*
+ * The object manager & the parents of the threads only, thread safe
+ * if asked to be or if more than one thread will be using it.
+ */
+static benchmark_context_t *
+om_context_create (int n_threads, int ops_per_thread, boolean thread_safe)
+{
+    benchmark_context_t *ctx = context_create(n_threads, ops_per_thread);
+    int t;
+
+    if (NULL == ctx) return NULL;
+    if (om_init(&ctx->u.om, thread_safe || (n_threads > 1), BENCHMARK_OM_ID,
+            benchmark_parent_mem_monitor)) {
+        free(ctx);
+        return NULL;
+    }
+    for (t = 0; t < n_threads; t++) {
+        if (om_object_create(&ctx->u.om, 0, 0,
+                BENCHMARK_OM_PARENT_TYPE, t)) {
+            om_destroy(&ctx->u.om);
+            free(ctx);
+            return NULL;
+        }
+    }
+    return ctx;
+}
+
+/* the objects of every thread under its parent, NULL if 'ctx' is */
+static benchmark_context_t *
+om_objects_create (benchmark_context_t *ctx)
+{
+    int t, i;
+
+    if (NULL == ctx) return NULL;
+    for (t = 0; t < ctx->n_threads; t++) {
+        for (i = 1; i <= ctx->ops_per_thread; i++) {
+            if (om_object_create(&ctx->u.om, BENCHMARK_OM_PARENT_TYPE, t,
+                    BENCHMARK_OM_TYPE(t), i)) {
+                om_destroy(&ctx->u.om);
+                free(ctx);
+                return NULL;
+            }
+        }
+    }
+    return ctx;
+}
+
+/* the attributes of all the objects, NULL if 'ctx' is */
+static benchmark_context_t *
+om_attributes_add (benchmark_context_t *ctx)
+{
+    int t, i, id, value;
+
+    if (NULL == ctx) return NULL;
+    for (t = 0; t < ctx->n_threads; t++) {
+        for (i = 1; i <= ctx->ops_per_thread; i++) {
+            for (id = 0; id < BENCHMARK_OM_ATTRIBUTES; id++) {
+                value = i + id;
+                if (om_attribute_add(&ctx->u.om, BENCHMARK_OM_TYPE(t), i,
+                        id, sizeof(value), (byte*) &value)) {
+                    om_destroy(&ctx->u.om);
+                    free(ctx);
+                    return NULL;
+                }
+            }
+        }
+    }
+    return ctx;
+}
+
+static void *
+om_setup (int n_threads, int ops_per_thread)
+{
+    return om_context_create(n_threads, ops_per_thread, false);
+}
+
+static void *
+om_setup_objects (int n_threads, int ops_per_thread)
+{
+    return om_objects_create(
+        om_context_create(n_threads, ops_per_thread, false));
+}
+
+/*
+ * All the objects in one tree under the parent of thread 0, every
+ * object having BENCHMARK_OM_BRANCHING children, as many levels deep
+ * as it takes.
+ */
+static void *
+om_setup_tree (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = om_setup(1, ops_per_thread);
+    int i, parent;
+
+    if (NULL == ctx) return NULL;
+    for (i = 1; i <= ops_per_thread; i++) {
+        parent = i / BENCHMARK_OM_BRANCHING;
+        if (om_object_create(&ctx->u.om,
+                parent ? BENCHMARK_OM_TYPE(0) : BENCHMARK_OM_PARENT_TYPE,
+                parent, BENCHMARK_OM_TYPE(0), i)) {
+            om_destroy(&ctx->u.om);
+            free(ctx);
+            return NULL;
+        }
+    }
+    return ctx;
+}
+
+static void *
+om_setup_loaded (int n_threads, int ops_per_thread)
+{
+    return om_attributes_add(om_objects_create(
+        om_context_create(n_threads, ops_per_thread, false)));
+}
+
+/* loaded, but thread safe for a writer to run alongside the thread */
+static void *
+om_setup_loaded_shared (int n_threads, int ops_per_thread)
+{
+    return om_attributes_add(om_objects_create(
+        om_context_create(n_threads, ops_per_thread, true)));
+}
+
+/* attribute 1 of every thread's objects indexed */
+static void *
+om_setup_indexed (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = om_setup_loaded(n_threads, ops_per_thread);
+    int t;
+
+    if (NULL == ctx) return NULL;
+    for (t = 0; t < n_threads; t++) {
+        if (om_attribute_index_create(&ctx->u.om, BENCHMARK_OM_TYPE(t), 1)) {
+            om_destroy(&ctx->u.om);
+            free(ctx);
+            return NULL;
+        }
+    }
+    return ctx;
+}
+
+static void
+om_create_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int i;
+
+    for (i = 1; i <= ops; i++) {
+        BENCHMARK_TIMED(om_object_create(&ctx->u.om,
+            BENCHMARK_OM_PARENT_TYPE, thread, BENCHMARK_OM_TYPE(thread), i));
+    }
+}
+
+/* one operation is one attribute, BENCHMARK_OM_ATTRIBUTES per object */
+static void
+om_attribute_add_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int i, value;
+
+    for (i = 0; i < ops; i++) {
+        value = i;
+        BENCHMARK_TIMED(om_attribute_add(&ctx->u.om, BENCHMARK_OM_TYPE(thread),
+            (i / BENCHMARK_OM_ATTRIBUTES) + 1, i % BENCHMARK_OM_ATTRIBUTES,
+            sizeof(value), (byte*) &value));
+    }
+}
+
+/*
+ * Sets the attributes again (to the values they already have) in
+ * transactions of 'size', one operation being one attribute set.
+ */
+static void
+om_transaction_run (benchmark_context_t *ctx, int thread, int ops, int size)
+{
+    om_transaction_t transaction;
+    int i, instance, id, value;
+
+    om_transaction_init(&transaction, &ctx->u.om);
+    for (i = 0; i < ops; i++) {
+        instance = (i / BENCHMARK_OM_ATTRIBUTES) + 1;
+        id = i % BENCHMARK_OM_ATTRIBUTES;
+        value = instance + id;
+        om_transaction_attribute_add(&transaction, BENCHMARK_OM_TYPE(thread),
+            instance, id, sizeof(value), (byte*) &value);
+        if (transaction.n_ops >= size) om_transaction_commit(&transaction);
+    }
+    if (transaction.n_ops > 0) om_transaction_commit(&transaction);
+    om_transaction_destroy(&transaction);
+}
+
+static void
+om_transaction_16_run (void *context, int thread, int ops)
+{
+    om_transaction_run(context, thread, ops, 16);
+}
+
+static void
+om_transaction_256_run (void *context, int thread, int ops)
+{
+    om_transaction_run(context, thread, ops, 256);
+}
+
+static void
+om_transaction_4096_run (void *context, int thread, int ops)
+{
+    om_transaction_run(context, thread, ops, 4096);
+}
+
+static void
+om_search_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int i, value, length;
+
+    for (i = 1; i <= ops; i++) {
+        BENCHMARK_TIMED(
+            if (om_object_exists(&ctx->u.om, BENCHMARK_OM_TYPE(thread), i)) {
+                om_attribute_get(&ctx->u.om, BENCHMARK_OM_TYPE(thread), i, 0,
+                    &length, sizeof(value), (byte*) &value);
+            });
+    }
+}
+
+/* by scanning every object of the type, or through the index if created */
+static void
+om_find_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    object_identifier_t found [BENCHMARK_OM_FOUND];
+    int i, n_found;
+
+    for (i = 1; i <= ops; i++) {
+        BENCHMARK_TIMED(om_attribute_find(&ctx->u.om,
+            BENCHMARK_OM_TYPE(thread), 1, i + 1, i + 1,
+            found, BENCHMARK_OM_FOUND, &n_found));
+    }
+}
+
+/* one operation is one object returned in batches of BENCHMARK_OM_BATCH */
+static void
+om_cursor_next_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    object_identifier_t batch [BENCHMARK_OM_BATCH];
+    om_cursor_t cursor;
+    int n_returned;
+
+    om_cursor_init_type(&cursor, BENCHMARK_OM_TYPE(thread));
+    while (0 == om_cursor_next_batch(&ctx->u.om, &cursor,
+        batch, BENCHMARK_OM_BATCH, &n_returned));
+}
+
+static void
+om_cursor_prev_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    object_identifier_t batch [BENCHMARK_OM_BATCH];
+    om_cursor_t cursor;
+    int n_returned;
+
+    om_cursor_init_type(&cursor, BENCHMARK_OM_TYPE(thread));
+    om_cursor_seek(&cursor, INT_MAX);
+    while (0 == om_cursor_prev_batch(&ctx->u.om, &cursor,
+        batch, BENCHMARK_OM_BATCH, &n_returned));
+}
+
+/* one operation is one object visited, under the parent of the thread */
+static int
+om_count_tfn (void *omp, void *object,
+    void *count, void *p1, void *p2, void *p3, void *p4)
+{
+    (*((int*) count))++;
+    return 0;
+}
+
+static void
+om_traverse_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int count = 0;
+
+    om_traverse(&ctx->u.om, BENCHMARK_OM_PARENT_TYPE, thread,
+        om_count_tfn, &count, NULL, NULL, NULL, NULL);
+}
+
+/*
+ * Every traversing thread counts into its own counter, which are all
+ * added up at the end.
+ */
+static int
+om_parallel_count_tfn (void *omp, void *object, void *thread_data,
+    void *p0, void *p1, void *p2, void *p3)
+{
+    long long int **counter = (long long int**) thread_data;
+
+    if (NULL == *counter) {
+        *counter = calloc(1, sizeof(long long int));
+        if (NULL == *counter) return ENOMEM;
+    }
+    (**counter)++;
+    return 0;
+}
+
+static void
+om_parallel_count_reduce (void *thread_data, void *total)
+{
+    if (thread_data) {
+        *((long long int*) total) += *((long long int*) thread_data);
+        free(thread_data);
+    }
+}
+
+/* all the objects are under the parent of thread 0 in both set ups */
+static void
+om_traverse_parallel_run (benchmark_context_t *ctx, int n_threads)
+{
+    long long int count = 0;
+    int failed;
+
+    failed = om_traverse_parallel(&ctx->u.om, BENCHMARK_OM_PARENT_TYPE, 0,
+        n_threads, om_parallel_count_tfn, om_parallel_count_reduce,
+        &count, NULL, NULL, NULL);
+    if (failed) {
+        benchmark_failed(failed);
+    } else if (count != ctx->ops_per_thread) {
+        fprintf(stderr, "parallel traversal counted %lld of %d objects\n",
+            count, ctx->ops_per_thread);
+        benchmark_failed(EIO);
+    }
+}
+
+static void
+om_traverse_parallel_2_run (void *context, int thread, int ops)
+{
+    om_traverse_parallel_run(context, 2);
+}
+
+static void
+om_traverse_parallel_4_run (void *context, int thread, int ops)
+{
+    om_traverse_parallel_run(context, 4);
+}
+
+/* one operation is one object (with its attributes) removed */
+static void
+om_remove_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+    int i;
+
+    for (i = 1; i <= ops; i++) {
+        BENCHMARK_TIMED(
+            om_object_remove(&ctx->u.om, BENCHMARK_OM_TYPE(thread), i));
+    }
+}
+
+/* the same, all in one go by removing the parent of them all */
+static void
+om_subtree_remove_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+
+    om_object_remove(&ctx->u.om, BENCHMARK_OM_PARENT_TYPE, thread);
+}
+
+/*
+ * One operation is one object written out to the file, holding off
+ * the writers all along or only while forking the snapshot writer.
+ * A writer keeps setting an attribute of the objects (to the value it
+ * already has) while the file is being written, to report the longest
+ * it had to wait for any one set & how many it could do meanwhile.
+ */
+typedef struct om_stalled_writer_s {
+
+    object_manager_t *omp;
+    int objects;
+    volatile int running;
+    volatile int stop;
+    cycles_t longest;
+    int sets;
+
+} om_stalled_writer_t;
+
+static void *
+om_stalled_writer (void *arg)
+{
+    om_stalled_writer_t *swp = arg;
+    cycles_t start, stall;
+    int instance = 0;
+
+    swp->running = 1;
+    while (!swp->stop) {
+        instance = (instance % swp->objects) + 1;
+        start = cycles_now();
+        om_attribute_add(swp->omp, BENCHMARK_OM_TYPE(0), instance, 0,
+            sizeof(instance), (byte*) &instance);
+        stall = cycles_now() - start;
+        if (stall > swp->longest) swp->longest = stall;
+        swp->sets++;
+    }
+    return NULL;
+}
+
+static int
+om_file_write (object_manager_t *omp)
+{
+    return om_write(omp);
+}
+
+static int
+om_snapshot_write (object_manager_t *omp)
+{
+    om_snapshot_t snapshot;
+    int failed;
+
+    failed = om_snapshot_start(omp, &snapshot);
+    return failed ? failed : om_snapshot_wait(&snapshot);
+}
+
+static void
+om_stalled_write (benchmark_context_t *ctx, int (*write)(object_manager_t*))
+{
+    om_stalled_writer_t writer =
+        { .omp = &ctx->u.om, .objects = ctx->ops_per_thread };
+    pthread_t tid;
+    int failed;
+
+    failed = pthread_create(&tid, NULL, om_stalled_writer, &writer);
+    if (failed) {
+        benchmark_failed(failed);
+        return;
+    }
+    while (!writer.running) sched_yield();
+    failed = write(&ctx->u.om);
+    writer.stop = 1;
+    pthread_join(tid, NULL);
+    if (failed) benchmark_failed(failed);
+    benchmark_metric("writer_longest_stall_ns",
+        (double) cycles_to_nsecs(writer.longest));
+    benchmark_metric("writer_sets", writer.sets);
+}
+
+static void
+om_write_run (void *context, int thread, int ops)
+{
+    om_stalled_write(context, om_file_write);
+}
+
+static void
+om_snapshot_run (void *context, int thread, int ops)
+{
+    om_stalled_write(context, om_snapshot_write);
+}
+
+static void
+om_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+    char name [TYPICAL_NAME_SIZE];
+
+    om_destroy(&ctx->u.om);
+    free(ctx);
+
+    /* in case it was written out */
+    sprintf(name, "om_%d", BENCHMARK_OM_ID);
+    unlink(name);
+    strcat(name, "_BACKUP");
+    unlink(name);
+}
+
+/* the memory the object manager used, averaged over all its objects */
+static void
+om_size_teardown (void *context)
+{
+    benchmark_context_t *ctx = context;
+
+    benchmark_metric("bytes_per_object",
+        (double) mem_monitor_bytes_used(ctx->u.om.mem_mon_p) /
+            om_object_count(&ctx->u.om));
+    om_teardown(context);
+}
+
+/*
+ * Shared memory, the object manager is published into a segment which
+ * readers (threads of this process here) look the objects up from.
+ */
+static void *
+om_setup_shared (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = om_setup_loaded(n_threads, ops_per_thread);
+    char name [TYPICAL_NAME_SIZE];
+
+    if (NULL == ctx) return NULL;
+    sprintf(name, "/benchmark_om_%d", getpid());
+    if (om_shared_create(&benchmark_om_shared, name,
+            (long long int) BENCHMARK_OM_SHARED_SIZE *
+                n_threads * ops_per_thread)) {
+        om_teardown(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+static void *
+om_setup_published (int n_threads, int ops_per_thread)
+{
+    benchmark_context_t *ctx = om_setup_shared(n_threads, ops_per_thread);
+    char name [TYPICAL_NAME_SIZE];
+
+    if (NULL == ctx) return NULL;
+    sprintf(name, "/benchmark_om_%d", getpid());
+    if (om_shared_publish(&benchmark_om_shared, &ctx->u.om) ||
+        om_shared_attach(&benchmark_om_reader, name)) {
+            om_shared_detach(&benchmark_om_shared);
+            om_teardown(ctx);
+            return NULL;
+    }
+    return ctx;
+}
+
+/* one operation is one object published */
+static void
+om_shared_publish_run (void *context, int thread, int ops)
+{
+    benchmark_context_t *ctx = context;
+
+    om_shared_publish(&benchmark_om_shared, &ctx->u.om);
+}
+
+/* one operation is the look up of an attribute & of the parent */
+static void
+om_shared_lookup_run (void *context, int thread, int ops)
+{
+    int i, value, length, parent_type, parent_instance;
+
+    for (i = 1; i <= ops; i++) {
+        om_shared_attribute_get(&benchmark_om_reader,
+            BENCHMARK_OM_TYPE(thread), i, 0,
+            &length, sizeof(value), (byte*) &value);
+        om_shared_parent_get(&benchmark_om_reader,
+            BENCHMARK_OM_TYPE(thread), i, &parent_type, &parent_instance);
+    }
+}
+
+static void
+om_shared_teardown (void *context)
+{
+    om_shared_detach(&benchmark_om_shared);
+    om_teardown(context);
+}
+
+static void
+om_published_teardown (void *context)
+{
+    om_shared_detach(&benchmark_om_reader);
+    om_shared_teardown(context);
+}
+
+/******************************************************************************
+ *
+ * The registry
+ */
+
+#define UNLIMITED               (1 << 30)
+
+/* insertions which move O(n) data, and searches which walk O(n) nodes */
+#define BENCHMARK_SLOW_OPS      20000
+#define BENCHMARK_LINEAR_OPS    2000
+
+PUBLIC benchmark_case_t benchmark_cases [] = {
+
+    { "avl_insert", "avl tree insertions of unique keys", UNLIMITED, 0,
+        avl_setup, avl_insert_run, avl_teardown },
+    { "avl_search", "avl tree successful searches", UNLIMITED, 0,
+        avl_setup_loaded, avl_search_run, avl_teardown },
+    { "avl_remove", "avl tree removals", UNLIMITED, 0,
+        avl_setup_loaded, avl_remove_run, avl_teardown },
+    { "avl_walk_callback", "avl tree in order walk by range traversal",
+        UNLIMITED, 0, avl_setup_loaded, avl_walk_callback_run, avl_teardown },
+    { "avl_walk_cursor", "avl tree in order walk by cursor",
+        UNLIMITED, 0, avl_setup_loaded, avl_walk_cursor_run, avl_teardown },
+
+    { "index_insert", "index object insertions of unique keys",
+        UNLIMITED, BENCHMARK_SLOW_OPS,
+        index_setup, index_insert_run, index_teardown },
+    { "index_search", "index object successful searches",
+        UNLIMITED, BENCHMARK_SLOW_OPS,
+        index_setup_loaded, index_search_run, index_teardown },
+    { "index_walk_cursor", "index object in order walk by cursor",
+        UNLIMITED, BENCHMARK_SLOW_OPS,
+        index_setup_loaded, index_walk_cursor_run, index_teardown },
+
+    { "radix_insert", "radix tree insertions of 8 byte keys", UNLIMITED, 0,
+        radix_setup, radix_insert_run, radix_teardown },
+    { "radix_search", "radix tree successful searches", UNLIMITED, 0,
+        radix_setup_loaded, radix_search_run, radix_teardown },
+    { "radix_walk_callback", "radix tree walk by traversal callback",
+        1, 0, radix_setup_loaded, radix_walk_callback_run, radix_teardown },
+    { "radix_walk_cursor", "radix tree walk by cursor",
+        1, 0, radix_setup_loaded, radix_walk_cursor_run, radix_teardown },
+
+    { "olist_add", "ordered list additions",
+        UNLIMITED, BENCHMARK_LINEAR_OPS,
+        olist_setup, olist_add_run, olist_teardown },
+    { "olist_search", "ordered list successful searches",
+        UNLIMITED, BENCHMARK_LINEAR_OPS,
+        olist_setup_loaded, olist_search_run, olist_teardown },
+    { "olist_walk_cursor", "ordered list walk by cursor",
+        UNLIMITED, BENCHMARK_LINEAR_OPS,
+        olist_setup_loaded, olist_walk_cursor_run, olist_teardown },
+
+    { "lifo_add_remove", "lifo addition & removal of the same data",
+        UNLIMITED, 0, lifo_setup, lifo_run, lifo_teardown },
+    { "list_append_remove", "list append & removal of the same data",
+        UNLIMITED, 0, list_setup, list_run, list_teardown },
+
+    { "chunk_alloc_free", "chunk allocation & free, in bursts",
+        UNLIMITED, 0, chunk_setup, chunk_run, chunk_teardown },
+    { "buffer_alloc_free", "buffer allocation (mixed sizes) & free",
+        UNLIMITED, 0, buffer_setup, buffer_run, buffer_teardown },
+    { "slab_alloc_free", "slab allocation (same mixed sizes) & free",
+        UNLIMITED, 0, slab_setup, slab_run, slab_teardown },
+    { "malloc_alloc_free", "malloc (same mixed sizes) & free",
+        UNLIMITED, 0, malloc_setup, malloc_run, context_free },
+
+    { "lock_write", "write lock grab & release on a shared lock",
+        UNLIMITED, 0, lock_setup, lock_write_run, lock_teardown },
+    { "lock_read", "read lock grab & release on a shared lock",
+        UNLIMITED, 0, lock_setup, lock_read_run, lock_teardown },
+
+    { "tlv_build_parse", "append 16 tlvs into a buffer & parse them back",
+        UNLIMITED, 0, tlv_setup, tlv_run, context_free },
+
+    { "tlv_fanout_copy", "tlvs + header copied to 4 consumers",
+        UNLIMITED, 0, fanout_setup, fanout_copy_run, buffer_teardown },
+    { "tlv_fanout_msgbuf", "tlvs built in a message buffer shared by 4",
+        UNLIMITED, 0, fanout_setup, fanout_msgbuf_run, buffer_teardown },
+
+    { "debug_disabled", "a TRACE call site which is not reported",
+        UNLIMITED, 0, debug_setup, debug_disabled_run, context_free },
+
+    { "mem_monitor_plain", "malloc & free, unsynchronized (racy) accounting",
+        UNLIMITED, 0, mem_monitor_unsynchronized_setup, mem_monitor_run,
+        mem_monitor_teardown },
+    { "mem_monitor_atomic", "malloc & free, atomic accounting",
+        UNLIMITED, 0, mem_monitor_atomic_setup, mem_monitor_run,
+        mem_monitor_teardown },
+    { "mem_monitor_sharded", "malloc & free, per thread sharded accounting",
+        UNLIMITED, 0, mem_monitor_sharded_setup, mem_monitor_run,
+        mem_monitor_teardown },
+
+    { "ez_sprintf_format", "one dump line formatted by ez_sprintf_append",
+        UNLIMITED, 0, ez_sprintf_setup, ez_sprintf_format_run, context_free },
+    { "ez_sprintf_typed", "the same line built by the typed appends",
+        UNLIMITED, 0, ez_sprintf_setup, ez_sprintf_typed_run, context_free },
+
+    { "line_counter_hit", "a LINE_COUNTER_HIT call site",
+        UNLIMITED, 0, line_counter_setup, line_counter_hit_run,
+        context_free },
+    { "line_counter_block", "increment_line_counter (not thread safe)",
+        1, 0, line_counter_block_setup, line_counter_block_run,
+        context_free },
+
+    { "om_create", "object manager object creations",
+        UNLIMITED, 0, om_setup, om_create_run, om_size_teardown },
+    { "om_attribute_add", "object manager integer attribute additions",
+        UNLIMITED, 0, om_setup_objects, om_attribute_add_run,
+        om_size_teardown },
+    { "om_transaction_16", "attribute sets in transactions of 16",
+        UNLIMITED, 0, om_setup_loaded, om_transaction_16_run, om_teardown },
+    { "om_transaction_256", "attribute sets in transactions of 256",
+        UNLIMITED, 0, om_setup_loaded, om_transaction_256_run, om_teardown },
+    { "om_transaction_4096", "attribute sets in transactions of 4096",
+        UNLIMITED, 0, om_setup_loaded, om_transaction_4096_run,
+        om_teardown },
+    { "om_search", "object manager object exists & attribute get",
+        UNLIMITED, 0, om_setup_loaded, om_search_run, om_teardown },
+    { "om_find_scan", "attribute value search looking at every object",
+        UNLIMITED, BENCHMARK_LINEAR_OPS,
+        om_setup_loaded, om_find_run, om_teardown },
+    { "om_find_index", "attribute value search through an index",
+        UNLIMITED, BENCHMARK_LINEAR_OPS,
+        om_setup_indexed, om_find_run, om_teardown },
+    { "om_cursor_next", "objects of a type by cursor, in batches of 64",
+        UNLIMITED, 0, om_setup_objects, om_cursor_next_run, om_teardown },
+    { "om_cursor_prev", "the same, backwards",
+        UNLIMITED, 0, om_setup_objects, om_cursor_prev_run, om_teardown },
+    { "om_traverse", "object manager serial traversal of children",
+        UNLIMITED, 0, om_setup_objects, om_traverse_run, om_teardown },
+    { "om_traverse_x2", "the same traversal by 2 threads",
+        1, 0, om_setup_objects, om_traverse_parallel_2_run, om_teardown },
+    { "om_traverse_x4", "the same traversal by 4 threads",
+        1, 0, om_setup_objects, om_traverse_parallel_4_run, om_teardown },
+    { "om_tree_traverse", "serial traversal of a 4 way branching tree",
+        1, 0, om_setup_tree, om_traverse_run, om_teardown },
+    { "om_tree_traverse_x2", "the same traversal by 2 threads",
+        1, 0, om_setup_tree, om_traverse_parallel_2_run, om_teardown },
+    { "om_tree_traverse_x4", "the same traversal by 4 threads",
+        1, 0, om_setup_tree, om_traverse_parallel_4_run, om_teardown },
+    { "om_remove", "object manager object removals",
+        UNLIMITED, 0, om_setup_loaded, om_remove_run, om_teardown },
+    { "om_subtree_remove", "the same objects removed with their parent",
+        UNLIMITED, 0, om_setup_loaded, om_subtree_remove_run, om_teardown },
+    { "om_write", "object manager written to a file",
+        1, 0, om_setup_loaded_shared, om_write_run, om_teardown },
+    { "om_snapshot", "the same by a forked snapshot writer",
+        1, 0, om_setup_loaded_shared, om_snapshot_run, om_teardown },
+    { "om_shared_publish", "object manager published to shared memory",
+        1, 0, om_setup_shared, om_shared_publish_run, om_shared_teardown },
+    { "om_shared_lookup", "shared memory attribute & parent look ups",
+        UNLIMITED, 0, om_setup_published, om_shared_lookup_run,
+        om_published_teardown },
+
+    { NULL, NULL, 0, 0, NULL, NULL, NULL }
+};
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
@@ -47,9 +47,47 @@ static debug_module_block_t buffer_manager_debug = {
 };
 
 /*
- * initialize a buffer pool with all its buffers.  Each buffer can hold
- * data of size 'size' and there will be 'count' of these buffers
- * in this pool.
+ * Adds a block of 'count' buffers to the pool, all of which
+ * are placed on the free list of the pool.
+ *
+ * 0 will be returned if successful, else ENOMEM.
+ */
+static int
+buffer_pool_add_block (buffer_pool_t *poolp, int count)
+{
+    buffer_manager_t *bmp = poolp->bmp;
+    buffer_block_t *blockp;
+    buffer_t *bufp;
+    byte *ptr;
+    int i;
+
+    blockp = MEM_MONITOR_ALLOC(bmp,
+        sizeof(buffer_block_t) + (poolp->actual_buffer_size * count));
+    if (NULL == blockp) return ENOMEM;
+
+    blockp->poolp = poolp;
+    blockp->count = blockp->n_free = count;
+    blockp->next = poolp->blocks;
+    poolp->blocks = blockp;
+
+    /* now partition each buffer in the block, last one first */
+    ptr = ((byte*) &blockp->buffers[0]) + (poolp->actual_buffer_size * count);
+    for (i = 0; i < count; i++) {
+        ptr -= poolp->actual_buffer_size;
+        bufp = (buffer_t*) ptr;
+        bufp->blockp = blockp;
+        bufp->next = poolp->head;
+        poolp->head = bufp;
+    }
+    poolp->buffer_count += count;
+
+    return 0;
+}
+
+/*
+ * initialize a buffer pool with all its initial buffers.  Each buffer
+ * can hold data of size 'size' and there will be 'count' of these
+ * buffers in this pool, which can grow up to 'max_count'.
  *
  * Note that the sanity of the numbers have all been verified
  * by the time the flow reaches here.  So, there is no need to
@@ -61,50 +99,103 @@ static debug_module_block_t buffer_manager_debug = {
  */
 static int
 buffer_manager_pool_init (buffer_manager_t *bmp,
-        int pool_number, size_count_tuple_t *tuple)
+        int pool_number, buffer_pool_spec_t *spec)
 {
-    int size = tuple->size;
-    int count = tuple->count;
-    int i, total_size, aligned_data_size, actual_buffer_size;
-    byte *block, *ptr;
-    buffer_t *bufp = NULL;  /* shut the compiler up */
     buffer_pool_t *poolp = &bmp->pools[pool_number];
 
     /* empty the pool first */
     memset(poolp, 0, sizeof(buffer_pool_t));
 
     /* adjusted sizes */
-    aligned_data_size = (size + 7) & ~7;
-    actual_buffer_size = aligned_data_size + sizeof(buffer_t);
-    total_size = actual_buffer_size * count;
+    poolp->bmp = bmp;
+    poolp->specified_size = spec->size;
+    poolp->actual_buffer_size = ((spec->size + 7) & ~7) + sizeof(buffer_t);
+    poolp->initial_count = poolp->grow_count = spec->count;
+    poolp->max_count =
+        (spec->max_count > spec->count) ? spec->max_count : spec->count;
+
+    return
+        buffer_pool_add_block(poolp, spec->count);
+}
 
-    /* allocate the big block for the entire pool and fill fields */
-    block = MEM_MONITOR_ALLOC(bmp, total_size);
-    
-    /* cannot proceed if so */
-    if (NULL == block) return ENOMEM;
+/*
+ * grows the pool by another block if it is allowed to
+ */
+static int
+buffer_pool_grow (buffer_pool_t *poolp)
+{
+    int count = poolp->max_count - poolp->buffer_count;
 
-    /* we are ok, fill the rest */
-    poolp->bmp = bmp;
-    poolp->specified_size = size;
-    poolp->actual_buffer_size = actual_buffer_size;
-    poolp->buffer_count = count;
-    poolp->block = block;
-    poolp->head = (buffer_t*) block;
-
-    /* now partition each buffer in the big block */
-    ptr = block;
-    for (i = 0; i < count; i++) {
-        bufp = (buffer_t*) ptr;
-        bufp->poolp = poolp;
-        ptr += actual_buffer_size;
-        bufp->next = (buffer_t*) ptr;
+    if (count <= 0) return ENOSPC;
+    if (count > poolp->grow_count) count = poolp->grow_count;
+    if (buffer_pool_add_block(poolp, count)) return ENOMEM;
+    poolp->stats.grows++;
+
+    return 0;
+}
+
+/*
+ * Gives back every block (except the initial one) whose buffers are
+ * all free, as long as the rest can still hold the high water mark.
+ * The buffers of those blocks are first taken off the free list.
+ */
+static int
+thread_unsafe_buffer_pool_trim (buffer_pool_t *poolp)
+{
+    buffer_block_t *blockp, **prevp;
+    buffer_t *bufp, *next;
+    int remaining = poolp->buffer_count;
+    int released = 0;
+
+    /* mark the blocks to release by setting their free counts to -1 */
+    for (blockp = poolp->blocks; blockp->next; blockp = blockp->next) {
+        if ((blockp->n_free == blockp->count) &&
+            ((remaining - blockp->count) >= poolp->high_water)) {
+                remaining -= blockp->count;
+                blockp->n_free = -1;
+                released++;
+        }
     }
 
-    /* last buffer */
-    bufp->next = NULL;
+    if (released) {
 
-    return 0;
+        /* rebuild the free list without their buffers */
+        bufp = poolp->head;
+        poolp->head = NULL;
+        while (bufp) {
+            next = bufp->next;
+            if (bufp->blockp->n_free >= 0) {
+                bufp->next = poolp->head;
+                poolp->head = bufp;
+            }
+            bufp = next;
+        }
+
+        /* and free them */
+        prevp = &poolp->blocks;
+        while ((blockp = *prevp)) {
+            if (blockp->n_free >= 0) {
+                prevp = &blockp->next;
+            } else {
+                *prevp = blockp->next;
+                MEM_MONITOR_FREE(blockp);
+            }
+        }
+        poolp->buffer_count = remaining;
+        poolp->stats.shrinks += released;
+    }
+
+    /* decay the high water mark half way to what is used now */
+    poolp->high_water = (poolp->high_water + poolp->in_use + 1) / 2;
+
+    return released;
+}
+
+/* the hidden header of a buffer the user has */
+static inline buffer_t *
+buffer_of (void *ptr)
+{
+    return (buffer_t*) (((byte*) ptr) - (int) (sizeof(buffer_t)));
 }
 
 static int
@@ -112,11 +203,11 @@ buffer_manager_lookup_table_init (buffer_manager_t *bmp)
 {
     int p, idx;
 
-    bmp->size_lookup_table = MEM_MONITOR_ALLOC(bmp, bmp->max_size);
+    bmp->size_lookup_table = MEM_MONITOR_ALLOC(bmp, bmp->max_size + 1);
     if (NULL == bmp->size_lookup_table) {
         ERROR(&buffer_manager_debug,
             "allocating %d bytes for buffer manager size lookup array failed\n",
-            bmp->max_size);
+            bmp->max_size + 1);
         return ENOMEM;
     }
 
@@ -135,25 +226,46 @@ buffer_manager_initialize (buffer_manager_t *bmp,
         boolean make_it_thread_safe,
         size_count_tuple_t tuples [],
         mem_monitor_t *parent_mem_monitor)
+{
+    buffer_pool_spec_t specs [MAX_POOLS + 1];
+    int p;
+
+    /* fixed pools are growable pools which cannot grow */
+    for (p = 0; p <= MAX_POOLS; p++) {
+        specs[p].size = tuples[p].size;
+        specs[p].count = specs[p].max_count = tuples[p].count;
+        if ((tuples[p].size < 0) && (tuples[p].count < 0)) break;
+    }
+
+    return
+        buffer_manager_initialize_growable(bmp, make_it_thread_safe,
+            specs, parent_mem_monitor);
+}
+
+PUBLIC int
+buffer_manager_initialize_growable (buffer_manager_t *bmp,
+        boolean make_it_thread_safe,
+        buffer_pool_spec_t specs [],
+        mem_monitor_t *parent_mem_monitor)
 {
     int p, pcnt, prev_size;
 
     /*
-     * Make one pass over the tuples array, checking everything
+     * Make one pass over the specs array, checking everything
      * and making sure that all the numbers are sane & acceptable.
      */
     prev_size = pcnt = 0;
     while (true) {
 
-        int cnt = tuples[pcnt].count;
-        int sz = tuples[pcnt].size;
+        int cnt = specs[pcnt].count;
+        int sz = specs[pcnt].size;
 
         INFO(&buffer_manager_debug,
             "processing %d buffer pools with requested size of %d bytes\n",
             cnt, sz);
         
         /*
-         * if end of tuples is reached (BOTH sz & cnt are negative), we are done
+         * if end of specs is reached (BOTH sz & cnt are negative), we are done
          */
         if ((sz < 0) && (cnt < 0)) {
 
@@ -205,7 +317,7 @@ buffer_manager_initialize (buffer_manager_t *bmp,
 
 
     /*
-     * the tuples are all sane, we can now proceed with everything else
+     * the specs are all sane, we can now proceed with everything else
      */
     MEM_MONITOR_SETUP(bmp);
     LOCK_SETUP(bmp);
@@ -223,25 +335,23 @@ buffer_manager_initialize (buffer_manager_t *bmp,
      * that if a buffer allocation request of size > than this number
      * is required, we cannot honor it.
      */
-    bmp->max_size = tuples[pcnt -1].size;
+    bmp->max_size = specs[pcnt -1].size;
 
     /* now initialize all the pools and their buffers */
     for (p = 0; p < pcnt; p++) {
-        buffer_manager_pool_init(bmp, p, &tuples[p]);
+        buffer_manager_pool_init(bmp, p, &specs[p]);
     }
 
     /* now initialize the size -> pool lookup table for fast allocation */
     buffer_manager_lookup_table_init(bmp);
 
-    OBJ_WRITE_UNLOCK(bmp);
-
     return 0;
 }
 
 PUBLIC void*
 buffer_allocate (buffer_manager_t *bmp, int size)
 {
-    int p;
+    int p, first;
     buffer_pool_t *poolp;
     buffer_t *bufp;
     void *data = NULL;
@@ -255,25 +365,42 @@ buffer_allocate (buffer_manager_t *bmp, int size)
 
     /*
      * pools are ordered based on size so that if a
-     * particular sized pool is exhausted, a buffer is
-     * allocated from the next higher sized pool.
+     * particular sized pool is exhausted (and cannot grow),
+     * a buffer is allocated from the next higher sized pool.
      * We normally start from the pool given to us from the
      * lookup table.  However, if the lookup table was not
      * allocated (usually due to malloc failure), then we
-     * start from the first pool (0).
+     * start from the first pool big enough.
      */
     p = (bmp->size_lookup_table) ? bmp->size_lookup_table[size] : 0;
+    while ((p < bmp->num_pools) && (size > bmp->pools[p].specified_size)) p++;
+    first = p;
     while (p < bmp->num_pools) {
         poolp = &bmp->pools[p];
-        if ((size <= poolp->specified_size) && poolp->head) {
+        if (poolp->head || (0 == buffer_pool_grow(poolp))) {
             bufp = poolp->head;
             poolp->head = bufp->next;
+            bufp->blockp->n_free--;
+            if (++poolp->in_use > poolp->high_water) {
+                poolp->high_water = poolp->in_use;
+            }
             data = &bufp->data[0];
             break;
         }
         p++;
     }
 
+    /* all the requests are accounted for in the pool they are sized for */
+    if (first < bmp->num_pools) {
+        if (NULL == data) {
+            bmp->pools[first].stats.failures++;
+        } else if (p == first) {
+            bmp->pools[first].stats.hits++;
+        } else {
+            bmp->pools[first].stats.fallthroughs++;
+        }
+    }
+
     OBJ_WRITE_UNLOCK(bmp);
     return data;
 }
@@ -281,25 +408,106 @@ buffer_allocate (buffer_manager_t *bmp, int size)
 PUBLIC void
 buffer_free (void *ptr)
 {
-    byte *bptr = ((byte*) ptr) - (int) (sizeof(buffer_t));
-    buffer_t *bufp = (buffer_t*) bptr;
+    buffer_t *bufp = buffer_of(ptr);
+    buffer_pool_t *poolp = bufp->blockp->poolp;
+
+    OBJ_WRITE_LOCK(poolp->bmp);
+    bufp->next = poolp->head;
+    poolp->head = bufp;
+    bufp->blockp->n_free++;
+    poolp->in_use--;
+    OBJ_WRITE_UNLOCK(poolp->bmp);
+}
+
+PUBLIC boolean
+buffer_manager_owns (buffer_manager_t *bmp, void *ptr)
+{
+    buffer_block_t *blockp;
+    buffer_pool_t *poolp;
+    byte *start;
+    boolean owned = false;
+    int p;
 
-    OBJ_WRITE_LOCK(bufp->poolp->bmp);
-    bufp->next = bufp->poolp->head;
-    bufp->poolp->head = bufp;
-    OBJ_WRITE_UNLOCK(bufp->poolp->bmp);
+    OBJ_READ_LOCK(bmp);
+    for (p = 0; (p < bmp->num_pools) && !owned; p++) {
+        poolp = &bmp->pools[p];
+        for (blockp = poolp->blocks; blockp; blockp = blockp->next) {
+            start = (byte*) &blockp->buffers[0];
+            if (((byte*) ptr >= start) && ((byte*) ptr <
+                    (start + (blockp->count * poolp->actual_buffer_size)))) {
+                owned = true;
+                break;
+            }
+        }
+    }
+    OBJ_READ_UNLOCK(bmp);
+
+    return owned;
+}
+
+PUBLIC int
+buffer_manager_trim (buffer_manager_t *bmp)
+{
+    int p, released = 0;
+
+    OBJ_WRITE_LOCK(bmp);
+    for (p = 0; p < bmp->num_pools; p++) {
+        if (bmp->pools[p].blocks) {
+            released += thread_unsafe_buffer_pool_trim(&bmp->pools[p]);
+        }
+    }
+    OBJ_WRITE_UNLOCK(bmp);
+
+    return released;
+}
+
+PUBLIC int
+buffer_manager_pool_statistics (buffer_manager_t *bmp, int pool,
+        buffer_pool_stats_t *stats)
+{
+    if ((pool < 0) || (pool >= bmp->num_pools)) return EINVAL;
+    OBJ_READ_LOCK(bmp);
+    *stats = bmp->pools[pool].stats;
+    OBJ_READ_UNLOCK(bmp);
+
+    return 0;
+}
+
+PUBLIC void
+buffer_manager_report (buffer_manager_t *bmp, FILE *fp)
+{
+    buffer_pool_t *poolp;
+    int p;
+
+    OBJ_READ_LOCK(bmp);
+    fprintf(fp, "%8s %8s %8s %8s %8s %12s %12s %10s %8s %8s\n",
+        "size", "buffers", "max", "in use", "high", "hits",
+        "fallthroughs", "failures", "grows", "shrinks");
+    for (p = 0; p < bmp->num_pools; p++) {
+        poolp = &bmp->pools[p];
+        fprintf(fp, "%8d %8d %8d %8d %8d %12llu %12llu %10llu %8llu %8llu\n",
+            poolp->specified_size, poolp->buffer_count, poolp->max_count,
+            poolp->in_use, poolp->high_water, poolp->stats.hits,
+            poolp->stats.fallthroughs, poolp->stats.failures,
+            poolp->stats.grows, poolp->stats.shrinks);
+    }
+    OBJ_READ_UNLOCK(bmp);
 }
 
 PUBLIC void
 buffer_manager_destroy (buffer_manager_t *bmp)
 {
     int i;
+    buffer_block_t *blockp;
     buffer_pool_t *pools = (buffer_pool_t*) bmp->pools;
 
     OBJ_WRITE_LOCK(bmp);
     for (i = 0; i < bmp->num_pools; i++) {
-        MEM_MONITOR_FREE(pools[i].block);
-        memset(&pools[i].block, 0, sizeof(buffer_pool_t));
+        while ((blockp = pools[i].blocks)) {
+            pools[i].blocks = blockp->next;
+            MEM_MONITOR_FREE(blockp);
+        }
+        memset(&pools[i], 0, sizeof(buffer_pool_t));
     }
     MEM_MONITOR_FREE(bmp->size_lookup_table);
     OBJ_WRITE_UNLOCK(bmp);
@@ -307,6 +515,87 @@ buffer_manager_destroy (buffer_manager_t *bmp)
     memset(bmp, 0, sizeof(*bmp));
 }
 
+/******************************************************************************
+ *
+ * Reference counted message buffers
+ */
+
+PUBLIC int
+msgbuf_allocate (buffer_manager_t *bmp, msgbuf_t *mb,
+        int headroom, int size)
+{
+    msgbuf_storage_t *storage;
+    int total = sizeof(msgbuf_storage_t) + headroom + size;
+
+    if ((headroom < 0) || (size < 0)) return EINVAL;
+    storage = buffer_allocate(bmp, total);
+    if (NULL == storage) return ENOMEM;
+
+    /* all of the buffer can be used, not just what was asked for */
+    storage->refcount = 1;
+    storage->size = buffer_of(storage)->blockp->poolp->specified_size -
+        sizeof(msgbuf_storage_t);
+    mb->storage = storage;
+    mb->data = ((byte*) &storage->bytes[0]) + headroom;
+    mb->length = 0;
+
+    return 0;
+}
+
+PUBLIC void
+msgbuf_clone (msgbuf_t *dst, msgbuf_t *src)
+{
+    __sync_fetch_and_add(&src->storage->refcount, 1);
+    *dst = *src;
+}
+
+PUBLIC int
+msgbuf_slice (msgbuf_t *dst, msgbuf_t *src, int offset, int length)
+{
+    if ((offset < 0) || (length < 0) || ((offset + length) > src->length))
+        return EINVAL;
+    __sync_fetch_and_add(&src->storage->refcount, 1);
+    dst->storage = src->storage;
+    dst->data = src->data + offset;
+    dst->length = length;
+
+    return 0;
+}
+
+PUBLIC void
+msgbuf_release (msgbuf_t *mb)
+{
+    if (NULL == mb->storage) return;
+    if (0 == __sync_sub_and_fetch(&mb->storage->refcount, 1)) {
+        buffer_free(mb->storage);
+    }
+    mb->storage = NULL;
+    mb->data = NULL;
+    mb->length = 0;
+}
+
+PUBLIC int
+msgbuf_unshare (msgbuf_t *mb)
+{
+    buffer_manager_t *bmp;
+    msgbuf_t copy;
+    int headroom;
+
+    if (!msgbuf_is_shared(mb)) return 0;
+    bmp = buffer_of(mb->storage)->blockp->poolp->bmp;
+    headroom = msgbuf_headroom(mb);
+    if (msgbuf_allocate(bmp, &copy, headroom,
+            mb->storage->size - headroom)) {
+        return ENOMEM;
+    }
+    memcpy(copy.storage->bytes, mb->storage->bytes, mb->storage->size);
+    copy.length = mb->length;
+    msgbuf_release(mb);
+    *mb = copy;
+
+    return 0;
+}
+
 #ifdef __cplusplus
 } // extern C
 #endif
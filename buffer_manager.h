@@ -70,6 +70,23 @@
 * stop if memory is exhausted.  It will not crash but unallocatable
 * pools will simply be set to NULL.
 *
+* Pools can also be made growable (buffer_manager_initialize_growable)
+* by giving each one a maximum count as well.  Only the initial count
+* of buffers is pre-carved, and when a pool runs out, another block of
+* that many buffers is added to it, until it reaches its maximum.  So
+* bursts can be absorbed without having to provision for the worst
+* case all the time.  Every pool keeps track of the most buffers which
+* were in use at the same time (its high water mark).  Calling
+* 'buffer_manager_trim' periodically gives back the added blocks whose
+* buffers are all free, as long as what remains can still hold the high
+* water mark.  Every trim also decays the high water mark half way
+* towards how many buffers are in use right then, so after a burst
+* has passed, its blocks are given back over the next few trims.
+*
+* Every pool also counts how many requests it served (hits), how many
+* it could not serve and passed on to a bigger pool (fallthroughs) and
+* how many no pool could serve (failures), to help tune the sizes.
+*
 *******************************************************************************
 *******************************************************************************
 *******************************************************************************
@@ -100,7 +117,21 @@ typedef struct size_count_tuple_s {
 
 } size_count_tuple_t;
 
+/*
+ * Same as above for growable pools.  A pool starts with 'count'
+ * buffers and can grow up to 'max_count' buffers, 'count' at a time.
+ * A 'max_count' of 0 (or less than 'count') means the pool cannot grow.
+ */
+typedef struct buffer_pool_spec_s {
+
+    int size;
+    int count;
+    int max_count;
+
+} buffer_pool_spec_t;
+
 typedef struct buffer_s buffer_t;
+typedef struct buffer_block_s buffer_block_t;
 typedef struct buffer_pool_s buffer_pool_t;
 typedef struct buffer_manager_s buffer_manager_t;
 
@@ -110,17 +141,17 @@ typedef struct buffer_manager_s buffer_manager_t;
  * This will be 8 byte aligned.
  *
  * The 'next' pointer simply points to the next free available
- * buffer.  The 'poolp' points to the pool this buffer belongs to,
- * where it should be returned to when freed.  This makes it
- * a very fast free operation to simply re-insert it to the head
- * of the free list of that pool.
+ * buffer.  The 'blockp' points to the block this buffer was carved
+ * from, which knows the pool it should be returned to when freed.
+ * This makes it a very fast free operation to simply re-insert it
+ * to the head of the free list of that pool.
  *
  * Note that user does NOT see or need anything before 'data'.
  */
 struct buffer_s {
 
-    /* the memory pool this buffer belongs to (used when freeing) */
-    buffer_pool_t *poolp;
+    /* the block (& hence the pool) this buffer belongs to */
+    buffer_block_t *blockp;
 
     /* next free buffer in the list (used for allocating) */
     buffer_t *next;
@@ -132,6 +163,40 @@ struct buffer_s {
     unsigned char data [0] __attribute__((aligned(8)));
 };
 
+/*
+ * One malloced block of buffers of a pool.  A pool has one at the start
+ * and gets one more every time it grows.
+ */
+struct buffer_block_s {
+
+    buffer_pool_t *poolp;
+    buffer_block_t *next;
+
+    /* how many buffers were carved from this block & how many are free */
+    int count;
+    int n_free;
+
+    /* buffers follow */
+    long long int buffers [0];
+};
+
+typedef struct buffer_pool_stats_s {
+
+    /* requests this pool was the right size for & served */
+    unsigned long long int hits;
+
+    /* requests this pool was the right size for but served by a bigger one */
+    unsigned long long int fallthroughs;
+
+    /* requests this pool was the right size for & no pool could serve */
+    unsigned long long int failures;
+
+    /* how many times blocks were added to & given back from the pool */
+    unsigned long long int grows;
+    unsigned long long int shrinks;
+
+} buffer_pool_stats_t;
+
 /*
  * Defines ONE memory pool
  */
@@ -154,20 +219,33 @@ struct buffer_pool_s {
      */
     int actual_buffer_size;
 
-    /* how many buffers this particular pool has */
+    /* how many buffers this particular pool has right now */
     int buffer_count;
 
     /*
-     * The entire malloced block for this pool.
-     * When destroying a pool, the entire set of
-     * buffers can be destroyed just by freeing this single
-     * block.  One does not have to free traversing
+     * how many it started with (and never goes below), how many it
+     * can grow up to and how many it grows by each time.
+     */
+    int initial_count;
+    int max_count;
+    int grow_count;
+
+    /*
+     * All the malloced blocks for this pool, the initial one last.
+     * When destroying a pool, the entire set of buffers can be destroyed
+     * just by freeing these blocks.  One does not have to free traversing
      * any lists, one buffer at a time.
      */
-    void *block;
+    buffer_block_t *blocks;
 
-    /* linked list of all the buffers */
+    /* linked list of all the free buffers */
     buffer_t *head;
+
+    /* buffers in use now & the (decaying) most ever in use */
+    int in_use;
+    int high_water;
+
+    buffer_pool_stats_t stats;
 };
 
 /*
@@ -209,15 +287,197 @@ buffer_manager_initialize (buffer_manager_t *bmp,
         size_count_tuple_t tuples [],
         mem_monitor_t *parent_mem_monitor);
 
+/*
+ * Same as above with growable pools, see buffer_pool_spec_t.
+ * Any two negative numbers as size & count terminate the array.
+ */
+extern int
+buffer_manager_initialize_growable (buffer_manager_t *bmp,
+        bool make_it_thread_safe,
+        buffer_pool_spec_t specs [],
+        mem_monitor_t *parent_mem_monitor);
+
 extern void *
 buffer_allocate (buffer_manager_t *bmp, int size);
 
 extern void
 buffer_free (void *ptr);
 
+/*
+ * Whether 'ptr' is a buffer allocated from this buffer manager.
+ */
+extern boolean
+buffer_manager_owns (buffer_manager_t *bmp, void *ptr);
+
+/*
+ * Gives the blocks which pools grew by & are not needed any more back,
+ * and decays the high water marks.  Meant to be called periodically.
+ * Returns how many blocks were given back.
+ */
+extern int
+buffer_manager_trim (buffer_manager_t *bmp);
+
+/*
+ * Copies the statistics of pool number 'pool' (0 is the pool with
+ * the smallest buffers) into 'stats'.  Returns 0 or EINVAL.
+ */
+extern int
+buffer_manager_pool_statistics (buffer_manager_t *bmp, int pool,
+        buffer_pool_stats_t *stats);
+
+/*
+ * prints the sizes, counts & statistics of all the pools
+ */
+extern void
+buffer_manager_report (buffer_manager_t *bmp, FILE *fp);
+
 extern void
 buffer_manager_destroy (buffer_manager_t *bmp);
 
+/******************************************************************************
+ *
+ * Reference counted message buffers.
+ *
+ * A message buffer is a view ('data' & 'length') into a shared storage
+ * buffer allocated from a buffer manager, much like an mbuf or an skb.
+ * The storage has room before (headroom) & after (tailroom) the data,
+ * so that headers can be prepended & trailers appended without moving
+ * the data around.  A message can be passed to many consumers (event
+ * handlers, encoders, I/O threads) without being copied: every one of
+ * them gets its own view thru 'msgbuf_clone' or 'msgbuf_slice' (which
+ * views only a part of it) and releases it when done.  The storage is
+ * given back to its buffer manager when the last view is released.
+ * Reference counts are atomic, so views can be released by any thread.
+ *
+ * Views are small structures owned by the caller (on the stack or in
+ * another structure), only the storage is shared.  A view must NOT be
+ * used to write into a storage which is shared with other views, since
+ * they would see the changes.  'msgbuf_unshare' gives the view a private
+ * copy of its own if the storage is shared, before writing into it.
+ */
+
+typedef struct msgbuf_storage_s {
+
+    /* how many views refer to this storage */
+    volatile int refcount;
+
+    /* how many bytes 'bytes' has */
+    int size;
+
+    long long int bytes [0];
+
+} msgbuf_storage_t;
+
+typedef struct msgbuf_s {
+
+    msgbuf_storage_t *storage;
+    byte *data;
+    int length;
+
+} msgbuf_t;
+
+/*
+ * Allocates a storage of at least 'headroom' + 'size' bytes from the
+ * buffer manager and sets up 'mb' as an empty view of it, starting
+ * after 'headroom' bytes.  Returns 0, EINVAL or ENOMEM.
+ */
+extern int
+msgbuf_allocate (buffer_manager_t *bmp, msgbuf_t *mb,
+        int headroom, int size);
+
+/*
+ * 'dst' becomes another view of exactly what 'src' views.
+ */
+extern void
+msgbuf_clone (msgbuf_t *dst, msgbuf_t *src);
+
+/*
+ * 'dst' becomes a view of the 'length' bytes of 'src' starting
+ * at 'offset'.  Returns 0 or EINVAL if they are not all in 'src'.
+ */
+extern int
+msgbuf_slice (msgbuf_t *dst, msgbuf_t *src, int offset, int length);
+
+/*
+ * Releases the view, and the storage if it was the last view of it.
+ */
+extern void
+msgbuf_release (msgbuf_t *mb);
+
+/*
+ * If the storage is shared, copies it (headroom & tailroom included)
+ * into a new storage from the same buffer manager which only this
+ * view refers to.  Returns 0 or ENOMEM.
+ */
+extern int
+msgbuf_unshare (msgbuf_t *mb);
+
+static inline boolean
+msgbuf_is_shared (msgbuf_t *mb)
+{ return mb->storage->refcount > 1; }
+
+static inline int
+msgbuf_headroom (msgbuf_t *mb)
+{ return (int) (mb->data - (byte*) &mb->storage->bytes[0]); }
+
+static inline int
+msgbuf_tailroom (msgbuf_t *mb)
+{ return mb->storage->size - msgbuf_headroom(mb) - mb->length; }
+
+/*
+ * Grows the data by 'n' bytes at the front, returns where the prepended
+ * bytes should be written to or NULL if there is not enough headroom.
+ * Other views may be using those bytes, so it is also NULL if the
+ * storage is shared (see msgbuf_unshare).
+ */
+static inline byte *
+msgbuf_prepend (msgbuf_t *mb, int n)
+{
+    if ((n < 0) || (n > msgbuf_headroom(mb)) || msgbuf_is_shared(mb))
+        return NULL;
+    mb->data -= n;
+    mb->length += n;
+    return mb->data;
+}
+
+/*
+ * Grows the data by 'n' bytes at the end, returns where the appended
+ * bytes should be written to or NULL if there is not enough tailroom
+ * or the storage is shared.
+ */
+static inline byte *
+msgbuf_append (msgbuf_t *mb, int n)
+{
+    byte *end = mb->data + mb->length;
+
+    if ((n < 0) || (n > msgbuf_tailroom(mb)) || msgbuf_is_shared(mb))
+        return NULL;
+    mb->length += n;
+    return end;
+}
+
+/*
+ * Drops 'n' bytes from the front of the data (a header which has been
+ * processed for example), returns the new start or NULL if too many.
+ */
+static inline byte *
+msgbuf_trim_front (msgbuf_t *mb, int n)
+{
+    if ((n < 0) || (n > mb->length)) return NULL;
+    mb->data += n;
+    mb->length -= n;
+    return mb->data;
+}
+
+/* drops 'n' bytes from the end, returns 0 or EINVAL */
+static inline int
+msgbuf_trim_back (msgbuf_t *mb, int n)
+{
+    if ((n < 0) || (n > mb->length)) return EINVAL;
+    mb->length -= n;
+    return 0;
+}
+
 #ifdef __cplusplus
 } /* extern C */
 #endif
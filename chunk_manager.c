@@ -33,6 +33,8 @@
 *******************************************************************************
 ******************************************************************************/
 
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include "chunk_manager.h"
 
 #ifdef __cplusplus
@@ -75,6 +77,17 @@ struct chunk_group_s {
     /* big bulk of the memory, all chunks adjacent in one big block */
     void *chunks_block;
 
+    /*
+     * how big the block is & whether it was mmap'ed, in which case
+     * how much was mapped (whole huge pages if they are used)
+     */
+    long long int block_size;
+    boolean mapped;
+    long long int map_size;
+
+    /* free list the group feeds, the numa node it is bound to if any */
+    int node;
+
     /* how many free chunks are in this group */
     int n_grp_free;
 
@@ -83,8 +96,132 @@ struct chunk_group_s {
 
 };
 
+/*
+ * Asking the kernel for the numa node on every allocation costs more
+ * than the allocation itself, so every thread remembers its node and
+ * only asks again after this many allocations, in case it has been
+ * moved to another node meanwhile.
+ */
+#define CHUNK_MANAGER_NODE_REFRESH      1024
+
+static __thread int my_numa_node = -1;
+static __thread int my_numa_node_uses = 0;
+
+static int
+chunk_manager_lookup_node (void)
+{
+#ifdef SYS_getcpu
+    unsigned int cpu, node;
+
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) return node;
+#endif
+    return 0;
+}
+
+/*
+ * numa node the calling thread is (recently) running on,
+ * which is always 0 if CHUNK_MANAGER_NUMA is not in effect.
+ */
+static inline int
+chunk_manager_current_node (chunk_manager_t *cmgrp)
+{
+    if (0 == (cmgrp->options & CHUNK_MANAGER_NUMA)) return 0;
+    if ((my_numa_node < 0) ||
+        (++my_numa_node_uses >= CHUNK_MANAGER_NODE_REFRESH)) {
+            my_numa_node = chunk_manager_lookup_node();
+            my_numa_node_uses = 0;
+    }
+    return my_numa_node;
+}
+
+/*
+ * free list for the node.  Nodes which do not have one of their own
+ * share the first one, see the header file.
+ */
+static inline int
+chunk_manager_node_list (int node)
+{
+    return (node < CHUNK_MANAGER_MAX_NUMA_NODES) ? node : 0;
+}
+
+/*
+ * Binds the (not yet touched) block to the numa node so that its
+ * pages are faulted in there.  Called thru the system call directly
+ * so as not to depend on libnuma.  Failures (no numa support in
+ * the kernel, single node machine etc) are harmless and ignored.
+ */
+static void
+chunk_manager_bind_block (void *block, long long int size, int node)
+{
+#ifdef SYS_mbind
+    unsigned long int nodemask = 1UL << node;
+
+    /* 2 is MPOL_BIND */
+    syscall(SYS_mbind, block, size, 2, &nodemask,
+        sizeof(nodemask) * 8, 0);
+#endif
+}
+
+/*
+ * mmaps a block for a group, aligned to a huge page
+ * if huge pages are asked for.  Returns NULL on failure.
+ */
+static void *
+chunk_manager_map_block (chunk_manager_t *cmgrp, long long int size)
+{
+    byte *block = MAP_FAILED, *aligned;
+    long long int extra;
+
+#ifdef MAP_HUGETLB
+    if (cmgrp->options & CHUNK_MANAGER_HUGETLB) {
+        block = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (block != MAP_FAILED) return block;
+    }
+#endif
+
+    if (0 == (cmgrp->options &
+            (CHUNK_MANAGER_HUGE_PAGES | CHUNK_MANAGER_HUGETLB))) {
+        block = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return (block == MAP_FAILED) ? NULL : block;
+    }
+
+    /*
+     * map one huge page more than needed and unmap the parts
+     * before & after the first huge page boundary in it
+     */
+    block = mmap(NULL, size + CHUNK_MANAGER_HUGE_PAGE_SIZE,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED) return NULL;
+    aligned = (byte*) (((unsigned long long int) block +
+        CHUNK_MANAGER_HUGE_PAGE_SIZE - 1) &
+            ~((unsigned long long int) CHUNK_MANAGER_HUGE_PAGE_SIZE - 1));
+    extra = aligned - block;
+    if (extra) munmap(block, extra);
+    extra = CHUNK_MANAGER_HUGE_PAGE_SIZE - extra;
+    if (extra) munmap(aligned + size, extra);
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+
+    return aligned;
+}
+
+static void
+chunk_manager_group_free (chunk_manager_t *cmgrp, chunk_group_t *cgp)
+{
+    if (cgp->mapped) {
+        munmap(cgp->chunks_block, cgp->map_size);
+        mem_monitor_account_external(cmgrp->mem_mon_p, -cgp->map_size);
+    } else {
+        MEM_MONITOR_FREE(cgp->chunks_block);
+    }
+    MEM_MONITOR_FREE(cgp);
+}
+
 static int
-chunk_manager_add_group_failed (chunk_manager_t *cmgrp)
+chunk_manager_add_group_failed (chunk_manager_t *cmgrp, int node)
 {
     byte *bp;
     chunk_header_t *chp;
@@ -96,25 +233,51 @@ chunk_manager_add_group_failed (chunk_manager_t *cmgrp)
     if (NULL == cgp) return ENOMEM;
 
     /* allocate the big chunk block */
-    cgp->chunks_block = MEM_MONITOR_ALLOC(cmgrp,
-            (cmgrp->actual_chunk_size * cmgrp->chunks_per_group));
+    cgp->block_size = (long long int)
+        cmgrp->actual_chunk_size * cmgrp->chunks_per_group;
+    cgp->node = chunk_manager_node_list(node);
+    if (cmgrp->options) {
+
+        /* huge pages can only be unmapped whole */
+        cgp->map_size = cgp->block_size;
+        if (cmgrp->options &
+                (CHUNK_MANAGER_HUGE_PAGES | CHUNK_MANAGER_HUGETLB)) {
+            cgp->map_size = (cgp->map_size +
+                CHUNK_MANAGER_HUGE_PAGE_SIZE - 1) &
+                    ~((long long int) CHUNK_MANAGER_HUGE_PAGE_SIZE - 1);
+        }
+        cgp->chunks_block = chunk_manager_map_block(cmgrp, cgp->map_size);
+        cgp->mapped = true;
+    } else {
+        cgp->chunks_block = MEM_MONITOR_ALLOC(cmgrp, cgp->block_size);
+        cgp->mapped = false;
+    }
     if (NULL == cgp->chunks_block) {
         MEM_MONITOR_FREE(cgp);
         return ENOMEM;
     }
+    if (cgp->mapped) {
+        mem_monitor_account_external(cmgrp->mem_mon_p, cgp->map_size);
+        if ((cmgrp->options & CHUNK_MANAGER_NUMA) &&
+            (node < CHUNK_MANAGER_MAX_NUMA_NODES)) {
+                chunk_manager_bind_block(cgp->chunks_block,
+                    cgp->map_size, node);
+        }
+    }
 
     /*
      * run thru the newly allocated block and partition each chunk
-     * and add it to the head of the free chunks list in the main
-     * manager.
+     * and add it to the head of the free chunks list of its node
+     * in the main manager.  Chunks are pushed in reverse so that
+     * they are handed out in address order.
      */
-    bp = cgp->chunks_block;
+    bp = ((byte*) cgp->chunks_block) + cgp->block_size;
     for (i = 0; i < cmgrp->chunks_per_group; i++) {
+        bp -= cmgrp->actual_chunk_size;
         chp = (chunk_header_t*) bp;
         chp->my_group = cgp;
-        chp->next_chunk_header = cmgrp->free_chunks_list;
-        cmgrp->free_chunks_list = chp;
-        bp += cmgrp->actual_chunk_size;
+        chp->next_chunk_header = cmgrp->free_chunks_lists[cgp->node];
+        cmgrp->free_chunks_lists[cgp->node] = chp;
     }
 
     /* update group related stuff */
@@ -142,12 +305,14 @@ static inline void *
 thread_unsafe_chunk_manager_alloc (chunk_manager_t *cmgrp)
 {
     chunk_header_t *chp;
+    int node = chunk_manager_current_node(cmgrp);
+    int list = chunk_manager_node_list(node);
 
-    /* pop the first chunk from the free chunks list */
+    /* pop the first chunk from the free chunks list of our node */
     //if (cmgrp->n_cmgr_free > 0) {
-    chp = cmgrp->free_chunks_list;
+    chp = cmgrp->free_chunks_lists[list];
     if (chp) {
-        cmgrp->free_chunks_list = chp->next_chunk_header;
+        cmgrp->free_chunks_lists[list] = chp->next_chunk_header;
         (chp->my_group->n_grp_free)--;
         //(cmgrp->n_cmgr_free)--;
         return &(chp->data[0]);
@@ -157,7 +322,7 @@ thread_unsafe_chunk_manager_alloc (chunk_manager_t *cmgrp)
      * if we are here, no more free chunks left, so create a new
      * group and recursively call the function again.
      */
-    if (chunk_manager_add_group_failed(cmgrp)) {
+    if (chunk_manager_add_group_failed(cmgrp, node)) {
         return null;
     }
 
@@ -186,7 +351,7 @@ thread_unsafe_chunk_manager_trim (chunk_manager_t *cmgrp)
 {
     chunk_header_t *chp, *next_chp;
     chunk_group_t *cgp, *next_cgp;
-    int chunks_tobe_freed, grps_tobe_freed;
+    int chunks_tobe_freed, grps_tobe_freed, node;
 
     /*
      * since we free up entire groups of chunks, there must at least
@@ -198,28 +363,30 @@ thread_unsafe_chunk_manager_trim (chunk_manager_t *cmgrp)
         //return 0;
 
     chunks_tobe_freed = grps_tobe_freed = 0;
-    chp = cmgrp->free_chunks_list;
-    cmgrp->free_chunks_list = null;
-    //cmgrp->n_cmgr_free = 0;
-    while (chp) {
-
-        next_chp = chp->next_chunk_header;
-
-        /*
-         * if this chunk does not belong to a group whose chunks
-         * are all free (will be deleted), then re-add it to the
-         * free list.  The rest will be left 'dangling' but they
-         * will soon be all deleted anyway so it does not matter.
-         */
-        if (chp->my_group->n_grp_free < cmgrp->chunks_per_group) {
-            chp->next_chunk_header = cmgrp->free_chunks_list;
-            cmgrp->free_chunks_list = chp;
-            //(cmgrp->n_cmgr_free)++;
-        } else {
-            chunks_tobe_freed++;
-        }
+    for (node = 0; node < CHUNK_MANAGER_MAX_NUMA_NODES; node++) {
+        chp = cmgrp->free_chunks_lists[node];
+        cmgrp->free_chunks_lists[node] = null;
+        //cmgrp->n_cmgr_free = 0;
+        while (chp) {
+
+            next_chp = chp->next_chunk_header;
+
+            /*
+             * if this chunk does not belong to a group whose chunks
+             * are all free (will be deleted), then re-add it to the
+             * free list.  The rest will be left 'dangling' but they
+             * will soon be all deleted anyway so it does not matter.
+             */
+            if (chp->my_group->n_grp_free < cmgrp->chunks_per_group) {
+                chp->next_chunk_header = cmgrp->free_chunks_lists[node];
+                cmgrp->free_chunks_lists[node] = chp;
+                //(cmgrp->n_cmgr_free)++;
+            } else {
+                chunks_tobe_freed++;
+            }
 
-        chp = next_chp;
+            chp = next_chp;
+        }
     }
 
     /*
@@ -235,8 +402,7 @@ thread_unsafe_chunk_manager_trim (chunk_manager_t *cmgrp)
                 cgp->next_chunk_group = cmgrp->groups;
                 cmgrp->groups = cgp;
             } else {
-                MEM_MONITOR_FREE(cgp->chunks_block);
-                MEM_MONITOR_FREE(cgp);
+                chunk_manager_group_free(cmgrp, cgp);
                 grps_tobe_freed++;
             }
             cgp = next_cgp;
@@ -254,6 +420,19 @@ chunk_manager_init (chunk_manager_t *cmgrp,
     int chunk_size, int chunks_per_group,
     mem_monitor_t *parent_mem_monitor)
 {
+    return
+        chunk_manager_init_with_options(cmgrp, make_it_thread_safe,
+            chunk_size, chunks_per_group, 0, parent_mem_monitor);
+}
+
+PUBLIC int
+chunk_manager_init_with_options (chunk_manager_t *cmgrp,
+    boolean make_it_thread_safe,
+    int chunk_size, int chunks_per_group, int options,
+    mem_monitor_t *parent_mem_monitor)
+{
+    long long int group_size;
+
     /* basic sanity checks */
     if ((chunk_size < MIN_CHUNK_SIZE) ||
         (chunk_size > MAX_CHUNK_SIZE)) {
@@ -263,6 +442,10 @@ chunk_manager_init (chunk_manager_t *cmgrp,
         (chunks_per_group > MAX_CHUNKS_PER_GROUP)) {
             return EINVAL;
     }
+    if (options & ~(CHUNK_MANAGER_HUGE_PAGES | CHUNK_MANAGER_HUGETLB |
+            CHUNK_MANAGER_NUMA)) {
+        return EINVAL;
+    }
 
     /* clear absolutely everything */
     memset(cmgrp, 0, sizeof(chunk_manager_t));
@@ -276,6 +459,19 @@ chunk_manager_init (chunk_manager_t *cmgrp,
         ((chunk_size + 7) & ~7) + sizeof(chunk_header_t);
 
     cmgrp->chunks_per_group = chunks_per_group;
+    cmgrp->options = options;
+
+    /*
+     * with huge pages, groups are made up of whole huge pages,
+     * so add as many chunks as fit into the rounded up size
+     */
+    if (options & (CHUNK_MANAGER_HUGE_PAGES | CHUNK_MANAGER_HUGETLB)) {
+        group_size = (long long int) cmgrp->actual_chunk_size *
+            chunks_per_group;
+        group_size = (group_size + CHUNK_MANAGER_HUGE_PAGE_SIZE - 1) &
+            ~((long long int) CHUNK_MANAGER_HUGE_PAGE_SIZE - 1);
+        cmgrp->chunks_per_group = group_size / cmgrp->actual_chunk_size;
+    }
 
     return 0;
 }
@@ -310,9 +506,9 @@ chunk_free (void *chunk)
     /* main chunk manager is being returned one */
     //(cmgrp->n_cmgr_free)++;
 
-    /* place it back into the head of free chunks list */
-    chp->next_chunk_header = cmgrp->free_chunks_list;
-    cmgrp->free_chunks_list = chp;
+    /* place it back into the head of the free chunks list of its node */
+    chp->next_chunk_header = cmgrp->free_chunks_lists[chp->my_group->node];
+    cmgrp->free_chunks_lists[chp->my_group->node] = chp;
 
     OBJ_WRITE_UNLOCK(cmgrp);
 }
@@ -338,8 +534,7 @@ chunk_manager_destroy (chunk_manager_t *cmgrp)
     grp = cmgrp->groups;
     while (grp) {
         next_grp = grp->next_chunk_group;
-        MEM_MONITOR_FREE(grp->chunks_block);
-        MEM_MONITOR_FREE(grp);
+        chunk_manager_group_free(cmgrp, grp);
         grp = next_grp;
     }
     memset(cmgrp, 0, sizeof(chunk_manager_t));
@@ -88,6 +88,36 @@ extern "C" {
  *
  */
 
+/*
+ * Options for 'chunk_manager_init_with_options'.
+ *
+ * CHUNK_MANAGER_HUGE_PAGES: every group is mmap'ed on a huge page
+ * (2MB) boundary, rounded up to whole huge pages (by adding more
+ * chunks to it) and transparent huge pages are asked for it with
+ * madvise(MADV_HUGEPAGE).  Millions of chunks then sit on a few
+ * huge pages, cutting down on TLB misses when they are accessed
+ * all over the place, as the nodes of big trees & lists are.
+ *
+ * CHUNK_MANAGER_HUGETLB: same but the groups are mmap'ed from the
+ * explicitly reserved huge pages (MAP_HUGETLB) if there are any left,
+ * falling back to CHUNK_MANAGER_HUGE_PAGES otherwise.
+ *
+ * CHUNK_MANAGER_NUMA: every group is bound (mbind) to the numa node
+ * of the thread which caused it to be created, and every node has
+ * its own free list.  A thread allocates chunks from the free list
+ * of the node it is running on, so it always gets local memory.
+ * A freed chunk goes back to the free list of the node it is on.
+ * Only nodes below CHUNK_MANAGER_MAX_NUMA_NODES have a free list of
+ * their own.  Threads on any other node share the free list of node
+ * 0 and the groups they create are not bound to any node.
+ */
+#define CHUNK_MANAGER_HUGE_PAGES        (1 << 0)
+#define CHUNK_MANAGER_HUGETLB           (1 << 1)
+#define CHUNK_MANAGER_NUMA              (1 << 2)
+
+#define CHUNK_MANAGER_HUGE_PAGE_SIZE    (2 * 1024 * 1024)
+#define CHUNK_MANAGER_MAX_NUMA_NODES    8
+
 typedef struct chunk_header_s chunk_header_t;
 typedef struct chunk_group_s chunk_group_t;
 typedef struct chunk_manager_s chunk_manager_t;
@@ -107,11 +137,15 @@ struct chunk_manager_s {
     /* how many chunks per group is needed */
     int chunks_per_group;
 
+    /* CHUNK_MANAGER_* options below */
+    int options;
+
     /*
-     * a linked list of all the free chunks in all the
-     * groups and their count
+     * linked lists of all the free chunks in all the groups and
+     * their count.  Without CHUNK_MANAGER_NUMA, only the first
+     * one is used, otherwise there is one for every numa node.
      */
-    chunk_header_t *free_chunks_list;
+    chunk_header_t *free_chunks_lists [CHUNK_MANAGER_MAX_NUMA_NODES];
     int n_cmgr_free;
 
     /* a linked list of all the groups */
@@ -151,6 +185,17 @@ chunk_manager_init (chunk_manager_t *cmgrp,
     int chunk_size, int chunks_per_group,
     mem_monitor_t *parent_mem_monitor);
 
+/*
+ * Same as above, with any of the CHUNK_MANAGER_* options OR'ed
+ * together in 'options'.  Options which the platform does not
+ * support are silently ignored.
+ */
+extern int
+chunk_manager_init_with_options (chunk_manager_t *cmgrp,
+    boolean make_it_thread_safe,
+    int chunk_size, int chunks_per_group, int options,
+    mem_monitor_t *parent_mem_monitor);
+
 /*
  * returns a pointer to a memory block with a size specified
  * at the initialization of the chunk manager.  Do NOT access
@@ -33,6 +33,11 @@
 *******************************************************************************
 ******************************************************************************/
 
+#include <stddef.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
 #include "debug_framework.h"
 
 #ifdef __cplusplus
@@ -46,6 +51,1197 @@ static const char *level_strings [] = {
     [ERROR_DEBUG_LEVEL] = "ERROR",
     [FATAL_ERROR_DEBUG_LEVEL] = "FATAL_ERROR" };
 
+/******************************************************************************
+ *
+ * Format string scanning, shared by argument capturing & formatting.
+ */
+
+typedef struct format_spec_s {
+
+    /* the whole conversion specification, starting with the '%' */
+    const char *start;
+    int length;
+
+    /* how many '*' (width/precision) integer arguments it consumes */
+    int stars;
+
+    /* length modifier, 'H' is used for 'hh' and 'q' for 'll' */
+    char modifier;
+
+    /* conversion character, 0 if the specification is malformed */
+    char conversion;
+
+} format_spec_t;
+
+/*
+ * parses the conversion specification starting at 'fmt' (which
+ * points to a '%') and returns the pointer just past it.
+ */
+static const char *
+format_spec_parse (const char *fmt, format_spec_t *spec)
+{
+    const char *p = fmt + 1;
+
+    spec->start = fmt;
+    spec->stars = 0;
+    spec->modifier = 0;
+    spec->conversion = 0;
+
+    /* flags */
+    while (*p && strchr("-+ #0'", *p)) p++;
+
+    /* width */
+    if (*p == '*') {
+        spec->stars++;
+        p++;
+    } else {
+        while ((*p >= '0') && (*p <= '9')) p++;
+    }
+
+    /* precision */
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->stars++;
+            p++;
+        } else {
+            while ((*p >= '0') && (*p <= '9')) p++;
+        }
+    }
+
+    /* length modifier */
+    if ((p[0] == 'h') && (p[1] == 'h')) {
+        spec->modifier = 'H';
+        p += 2;
+    } else if ((p[0] == 'l') && (p[1] == 'l')) {
+        spec->modifier = 'q';
+        p += 2;
+    } else if (*p && strchr("hlLqjzt", *p)) {
+        spec->modifier = *p++;
+    }
+
+    /* conversion */
+    if (*p && strchr("diouxXcCeEfFgGaAsSpn", *p)) {
+        spec->conversion = *p++;
+    }
+    spec->length = p - fmt;
+
+    return p;
+}
+
+static inline bool
+is_integer_conversion (char conversion)
+{ return conversion && (NULL != strchr("diouxXcC", conversion)); }
+
+static inline bool
+is_double_conversion (char conversion)
+{ return conversion && (NULL != strchr("eEfFgGaA", conversion)); }
+
+static inline long long int
+integer_arg_pull (format_spec_t *spec, va_list *args)
+{
+    switch (spec->modifier) {
+    case 'l':   return va_arg(*args, long int);
+    case 'q':   return va_arg(*args, long long int);
+    case 'j':   return va_arg(*args, intmax_t);
+    case 'z':   return va_arg(*args, size_t);
+    case 't':   return va_arg(*args, ptrdiff_t);
+    default:    return va_arg(*args, int);
+    }
+}
+
+PUBLIC void
+debug_args_capture (debug_args_t *dap, const char *fmt, va_list args)
+{
+    format_spec_t spec;
+    va_list copy;
+    const char *str;
+    int i, len;
+
+    dap->n_args = dap->truncated = 0;
+    dap->string_bytes = 0;
+
+    /* va_list may be an array type, pass a pointer to a copy around */
+    va_copy(copy, args);
+    while (*fmt) {
+
+        if (*fmt != '%') {
+            fmt++;
+            continue;
+        }
+        if (fmt[1] == '%') {
+            fmt += 2;
+            continue;
+        }
+        fmt = format_spec_parse(fmt, &spec);
+        if (0 == spec.conversion) break;
+
+        if ((dap->n_args + spec.stars + 1) > DEBUG_RECORD_MAX_ARGS) {
+            dap->truncated = 1;
+            break;
+        }
+        for (i = 0; i < spec.stars; i++) {
+            dap->args[dap->n_args++].i = va_arg(copy, int);
+        }
+
+        if (is_integer_conversion(spec.conversion)) {
+            dap->args[dap->n_args++].i = integer_arg_pull(&spec, &copy);
+        } else if (is_double_conversion(spec.conversion)) {
+            dap->args[dap->n_args++].d = (spec.modifier == 'L') ?
+                (double) va_arg(copy, long double) : va_arg(copy, double);
+        } else if ((spec.conversion == 's') && (spec.modifier != 'l')) {
+            str = va_arg(copy, const char*);
+            if (NULL == str) {
+                dap->args[dap->n_args++].i = -1;
+                continue;
+            }
+            len = DEBUG_RECORD_STRING_SPACE - dap->string_bytes - 1;
+            if (len < 0) len = 0;
+            dap->args[dap->n_args++].i = dap->string_bytes;
+            for (i = 0; (i < len) && str[i]; i++) {
+                dap->strings[dap->string_bytes + i] = str[i];
+            }
+            dap->strings[dap->string_bytes + i] = 0;
+            dap->string_bytes += i + 1;
+            if (dap->string_bytes >= DEBUG_RECORD_STRING_SPACE) {
+                dap->string_bytes = DEBUG_RECORD_STRING_SPACE - 1;
+            }
+        } else {
+
+            /* %p, %n and wide strings, only the pointer value is kept */
+            dap->args[dap->n_args++].p = va_arg(copy, void*);
+        }
+    }
+    va_end(copy);
+}
+
+/*
+ * appends 'len' characters (or less if there is no more room)
+ * which snprintf (or a copy) has already written at buffer[*idx].
+ */
+static inline void
+format_advance (int *idx, int size, int len)
+{
+    if (len < 0) len = 0;
+    if (*idx + len > size - 1) len = size - 1 - *idx;
+    *idx += len;
+}
+
+PUBLIC int
+debug_args_format (char *buffer, int size,
+    const char *fmt, debug_args_t *dap)
+{
+    format_spec_t spec;
+    char one_spec [32];
+    int idx, arg, len, i;
+    int w [2] = { 0, 0 };
+    debug_arg_t *a;
+    const char *str, *whole_fmt = fmt;
+
+    if (size <= 0) return 0;
+    idx = arg = 0;
+    while (*fmt && (idx < size - 1)) {
+
+        /* literal text */
+        if ((*fmt != '%') || (fmt[1] == '%')) {
+            buffer[idx++] = *fmt;
+            fmt += (*fmt == '%') ? 2 : 1;
+            continue;
+        }
+
+        fmt = format_spec_parse(fmt, &spec);
+        if ((0 == spec.conversion) ||
+            (spec.length >= (int) sizeof(one_spec)) ||
+            (arg + spec.stars + 1 > dap->n_args)) {
+                len = snprintf(&buffer[idx], size - idx, "...");
+                format_advance(&idx, size, len);
+                break;
+        }
+        memcpy(one_spec, spec.start, spec.length);
+        one_spec[spec.length] = 0;
+        for (i = 0; i < spec.stars; i++) w[i] = (int) dap->args[arg++].i;
+        a = &dap->args[arg++];
+
+        /* the star arguments always precede the value itself */
+        #define FORMAT_ONE(value) \
+            ((spec.stars == 0) ? \
+                snprintf(&buffer[idx], size - idx, one_spec, value) : \
+            (spec.stars == 1) ? \
+                snprintf(&buffer[idx], size - idx, one_spec, w[0], value) : \
+                snprintf(&buffer[idx], size - idx, one_spec, w[0], w[1], value))
+
+        if (is_integer_conversion(spec.conversion)) {
+            switch (spec.modifier) {
+            case 'l':   len = FORMAT_ONE((long int) a->i); break;
+            case 'q':   len = FORMAT_ONE(a->i); break;
+            case 'j':   len = FORMAT_ONE((intmax_t) a->i); break;
+            case 'z':   len = FORMAT_ONE((size_t) a->i); break;
+            case 't':   len = FORMAT_ONE((ptrdiff_t) a->i); break;
+            default:    len = FORMAT_ONE((int) a->i); break;
+            }
+        } else if (is_double_conversion(spec.conversion)) {
+            if (spec.modifier == 'L') {
+                len = FORMAT_ONE((long double) a->d);
+            } else {
+                len = FORMAT_ONE(a->d);
+            }
+        } else if ((spec.conversion == 's') && (spec.modifier != 'l')) {
+            /* offsets come from trace files too, never trust them */
+            str = (a->i < 0) ? "(null)" :
+                (a->i >= dap->string_bytes) ? "(bad string)" :
+                &dap->strings[a->i];
+            len = FORMAT_ONE(str);
+        } else if (spec.conversion == 'n') {
+            len = 0;
+        } else {
+            len = snprintf(&buffer[idx], size - idx, "%p", a->p);
+        }
+
+        #undef FORMAT_ONE
+
+        format_advance(&idx, size, len);
+    }
+    if (dap->truncated && (0 == *fmt)) {
+        len = snprintf(&buffer[idx], size - idx, "...");
+        format_advance(&idx, size, len);
+    }
+
+    /* a cut short message must still end the line if it was meant to */
+    len = strlen(whole_fmt);
+    if (len && (whole_fmt[len-1] == '\n') && idx &&
+        (buffer[idx-1] != '\n')) {
+            if (idx >= size - 1) idx--;
+            buffer[idx++] = '\n';
+    }
+    buffer[idx] = 0;
+
+    return idx;
+}
+
+/******************************************************************************
+ *
+ * Asynchronous reporting rings.
+ */
+
+typedef struct debug_ring_s debug_ring_t;
+
+struct debug_ring_s {
+
+    /* all rings are chained together for the reporting thread */
+    debug_ring_t *next;
+
+    /* set when the owning thread exits, ring is freed once drained */
+    volatile int owner_exited;
+
+    /* small number identifying the owning thread in trace files */
+    unsigned int thread_number;
+
+    /* only ever written by the reporting thread */
+    volatile unsigned int tail __attribute__((aligned(64)));
+
+    /* only ever written by the owning thread */
+    volatile unsigned int head __attribute__((aligned(64)));
+    unsigned long long int dropped;
+
+    /* set while the owning thread is putting a record in, see below */
+    volatile int recording;
+
+    unsigned int mask;
+    debug_record_t records [0] __attribute__((aligned(64)));
+};
+
+/* sleep time of the reporting thread when all rings are empty */
+#define DEBUG_RING_IDLE_SLEEP_NSECS     (1000000)
+
+/* longest message a record can be expanded to */
+#define DEBUG_RING_MAX_LINE             512
+
+/*
+ * Binary trace file layout.  All values are in the byte order of the
+ * machine which wrote the file and every record is padded to a multiple
+ * of 8 bytes.  The file starts with a header, followed by any mix of:
+ *
+ * - a site record, written the very first time a call site is seen,
+ *   which assigns an id to it and holds its level, line number and the
+ *   module name, file name, function name & format strings (each null
+ *   terminated) in that order.
+ *
+ * - a message record, which holds the site id, time stamp, thread and
+ *   the raw arguments exactly as in a 'debug_args_t', followed by the
+ *   string bytes of the '%s' arguments.
+ *
+ * A site record always precedes all the messages referring to it.
+ */
+#define DEBUG_TRACE_MAGIC               "DBGTRACE"
+#define DEBUG_TRACE_VERSION             1
+#define DEBUG_TRACE_BYTE_ORDER          0x01020304
+
+#define DEBUG_TRACE_SITE_RECORD         1
+#define DEBUG_TRACE_MESSAGE_RECORD      2
+
+/* format strings etc. longer than this are cut short in the trace */
+#define DEBUG_TRACE_MAX_STRING          1024
+
+#define DEBUG_TRACE_PADDED(n)           (((n) + 7) & ~7)
+
+typedef struct debug_trace_file_header_s {
+
+    char magic [8];
+    uint32_t version;
+    uint32_t byte_order;
+
+} debug_trace_file_header_t;
+
+typedef struct debug_trace_site_record_s {
+
+    uint32_t length;
+    uint32_t type;
+    uint32_t id;
+    int32_t line_number;
+    int32_t level;
+
+    /* excluding the terminating null characters */
+    uint32_t string_lengths [4];
+
+} debug_trace_site_record_t;
+
+typedef struct debug_trace_message_record_s {
+
+    uint32_t length;
+    uint32_t type;
+    uint32_t id;
+    uint32_t thread_number;
+    int64_t time_stamp;
+    uint8_t n_args;
+    uint8_t truncated;
+    int16_t string_bytes;
+    uint32_t reserved;
+
+} debug_trace_message_record_t;
+
+/* a call site already written into the trace, keyed by all its fields */
+typedef struct debug_trace_site_s {
+
+    const char *fmt;
+    const char *file_name;
+    debug_module_block_t *dmbp;
+    int line_number;
+    int level;
+    unsigned int id;
+
+} debug_trace_site_t;
+
+static struct {
+
+    /* checked by every message, so it goes first */
+    volatile int running;
+    volatile int stop_requested;
+
+    FILE *output;
+    unsigned int records_per_ring;
+
+    /* records are written out in binary rather than as text */
+    int binary;
+
+    /* call sites seen so far in a binary trace, see below */
+    debug_trace_site_t *sites;
+    unsigned int sites_size, n_sites;
+
+    /* protects the list of rings (grabbed only when it changes) */
+    lock_obj_t rings_lock;
+    debug_ring_t *rings;
+    unsigned int threads_seen;
+    unsigned long long int dropped_by_freed_rings;
+
+    /* records which could not be written into a binary trace */
+    unsigned long long int dropped_by_reporter;
+
+    pthread_t reporter;
+
+} debug_ring_control;
+
+static pthread_once_t debug_ring_once = PTHREAD_ONCE_INIT;
+static pthread_key_t debug_ring_key;
+static __thread debug_ring_t *my_debug_ring = NULL;
+
+static void
+debug_ring_owner_exits (void *vring)
+{
+    ((debug_ring_t*) vring)->owner_exited = 1;
+}
+
+static void
+debug_ring_key_create (void)
+{
+    lock_obj_init(&debug_ring_control.rings_lock);
+    pthread_key_create(&debug_ring_key, debug_ring_owner_exits);
+}
+
+/*
+ * Rings are never freed while their thread is alive, so
+ * that a thread can cache its ring pointer for good.
+ */
+static debug_ring_t *
+debug_ring_of_this_thread (void)
+{
+    debug_ring_t *ring;
+    unsigned int count;
+
+    if (my_debug_ring) return my_debug_ring;
+    count = debug_ring_control.records_per_ring;
+    ring = calloc(1, sizeof(debug_ring_t) + (count * sizeof(debug_record_t)));
+    if (NULL == ring) return NULL;
+    ring->mask = count - 1;
+
+    grab_write_lock(&debug_ring_control.rings_lock);
+    ring->thread_number = ++debug_ring_control.threads_seen;
+    ring->next = debug_ring_control.rings;
+    debug_ring_control.rings = ring;
+    release_write_lock(&debug_ring_control.rings_lock);
+
+    pthread_setspecific(debug_ring_key, ring);
+    my_debug_ring = ring;
+
+    return ring;
+}
+
+/*
+ * Returns false if reporting stopped before the record could be put
+ * in, so the caller has to report the message itself.  Reporting may
+ * stop right after the caller checked 'running', so it is checked
+ * again once 'recording' is set.  The stopping thread clears 'running'
+ * and then waits for every ring to stop recording before the last
+ * drain, so whatever went into a ring is never left behind.
+ */
+static bool
+debug_ring_record (debug_module_block_t *dmbp, int level,
+    const char *file_name, const char *function_name, const int line_number,
+    char *fmt, va_list args)
+{
+    debug_ring_t *ring;
+    debug_record_t *rec;
+    unsigned int head;
+
+    ring = debug_ring_of_this_thread();
+    if (NULL == ring) return true;
+
+    ring->recording = 1;
+    __sync_synchronize();
+    if (!debug_ring_control.running) {
+        ring->recording = 0;
+        return false;
+    }
+
+    head = ring->head;
+    if ((head - ring->tail) > ring->mask) {
+        ring->dropped++;
+        __atomic_store_n(&ring->recording, 0, __ATOMIC_RELEASE);
+        return true;
+    }
+    rec = &ring->records[head & ring->mask];
+    rec->time_stamp = time_now();
+    rec->dmbp = dmbp;
+    rec->file_name = file_name;
+    rec->function_name = function_name;
+    rec->fmt = fmt;
+    rec->line_number = line_number;
+    rec->level = level;
+    debug_args_capture(&rec->args, fmt, args);
+
+    /* record MUST be complete before the reporter can see it */
+    __sync_synchronize();
+    ring->head = head + 1;
+    __atomic_store_n(&ring->recording, 0, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static void
+debug_record_report (FILE *fp, debug_record_t *rec)
+{
+    char line [DEBUG_RING_MAX_LINE];
+
+    debug_args_format(line, sizeof(line), rec->fmt, &rec->args);
+    fprintf(fp, "[%lld.%09lld] %s: %s: %s(%d): <%s>: %s",
+        rec->time_stamp / SEC_TO_NSEC_FACTOR,
+        rec->time_stamp % SEC_TO_NSEC_FACTOR,
+        level_strings[rec->level], &rec->dmbp->module_name[0],
+        rec->file_name, rec->line_number, rec->function_name, line);
+}
+
+/******************************************************************************
+ *
+ * Binary trace files.  Only the reporting thread ever writes into them,
+ * hence none of the below needs any locking.
+ */
+
+#define DEBUG_TRACE_INITIAL_SITES       256
+
+static inline unsigned int
+debug_trace_site_hash (debug_record_t *rec)
+{
+    return (unsigned int) ((((uintptr_t) rec->fmt) >> 3) * 2654435761u) +
+        rec->line_number;
+}
+
+static inline bool
+debug_trace_site_matches (debug_trace_site_t *site, debug_record_t *rec)
+{
+    return
+        (site->fmt == rec->fmt) &&
+        (site->line_number == rec->line_number) &&
+        (site->file_name == rec->file_name) &&
+        (site->dmbp == rec->dmbp) &&
+        (site->level == rec->level);
+}
+
+/*
+ * Returns the slot where the site of 'rec' is, or should be inserted.
+ */
+static debug_trace_site_t *
+debug_trace_site_slot (debug_trace_site_t *sites, unsigned int size,
+    debug_record_t *rec)
+{
+    unsigned int i = debug_trace_site_hash(rec);
+
+    while (1) {
+        i &= (size - 1);
+        if ((NULL == sites[i].fmt) || debug_trace_site_matches(&sites[i], rec))
+            return &sites[i];
+        i++;
+    }
+}
+
+/*
+ * keeps the table of sites at most half full
+ */
+static int
+debug_trace_sites_grow (void)
+{
+    debug_trace_site_t *sites, *old = debug_ring_control.sites;
+    debug_record_t key;
+    unsigned int i, size;
+
+    size = debug_ring_control.sites_size ?
+        (debug_ring_control.sites_size << 1) : DEBUG_TRACE_INITIAL_SITES;
+    sites = calloc(size, sizeof(debug_trace_site_t));
+    if (NULL == sites) return ENOMEM;
+    for (i = 0; i < debug_ring_control.sites_size; i++) {
+        if (NULL == old[i].fmt) continue;
+        key.fmt = old[i].fmt;
+        key.line_number = old[i].line_number;
+        key.file_name = old[i].file_name;
+        key.dmbp = old[i].dmbp;
+        key.level = old[i].level;
+        *debug_trace_site_slot(sites, size, &key) = old[i];
+    }
+    free(old);
+    debug_ring_control.sites = sites;
+    debug_ring_control.sites_size = size;
+
+    return 0;
+}
+
+static int
+debug_trace_string_append (byte *buffer, int idx, const char *str,
+    uint32_t *length)
+{
+    int len = str ? strlen(str) : 0;
+
+    if (len > DEBUG_TRACE_MAX_STRING) len = DEBUG_TRACE_MAX_STRING;
+    if (len) memcpy(&buffer[idx], str, len);
+    buffer[idx + len] = 0;
+    *length = len;
+
+    return idx + len + 1;
+}
+
+/*
+ * Returns the id of the call site of 'rec', writing its site record
+ * out the very first time it is seen.  Returns -1 if out of memory.
+ */
+static int
+debug_trace_site_id (FILE *fp, debug_record_t *rec)
+{
+    debug_trace_site_t *site;
+    debug_trace_site_record_t *srp;
+    byte buffer [sizeof(debug_trace_site_record_t) +
+        (4 * (DEBUG_TRACE_MAX_STRING + 1)) + 8];
+    int idx;
+
+    if (((debug_ring_control.n_sites + 1) * 2) > debug_ring_control.sites_size)
+        if (debug_trace_sites_grow()) return -1;
+    site = debug_trace_site_slot(debug_ring_control.sites,
+                debug_ring_control.sites_size, rec);
+    if (site->fmt) return site->id;
+
+    site->fmt = rec->fmt;
+    site->line_number = rec->line_number;
+    site->file_name = rec->file_name;
+    site->dmbp = rec->dmbp;
+    site->level = rec->level;
+    site->id = debug_ring_control.n_sites++;
+
+    srp = (debug_trace_site_record_t*) buffer;
+    idx = sizeof(debug_trace_site_record_t);
+    idx = debug_trace_string_append(buffer, idx,
+            rec->dmbp->module_name, &srp->string_lengths[0]);
+    idx = debug_trace_string_append(buffer, idx,
+            rec->file_name, &srp->string_lengths[1]);
+    idx = debug_trace_string_append(buffer, idx,
+            rec->function_name, &srp->string_lengths[2]);
+    idx = debug_trace_string_append(buffer, idx,
+            rec->fmt, &srp->string_lengths[3]);
+    while (idx != DEBUG_TRACE_PADDED(idx)) buffer[idx++] = 0;
+    srp->length = idx;
+    srp->type = DEBUG_TRACE_SITE_RECORD;
+    srp->id = site->id;
+    srp->line_number = rec->line_number;
+    srp->level = rec->level;
+    fwrite(buffer, idx, 1, fp);
+
+    return site->id;
+}
+
+static void
+debug_record_write (FILE *fp, debug_record_t *rec, unsigned int thread_number)
+{
+    debug_trace_message_record_t *mrp;
+    byte buffer [sizeof(debug_trace_message_record_t) +
+        sizeof(rec->args.args) + sizeof(rec->args.strings) + 8];
+    int id, idx, len;
+
+    id = debug_trace_site_id(fp, rec);
+    if (id < 0) {
+        debug_ring_control.dropped_by_reporter++;
+        return;
+    }
+    mrp = (debug_trace_message_record_t*) buffer;
+    mrp->type = DEBUG_TRACE_MESSAGE_RECORD;
+    mrp->id = id;
+    mrp->thread_number = thread_number;
+    mrp->time_stamp = rec->time_stamp;
+    mrp->n_args = rec->args.n_args;
+    mrp->truncated = rec->args.truncated;
+    mrp->string_bytes = rec->args.string_bytes;
+    mrp->reserved = 0;
+    idx = sizeof(debug_trace_message_record_t);
+    len = rec->args.n_args * sizeof(debug_arg_t);
+    memcpy(&buffer[idx], rec->args.args, len);
+    idx += len;
+    memcpy(&buffer[idx], rec->args.strings, rec->args.string_bytes);
+    idx += rec->args.string_bytes;
+    while (idx != DEBUG_TRACE_PADDED(idx)) buffer[idx++] = 0;
+    mrp->length = idx;
+    fwrite(buffer, idx, 1, fp);
+}
+
+/*
+ * Drains every ring once and frees the ones whose threads have
+ * exited.  Returns how many records have been reported.
+ */
+static int
+debug_rings_drain (void)
+{
+    debug_ring_t *ring, **prevp;
+    unsigned int head, tail;
+    int drained = 0;
+
+    grab_write_lock(&debug_ring_control.rings_lock);
+    prevp = &debug_ring_control.rings;
+    while ((ring = *prevp)) {
+        head = ring->head;
+        __sync_synchronize();
+        for (tail = ring->tail; tail != head; tail++) {
+            if (debug_ring_control.binary) {
+                debug_record_write(debug_ring_control.output,
+                    &ring->records[tail & ring->mask], ring->thread_number);
+            } else {
+                debug_record_report(debug_ring_control.output,
+                    &ring->records[tail & ring->mask]);
+            }
+            drained++;
+        }
+        __sync_synchronize();
+        ring->tail = tail;
+
+        if (ring->owner_exited && (ring->head == tail)) {
+            *prevp = ring->next;
+            debug_ring_control.dropped_by_freed_rings += ring->dropped;
+            free(ring);
+        } else {
+            prevp = &ring->next;
+        }
+    }
+    release_write_lock(&debug_ring_control.rings_lock);
+    if (drained) fflush(debug_ring_control.output);
+
+    return drained;
+}
+
+static void *
+debug_ring_reporter (void *arg)
+{
+    int stopping;
+
+    while (1) {
+        stopping = debug_ring_control.stop_requested;
+        if ((0 == debug_rings_drain()) && !stopping) {
+            nano_seconds_sleep(DEBUG_RING_IDLE_SLEEP_NSECS);
+        }
+
+        /* one last full pass was made after the stop request */
+        if (stopping) break;
+    }
+    return NULL;
+}
+
+static int
+debug_reporting_start (FILE *output, int records_per_ring, int binary)
+{
+    unsigned int count;
+    int failed;
+
+    pthread_once(&debug_ring_once, debug_ring_key_create);
+    if (debug_ring_control.running) return EBUSY;
+    if (records_per_ring < 0) return EINVAL;
+    if (0 == records_per_ring) records_per_ring = DEBUG_RING_DEFAULT_RECORDS;
+
+    /*
+     * rings created by an earlier start keep their size, so
+     * the size can only be set before the very first start.
+     */
+    if (0 == debug_ring_control.records_per_ring) {
+        for (count = 16; count < (unsigned int) records_per_ring; count <<= 1);
+        debug_ring_control.records_per_ring = count;
+    }
+    debug_ring_control.output = output ? output : stderr;
+    debug_ring_control.binary = binary;
+    debug_ring_control.stop_requested = 0;
+    failed = pthread_create(&debug_ring_control.reporter, NULL,
+                debug_ring_reporter, NULL);
+    if (failed) return failed;
+    debug_ring_control.running = 1;
+
+    return 0;
+}
+
+/*
+ * Returns EIO if anything could not be written into a binary trace.
+ */
+static int
+debug_reporting_stop (void)
+{
+    debug_ring_t *ring;
+    int failed = 0;
+
+    if (!debug_ring_control.running) return 0;
+    debug_ring_control.running = 0;
+    __sync_synchronize();
+
+    /* no record can go into a ring after this */
+    grab_read_lock(&debug_ring_control.rings_lock);
+    for (ring = debug_ring_control.rings; ring; ring = ring->next) {
+        while (ring->recording) sched_yield();
+    }
+    release_read_lock(&debug_ring_control.rings_lock);
+
+    debug_ring_control.stop_requested = 1;
+    pthread_join(debug_ring_control.reporter, NULL);
+
+    if (debug_ring_control.binary) {
+        failed = ferror(debug_ring_control.output);
+        if (fclose(debug_ring_control.output)) failed = 1;
+        debug_ring_control.output = NULL;
+        debug_ring_control.binary = 0;
+        free(debug_ring_control.sites);
+        debug_ring_control.sites = NULL;
+        debug_ring_control.sites_size = debug_ring_control.n_sites = 0;
+    }
+
+    return failed ? EIO : 0;
+}
+
+PUBLIC int
+debug_ring_start (FILE *output, int records_per_ring)
+{
+    return debug_reporting_start(output, records_per_ring, 0);
+}
+
+PUBLIC void
+debug_ring_stop (void)
+{
+    (void) debug_reporting_stop();
+}
+
+PUBLIC int
+debug_trace_start (const char *trace_file_name, int records_per_ring)
+{
+    debug_trace_file_header_t header;
+    FILE *fp;
+    int failed;
+
+    if (NULL == trace_file_name) return EINVAL;
+    if (debug_ring_control.running) return EBUSY;
+    fp = fopen(trace_file_name, "wb");
+    if (NULL == fp) return errno;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DEBUG_TRACE_MAGIC, sizeof(header.magic));
+    header.version = DEBUG_TRACE_VERSION;
+    header.byte_order = DEBUG_TRACE_BYTE_ORDER;
+    if (1 != fwrite(&header, sizeof(header), 1, fp)) {
+        fclose(fp);
+        return EIO;
+    }
+
+    failed = debug_reporting_start(fp, records_per_ring, 1);
+    if (failed) fclose(fp);
+
+    return failed;
+}
+
+PUBLIC int
+debug_trace_stop (void)
+{
+    if (!debug_ring_control.binary) return 0;
+    return debug_reporting_stop();
+}
+
+PUBLIC unsigned long long int
+debug_ring_dropped_count (void)
+{
+    debug_ring_t *ring;
+    unsigned long long int dropped;
+
+    pthread_once(&debug_ring_once, debug_ring_key_create);
+    grab_write_lock(&debug_ring_control.rings_lock);
+    dropped = debug_ring_control.dropped_by_freed_rings +
+        debug_ring_control.dropped_by_reporter;
+    for (ring = debug_ring_control.rings; ring; ring = ring->next) {
+        dropped += ring->dropped;
+    }
+    release_write_lock(&debug_ring_control.rings_lock);
+
+    return dropped;
+}
+
+/******************************************************************************
+ *
+ * Decoding binary trace files.
+ */
+
+typedef struct debug_trace_decoded_site_s {
+
+    debug_trace_site_record_t *srp;
+    const char *module_name;
+    const char *file_name;
+    const char *function_name;
+    const char *fmt;
+
+} debug_trace_decoded_site_t;
+
+/*
+ * messages are reported in time order, and in file
+ * order (which is per thread order) for equal times.
+ */
+static int
+debug_trace_message_compare (const void *v1, const void *v2)
+{
+    debug_trace_message_record_t *m1 = *(debug_trace_message_record_t**) v1;
+    debug_trace_message_record_t *m2 = *(debug_trace_message_record_t**) v2;
+
+    if (m1->time_stamp != m2->time_stamp)
+        return (m1->time_stamp < m2->time_stamp) ? -1 : 1;
+    return (m1 < m2) ? -1 : (m1 > m2);
+}
+
+static int
+debug_trace_site_decode (debug_trace_site_record_t *srp,
+    debug_trace_decoded_site_t *site)
+{
+    const char **strings [4] = { &site->module_name, &site->file_name,
+                                 &site->function_name, &site->fmt };
+    uint32_t available = srp->length - sizeof(debug_trace_site_record_t);
+    char *str = (char*) (srp + 1);
+    int i;
+
+    if ((srp->level < TRACE_DEBUG_LEVEL) ||
+        (srp->level > FATAL_ERROR_DEBUG_LEVEL))
+            return EINVAL;
+    for (i = 0; i < 4; i++) {
+        if ((srp->string_lengths[i] >= available) ||
+            str[srp->string_lengths[i]])
+                return EINVAL;
+        *strings[i] = str;
+        str += srp->string_lengths[i] + 1;
+        available -= srp->string_lengths[i] + 1;
+    }
+    site->srp = srp;
+
+    return 0;
+}
+
+static int
+debug_trace_message_decode (debug_trace_message_record_t *mrp,
+    debug_args_t *dap)
+{
+    int len;
+
+    if ((mrp->n_args > DEBUG_RECORD_MAX_ARGS) ||
+        (mrp->string_bytes < 0) ||
+        (mrp->string_bytes > DEBUG_RECORD_STRING_SPACE))
+            return EINVAL;
+    len = mrp->n_args * sizeof(debug_arg_t);
+    if ((sizeof(debug_trace_message_record_t) + len + mrp->string_bytes) >
+        mrp->length)
+            return EINVAL;
+    dap->n_args = mrp->n_args;
+    dap->truncated = mrp->truncated;
+    dap->string_bytes = mrp->string_bytes;
+    memcpy(dap->args, mrp + 1, len);
+    memcpy(dap->strings, ((byte*) (mrp + 1)) + len, mrp->string_bytes);
+
+    /* a corrupt string offset must not let the formatting run wild */
+    dap->strings[DEBUG_RECORD_STRING_SPACE - 1] = 0;
+
+    return 0;
+}
+
+static int
+debug_trace_buffer_decode (byte *data, long int size, FILE *output)
+{
+    debug_trace_file_header_t *header = (debug_trace_file_header_t*) data;
+    debug_trace_decoded_site_t *sites = NULL, *site;
+    debug_trace_message_record_t **messages = NULL, *mrp;
+    debug_trace_site_record_t *srp;
+    debug_args_t args;
+    char line [DEBUG_RING_MAX_LINE];
+    int n_sites = 0, n_messages = 0, max_messages = 0, i, failed = 0;
+    long int idx;
+    void *bigger;
+
+    if ((size < (long int) sizeof(debug_trace_file_header_t)) ||
+        memcmp(header->magic, DEBUG_TRACE_MAGIC, sizeof(header->magic)) ||
+        (header->version != DEBUG_TRACE_VERSION) ||
+        (header->byte_order != DEBUG_TRACE_BYTE_ORDER))
+            return EINVAL;
+
+    /*
+     * collect all the sites & messages first, since messages must
+     * be sorted, a file written by multiple threads is not in order.
+     */
+    idx = sizeof(debug_trace_file_header_t);
+    while (idx < size) {
+        srp = (debug_trace_site_record_t*) &data[idx];
+
+        /* a trace cut short (writer crashed) is decoded as far as it goes */
+        if ((size - idx < 8) || (srp->length > size - idx)) break;
+        if ((srp->length < 8) || (srp->length & 7)) {
+            failed = EINVAL;
+            break;
+        }
+        if (srp->type == DEBUG_TRACE_SITE_RECORD) {
+            if ((srp->length < sizeof(debug_trace_site_record_t)) ||
+                (srp->id != (uint32_t) n_sites)) {
+                    failed = EINVAL;
+                    break;
+            }
+            bigger = realloc(sites, (n_sites + 1) * sizeof(*sites));
+            if (NULL == bigger) {
+                failed = ENOMEM;
+                break;
+            }
+            sites = bigger;
+            failed = debug_trace_site_decode(srp, &sites[n_sites]);
+            if (failed) break;
+            n_sites++;
+        } else if (srp->type == DEBUG_TRACE_MESSAGE_RECORD) {
+            if (srp->length < sizeof(debug_trace_message_record_t)) {
+                failed = EINVAL;
+                break;
+            }
+            if (n_messages >= max_messages) {
+                max_messages = max_messages ? (max_messages * 2) : 1024;
+                bigger = realloc(messages, max_messages * sizeof(*messages));
+                if (NULL == bigger) {
+                    failed = ENOMEM;
+                    break;
+                }
+                messages = bigger;
+            }
+            messages[n_messages++] = (debug_trace_message_record_t*) srp;
+        }
+
+        /* unknown record types are skipped */
+        idx += srp->length;
+    }
+
+    if (0 == failed) {
+        qsort(messages, n_messages, sizeof(*messages),
+            debug_trace_message_compare);
+        for (i = 0; i < n_messages; i++) {
+            mrp = messages[i];
+            if ((mrp->id >= (uint32_t) n_sites) ||
+                debug_trace_message_decode(mrp, &args)) {
+                    failed = EINVAL;
+                    break;
+            }
+            site = &sites[mrp->id];
+            debug_args_format(line, sizeof(line), site->fmt, &args);
+            fprintf(output, "[%lld.%09lld] %s: %s: %s(%d): <%s>: %s",
+                (long long int) mrp->time_stamp / SEC_TO_NSEC_FACTOR,
+                (long long int) mrp->time_stamp % SEC_TO_NSEC_FACTOR,
+                level_strings[site->srp->level], site->module_name,
+                site->file_name, site->srp->line_number,
+                site->function_name, line);
+        }
+    }
+    free(sites);
+    free(messages);
+
+    return failed;
+}
+
+PUBLIC int
+debug_trace_decode (const char *trace_file_name, FILE *output)
+{
+    FILE *fp;
+    byte *data;
+    long int size;
+    int failed;
+
+    if (NULL == trace_file_name) return EINVAL;
+    fp = fopen(trace_file_name, "rb");
+    if (NULL == fp) return errno;
+    if (fseek(fp, 0, SEEK_END) || ((size = ftell(fp)) < 0) ||
+        fseek(fp, 0, SEEK_SET)) {
+            fclose(fp);
+            return EIO;
+    }
+
+    /* malloc returns 8 byte aligned memory which all records rely on */
+    data = malloc(size + 1);
+    if (NULL == data) {
+        fclose(fp);
+        return ENOMEM;
+    }
+    if ((size > 0) && (1 != fread(data, size, 1, fp))) {
+        failed = EIO;
+    } else {
+        failed = debug_trace_buffer_decode(data, size, output ? output : stdout);
+    }
+    free(data);
+    fclose(fp);
+
+    return failed;
+}
+
+/******************************************************************************
+ *
+ * Static tracepoints (see DEBUG_STATIC_TRACEPOINTS in the header).
+ */
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+/* all the sites, collected by the linker, if any exists at all */
+extern debug_tracepoint_t __start_debug_tracepoints [] __attribute__((weak));
+extern debug_tracepoint_t __stop_debug_tracepoints [] __attribute__((weak));
+
+static const byte nop5 [5] = { 0x0f, 0x1f, 0x44, 0x00, 0x00 };
+
+/* text page protections can not be changed by many threads at once */
+static lock_obj_t tracepoints_lock;
+
+/*
+ * The site never straddles an 8 byte word (the assembler makes sure of
+ * it), so the whole instruction is swapped with one aligned store.
+ */
+static int
+debug_tracepoint_patch (debug_tracepoint_t *tp, bool enable)
+{
+    unsigned long long int *word, old_word, new_word;
+    int offset, rel32;
+    long page_size;
+    byte *page;
+
+    offset = tp->code & 7;
+    word = (unsigned long long int*) (tp->code - offset);
+    old_word = new_word = *word;
+    if (enable) {
+        rel32 = (int) (tp->target - (tp->code + sizeof(nop5)));
+        ((byte*) &new_word)[offset] = 0xE9;
+        memcpy(((byte*) &new_word) + offset + 1, &rel32, sizeof(rel32));
+    } else {
+        memcpy(((byte*) &new_word) + offset, nop5, sizeof(nop5));
+    }
+    if (new_word == old_word) return 0;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    page = (byte*) (((unsigned long) word) & ~(page_size - 1));
+    if (mprotect(page, page_size, PROT_READ | PROT_WRITE | PROT_EXEC)) {
+        return errno;
+    }
+    __sync_val_compare_and_swap(word, old_word, new_word);
+    mprotect(page, page_size, PROT_READ | PROT_EXEC);
+
+    return 0;
+}
+
+/*
+ * If 'dmbp' is NULL, every site is synchronized to its own module block.
+ */
+static int
+debug_tracepoints_patch_all (debug_module_block_t *dmbp)
+{
+    debug_tracepoint_t *tp;
+    int rc, failed = 0;
+
+    grab_write_lock(&tracepoints_lock);
+    for (tp = __start_debug_tracepoints; tp < __stop_debug_tracepoints; tp++) {
+        if (dmbp && (tp->dmbp != dmbp)) continue;
+        rc = debug_tracepoint_patch(tp, tp->level >= tp->dmbp->level);
+        if (rc && !failed) failed = rc;
+    }
+    release_write_lock(&tracepoints_lock);
+
+    return failed;
+}
+
+/*
+ * All sites are assembled as NOPs, those of the statically initialized
+ * module blocks with low levels must be turned on before main runs.
+ */
+static void __attribute__((constructor))
+debug_tracepoints_initialize (void)
+{
+    lock_obj_init(&tracepoints_lock);
+    debug_tracepoints_patch_all(NULL);
+}
+
+PUBLIC int
+debug_tracepoints_update (debug_module_block_t *dmbp)
+{
+    if (NULL == dmbp) return EINVAL;
+    return
+        debug_tracepoints_patch_all(dmbp);
+}
+
+#else /* !__x86_64__ */
+
+PUBLIC int
+debug_tracepoints_update (debug_module_block_t *dmbp)
+{
+    return ENOTSUP;
+}
+
+#endif /* __x86_64__ */
+
+/******************************************************************************
+ *
+ * Reporting.
+ */
+
 /*
  * When this function is called, both the module number
  * and level are already verified (thru the macros calling it)
@@ -58,6 +1254,20 @@ _process_debug_message_ (debug_module_block_t *dmbp, int level,
 {
     va_list args;
 
+    va_start(args, fmt);
+
+    /*
+     * If asynchronous reporting is on, simply drop a record into
+     * this thread's ring, no locking and no formatting is needed.
+     */
+    if (debug_ring_control.running && (NULL == dmbp->drf) &&
+        (level < FATAL_ERROR_DEBUG_LEVEL) &&
+        debug_ring_record(dmbp, level, file_name, function_name,
+            line_number, fmt, args)) {
+                va_end(args);
+                return;
+    }
+
     /*
      * In a multi threaded environment, we dont want the
      * printing/reporting to be garbled if context
@@ -66,7 +1276,6 @@ _process_debug_message_ (debug_module_block_t *dmbp, int level,
      */
     OBJ_WRITE_LOCK(dmbp);
 
-    va_start(args, fmt);
     if (dmbp->drf) {
         dmbp->drf(dmbp, level, file_name, function_name,
             line_number, fmt, args);
@@ -79,6 +1288,7 @@ _process_debug_message_ (debug_module_block_t *dmbp, int level,
     }
 
     OBJ_WRITE_UNLOCK(dmbp);
+    va_end(args);
 }
 
 PUBLIC int
@@ -91,6 +1301,12 @@ debug_module_block_init (debug_module_block_t *dmbp,
     debug_module_block_set_module_name(dmbp, name);
     debug_module_block_set_reporting_function(dmbp, drf);
 
+    /*
+     * this library itself may not have been compiled with static
+     * tracepoints but the caller may well have been.
+     */
+    (void) debug_tracepoints_update(dmbp);
+
     return 0;
 }
 
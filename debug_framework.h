@@ -114,6 +114,104 @@ struct debug_module_block_s {
 
 };
 
+/******************************************************************************
+ *
+ * Cost of a debug call site when it is NOT reported.
+ *
+ * Compile time: any TRACE/INFO/WARN whose level is below
+ * DEBUG_COMPILE_TIME_MINIMUM_LEVEL is stripped out completely by the
+ * compiler, not even the level check remains.  For example, compiling
+ * with -DDEBUG_COMPILE_TIME_MINIMUM_LEVEL=2 leaves only WARN & the errors.
+ * Errors (ERROR, FATAL_ERROR) can never be stripped.
+ *
+ * Run time: by default, a site loads the level of its module block
+ * and branches on it.  If compiled with -DDEBUG_STATIC_TRACEPOINTS
+ * (gcc/clang on x86_64 only), every site instead becomes a single 5 byte
+ * NOP, which is patched into a jump to the reporting code when the site
+ * gets enabled, and back into a NOP when it gets disabled, every time
+ * 'debug_module_block_set_level' is called.  A disabled site hence costs
+ * no memory load and no branch.  The assembler may insert a padding
+ * NOP in front of the site so that it never straddles an 8 byte word,
+ * which is what allows it to be patched atomically while other threads
+ * may be executing it.
+ *
+ * In that mode, the module block passed into the macros MUST be the
+ * address of a global or static debug_module_block_t (which is how all
+ * the modules in this library use it), it must NOT be a variable.  Also,
+ * the level of such a module block must only be changed thru
+ * 'debug_module_block_set_level' (or initialized statically).
+ * Patching needs the text pages to be made temporarily writable, so
+ * if the system forbids that, sites stay as they are and the patching
+ * call returns an error.  This mode can not be used in shared libraries.
+ */
+
+#ifndef DEBUG_COMPILE_TIME_MINIMUM_LEVEL
+#define DEBUG_COMPILE_TIME_MINIMUM_LEVEL        TRACE_DEBUG_LEVEL
+#endif /* DEBUG_COMPILE_TIME_MINIMUM_LEVEL */
+
+#if defined(DEBUG_STATIC_TRACEPOINTS) && \
+    defined(__x86_64__) && defined(__GNUC__)
+#define DEBUG_STATIC_TRACEPOINTS_ENABLED
+#endif
+
+/*
+ * Every patchable site is described by one of these, all stored
+ * in the 'debug_tracepoints' section by the assembler.
+ */
+typedef struct debug_tracepoint_s {
+
+    /* address of the 5 byte NOP/JMP instruction */
+    unsigned long long int code;
+
+    /* where the site jumps to when enabled */
+    unsigned long long int target;
+
+    debug_module_block_t *dmbp;
+    long long int level;
+
+} debug_tracepoint_t;
+
+/*
+ * Re-patches all the sites belonging to 'dmbp' according to its current
+ * level.  Returns 0 or an errno.  Normally called implicitly thru
+ * 'debug_module_block_set_level'.
+ */
+extern int
+debug_tracepoints_update (debug_module_block_t *dmbp);
+
+#ifdef DEBUG_STATIC_TRACEPOINTS_ENABLED
+
+#define DEBUG_SITE_RUNTIME_CHECK(dmbp, lvl) \
+    ({ \
+        __label__ __debug_site_on__; \
+        int __debug_site_enabled__ = 0; \
+        asm goto (".bundle_align_mode 3\n\t" \
+                  "%{disp8%} nopl 0x0(%%rax,%%rax,1)\n\t" \
+                  ".bundle_align_mode 0\n\t" \
+                  "2:\n\t" \
+                  ".pushsection debug_tracepoints, \"aw\"\n\t" \
+                  ".balign 8\n\t" \
+                  ".quad 2b - 5, %l[__debug_site_on__], %c0, %c1\n\t" \
+                  ".popsection\n\t" \
+                  : : "i" (dmbp), "i" (lvl) : : __debug_site_on__); \
+        if (0) { \
+    __debug_site_on__: \
+            __debug_site_enabled__ = 1; \
+        } \
+        __debug_site_enabled__; \
+    })
+
+#else /* !DEBUG_STATIC_TRACEPOINTS_ENABLED */
+
+#define DEBUG_SITE_RUNTIME_CHECK(dmbp, lvl) \
+    ((dmbp)->level <= (lvl))
+
+#endif /* DEBUG_STATIC_TRACEPOINTS_ENABLED */
+
+#define DEBUG_SITE_ENABLED(dmbp, lvl) \
+    (((lvl) >= DEBUG_COMPILE_TIME_MINIMUM_LEVEL) && \
+        DEBUG_SITE_RUNTIME_CHECK(dmbp, lvl))
+
 static inline
 void debug_module_block_set_level (debug_module_block_t *dmbp, int level)
 {
@@ -124,6 +222,9 @@ void debug_module_block_set_level (debug_module_block_t *dmbp, int level)
         level = TRACE_DEBUG_LEVEL;
     }
     dmbp->level = level;
+#ifdef DEBUG_STATIC_TRACEPOINTS_ENABLED
+    debug_tracepoints_update(dmbp);
+#endif
 }
 
 static inline void
@@ -142,21 +243,21 @@ debug_module_block_set_reporting_function (debug_module_block_t *dmbp,
 
 #define TRACE(dmbp, fmt, args...) \
     do { \
-        if ((dmbp)->level > TRACE_DEBUG_LEVEL) break; \
+        if (!DEBUG_SITE_ENABLED(dmbp, TRACE_DEBUG_LEVEL)) break; \
         _process_debug_message_(dmbp, TRACE_DEBUG_LEVEL, \
             __FILE__, __FUNCTION__, __LINE__, fmt, ## args); \
     } while (0)
 
 #define INFO(dmbp, fmt, args...) \
     do { \
-        if ((dmbp)->level > INFORM_DEBUG_LEVEL) break; \
+        if (!DEBUG_SITE_ENABLED(dmbp, INFORM_DEBUG_LEVEL)) break; \
         _process_debug_message_(dmbp, INFORM_DEBUG_LEVEL, \
             __FILE__, __FUNCTION__, __LINE__, fmt, ## args); \
     } while (0)
     
 #define WARN(dmbp, fmt, args...) \
     do { \
-        if ((dmbp)->level > WARNING_DEBUG_LEVEL) break; \
+        if (!DEBUG_SITE_ENABLED(dmbp, WARNING_DEBUG_LEVEL)) break; \
         _process_debug_message_(dmbp, WARNING_DEBUG_LEVEL, \
             __FILE__, __FUNCTION__, __LINE__, fmt, ## args); \
     } while (0)
@@ -185,6 +286,161 @@ debug_module_block_init (debug_module_block_t *dmbp,
         bool make_it_thread_safe,
         int level, char *name, debug_reporting_function drf);
 
+/******************************************************************************
+ *
+ * Asynchronous (ring buffer) reporting.
+ *
+ * When started, messages of modules which do NOT have a user defined
+ * reporting function are no longer formatted & printed at the call site.
+ * Instead, a compact binary record (time stamp, level, file/function/line
+ * pointers and the raw arguments) is written into a lock free ring owned
+ * by the calling thread.  A single background thread drains all the
+ * rings, formats the records and writes them out.  Therefore the calling
+ * thread never takes the module lock and never performs any I/O.
+ *
+ * Each ring has exactly one producer (the thread owning it) and one
+ * consumer (the background thread), so no atomic operations are needed,
+ * only memory barriers.  If a ring is full, the message is dropped and
+ * counted, rather than blocking the caller.  Messages are ordered
+ * within a thread but NOT necessarily across threads, which is why
+ * every message is reported with its time stamp.
+ *
+ * Since only the POINTER of the format string is recorded, the format
+ * string MUST be a static string, which is always the case when the
+ * macros above are used.  Arguments of '%s' are copied into the record
+ * (up to DEBUG_RECORD_STRING_SPACE bytes in total) and are truncated
+ * if they do not fit.  At most DEBUG_RECORD_MAX_ARGS arguments are
+ * recorded, the rest of the message is replaced by "...".
+ *
+ * FATAL_ERROR messages are ALWAYS reported synchronously.
+ */
+
+#define DEBUG_RECORD_MAX_ARGS           8
+#define DEBUG_RECORD_STRING_SPACE       96
+#define DEBUG_RING_DEFAULT_RECORDS      1024
+
+/* one raw argument, as it was pulled off the va_list */
+typedef union debug_arg_u {
+
+    long long int i;
+    double d;
+    void *p;
+
+} debug_arg_t;
+
+/*
+ * All the raw arguments of one message.  For a '%s' argument, 'i'
+ * holds the offset of the copied string in 'strings' or -1 if the
+ * string pointer was NULL.
+ */
+typedef struct debug_args_s {
+
+    byte n_args;
+    byte truncated;
+    short string_bytes;
+    debug_arg_t args [DEBUG_RECORD_MAX_ARGS];
+    char strings [DEBUG_RECORD_STRING_SPACE];
+
+} debug_args_t;
+
+typedef struct debug_record_s {
+
+    nano_seconds_t time_stamp;
+    debug_module_block_t *dmbp;
+    const char *file_name;
+    const char *function_name;
+    const char *fmt;
+    int line_number;
+    int level;
+    debug_args_t args;
+
+} debug_record_t;
+
+/*
+ * Starts the background reporting thread.  All asynchronous messages
+ * will be written to 'output' (stderr if NULL).  'records_per_ring'
+ * is how many messages each thread can have outstanding before they
+ * start getting dropped.  It is rounded up to a power of 2.  If 0,
+ * DEBUG_RING_DEFAULT_RECORDS is used.
+ *
+ * Returns 0 or an errno.
+ */
+extern int
+debug_ring_start (FILE *output, int records_per_ring);
+
+/*
+ * Stops asynchronous reporting, after draining all the rings.
+ * Reporting reverts back to being synchronous.
+ */
+extern void
+debug_ring_stop (void);
+
+/*
+ * total number of messages dropped so far since the rings were full
+ */
+extern unsigned long long int
+debug_ring_dropped_count (void);
+
+/*
+ * Pulls the arguments described by 'fmt' off 'args' and stores them
+ * in 'dap' WITHOUT formatting them.
+ */
+extern void
+debug_args_capture (debug_args_t *dap, const char *fmt, va_list args);
+
+/*
+ * Formats a message from its format string and the arguments previously
+ * captured by 'debug_args_capture' into 'buffer'.  The output is always
+ * null terminated.  Returns the number of characters written.
+ */
+extern int
+debug_args_format (char *buffer, int size,
+    const char *fmt, debug_args_t *dap);
+
+/******************************************************************************
+ *
+ * Binary trace files.
+ *
+ * Same as the asynchronous reporting above, except that the background
+ * thread does not format the records either.  Instead, each call site
+ * is given a small id the first time it is seen and its strings (module,
+ * file, function & format) are written into the trace file only once.
+ * After that, each message is written as only the site id, time stamp,
+ * thread number & its raw arguments.  Nothing is formatted until the
+ * trace is decoded offline (see 'debug_trace_decoder'), which is what
+ * makes it cheap enough to leave TRACE level messages on under load.
+ *
+ * The trace file can only be decoded on a machine with the same byte
+ * order & pointer size as the one which wrote it.  Decoded messages
+ * look exactly the same as the ones asynchronous reporting prints,
+ * sorted by their time stamps.
+ */
+
+/*
+ * Starts writing all asynchronous messages into the binary trace file
+ * named 'trace_file_name', which is truncated first.  'records_per_ring'
+ * is as in 'debug_ring_start'.  Returns 0 or an errno.
+ */
+extern int
+debug_trace_start (const char *trace_file_name, int records_per_ring);
+
+/*
+ * Stops tracing after draining all the rings and closes the trace file.
+ * Returns 0, or EIO if part of the trace could not be written.
+ * 'debug_ring_stop' also stops tracing, but does not report the errors.
+ */
+extern int
+debug_trace_stop (void);
+
+/*
+ * Decodes a binary trace file and writes the reconstructed messages into
+ * 'output' (stdout if NULL).  Returns 0, or an errno if the file could
+ * not be read or is not a valid trace file.  A trace which is cut short
+ * is decoded up to where it ends.
+ */
+extern int
+debug_trace_decode (const char *trace_file_name, FILE *output);
+
 /**************************************************************************
  *
  * PRIVATE, DO NOT USE.  DEFINED ONLY TO PASS COMPILATIONS.
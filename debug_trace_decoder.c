@@ -0,0 +1,23 @@
+
+#include "debug_framework.h"
+
+/*
+ * Reconstructs the human readable messages of a binary
+ * trace file written by 'debug_trace_start' onto stdout.
+ */
+int main (int argc, char *argv[])
+{
+    int failed;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <trace file>\n", argv[0]);
+        return 1;
+    }
+    failed = debug_trace_decode(argv[1], stdout);
+    if (failed) {
+        fprintf(stderr, "%s: cannot decode %s: %s\n",
+            argv[0], argv[1], strerror(failed));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,245 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Epoch based memory reclamation, see epoch_manager.h
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include "epoch_manager.h"
+#include "thread_slots.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *
+ * Thread slots, the index of a thread into the slots of every epoch
+ * manager.  Assigned at the first entry of a thread & recycled when
+ * it exits.
+ */
+
+__thread int epoch_thread_slot = EPOCH_THREAD_SLOT_UNASSIGNED;
+
+static thread_slots_t epoch_thread_slots =
+    THREAD_SLOTS_INITIALIZER(EPOCH_MAX_THREADS);
+
+PUBLIC int
+epoch_thread_slot_assign (void)
+{
+    epoch_thread_slot = thread_slot_assign(&epoch_thread_slots);
+    return epoch_thread_slot;
+}
+
+PUBLIC void
+epoch_overflow_enter (epoch_manager_t *emp)
+{
+    /* a full barrier, so it is visible before anything is read */
+    __sync_fetch_and_add(&emp->overflow_readers, 1);
+}
+
+PUBLIC void
+epoch_overflow_exit (epoch_manager_t *emp)
+{
+    __sync_fetch_and_sub(&emp->overflow_readers, 1);
+}
+
+/******************************************************************************
+ *
+ * Reclamation
+ */
+
+static inline void
+epoch_lock (epoch_manager_t *emp)
+{
+    while (__sync_lock_test_and_set(&emp->mtx, 1)) sched_yield();
+}
+
+static inline void
+epoch_unlock (epoch_manager_t *emp)
+{
+    __sync_lock_release(&emp->mtx);
+}
+
+/*
+ * The global epoch can move on only if every reader in a critical
+ * section has entered in the current one.  Called with the lock held.
+ */
+static boolean
+epoch_try_advance (epoch_manager_t *emp)
+{
+    unsigned long long int current = emp->global_epoch;
+    unsigned long long int epoch;
+    int slot;
+
+    /* the reads of the slots must not be done before this point */
+    __sync_synchronize();
+    if (emp->overflow_readers) return FALSE;
+    for (slot = 0; slot < EPOCH_MAX_THREADS; slot++) {
+        epoch = emp->slots[slot].epoch;
+        if ((epoch & 1) && ((epoch >> 1) != current)) return FALSE;
+    }
+    __atomic_store_n(&emp->global_epoch, current + 1, __ATOMIC_RELEASE);
+    emp->advances++;
+    return TRUE;
+}
+
+static int
+epoch_destroy_list (epoch_retired_t *list)
+{
+    epoch_retired_t *next;
+    int count = 0;
+
+    while (list) {
+        next = list->next;
+        list->dh_fptr(list->data, list->extra_arg);
+        mem_monitor_free(list);
+        list = next;
+        count++;
+    }
+    return count;
+}
+
+PUBLIC int
+epoch_reclaim (epoch_manager_t *emp)
+{
+    epoch_retired_t *safe = NULL;
+    int count, bucket;
+
+    epoch_lock(emp);
+    if (epoch_try_advance(emp)) {
+
+        /* retired 2 epochs ago, no reader can still see these */
+        bucket = (int) ((emp->global_epoch + 1) % 3);
+        safe = emp->retired[bucket];
+        emp->retired[bucket] = NULL;
+    }
+    epoch_unlock(emp);
+
+    /* destroyed outside the lock, destructors may take their time */
+    count = epoch_destroy_list(safe);
+    if (count) {
+        epoch_lock(emp);
+        emp->n_retired -= count;
+        emp->reclamations += count;
+        epoch_unlock(emp);
+    }
+    return count;
+}
+
+/***************************** 80 column separator ****************************/
+
+PUBLIC int
+epoch_manager_init (epoch_manager_t *emp,
+    mem_monitor_t *parent_mem_monitor)
+{
+    memset(emp, 0, sizeof(epoch_manager_t));
+    MEM_MONITOR_SETUP(emp);
+
+    /* so that the epoch of a reader is never 0 */
+    emp->global_epoch = 1;
+
+    return 0;
+}
+
+PUBLIC int
+epoch_retire (epoch_manager_t *emp, void *data,
+    destruction_handler_t dh_fptr, void *extra_arg)
+{
+    epoch_retired_t *rp;
+    int bucket, n_retired;
+
+    rp = MEM_MONITOR_ALLOC(emp, sizeof(epoch_retired_t));
+    if (NULL == rp) return ENOMEM;
+    rp->data = data;
+    rp->dh_fptr = dh_fptr;
+    rp->extra_arg = extra_arg;
+
+    epoch_lock(emp);
+    bucket = (int) (emp->global_epoch % 3);
+    rp->next = emp->retired[bucket];
+    emp->retired[bucket] = rp;
+    n_retired = ++emp->n_retired;
+    emp->retirements++;
+    epoch_unlock(emp);
+
+    if (0 == (n_retired % EPOCH_RECLAIM_THRESHOLD)) epoch_reclaim(emp);
+    return 0;
+}
+
+PUBLIC void
+epoch_synchronize (epoch_manager_t *emp)
+{
+    unsigned long long int target = emp->global_epoch + 2;
+
+    /*
+     * after 2 advances every reader which was in has left & whatever
+     * was retired until now has been handed to its destructor
+     */
+    while (__atomic_load_n(&emp->global_epoch, __ATOMIC_ACQUIRE) < target) {
+        if (0 == epoch_reclaim(emp)) sched_yield();
+    }
+}
+
+PUBLIC void
+epoch_manager_destroy (epoch_manager_t *emp)
+{
+    int bucket;
+
+    epoch_lock(emp);
+    for (bucket = 0; bucket < 3; bucket++) {
+        epoch_destroy_list(emp->retired[bucket]);
+        emp->retired[bucket] = NULL;
+    }
+    emp->n_retired = 0;
+    epoch_unlock(emp);
+}
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
@@ -0,0 +1,234 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Epoch based memory reclamation.
+**
+** Lets readers access shared structures without taking any lock, while
+** writers (which still serialize among themselves) change them.  A
+** writer never frees anything a reader may still be looking at; it
+** unlinks it so no new reader can find it & then 'retires' it.  What
+** is retired is freed later, once every reader which could possibly
+** have seen it has left its read side critical section.
+**
+** A reader brackets its accesses with 'epoch_enter' & 'epoch_exit',
+** which only write to a slot of the calling thread, so readers never
+** wait for anything and do not interfere with each other.  Critical
+** sections can be nested.
+**
+** There is a global epoch & a reader records the epoch it entered in.
+** The global epoch can only advance when every reader currently inside
+** a critical section has entered in the current epoch.  Anything retired
+** in epoch E is therefore unreachable by all readers once the global
+** epoch is E + 2 and is freed then.  A reader which stays in for a
+** long time only delays freeing, it never blocks a writer.
+**
+** The first EPOCH_MAX_THREADS live threads each have their own slot.
+** Any thread beyond that shares a single counter with atomic operations,
+** which is slower & holds back reclamation as long as any such thread
+** is in, but is still correct.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#ifndef __EPOCH_MANAGER_H__
+#define __EPOCH_MANAGER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+#include "mem_monitor_object.h"
+
+#define EPOCH_MAX_THREADS               64
+
+/* reclamation is attempted every this many retirements */
+#define EPOCH_RECLAIM_THRESHOLD         64
+
+typedef struct epoch_retired_s epoch_retired_t;
+
+struct epoch_retired_s {
+    epoch_retired_t *next;
+    void *data;
+    destruction_handler_t dh_fptr;
+    void *extra_arg;
+};
+
+/* one per thread, on its own cache line so readers do not share them */
+typedef struct epoch_slot_s {
+
+    /* (epoch << 1) | 1 while in a critical section, 0 otherwise */
+    volatile unsigned long long int epoch;
+
+    /* nesting depth, only touched by the owner thread */
+    int depth;
+
+} __attribute__((aligned(64))) epoch_slot_t;
+
+typedef struct epoch_manager_s {
+
+    MEM_MON_VARIABLES;
+
+    epoch_slot_t slots [EPOCH_MAX_THREADS];
+
+    volatile unsigned long long int global_epoch;
+
+    /* threads without a slot which are in a critical section */
+    volatile int overflow_readers;
+
+    /* protects the rest */
+    volatile int mtx;
+
+    /* retired in epochs which are 0, 1 & 2 modulo 3 */
+    epoch_retired_t *retired [3];
+    int n_retired;
+
+    /* statistics */
+    unsigned long long int retirements;
+    unsigned long long int reclamations;
+    unsigned long long int advances;
+
+} epoch_manager_t;
+
+/*
+ * Index of the calling thread into the slots of every epoch manager,
+ * assigned the first time a thread enters & recycled when it exits.
+ * EPOCH_MAX_THREADS means the thread uses the overflow counter.
+ */
+#define EPOCH_THREAD_SLOT_UNASSIGNED    (EPOCH_MAX_THREADS + 1)
+extern __thread int epoch_thread_slot;
+
+/* PRIVATE, used by 'epoch_enter' the first time a thread enters */
+extern int
+epoch_thread_slot_assign (void);
+
+/* PRIVATE, slow paths of 'epoch_enter' & 'epoch_exit' */
+extern void
+epoch_overflow_enter (epoch_manager_t *emp);
+
+extern void
+epoch_overflow_exit (epoch_manager_t *emp);
+
+extern int
+epoch_manager_init (epoch_manager_t *emp,
+    mem_monitor_t *parent_mem_monitor);
+
+static inline void
+epoch_enter (epoch_manager_t *emp)
+{
+    epoch_slot_t *sp;
+    int slot = epoch_thread_slot;
+
+    if (slot == EPOCH_THREAD_SLOT_UNASSIGNED)
+        slot = epoch_thread_slot_assign();
+    if (slot >= EPOCH_MAX_THREADS) {
+        epoch_overflow_enter(emp);
+        return;
+    }
+    sp = &emp->slots[slot];
+    if (sp->depth++) return;
+    sp->epoch = (emp->global_epoch << 1) | 1;
+
+    /* the epoch must be visible before anything shared is read */
+    __sync_synchronize();
+}
+
+static inline void
+epoch_exit (epoch_manager_t *emp)
+{
+    epoch_slot_t *sp;
+    int slot = epoch_thread_slot;
+
+    if (slot >= EPOCH_MAX_THREADS) {
+        epoch_overflow_exit(emp);
+        return;
+    }
+    sp = &emp->slots[slot];
+    if (--sp->depth) return;
+
+    /* everything read before must be done before leaving */
+    __atomic_store_n(&sp->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Hands 'data', which must already be unreachable for new readers, over
+ * to be destroyed by 'dh_fptr' (with 'extra_arg') once no reader can be
+ * looking at it.  Writers must serialize the unlinking among themselves
+ * but this can be called by any thread.  Returns 0 or ENOMEM, in which
+ * case the caller must destroy 'data' some other way.
+ */
+extern int
+epoch_retire (epoch_manager_t *emp, void *data,
+    destruction_handler_t dh_fptr, void *extra_arg);
+
+/*
+ * Tries to advance the global epoch & destroys whatever is safe.
+ * Never waits for readers.  Returns how many were destroyed.
+ */
+extern int
+epoch_reclaim (epoch_manager_t *emp);
+
+/*
+ * Waits till every reader which is in a critical section at the time
+ * of the call has left & everything retired before the call has been
+ * destroyed (by this or, if reclaiming concurrently, another thread).
+ * Must NOT be called from inside a critical section, since it would
+ * wait forever.
+ */
+extern void
+epoch_synchronize (epoch_manager_t *emp);
+
+/*
+ * Destroys everything still retired, so it must only be called when
+ * no thread can be in a critical section any more.
+ */
+extern void
+epoch_manager_destroy (epoch_manager_t *emp);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif // __EPOCH_MANAGER_H__
+
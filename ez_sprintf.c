@@ -39,12 +39,34 @@
 #include <errno.h>
 #include "ez_sprintf.h"
 
+/* the extra bytes at the end of the buffer never written into */
+#define EZ_SPRINTF_MARGIN		8
+
+/* smallest buffer a growable object starts with */
+#define EZ_SPRINTF_MIN_GROWABLE_SIZE	256
+
+/* pairs of decimal digits, "00" to "99" */
+static const char decimal_digit_pairs [] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const char hex_digits [] = "0123456789abcdef";
+
 void
 ez_sprintf_reset(ez_sprintf_t *ezsp)
 {
 	ezsp->write_idx = 0;
 	ezsp->remaining_size = ezsp->max_size;
 	ezsp->current_indent = 0;
+	if (ezsp->buffer) ezsp->buffer[0] = 0;
 }
 
 void
@@ -53,11 +75,65 @@ ez_sprintf_init_with_external_buffer(ez_sprintf_t *ezsp,
 	int indent_size)
 {
 	ezsp->buffer = externally_supplied_buffer;
-	ezsp->max_size = external_buffer_size - 8;
+	ezsp->max_size = external_buffer_size - EZ_SPRINTF_MARGIN;
 	ezsp->indent_size = indent_size;
+	ezsp->growable = false;
+	ezsp->mem_mon_p = NULL;
 	ez_sprintf_reset(ezsp);
 }
 
+int
+ez_sprintf_init_growable(ez_sprintf_t *ezsp,
+	int initial_size, int indent_size, mem_monitor_t *parent_mem_monitor)
+{
+	if (initial_size < EZ_SPRINTF_MIN_GROWABLE_SIZE)
+		initial_size = EZ_SPRINTF_MIN_GROWABLE_SIZE;
+	MEM_MONITOR_SETUP(ezsp);
+	ezsp->buffer = MEM_MONITOR_ALLOC(ezsp, initial_size);
+	if (NULL == ezsp->buffer) return ENOMEM;
+	ezsp->max_size = initial_size - EZ_SPRINTF_MARGIN;
+	ezsp->indent_size = indent_size;
+	ezsp->growable = true;
+	ez_sprintf_reset(ezsp);
+
+	return 0;
+}
+
+/*
+ * makes sure at least 'needed' more bytes can be written, growing
+ * the buffer (at least doubling it) if it is allowed to.
+ */
+static int
+ez_sprintf_make_space(ez_sprintf_t *ezsp, int needed)
+{
+	int new_size;
+	char *new_buffer;
+
+	if (needed <= ezsp->remaining_size) return 0;
+	if (!ezsp->growable) return ENOSPC;
+
+	new_size = 2 * (ezsp->max_size + EZ_SPRINTF_MARGIN);
+	if (new_size < (ezsp->write_idx + needed + EZ_SPRINTF_MARGIN))
+		new_size = ezsp->write_idx + needed + EZ_SPRINTF_MARGIN;
+	new_buffer = MEM_MONITOR_REALLOC(ezsp, ezsp->buffer, new_size);
+	if (NULL == new_buffer) return ENOMEM;
+
+	ezsp->buffer = new_buffer;
+	ezsp->remaining_size += (new_size - EZ_SPRINTF_MARGIN) - ezsp->max_size;
+	ezsp->max_size = new_size - EZ_SPRINTF_MARGIN;
+
+	return 0;
+}
+
+/* accounts for 'len' bytes just written & null terminates */
+static inline void
+ez_sprintf_advance(ez_sprintf_t *ezsp, int len)
+{
+	ezsp->write_idx += len;
+	ezsp->remaining_size -= len;
+	ezsp->buffer[ezsp->write_idx] = 0;
+}
+
 /*
  * writes into the sprintf buffer starting from the current write index and
  * updates the current write index and how many bytes still remain to write
@@ -65,32 +141,42 @@ ez_sprintf_init_with_external_buffer(ez_sprintf_t *ezsp,
  * The ezsp structure is ready to pass into another ez_sprintf_append if user wants
  * to continue writing.
  *
- * Returns 0 upon success and an error code (ENOSPC) if not enuf space remains.
+ * Returns 0 upon success and an error code (ENOSPC) if not enuf space remains,
+ * in which case whatever fits is written.  A growable object grows instead
+ * and can only fail with ENOMEM.
  */
 int
 ez_sprintf_append (ez_sprintf_t *ezsp, char *fmt, ...)
 {
 	va_list args;
-	int len, rv = 0;
+	int len, rv;
 
 	/* process the parameters into the buffer */
 	va_start(args, fmt);
 	len = vsnprintf(&ezsp->buffer[ezsp->write_idx], ezsp->remaining_size,
 			fmt, args);
 	va_end(args);
+	if (len < 0) return EINVAL;
 
-	/* update all the counts */
-	ezsp->write_idx += len;
-	ezsp->remaining_size -= len;
-	if (ezsp->remaining_size < 0) {
-		ezsp->remaining_size = 0;
-		rv = ENOSPC;
+	/* did not fit, either grow & do it again or truncate */
+	if (len >= ezsp->remaining_size) {
+		rv = ez_sprintf_make_space(ezsp, len + 1);
+		if (0 == rv) {
+			va_start(args, fmt);
+			vsnprintf(&ezsp->buffer[ezsp->write_idx],
+				ezsp->remaining_size, fmt, args);
+			va_end(args);
+		} else {
+			len = ezsp->remaining_size > 0 ? ezsp->remaining_size - 1 : 0;
+			ez_sprintf_advance(ezsp, len);
+			return rv;
+		}
 	}
 
-	/* always null terminate */
-	ezsp->buffer[ezsp->write_idx] = 0;
+	/* update all the counts, always null terminates */
+	ez_sprintf_advance(ezsp, len);
 
-	return rv;
+	return 0;
 }
 
 /*
@@ -98,21 +184,158 @@ ez_sprintf_append (ez_sprintf_t *ezsp, char *fmt, ...)
  */
 int ez_sprintf_indent(ez_sprintf_t *ezsp)
 {
-	int i;
+	return
+		ez_sprintf_append_padding(ezsp, ' ', ezsp->current_indent);
+}
+
+int
+ez_sprintf_append_bytes(ez_sprintf_t *ezsp, const void *bytes, int count)
+{
+	int rv;
+
+	if (count <= 0) return 0;
+	if ((rv = ez_sprintf_make_space(ezsp, count))) return rv;
+	memcpy(&ezsp->buffer[ezsp->write_idx], bytes, count);
+	ez_sprintf_advance(ezsp, count);
+
+	return 0;
+}
+
+int
+ez_sprintf_append_string(ez_sprintf_t *ezsp, const char *string)
+{
+	return
+		ez_sprintf_append_bytes(ezsp, string, strlen(string));
+}
+
+int
+ez_sprintf_append_padding(ez_sprintf_t *ezsp, char c, int count)
+{
+	int rv;
+
+	if (count <= 0) return 0;
+	if ((rv = ez_sprintf_make_space(ezsp, count))) return rv;
+	memset(&ezsp->buffer[ezsp->write_idx], c, count);
+	ez_sprintf_advance(ezsp, count);
+
+	return 0;
+}
+
+/*
+ * Converts 'value' into decimal digits ending right before 'end',
+ * two digits at a time, and returns where the digits start.
+ */
+static inline char *
+decimal_digits(unsigned long long int value, char *end)
+{
+	const char *pair;
 
-	if (ezsp->remaining_size < ezsp->current_indent) return ENOSPC;
-	for (i = 0; i < ezsp->current_indent; i++) {
-		ezsp->buffer[ezsp->write_idx++] = ' ';
+	while (value >= 100) {
+		pair = &decimal_digit_pairs[(value % 100) * 2];
+		value /= 100;
+		*(--end) = pair[1];
+		*(--end) = pair[0];
+	}
+	if (value >= 10) {
+		pair = &decimal_digit_pairs[value * 2];
+		*(--end) = pair[1];
+		*(--end) = pair[0];
+	} else {
+		*(--end) = '0' + (char) value;
 	}
-	ezsp->remaining_size -= ezsp->current_indent;
+	return end;
+}
 
-	/* always null terminate */
-	ezsp->buffer[ezsp->write_idx] = 0;
+/* appends the digits between 'start' & 'end' right aligned to 'width' */
+static int
+ez_sprintf_append_aligned(ez_sprintf_t *ezsp, char *start, char *end,
+	int width)
+{
+	int len = end - start;
+	int pad = width > len ? width - len : 0;
+	int rv;
+
+	if ((rv = ez_sprintf_make_space(ezsp, pad + len))) return rv;
+	if (pad) memset(&ezsp->buffer[ezsp->write_idx], ' ', pad);
+	memcpy(&ezsp->buffer[ezsp->write_idx + pad], start, len);
+	ez_sprintf_advance(ezsp, pad + len);
+
+	return 0;
+}
+
+int
+ez_sprintf_append_uint(ez_sprintf_t *ezsp,
+	unsigned long long int value, int width)
+{
+	char digits [24];
+	char *end = &digits[sizeof(digits)];
+
+	return
+		ez_sprintf_append_aligned(ezsp,
+			decimal_digits(value, end), end, width);
+}
+
+int
+ez_sprintf_append_int(ez_sprintf_t *ezsp, long long int value, int width)
+{
+	char digits [24];
+	char *end = &digits[sizeof(digits)];
+	char *start;
+
+	/* negate as unsigned so that LLONG_MIN works too */
+	if (value < 0) {
+		start = decimal_digits(0ULL - (unsigned long long int) value, end);
+		*(--start) = '-';
+	} else {
+		start = decimal_digits(value, end);
+	}
+	return
+		ez_sprintf_append_aligned(ezsp, start, end, width);
+}
+
+int
+ez_sprintf_append_hex(ez_sprintf_t *ezsp,
+	unsigned long long int value, int min_digits)
+{
+	char digits [16];
+	int len, pad, rv;
+	char *end = &digits[sizeof(digits)];
+	char *start = end;
+
+	do {
+		*(--start) = hex_digits[value & 0xF];
+		value >>= 4;
+	} while (value);
+	len = end - start;
+	pad = min_digits > len ? min_digits - len : 0;
+
+	if ((rv = ez_sprintf_make_space(ezsp, pad + len))) return rv;
+	if (pad) memset(&ezsp->buffer[ezsp->write_idx], '0', pad);
+	memcpy(&ezsp->buffer[ezsp->write_idx + pad], start, len);
+	ez_sprintf_advance(ezsp, pad + len);
 
 	return 0;
 }
 
+int
+ez_sprintf_append_pointer(ez_sprintf_t *ezsp, const void *ptr)
+{
+	int rv;
+
+	if ((rv = ez_sprintf_append_bytes(ezsp, "0x", 2))) return rv;
+	rv = ez_sprintf_append_hex(ezsp, (uintptr_t) ptr, 0);
+
+	/* all or nothing */
+	if (rv) {
+		ezsp->write_idx -= 2;
+		ezsp->remaining_size += 2;
+		ezsp->buffer[ezsp->write_idx] = 0;
+	}
+	return rv;
+}
+
 void ez_sprintf_destroy(ez_sprintf_t *ezsp)
 {
+	if (ezsp->growable) MEM_MONITOR_FREE(ezsp->buffer);
 	memset(ezsp, 0, sizeof(ez_sprintf_t));
 }
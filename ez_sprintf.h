@@ -36,6 +36,9 @@
 #ifndef __EZ_SPRINTF_H__
 #define __EZ_SPRINTF_H__
 
+#include "common.h"
+#include "mem_monitor_object.h"
+
 /*
  * Makes sprintf easy to use.  User can simply add formatted
  * statements and this object will keep a count of everything.
@@ -43,11 +46,14 @@
 typedef struct ez_sprintf_s {
 
 	char *buffer;			/* the write buffer itself */
-	int max_size;			/* max size of the buffer (constant) */
+	int max_size;			/* max size of the buffer (constant unless growable) */
 	int remaining_size;		/* how many more bytes can be written */
 	int write_idx;			/* current point in buffer to start writing into */
 	int indent_size;		/* indent increment */
 	int current_indent;
+	bool growable;			/* buffer is owned & grown as needed */
+
+	MEM_MON_VARIABLES;
 
 } ez_sprintf_t;
 
@@ -59,9 +65,56 @@ extern void ez_sprintf_init_with_external_buffer(ez_sprintf_t *ezsp,
 	char *externally_supplied_buffer, int external_buffer_size,
 	int indent_size);
 
+/*
+ * initializes an ez sprintf object with a buffer which it allocates
+ * itself (starting at 'initial_size') and grows automatically as
+ * more is appended, so the output is never truncated.  The buffer
+ * is freed by ez_sprintf_destroy.  Returns 0 or ENOMEM.
+ */
+extern int ez_sprintf_init_growable(ez_sprintf_t *ezsp,
+	int initial_size, int indent_size, mem_monitor_t *parent_mem_monitor);
+
 /* appends printf formatted output and updates all its control variables */
 extern int ez_sprintf_append(ez_sprintf_t *ezsp, char *fmt, ...);
 
+/*
+ * Typed appends.
+ *
+ * These bypass vsnprintf completely and are many times faster,
+ * which matters when rendering large dumps.  Just like
+ * ez_sprintf_append, they return 0 or ENOSPC (ENOMEM if growable).
+ * Unlike it, when there is not enough space they append nothing.
+ */
+
+/* appends 'count' raw bytes */
+extern int ez_sprintf_append_bytes(ez_sprintf_t *ezsp,
+	const void *bytes, int count);
+
+/* appends a null terminated string, like "%s" */
+extern int ez_sprintf_append_string(ez_sprintf_t *ezsp, const char *string);
+
+/* appends 'count' copies of the character 'c' */
+extern int ez_sprintf_append_padding(ez_sprintf_t *ezsp, char c, int count);
+
+/*
+ * appends a signed/unsigned decimal, right aligned with spaces to at
+ * least 'width' characters, like "%*lld" & "%*llu".
+ */
+extern int ez_sprintf_append_int(ez_sprintf_t *ezsp,
+	long long int value, int width);
+extern int ez_sprintf_append_uint(ez_sprintf_t *ezsp,
+	unsigned long long int value, int width);
+
+/*
+ * appends lower case hex, zero padded to at least 'min_digits'
+ * digits, like "%0*llx".  No "0x" is prepended.
+ */
+extern int ez_sprintf_append_hex(ez_sprintf_t *ezsp,
+	unsigned long long int value, int min_digits);
+
+/* appends a pointer as "0x" followed by its hex value, "0x0" for NULL */
+extern int ez_sprintf_append_pointer(ez_sprintf_t *ezsp, const void *ptr);
+
 /*
  * increments the current indent by indent_size_override if not 0,
  * else by the default indent size specified at init time.
@@ -91,7 +144,7 @@ ez_sprintf_indent(ez_sprintf_t *ezsp);
 /* resets it (empties) an ez sprintf object */
 extern void ez_sprintf_reset(ez_sprintf_t *ezsp);
 
-/* destroys the object, frees its buffer */
+/* destroys the object, frees its buffer if it is growable */
 extern void ez_sprintf_destroy(ez_sprintf_t *ezsp);
 
 /*
@@ -109,6 +162,19 @@ extern void ez_sprintf_destroy(ez_sprintf_t *ezsp);
 	ez_sprintf_append(&ezs, "fourth line %d\n", 4);
 	ez_sprintf_append(&ezs, "and the last line %d %d %d %d%s", 13, 14, 15, 16, "\n");
 	printf(ezs.buffer);
+ *
+ * or, with no pre sizing & no format parsing at all:
+ *
+	ez_sprintf_t ezs;
+
+	ez_sprintf_init_growable(&ezs, 0, 4, NULL);
+	ez_sprintf_append_string(&ezs, "object ");
+	ez_sprintf_append_int(&ezs, 1234, 8);
+	ez_sprintf_append_string(&ezs, " at ");
+	ez_sprintf_append_pointer(&ezs, &ezs);
+	ez_sprintf_append_bytes(&ezs, "\n", 1);
+	printf("%s", ezs.buffer);
+	ez_sprintf_destroy(&ezs);
  */
 
 #endif /* __EZ_SPRINTF_H__ */
@@ -0,0 +1,252 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Generational handle table, see handle_table.h
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#include "handle_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* biggest index which can ever be handed out */
+#define HANDLE_TABLE_MAX_INDEX          (HANDLE_TABLE_NO_INDEX - 1)
+
+#define HANDLE_ENTRY(htp, index) \
+    (&(htp)->chunks[(index) >> HANDLE_TABLE_CHUNK_BITS] \
+        [(index) & (HANDLE_TABLE_CHUNK_ENTRIES - 1)])
+
+/*
+ * A directory is preceded by one pointer which links it into the
+ * retired directories list once it is replaced by a bigger one.
+ */
+static handle_entry_t **
+handle_directory_allocate (handle_table_t *htp, int size)
+{
+    void **base;
+
+    base = MEM_MONITOR_ZALLOC(htp, (size + 1) * sizeof(void*));
+    return base ? (handle_entry_t**) (base + 1) : NULL;
+}
+
+static int
+handle_table_grow (handle_table_t *htp)
+{
+    handle_entry_t **chunks = (handle_entry_t**) htp->chunks;
+    handle_entry_t **new_chunks, *chunk;
+    unsigned int first, i;
+    void **base;
+    int new_size;
+
+    first = (unsigned int) htp->n_chunks << HANDLE_TABLE_CHUNK_BITS;
+    if (first > htp->max_handles - 1) return ENOSPC;
+
+    /*
+     * the old directory may still be being read by a resolver,
+     * so it is only retired, never freed or modified
+     */
+    if (htp->n_chunks >= htp->chunks_size) {
+        new_size = htp->chunks_size ? htp->chunks_size * 2 : 16;
+        new_chunks = handle_directory_allocate(htp, new_size);
+        if (NULL == new_chunks) return ENOMEM;
+        if (chunks) {
+            memcpy(new_chunks, chunks, htp->n_chunks * sizeof(void*));
+            base = ((void**) chunks) - 1;
+            *base = htp->retired_chunks;
+            htp->retired_chunks = base;
+        }
+        __atomic_store_n(&htp->chunks, new_chunks, __ATOMIC_RELEASE);
+        htp->chunks_size = new_size;
+        chunks = new_chunks;
+    }
+
+    chunk = MEM_MONITOR_ZALLOC(htp,
+        HANDLE_TABLE_CHUNK_ENTRIES * sizeof(handle_entry_t));
+    if (NULL == chunk) return ENOMEM;
+
+    /* thread the new entries into the free list, lowest index first */
+    for (i = 0; i < HANDLE_TABLE_CHUNK_ENTRIES; i++) {
+        chunk[i].generation = 1;
+        chunk[i].next_free = first + i + 1;
+        if (first + i >= htp->max_handles - 1) {
+            chunk[i].next_free = HANDLE_TABLE_NO_INDEX;
+            break;
+        }
+    }
+    if (i == HANDLE_TABLE_CHUNK_ENTRIES)
+        chunk[i - 1].next_free = HANDLE_TABLE_NO_INDEX;
+    htp->free_index = first;
+
+    /* chunk must be complete before it can be seen */
+    chunks[htp->n_chunks] = chunk;
+    __atomic_store_n(&htp->n_chunks, htp->n_chunks + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+static int
+thread_unsafe_handle_create (handle_table_t *htp, void *pointer,
+    handle_t *handle_returned)
+{
+    handle_entry_t *entry;
+    unsigned int index;
+    int failed;
+
+    if (HANDLE_TABLE_NO_INDEX == htp->free_index) {
+        if ((failed = handle_table_grow(htp))) return failed;
+    }
+    index = htp->free_index;
+    entry = HANDLE_ENTRY(htp, index);
+    htp->free_index = entry->next_free;
+    __atomic_store_n(&entry->pointer, pointer, __ATOMIC_RELEASE);
+    htp->n_handles++;
+    *handle_returned = HANDLE_MAKE(index, entry->generation);
+
+    return 0;
+}
+
+static int
+thread_unsafe_handle_remove (handle_table_t *htp, handle_t handle,
+    void **pointer_removed)
+{
+    unsigned int index = HANDLE_INDEX(handle);
+    unsigned int generation = HANDLE_GENERATION(handle);
+    handle_entry_t *entry;
+    void *pointer;
+
+    if ((0 == generation) ||
+        ((index >> HANDLE_TABLE_CHUNK_BITS) >= (unsigned int) htp->n_chunks))
+            return ENODATA;
+    entry = HANDLE_ENTRY(htp, index);
+    if ((entry->generation != generation) || (NULL == entry->pointer))
+        return ENODATA;
+    pointer = entry->pointer;
+
+    /*
+     * invalidate every copy of the handle before the pointer is
+     * cleared, so a resolver can never see a half removed entry
+     */
+    if (0 == ++generation) generation = 1;
+    __atomic_store_n(&entry->generation, generation, __ATOMIC_RELEASE);
+    __atomic_store_n(&entry->pointer, NULL, __ATOMIC_RELEASE);
+    entry->next_free = htp->free_index;
+    htp->free_index = index;
+    htp->n_handles--;
+    if (pointer_removed) *pointer_removed = pointer;
+
+    return 0;
+}
+
+/***************************** 80 column separator ****************************/
+
+PUBLIC int
+handle_table_init (handle_table_t *htp,
+    boolean make_it_thread_safe,
+    unsigned int max_handles,
+    mem_monitor_t *parent_mem_monitor)
+{
+    memset(htp, 0, sizeof(handle_table_t));
+    MEM_MONITOR_SETUP(htp);
+    LOCK_SETUP(htp);
+    if ((0 == max_handles) || (max_handles > HANDLE_TABLE_MAX_INDEX))
+        max_handles = HANDLE_TABLE_MAX_INDEX;
+    htp->max_handles = max_handles;
+    htp->free_index = HANDLE_TABLE_NO_INDEX;
+
+    return 0;
+}
+
+PUBLIC int
+handle_create (handle_table_t *htp, void *pointer,
+    handle_t *handle_returned)
+{
+    int failed;
+
+    *handle_returned = NULL_HANDLE;
+    if (NULL == pointer) return EINVAL;
+    OBJ_WRITE_LOCK(htp);
+    failed = thread_unsafe_handle_create(htp, pointer, handle_returned);
+    OBJ_WRITE_UNLOCK(htp);
+
+    return failed;
+}
+
+PUBLIC int
+handle_remove (handle_table_t *htp, handle_t handle,
+    void **pointer_removed)
+{
+    int failed;
+
+    OBJ_WRITE_LOCK(htp);
+    failed = thread_unsafe_handle_remove(htp, handle, pointer_removed);
+    OBJ_WRITE_UNLOCK(htp);
+
+    return failed;
+}
+
+PUBLIC void
+handle_table_destroy (handle_table_t *htp)
+{
+    void **base, *next;
+    int c;
+
+    OBJ_WRITE_LOCK(htp);
+    for (c = 0; c < htp->n_chunks; c++) MEM_MONITOR_FREE(htp->chunks[c]);
+    if (htp->chunks) mem_monitor_free(((void**) htp->chunks) - 1);
+    for (base = htp->retired_chunks; base; base = next) {
+        next = *base;
+        mem_monitor_free(base);
+    }
+    OBJ_WRITE_UNLOCK(htp);
+    LOCK_OBJ_DESTROY(htp);
+    memset(htp, 0, sizeof(*htp));
+}
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
@@ -0,0 +1,200 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Generational handle table.
+**
+** Instead of a raw pointer, a 64 bit handle can be stored & passed
+** around: a 32 bit index into this table & the 32 bit generation of
+** that entry at the time the handle was created.  Every time an entry
+** is removed, its generation is incremented, so every handle which was
+** ever given out for it stops resolving (to NULL) from then on, even
+** after the entry is reused for another pointer.  A dangling or a
+** corrupted handle is therefore caught, instead of silently pointing
+** to freed or reused memory.  A handle of 0 (NULL_HANDLE) never
+** resolves to anything.
+**
+** Creation, resolution & removal are all O(1).  Entries live in chunks
+** of HANDLE_TABLE_CHUNK_ENTRIES which never move once allocated, so
+** existing handles stay valid while the table grows.  The directory
+** of chunks is replaced by a bigger copy when it fills up, and the old
+** copies are kept till the table is destroyed, so a reader which
+** still has an old copy is safe too.
+**
+** Creation & removal are serialized by the lock of the table (if it is
+** thread safe) but resolution never takes a lock: it reads the
+** generation, the pointer and the generation again and only returns
+** the pointer if the generation did not change in between.  Resolving
+** a handle does NOT keep what it points to alive though; if it can be
+** removed & freed by another thread, the user must make sure it is
+** not freed while still in use after being resolved.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#ifndef __HANDLE_TABLE_H__
+#define __HANDLE_TABLE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+#include "mem_monitor_object.h"
+#include "lock_object.h"
+
+typedef unsigned long long int handle_t;
+
+#define NULL_HANDLE                     ((handle_t) 0)
+
+#define HANDLE_INDEX(handle)            ((unsigned int) (handle))
+#define HANDLE_GENERATION(handle)       ((unsigned int) ((handle) >> 32))
+#define HANDLE_MAKE(index, generation) \
+    ((((handle_t) (generation)) << 32) | (handle_t) (index))
+
+#define HANDLE_TABLE_CHUNK_BITS         10
+#define HANDLE_TABLE_CHUNK_ENTRIES      (1 << HANDLE_TABLE_CHUNK_BITS)
+
+/* an index which can never be valid, terminates the free list */
+#define HANDLE_TABLE_NO_INDEX           (0xFFFFFFFF)
+
+typedef struct handle_entry_s {
+
+    /* matches the generation of the only handle which resolves */
+    volatile unsigned int generation;
+
+    /* next free entry if this one is free */
+    unsigned int next_free;
+
+    void * volatile pointer;
+
+} handle_entry_t;
+
+typedef struct handle_table_s {
+
+    MEM_MON_VARIABLES;
+    LOCK_VARIABLES;
+
+    /* chunks of entries, which never move */
+    handle_entry_t * volatile * volatile chunks;
+    int chunks_size;
+    volatile int n_chunks;
+
+    /* directories of chunks which were replaced by bigger ones */
+    void *retired_chunks;
+
+    /* at most this many entries can be used */
+    unsigned int max_handles;
+
+    /* head of the free entries list */
+    unsigned int free_index;
+
+    /* how many handles currently resolve */
+    unsigned int n_handles;
+
+} handle_table_t;
+
+/*
+ * 'max_handles' of 0 means as many as 32 bits can index.  No entries
+ * are allocated until the first handle is created.  Returns 0.
+ */
+extern int
+handle_table_init (handle_table_t *htp,
+    boolean make_it_thread_safe,
+    unsigned int max_handles,
+    mem_monitor_t *parent_mem_monitor);
+
+/*
+ * Creates a handle for 'pointer', which must not be NULL.
+ * Returns 0, EINVAL, ENOSPC (table full) or ENOMEM.
+ */
+extern int
+handle_create (handle_table_t *htp, void *pointer,
+    handle_t *handle_returned);
+
+/*
+ * Returns the pointer the handle was created for, or NULL if the
+ * handle was removed (or never existed).  Never takes a lock.
+ */
+static inline void *
+handle_resolve (handle_table_t *htp, handle_t handle)
+{
+    unsigned int index = HANDLE_INDEX(handle);
+    unsigned int generation = HANDLE_GENERATION(handle);
+    handle_entry_t * volatile *chunks;
+    handle_entry_t *entry;
+    void *pointer;
+
+    if ((index >> HANDLE_TABLE_CHUNK_BITS) >=
+        (unsigned int) __atomic_load_n(&htp->n_chunks, __ATOMIC_ACQUIRE))
+            return NULL;
+    chunks = __atomic_load_n(&htp->chunks, __ATOMIC_ACQUIRE);
+    entry = &chunks[index >> HANDLE_TABLE_CHUNK_BITS]
+        [index & (HANDLE_TABLE_CHUNK_ENTRIES - 1)];
+    if (__atomic_load_n(&entry->generation, __ATOMIC_ACQUIRE) != generation)
+        return NULL;
+    pointer = __atomic_load_n(&entry->pointer, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&entry->generation, __ATOMIC_ACQUIRE) != generation)
+        return NULL;
+
+    return pointer;
+}
+
+/*
+ * Removes the handle, so that neither it nor any copy of it resolves
+ * any more.  The pointer it resolved to is returned in 'pointer_removed'
+ * if it is not NULL.  Returns 0 or ENODATA if it did not resolve.
+ */
+extern int
+handle_remove (handle_table_t *htp, handle_t handle,
+    void **pointer_removed);
+
+extern void
+handle_table_destroy (handle_table_t *htp);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif // __HANDLE_TABLE_H__
+
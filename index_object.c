@@ -344,6 +344,91 @@ index_obj_reset (index_obj_t *idx)
     OBJ_WRITE_UNLOCK(idx);
 }
 
+/**************************** Cursors ****************************************/
+
+/* moves the cursor to 'position' & hands out the element there */
+static int
+index_obj_cursor_move (index_obj_cursor_t *cursor, int position,
+        void **data)
+{
+    index_obj_t *idx = cursor->idx;
+
+    if ((position < 0) || (position >= idx->n)) {
+        cursor->position = -1;
+        safe_pointer_set(data, NULL);
+        return ENODATA;
+    }
+    cursor->position = position;
+    safe_pointer_set(data, idx->elements[position]);
+    return 0;
+}
+
+PUBLIC int
+index_obj_cursor_first (index_obj_t *idx, index_obj_cursor_t *cursor,
+        void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(idx);
+    cursor->idx = idx;
+    failed = index_obj_cursor_move(cursor, 0, data);
+    OBJ_READ_UNLOCK(idx);
+    return failed;
+}
+
+PUBLIC int
+index_obj_cursor_last (index_obj_t *idx, index_obj_cursor_t *cursor,
+        void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(idx);
+    cursor->idx = idx;
+    failed = index_obj_cursor_move(cursor, idx->n - 1, data);
+    OBJ_READ_UNLOCK(idx);
+    return failed;
+}
+
+PUBLIC int
+index_obj_cursor_seek (index_obj_t *idx, index_obj_cursor_t *cursor,
+        void *key, void **data)
+{
+    int i, insertion_point = 0;
+    int failed;
+
+    OBJ_READ_LOCK(idx);
+    cursor->idx = idx;
+    i = index_obj_find_position(idx, key, &insertion_point);
+    failed = index_obj_cursor_move(cursor,
+                (i >= 0) ? i : insertion_point, data);
+    OBJ_READ_UNLOCK(idx);
+    return failed;
+}
+
+PUBLIC int
+index_obj_cursor_next (index_obj_cursor_t *cursor, void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(cursor->idx);
+    failed = index_obj_cursor_move(cursor,
+                (cursor->position < 0) ? -1 : (cursor->position + 1), data);
+    OBJ_READ_UNLOCK(cursor->idx);
+    return failed;
+}
+
+PUBLIC int
+index_obj_cursor_prev (index_obj_cursor_t *cursor, void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(cursor->idx);
+    failed = index_obj_cursor_move(cursor,
+                (cursor->position < 0) ? -1 : (cursor->position - 1), data);
+    OBJ_READ_UNLOCK(cursor->idx);
+    return failed;
+}
+
 /**************************** Destroy ****************************************/
 
 /*
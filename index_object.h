@@ -71,6 +71,24 @@ typedef struct index_obj_s {
 
 } index_obj_t;
 
+/*
+ * A cursor walks the index one element at a time in sorted order, in
+ * either direction, in a loop of the caller's own.  It is simply a
+ * position in the index, so it can never read outside of it, but an
+ * insertion or removal shifts every element after it by one.  If that
+ * happens before the cursor, it will see an element again or skip one.
+ * Every call takes the lock of the index by itself, nothing is held
+ * in between.
+ */
+typedef struct index_obj_cursor_s {
+
+    index_obj_t *idx;
+
+    /* -1 when the cursor is on nothing */
+    int position;
+
+} index_obj_cursor_t;
+
 /*
  * When the object is reset, it will have so many empty entries by default
  */
@@ -178,6 +196,33 @@ index_obj_remove (index_obj_t *idx,
 extern void
 index_obj_reset (index_obj_t *idx);
 
+/******************************** Cursors *************************************
+ *
+ * Cursor calls return 0 & place the element the cursor moved onto
+ * into 'data', or return ENODATA (& set 'data' to NULL) when there is
+ * none.  Once past either end, 'next' & 'prev' keep returning ENODATA.
+ *
+ * 'seek' positions the cursor on the first element which is >= 'key'
+ * as decided by the compare function, 'key' need not be in the index.
+ */
+extern int
+index_obj_cursor_first (index_obj_t *idx, index_obj_cursor_t *cursor,
+        void **data);
+
+extern int
+index_obj_cursor_last (index_obj_t *idx, index_obj_cursor_t *cursor,
+        void **data);
+
+extern int
+index_obj_cursor_seek (index_obj_t *idx, index_obj_cursor_t *cursor,
+        void *key, void **data);
+
+extern int
+index_obj_cursor_next (index_obj_cursor_t *cursor, void **data);
+
+extern int
+index_obj_cursor_prev (index_obj_cursor_t *cursor, void **data);
+
 /******************************** Destroy *************************************
  *
  * This calls destroys this index object and makes it un-usable.
@@ -59,6 +59,9 @@
 *******************************************************************************
 ******************************************************************************/
 
+#ifndef __LIFO_H__
+#define __LIFO_H__
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -124,4 +127,5 @@ lifo_destroy (lifo_t *lifo);
 } // extern C
 #endif
 
+#endif // __LIFO_H__
 
@@ -33,6 +33,7 @@
 *******************************************************************************
 ******************************************************************************/
 
+#include <pthread.h>
 #include "line_counters.h"
 
 #define PUBLIC
@@ -137,3 +138,274 @@ increment_line_counter(line_counter_block_t *lcbp,
 
 	return 0;
 }
+
+/******************************************************************************
+ *
+ * Per call site line counters.
+ */
+
+__thread line_counter_shard_t *my_line_counter_shard = NULL;
+
+/*
+ * Everything below is protected by 'registry_lock' which is
+ * grabbed only when a new site or thread appears & by the collector.
+ */
+static lock_obj_t registry_lock;
+static line_counter_site_t *sites [MAX_LINE_COUNTER_SITES];
+static volatile int n_sites = 0;
+static line_counter_shard_t *shards = NULL;
+
+/* hits of the shards which have been freed after their threads exited */
+static unsigned long long int retired_hits [MAX_LINE_COUNTER_SITES];
+
+/* what all the hits were at the last reset */
+static unsigned long long int baseline_hits [MAX_LINE_COUNTER_SITES];
+
+static pthread_once_t shard_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t shard_key;
+
+/*
+ * The collector frees the shard as soon as it sees 'owner_exited', so
+ * the thread must forget it first.  Anything counted by a later
+ * destructor of this thread then simply gets a new shard.
+ */
+static void
+shard_owner_exits(void *vshard)
+{
+	my_line_counter_shard = 0;
+	__sync_synchronize();
+	((line_counter_shard_t*) vshard)->owner_exited = 1;
+}
+
+static void
+shard_key_create(void)
+{
+	pthread_key_create(&shard_key, shard_owner_exits);
+}
+
+static line_counter_shard_t *
+shard_of_this_thread(void)
+{
+	line_counter_shard_t *shard;
+
+	if (my_line_counter_shard) return my_line_counter_shard;
+	pthread_once(&shard_key_once, shard_key_create);
+	shard = calloc(1, sizeof(line_counter_shard_t));
+	if (0 == shard) return 0;
+
+	grab_write_lock(&registry_lock);
+	shard->next = shards;
+	shards = shard;
+	release_write_lock(&registry_lock);
+
+	pthread_setspecific(shard_key, shard);
+	my_line_counter_shard = shard;
+
+	return shard;
+}
+
+/*
+ * A site is registered by whichever thread claims it first, the others
+ * count their hits as unsharded until the registration completes.
+ */
+static void
+site_register(line_counter_site_t *site)
+{
+	int index = LINE_COUNTER_SITE_UNREGISTERED;
+
+	if (!__sync_bool_compare_and_swap(&site->index,
+		LINE_COUNTER_SITE_UNREGISTERED, LINE_COUNTER_SITE_REGISTERING))
+			return;
+
+	grab_write_lock(&registry_lock);
+	if (n_sites < MAX_LINE_COUNTER_SITES) {
+		index = n_sites;
+		sites[index] = site;
+		__sync_synchronize();
+		n_sites = index + 1;
+	}
+	release_write_lock(&registry_lock);
+
+	/* a site which can not be registered stays 'registering' for good */
+	if (index >= 0) site->index = index;
+}
+
+PUBLIC void
+line_counter_site_hit_slow(line_counter_site_t *site)
+{
+	if (site->index == LINE_COUNTER_SITE_UNREGISTERED) site_register(site);
+	if ((site->index >= 0) && shard_of_this_thread()) {
+		my_line_counter_shard->counts[site->index]++;
+		return;
+	}
+	__sync_fetch_and_add(&site->unsharded_hits, 1);
+}
+
+/*
+ * Adds up all the hits into 'hits' (indexed by the site index)
+ * and frees the shards of the threads which have exited.
+ * Must be called with the registry lock held.
+ */
+static int
+hits_add_up(unsigned long long int *hits)
+{
+	line_counter_shard_t *shard, **prevp;
+	int i, n = n_sites;
+
+	for (i = 0; i < n; i++) {
+		hits[i] = retired_hits[i] + sites[i]->unsharded_hits;
+	}
+	prevp = &shards;
+	while ((shard = *prevp)) {
+		for (i = 0; i < n; i++) hits[i] += shard->counts[i];
+		if (shard->owner_exited) {
+			for (i = 0; i < n; i++) {
+				retired_hits[i] += shard->counts[i];
+			}
+			*prevp = shard->next;
+			free(shard);
+		} else {
+			prevp = &shard->next;
+		}
+	}
+
+	return n;
+}
+
+static int
+compare_totals(const void *v1, const void *v2)
+{
+	const line_counter_total_t *t1 = v1;
+	const line_counter_total_t *t2 = v2;
+
+	if (t1->hits != t2->hits) return (t1->hits < t2->hits) ? 1 : -1;
+	return t1->site->line_number - t2->site->line_number;
+}
+
+PUBLIC int
+line_counters_collect(line_counter_total_t *totals, int max)
+{
+	unsigned long long int *hits;
+	line_counter_total_t *all;
+	int i, n, count = 0;
+
+	if ((0 == totals) || (max <= 0)) return 0;
+	hits = malloc(MAX_LINE_COUNTER_SITES * sizeof(*hits));
+	all = malloc(MAX_LINE_COUNTER_SITES * sizeof(*all));
+	if ((0 == hits) || (0 == all)) {
+		free(hits);
+		free(all);
+		return 0;
+	}
+
+	grab_write_lock(&registry_lock);
+	n = hits_add_up(hits);
+	for (i = 0; i < n; i++) {
+		if (hits[i] <= baseline_hits[i]) continue;
+		all[count].site = sites[i];
+		all[count].hits = hits[i] - baseline_hits[i];
+		count++;
+	}
+	release_write_lock(&registry_lock);
+
+	qsort(all, count, sizeof(*all), compare_totals);
+	if (count > max) count = max;
+	memcpy(totals, all, count * sizeof(*all));
+	free(hits);
+	free(all);
+
+	return count;
+}
+
+PUBLIC void
+line_counters_dump(FILE *fp, int top_n)
+{
+	line_counter_total_t *totals;
+	int i, n;
+
+	if (top_n <= 0) return;
+	totals = malloc(top_n * sizeof(*totals));
+	if (0 == totals) return;
+	n = line_counters_collect(totals, top_n);
+	fprintf(fp, "%d hottest lines:\n", n);
+	for (i = 0; i < n; i++) {
+		fprintf(fp, "%16llu  %s(%d): <%s>\n", totals[i].hits,
+			totals[i].site->file_name, totals[i].site->line_number,
+			totals[i].site->function_name);
+	}
+	fflush(fp);
+	free(totals);
+}
+
+PUBLIC void
+line_counters_reset(void)
+{
+	unsigned long long int *hits;
+	int i, n;
+
+	hits = malloc(MAX_LINE_COUNTER_SITES * sizeof(*hits));
+	if (0 == hits) return;
+	grab_write_lock(&registry_lock);
+	n = hits_add_up(hits);
+	for (i = 0; i < n; i++) baseline_hits[i] = hits[i];
+	release_write_lock(&registry_lock);
+	free(hits);
+}
+
+/*
+ * Periodic aggregator.
+ */
+
+static struct {
+
+	volatile int running;
+	FILE *output;
+	int top_n;
+	int interval_msecs;
+	pthread_t thread;
+
+} aggregator;
+
+static void *
+aggregator_thread(void *arg)
+{
+	int slept;
+
+	while (aggregator.running) {
+
+		/* sleep in small steps so that stopping is quick */
+		for (slept = 0; aggregator.running &&
+			(slept < aggregator.interval_msecs); slept += 10) {
+				nano_seconds_sleep(10 * 1000000);
+		}
+		if (aggregator.running) {
+			line_counters_dump(aggregator.output, aggregator.top_n);
+		}
+	}
+	return 0;
+}
+
+PUBLIC int
+line_counters_aggregator_start(FILE *fp, int top_n, int interval_msecs)
+{
+	int failed;
+
+	if ((top_n <= 0) || (interval_msecs <= 0)) return EINVAL;
+	if (aggregator.running) return EBUSY;
+	aggregator.output = fp ? fp : stderr;
+	aggregator.top_n = top_n;
+	aggregator.interval_msecs = interval_msecs;
+	aggregator.running = 1;
+	failed = pthread_create(&aggregator.thread, 0, aggregator_thread, 0);
+	if (failed) aggregator.running = 0;
+
+	return failed;
+}
+
+PUBLIC void
+line_counters_aggregator_stop(void)
+{
+	if (!aggregator.running) return;
+	aggregator.running = 0;
+	pthread_join(aggregator.thread, 0);
+}
@@ -36,6 +36,9 @@
 #ifndef __LINE_COUNTERS_H__
 #define __LINE_COUNTERS_H__
 
+#include "common.h"
+#include "lock_object.h"
+
 /*
  * This structure represents how many times a specific line in the
  * indicated function has been executed during the running of the code.
@@ -94,4 +97,120 @@ extern void init_line_counter_block(line_counter_block_t *lcbp);
 extern int increment_line_counter(line_counter_block_t *lcbp,
 	const int line_number, const char *function_name);
 
+/******************************************************************************
+ *
+ * Per call site line counters.
+ *
+ * Unlike the line counter blocks above, these need no hashing at all.
+ * Every call site of LINE_COUNTER_HIT() owns a statically allocated
+ * site descriptor, which is given a small index the very first time it
+ * is hit.  Every thread counts into its own array (shard) of counters
+ * indexed by that, so a hit is a single non atomic increment of memory
+ * only the calling thread ever writes to.
+ *
+ * The collector adds up all the shards (and the shards of the threads
+ * which have exited) whenever asked, either on demand or periodically
+ * by a background aggregator, and reports the hottest lines.
+ *
+ * If compiled with -DNO_LINE_COUNTERS, LINE_COUNTER_HIT() disappears.
+ */
+
+/* maximum number of distinct call sites which can be counted per shard */
+#define MAX_LINE_COUNTER_SITES		4096
+
+#define LINE_COUNTER_SITE_UNREGISTERED	(-1)
+#define LINE_COUNTER_SITE_REGISTERING	(-2)
+
+typedef struct line_counter_site_s {
+
+	const char *file_name;
+	const char *function_name;
+	int line_number;
+
+	/* index into the shards once registered */
+	volatile int index;
+
+	/* hits which could not be counted in a shard (rare) */
+	unsigned long long int unsharded_hits;
+
+} line_counter_site_t;
+
+typedef struct line_counter_shard_s line_counter_shard_t;
+struct line_counter_shard_s {
+
+	/* all the shards are chained for the collector */
+	line_counter_shard_t *next;
+
+	/* set when the owning thread exits */
+	volatile int owner_exited;
+
+	unsigned long long int counts [MAX_LINE_COUNTER_SITES];
+};
+
+/* shard of the calling thread, NULL until it counts its first hit */
+extern __thread line_counter_shard_t *my_line_counter_shard;
+
+/* PRIVATE, used by LINE_COUNTER_HIT when the fast path cannot be taken */
+extern void line_counter_site_hit_slow(line_counter_site_t *site);
+
+static inline void
+line_counter_site_hit (line_counter_site_t *site)
+{
+	line_counter_shard_t *shard = my_line_counter_shard;
+	int index = site->index;
+
+	if ((index >= 0) && shard) {
+		shard->counts[index]++;
+		return;
+	}
+	line_counter_site_hit_slow(site);
+}
+
+#ifdef NO_LINE_COUNTERS
+
+#define LINE_COUNTER_HIT()
+
+#else /* !NO_LINE_COUNTERS */
+
+#define LINE_COUNTER_HIT() \
+	do { \
+		static line_counter_site_t __line_counter_site__ = { \
+			__FILE__, __FUNCTION__, __LINE__, \
+			LINE_COUNTER_SITE_UNREGISTERED, 0 }; \
+		line_counter_site_hit(&__line_counter_site__); \
+	} while (0)
+
+#endif /* NO_LINE_COUNTERS */
+
+/* total hits of one call site, as reported by the collector */
+typedef struct line_counter_total_s {
+
+	line_counter_site_t *site;
+	unsigned long long int hits;
+
+} line_counter_total_t;
+
+/*
+ * Adds up the hits of every call site since the last reset and
+ * stores the 'max' hottest ones into 'totals', hottest first.
+ * Returns how many were stored.  Hits which happen while this is
+ * running may or may not be included.
+ */
+extern int line_counters_collect(line_counter_total_t *totals, int max);
+
+/* prints the 'top_n' hottest lines */
+extern void line_counters_dump(FILE *fp, int top_n);
+
+/* from now on, hits are counted from 0 again */
+extern void line_counters_reset(void);
+
+/*
+ * Starts a background thread which dumps the 'top_n' hottest lines
+ * into 'fp' every 'interval_msecs' milli seconds.  Returns 0 or errno.
+ */
+extern int line_counters_aggregator_start(FILE *fp, int top_n,
+	int interval_msecs);
+
+extern void line_counters_aggregator_stop(void);
+
 #endif /* __LINE_COUNTERS_H__ */
@@ -0,0 +1,332 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#include <sys/mman.h>
+#include "mem_allocators.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************
+ *
+ * Chunk manager.
+ */
+
+static void *
+chunk_manager_block_allocate (void *context, int size)
+{
+    chunk_manager_t *cmgrp = (chunk_manager_t*) context;
+
+    /* no malloc fall back for chunks, see mem_allocators.h */
+    if (size <= cmgrp->chunk_size) return chunk_alloc(cmgrp);
+    return malloc(size);
+}
+
+static void
+chunk_manager_block_free (void *context, void *block, int size)
+{
+    chunk_manager_t *cmgrp = (chunk_manager_t*) context;
+
+    if (size <= cmgrp->chunk_size) {
+        chunk_free(block);
+    } else {
+        free(block);
+    }
+}
+
+PUBLIC void
+mem_allocator_chunk_manager_init (mem_allocator_t *allocator,
+    chunk_manager_t *cmgrp)
+{
+    allocator->name = "chunk manager";
+    allocator->context = cmgrp;
+    allocator->allocate = chunk_manager_block_allocate;
+    allocator->free = chunk_manager_block_free;
+    allocator->reallocate = NULL;
+}
+
+/******************************************************************************
+ *
+ * Buffer manager.
+ */
+
+static void *
+buffer_manager_block_allocate (void *context, int size)
+{
+    void *block = buffer_allocate((buffer_manager_t*) context, size);
+
+    return block ? block : malloc(size);
+}
+
+static void
+buffer_manager_block_free (void *context, void *block, int size)
+{
+    if (buffer_manager_owns((buffer_manager_t*) context, block)) {
+        buffer_free(block);
+    } else {
+        free(block);
+    }
+}
+
+PUBLIC void
+mem_allocator_buffer_manager_init (mem_allocator_t *allocator,
+    buffer_manager_t *bmp)
+{
+    allocator->name = "buffer manager";
+    allocator->context = bmp;
+    allocator->allocate = buffer_manager_block_allocate;
+    allocator->free = buffer_manager_block_free;
+    allocator->reallocate = NULL;
+}
+
+/******************************************************************************
+ *
+ * Slab allocator.
+ */
+
+static void *
+slab_allocator_block_allocate (void *context, int size)
+{
+    return slab_allocate((slab_allocator_t*) context, size);
+}
+
+static void
+slab_allocator_block_free (void *context, void *block, int size)
+{
+    slab_free(block);
+}
+
+static void *
+slab_allocator_block_reallocate (void *context, void *block,
+    int old_size, int new_size)
+{
+    return slab_reallocate((slab_allocator_t*) context, block, new_size);
+}
+
+PUBLIC void
+mem_allocator_slab_allocator_init (mem_allocator_t *allocator,
+    slab_allocator_t *sap)
+{
+    allocator->name = "slab allocator";
+    allocator->context = sap;
+    allocator->allocate = slab_allocator_block_allocate;
+    allocator->free = slab_allocator_block_free;
+    allocator->reallocate = slab_allocator_block_reallocate;
+}
+
+/******************************************************************************
+ *
+ * Arena.
+ */
+
+struct mem_arena_region_s {
+
+    mem_arena_region_t *next;
+    unsigned long long int size;
+
+    /* blocks are carved from here onwards */
+    unsigned long long int data [0];
+};
+
+#define ARENA_ALIGNMENT         8
+#define ARENA_ALIGN(size)       (((size) + ARENA_ALIGNMENT - 1) & \
+                                    ~(ARENA_ALIGNMENT - 1))
+
+PUBLIC int
+mem_arena_init (mem_arena_t *arena,
+    boolean make_it_thread_safe,
+    int region_size, boolean use_huge_pages)
+{
+    if (region_size < 0) return EINVAL;
+    memset(arena, 0, sizeof(mem_arena_t));
+    LOCK_SETUP(arena);
+    arena->region_size =
+        region_size ? region_size : MEM_ARENA_DEFAULT_REGION_SIZE;
+    arena->use_huge_pages = use_huge_pages;
+
+    return 0;
+}
+
+/*
+ * maps a new region big enough for at least 'size'
+ * bytes of blocks and makes it the current one
+ */
+static int
+thread_unsafe_mem_arena_region_add (mem_arena_t *arena, int size)
+{
+    unsigned long long int map_size;
+    mem_arena_region_t *region = MAP_FAILED;
+    int page_size = arena->use_huge_pages ?
+        MEM_ARENA_HUGE_PAGE_SIZE : (int) sysconf(_SC_PAGESIZE);
+
+    map_size = sizeof(mem_arena_region_t) + size;
+    if (map_size < (unsigned long long int) arena->region_size)
+        map_size = arena->region_size;
+    map_size = (map_size + page_size - 1) &
+        ~((unsigned long long int) page_size - 1);
+
+#ifdef MAP_HUGETLB
+    if (arena->use_huge_pages) {
+        region = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (region != MAP_FAILED) arena->huge_page_regions++;
+    }
+#endif
+    if (region == MAP_FAILED) {
+        region = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) return ENOMEM;
+#ifdef MADV_HUGEPAGE
+        if (arena->use_huge_pages) madvise(region, map_size, MADV_HUGEPAGE);
+#endif
+    }
+
+    region->size = map_size;
+    region->next = arena->regions;
+    arena->regions = region;
+    arena->next = (byte*) &region->data[0];
+    arena->end = ((byte*) region) + map_size;
+    arena->last_block = NULL;
+    arena->bytes_mapped += map_size;
+
+    return 0;
+}
+
+static void *
+thread_unsafe_mem_arena_allocate (mem_arena_t *arena, int size)
+{
+    byte *block;
+
+    size = ARENA_ALIGN(size);
+    if ((arena->end - arena->next) < size) {
+        if (thread_unsafe_mem_arena_region_add(arena, size)) return NULL;
+    }
+    block = arena->next;
+    arena->next += size;
+    arena->last_block = block;
+    arena->bytes_carved += size;
+
+    return block;
+}
+
+PUBLIC void *
+mem_arena_allocate (mem_arena_t *arena, int size)
+{
+    void *block;
+
+    OBJ_WRITE_LOCK(arena);
+    block = thread_unsafe_mem_arena_allocate(arena, size);
+    OBJ_WRITE_UNLOCK(arena);
+
+    return block;
+}
+
+PUBLIC void
+mem_arena_destroy (mem_arena_t *arena)
+{
+    mem_arena_region_t *region, *next;
+
+    OBJ_WRITE_LOCK(arena);
+    for (region = arena->regions; region; region = next) {
+        next = region->next;
+        munmap(region, region->size);
+    }
+    arena->regions = NULL;
+    arena->next = arena->end = arena->last_block = NULL;
+    OBJ_WRITE_UNLOCK(arena);
+    LOCK_OBJ_DESTROY(arena);
+    memset(arena, 0, sizeof(mem_arena_t));
+}
+
+static void *
+arena_block_allocate (void *context, int size)
+{
+    return
+        mem_arena_allocate((mem_arena_t*) context, size);
+}
+
+/* memory is only given back when the arena is destroyed */
+static void
+arena_block_free (void *context, void *block, int size)
+{
+}
+
+/*
+ * The most recently carved block is resized in place if the
+ * region has enough space left, which makes a growing buffer
+ * cheap.  Otherwise, a new block is carved and the data copied.
+ */
+static void *
+arena_block_reallocate (void *context, void *block,
+    int old_size, int new_size)
+{
+    mem_arena_t *arena = (mem_arena_t*) context;
+    byte *new_block;
+    long long int grow;
+
+    OBJ_WRITE_LOCK(arena);
+    if (block == arena->last_block) {
+        grow = (long long int) ARENA_ALIGN(new_size) - ARENA_ALIGN(old_size);
+        if (grow <= (arena->end - arena->next)) {
+            arena->next += grow;
+            arena->bytes_carved += grow;
+            OBJ_WRITE_UNLOCK(arena);
+            return block;
+        }
+    }
+    new_block = thread_unsafe_mem_arena_allocate(arena, new_size);
+    OBJ_WRITE_UNLOCK(arena);
+    if (new_block) {
+        memcpy(new_block, block, old_size < new_size ? old_size : new_size);
+    }
+
+    return new_block;
+}
+
+PUBLIC void
+mem_allocator_arena_init (mem_allocator_t *allocator, mem_arena_t *arena)
+{
+    allocator->name = arena->use_huge_pages ? "huge page arena" : "arena";
+    allocator->context = arena;
+    allocator->allocate = arena_block_allocate;
+    allocator->free = arena_block_free;
+    allocator->reallocate = arena_block_reallocate;
+}
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
@@ -0,0 +1,184 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Allocators a mem monitor can be pointed at.
+**
+** Every object in this library gets its memory from its mem monitor,
+** which normally gets it from malloc.  By pointing a parent mem monitor
+** at one of the allocators below (mem_monitor_set_allocator), a whole
+** set of objects sharing that parent allocates from there instead,
+** without any of them having to change:
+**
+**  - a chunk manager:  blocks up to its chunk size come from its
+**    pre carved chunks, bigger ones from malloc.
+**
+**  - a buffer manager: blocks which fit its pools come from the pools,
+**    anything else (too big or pools exhausted) from malloc.
+**
+**  - a slab allocator: every block comes from its size classes.
+**
+**  - an arena: a bump allocator carving blocks one after the other
+**    from big mmap'ed regions.  Allocation is just a pointer increment
+**    and freeing does nothing; all the memory is given back to the OS
+**    at once when the arena is destroyed.  Ideal for objects which are
+**    built up & thrown away as a whole.  The regions can be backed by
+**    huge pages (MAP_HUGETLB), which cuts down on TLB misses when large
+**    trees are walked.  If no huge pages are reserved in the system,
+**    regular pages are used & transparent huge pages are asked for.
+**
+** The pool or arena must NOT itself use the mem monitor it is backing
+** as its parent mem monitor, that would recurse forever.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#ifndef __MEM_ALLOCATORS_H__
+#define __MEM_ALLOCATORS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+#include "mem_monitor_object.h"
+#include "lock_object.h"
+#include "chunk_manager.h"
+#include "buffer_manager.h"
+#include "slab_allocator.h"
+
+/*
+ * Points the allocator at a chunk manager / buffer manager, which
+ * must be initialized already and must be thread safe if the mem
+ * monitor using the allocator is used by more than one thread.
+ *
+ * Blocks bigger than a chunk, or than the biggest buffer, come from
+ * malloc.  The pools of a buffer manager can run out, so a buffer
+ * manager allocator falls back to malloc for those too.  A chunk
+ * manager never runs out but grows, so when chunk_alloc fails there
+ * is no memory for a new group and the allocation fails (NULL)
+ * rather than trying malloc, which would also make every free have
+ * to find out which one the block came from.
+ */
+extern void
+mem_allocator_chunk_manager_init (mem_allocator_t *allocator,
+    chunk_manager_t *cmgrp);
+
+extern void
+mem_allocator_buffer_manager_init (mem_allocator_t *allocator,
+    buffer_manager_t *bmp);
+
+extern void
+mem_allocator_slab_allocator_init (mem_allocator_t *allocator,
+    slab_allocator_t *sap);
+
+/******************************************************************************
+ *
+ * Arena.
+ */
+
+/* default size of each region an arena carves its blocks from */
+#define MEM_ARENA_DEFAULT_REGION_SIZE       (4 * 1024 * 1024)
+
+/* huge page size assumed when rounding up huge page backed regions */
+#define MEM_ARENA_HUGE_PAGE_SIZE            (2 * 1024 * 1024)
+
+typedef struct mem_arena_region_s mem_arena_region_t;
+
+typedef struct mem_arena_s {
+
+    LOCK_VARIABLES;
+
+    /* size of each new region */
+    int region_size;
+    boolean use_huge_pages;
+
+    /* every region mmap'ed so far, the current one first */
+    mem_arena_region_t *regions;
+
+    /* where the next block will be carved from in the current region */
+    byte *next;
+    byte *end;
+
+    /* the most recently carved block, which can be resized in place */
+    byte *last_block;
+
+    /* how much is mmap'ed and how much of it is carved */
+    unsigned long long int bytes_mapped;
+    unsigned long long int bytes_carved;
+
+    /* how many regions could actually get explicit huge pages */
+    int huge_page_regions;
+
+} mem_arena_t;
+
+/*
+ * 'region_size' of 0 means MEM_ARENA_DEFAULT_REGION_SIZE.  Blocks
+ * bigger than the region size get a region of their own.  No memory
+ * is mapped until the first allocation.  Returns 0 or EINVAL.
+ */
+extern int
+mem_arena_init (mem_arena_t *arena,
+    boolean make_it_thread_safe,
+    int region_size, boolean use_huge_pages);
+
+/* returns 8 byte aligned memory or NULL */
+extern void *
+mem_arena_allocate (mem_arena_t *arena, int size);
+
+/*
+ * Gives every region back to the OS.  Everything ever
+ * allocated from the arena becomes invalid.
+ */
+extern void
+mem_arena_destroy (mem_arena_t *arena);
+
+extern void
+mem_allocator_arena_init (mem_allocator_t *allocator, mem_arena_t *arena);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif // __MEM_ALLOCATORS_H__
+
@@ -15,7 +15,12 @@
 *******************************************************************************
 ******************************************************************************/
 
+#include <stddef.h>
+#include <sched.h>
+#include <pthread.h>
 #include "mem_monitor_object.h"
+#include "thread_slots.h"
+#include "ez_sprintf.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,6 +40,9 @@ typedef struct mem_header_s {
     /* total size of bytes used INCLUDING THIS header */
     int total_size;
 
+    /* profiling site the block is attributed to, 0 if none */
+    int site_tag;
+
     /* make the whole size of the structure a mult of 8 bytes */
     unsigned long long data [0];
 
@@ -50,61 +58,583 @@ get_mem_header_ptr (void *ptr)
         (mem_header_t*) (((byte*) ptr) - sizeof(mem_header_t));
 }
 
+/******************************************************************************
+ *
+ * Accounting.
+ */
+
+/*
+ * Slot of the calling thread into the shards of every sharded mem
+ * monitor, assigned at its first allocation or free & recycled when
+ * the thread exits.  MEM_MONITOR_MAX_THREADS is the shared atomic slot.
+ */
+#define MEM_MONITOR_SLOT_UNASSIGNED         (MEM_MONITOR_MAX_THREADS + 1)
+
+static __thread int mem_monitor_thread_slot = MEM_MONITOR_SLOT_UNASSIGNED;
+
+static thread_slots_t mem_monitor_thread_slots =
+    THREAD_SLOTS_INITIALIZER(MEM_MONITOR_MAX_THREADS);
+
+static int
+mem_monitor_thread_slot_assign (void)
+{
+    mem_monitor_thread_slot = thread_slot_assign(&mem_monitor_thread_slots);
+    return mem_monitor_thread_slot;
+}
+
+/*
+ * Adds 'bytes' (which may be negative) to the bytes used and
+ * 'allocations' & 'frees' to the relevant counts, according to
+ * the mode of the mem monitor.
+ */
+static inline void
+mem_monitor_account (mem_monitor_t *mmp, long long bytes,
+    int allocations, int frees)
+{
+    mem_monitor_shard_t *shard;
+    int slot;
+
+    if (NULL == mmp) return;
+    switch (mmp->mode) {
+
+    case MEM_MONITOR_SHARDED:
+        slot = mem_monitor_thread_slot;
+        if (slot == MEM_MONITOR_SLOT_UNASSIGNED) {
+            slot = mem_monitor_thread_slot_assign();
+        }
+        shard = &mmp->shards[slot];
+        if (slot < MEM_MONITOR_MAX_THREADS) {
+            shard->bytes_used += bytes;
+            shard->allocations += allocations;
+            shard->frees += frees;
+            return;
+        }
+        __sync_fetch_and_add(&shard->bytes_used, bytes);
+        if (allocations) __sync_fetch_and_add(&shard->allocations, allocations);
+        if (frees) __sync_fetch_and_add(&shard->frees, frees);
+        return;
+
+    case MEM_MONITOR_ATOMIC:
+        __sync_fetch_and_add(&mmp->bytes_used, bytes);
+        if (allocations) __sync_fetch_and_add(&mmp->allocations, allocations);
+        if (frees) __sync_fetch_and_add(&mmp->frees, frees);
+        return;
+
+    default:
+        mmp->bytes_used += bytes;
+        mmp->allocations += allocations;
+        mmp->frees += frees;
+        return;
+    }
+}
+
+int
+mem_monitor_init (mem_monitor_t *mmp, int mode)
+{
+    int size;
+
+    if ((mode < MEM_MONITOR_UNSYNCHRONIZED) || (mode > MEM_MONITOR_SHARDED))
+        return EINVAL;
+    memset(mmp, 0, sizeof(mem_monitor_t));
+    mmp->mode = mode;
+    if (mode == MEM_MONITOR_SHARDED) {
+        size = (MEM_MONITOR_MAX_THREADS + 1) * sizeof(mem_monitor_shard_t);
+        if (posix_memalign((void**) &mmp->shards,
+                sizeof(mem_monitor_shard_t), size)) {
+            mmp->shards = NULL;
+            mmp->mode = MEM_MONITOR_UNSYNCHRONIZED;
+            return ENOMEM;
+        }
+        memset(mmp->shards, 0, size);
+    }
+    return 0;
+}
+
+void
+mem_monitor_account_external (mem_monitor_t *mmp, long long bytes)
+{
+    if (bytes > 0) {
+        mem_monitor_account(mmp, bytes, 1, 0);
+    } else if (bytes < 0) {
+        mem_monitor_account(mmp, bytes, 0, 1);
+    }
+}
+
+int
+mem_monitor_set_allocator (mem_monitor_t *mmp, mem_allocator_t *allocator)
+{
+    if (mem_monitor_allocations(mmp) != mem_monitor_frees(mmp)) return EBUSY;
+    mmp->allocator = allocator;
+    return 0;
+}
+
+void
+mem_monitor_destroy (mem_monitor_t *mmp)
+{
+    if (mmp->shards) free(mmp->shards);
+    mmp->shards = NULL;
+    mmp->mode = MEM_MONITOR_UNSYNCHRONIZED;
+}
+
+/*
+ * sum of the counts at 'offset' in all the shards, or
+ * in the mem monitor itself if it is not sharded
+ */
+static unsigned long long
+mem_monitor_sum (mem_monitor_t *mmp, int offset)
+{
+    unsigned long long sum = 0;
+    int i;
+
+    if (mmp->mode != MEM_MONITOR_SHARDED) {
+        return *((volatile unsigned long long*) (((byte*) mmp) + offset));
+    }
+    for (i = 0; i <= MEM_MONITOR_MAX_THREADS; i++) {
+        sum += *((volatile unsigned long long*)
+                    (((byte*) &mmp->shards[i]) + offset));
+    }
+    return sum;
+}
+
+/* the counts are at the same offsets in both the shard & the monitor */
+unsigned long long
+mem_monitor_bytes_used (mem_monitor_t *mmp)
+{
+    return
+        mem_monitor_sum(mmp, offsetof(mem_monitor_shard_t, bytes_used));
+}
+
+unsigned long long
+mem_monitor_allocations (mem_monitor_t *mmp)
+{
+    return
+        mem_monitor_sum(mmp, offsetof(mem_monitor_shard_t, allocations));
+}
+
+unsigned long long
+mem_monitor_frees (mem_monitor_t *mmp)
+{
+    return
+        mem_monitor_sum(mmp, offsetof(mem_monitor_shard_t, frees));
+}
+
+/******************************************************************************
+ *
+ * Allocation & freeing.
+ */
+
+static inline void *
+block_allocate (mem_monitor_t *mmp, int size)
+{
+    if (mmp && mmp->allocator) {
+        return
+            mmp->allocator->allocate(mmp->allocator->context, size);
+    }
+    return malloc(size);
+}
+
+static inline void
+block_free (mem_monitor_t *mmp, void *block, int size)
+{
+    if (mmp && mmp->allocator) {
+        mmp->allocator->free(mmp->allocator->context, block, size);
+    } else {
+        free(block);
+    }
+}
+
+static void *
+block_reallocate (mem_monitor_t *mmp, void *block, int old_size,
+    int new_size)
+{
+    mem_allocator_t *allocator = mmp ? mmp->allocator : NULL;
+    void *new_block;
+
+    if (NULL == allocator) return realloc(block, new_size);
+    if (allocator->reallocate) {
+        return
+            allocator->reallocate(allocator->context, block,
+                old_size, new_size);
+    }
+    new_block = allocator->allocate(allocator->context, new_size);
+    if (new_block) {
+        memcpy(new_block, block, old_size < new_size ? old_size : new_size);
+        allocator->free(allocator->context, block, old_size);
+    }
+    return new_block;
+}
+
+/******************************************************************************
+ *
+ * Allocation site profiling.
+ */
+
+#define MEM_PROFILE_HASH_SIZE           (2 * MEM_PROFILE_MAX_SITES)
+
+struct mem_profile_s {
+
+    volatile int mtx;
+
+    /*
+     * Tags are (epoch << 16) | (site index + 1) so that blocks tagged
+     * by an earlier profile of the same mem monitor are not mistaken
+     * for blocks of this one.
+     */
+    int epoch;
+
+    int n_sites;
+    mem_profile_site_t sites [MEM_PROFILE_MAX_SITES];
+
+    /* site index + 1 or 0 if empty, open addressing */
+    int hash [MEM_PROFILE_HASH_SIZE];
+
+    /* live blocks by size class of their (user) size */
+    unsigned long long class_live_blocks [MEM_PROFILE_SIZE_CLASSES];
+    unsigned long long class_live_bytes [MEM_PROFILE_SIZE_CLASSES];
+
+    /* allocations which could not be tagged (all sites used up) */
+    unsigned long long untagged_allocations;
+};
+
+static volatile unsigned int profile_epochs = 0;
+
+static inline void
+profile_lock (mem_profile_t *profile)
+{
+    while (__sync_lock_test_and_set(&profile->mtx, 1)) sched_yield();
+}
+
+static inline void
+profile_unlock (mem_profile_t *profile)
+{
+    __sync_lock_release(&profile->mtx);
+}
+
+/* class c holds sizes from 2^(c-1) up to 2^c - 1 */
+static inline int
+size_class (int size)
+{
+    int c = size > 0 ? 32 - __builtin_clz((unsigned int) size) : 0;
+
+    return c < MEM_PROFILE_SIZE_CLASSES ? c : MEM_PROFILE_SIZE_CLASSES - 1;
+}
+
+static inline mem_profile_site_t *
+profile_site_of_tag (mem_profile_t *profile, int tag)
+{
+    int index = (tag & 0xFFFF) - 1;
+
+    if ((0 == tag) || ((tag >> 16) != profile->epoch) ||
+        (index >= profile->n_sites))
+            return NULL;
+    return &profile->sites[index];
+}
+
+/*
+ * Finds (or creates) the site & adds a block of 'size' bytes to it.
+ * Returns the tag of the site or 0 if there is no more room for it.
+ */
+static int
+profile_block_add (mem_profile_t *profile,
+    const char *file, int line, void *caller, int size)
+{
+    unsigned long long h;
+    mem_profile_site_t *site = NULL;
+    int slot, index, tag = 0;
+
+    h = (((unsigned long long) (uintptr_t) file) ^
+         ((unsigned long long) (uintptr_t) caller)) * 31 + line;
+    h ^= h >> 17;
+    profile_lock(profile);
+    for (slot = h % MEM_PROFILE_HASH_SIZE; profile->hash[slot];
+         slot = (slot + 1) % MEM_PROFILE_HASH_SIZE) {
+            index = profile->hash[slot] - 1;
+            if ((profile->sites[index].line == line) &&
+                (profile->sites[index].file == file) &&
+                (profile->sites[index].caller == caller)) {
+                    site = &profile->sites[index];
+                    break;
+            }
+    }
+    if ((NULL == site) && (profile->n_sites < MEM_PROFILE_MAX_SITES)) {
+        index = profile->n_sites++;
+        profile->hash[slot] = index + 1;
+        site = &profile->sites[index];
+        site->file = file;
+        site->line = line;
+        site->caller = caller;
+    }
+    if (site) {
+        site->live_bytes += size;
+        site->live_blocks++;
+        site->allocations++;
+        site->allocated_bytes += size;
+        profile->class_live_blocks[size_class(size)]++;
+        profile->class_live_bytes[size_class(size)] += size;
+        tag = (profile->epoch << 16) | ((site - profile->sites) + 1);
+    } else {
+        profile->untagged_allocations++;
+    }
+    profile_unlock(profile);
+
+    return tag;
+}
+
+/* a block of 'old_size' bytes is now 'new_size', 0 if freed */
+static void
+profile_block_resize (mem_profile_t *profile, int tag,
+    int old_size, int new_size)
+{
+    mem_profile_site_t *site;
+
+    profile_lock(profile);
+    site = profile_site_of_tag(profile, tag);
+    if (site) {
+        site->live_bytes += (long long) new_size - old_size;
+        profile->class_live_blocks[size_class(old_size)]--;
+        profile->class_live_bytes[size_class(old_size)] -= old_size;
+        if (new_size) {
+            profile->class_live_blocks[size_class(new_size)]++;
+            profile->class_live_bytes[size_class(new_size)] += new_size;
+        } else {
+            site->live_blocks--;
+        }
+    }
+    profile_unlock(profile);
+}
+
+int
+mem_monitor_profiling_start (mem_monitor_t *mmp)
+{
+    mem_profile_t *profile;
+
+    if (mmp->profile) return EBUSY;
+    profile = calloc(1, sizeof(mem_profile_t));
+    if (NULL == profile) return ENOMEM;
+    /* 1 to 0x7FFF, so that the epoch shifted into a tag stays positive */
+    profile->epoch = (__sync_add_and_fetch(&profile_epochs, 1) % 0x7FFF) + 1;
+    mmp->profile = profile;
+
+    return 0;
+}
+
+void
+mem_monitor_profiling_stop (mem_monitor_t *mmp)
+{
+    free(mmp->profile);
+    mmp->profile = NULL;
+}
+
+static int
+compare_live_bytes (const void *v1, const void *v2)
+{
+    const mem_profile_site_t *s1 = v1;
+    const mem_profile_site_t *s2 = v2;
+
+    if (s1->live_bytes != s2->live_bytes)
+        return s1->live_bytes < s2->live_bytes ? 1 : -1;
+    if (s1->allocated_bytes != s2->allocated_bytes)
+        return s1->allocated_bytes < s2->allocated_bytes ? 1 : -1;
+    return 0;
+}
+
+/* copies all the sites sorted, the caller must free them */
+static mem_profile_site_t *
+profile_sites_sorted (mem_profile_t *profile, int *count)
+{
+    mem_profile_site_t *sites;
+
+    profile_lock(profile);
+    *count = profile->n_sites;
+    sites = malloc((*count + 1) * sizeof(mem_profile_site_t));
+    if (sites) {
+        memcpy(sites, profile->sites, *count * sizeof(mem_profile_site_t));
+    }
+    profile_unlock(profile);
+    if (sites) qsort(sites, *count, sizeof(mem_profile_site_t),
+        compare_live_bytes);
+
+    return sites;
+}
+
+int
+mem_monitor_profile_sites (mem_monitor_t *mmp,
+    mem_profile_site_t *sites, int max)
+{
+    mem_profile_site_t *all;
+    int count;
+
+    if ((NULL == mmp->profile) || (max <= 0)) return 0;
+    all = profile_sites_sorted(mmp->profile, &count);
+    if (NULL == all) return 0;
+    if (count > max) count = max;
+    memcpy(sites, all, count * sizeof(mem_profile_site_t));
+    free(all);
+
+    return count;
+}
+
+int
+mem_monitor_profile_report (mem_monitor_t *mmp,
+    ez_sprintf_t *ezsp, int top_n)
+{
+    mem_profile_t *profile = mmp->profile;
+    mem_profile_site_t *sites;
+    unsigned long long blocks = 0, bytes = 0;
+    int i, count, rv = 0;
+
+    if (NULL == profile) {
+        return
+            ez_sprintf_append(ezsp, "mem monitor is not being profiled\n");
+    }
+    sites = profile_sites_sorted(profile, &count);
+    if (NULL == sites) return ENOMEM;
+
+    for (i = 0; i < count; i++) {
+        blocks += sites[i].live_blocks;
+        bytes += sites[i].live_bytes;
+    }
+    rv |= ez_sprintf_append(ezsp,
+        "%llu bytes live in %llu blocks (+%llu bytes of headers) "
+        "from %d sites, %llu allocations not profiled\n",
+        bytes, blocks, blocks * sizeof(mem_header_t), count,
+        profile->untagged_allocations);
+    rv |= ez_sprintf_append(ezsp, "%16s %12s %12s %16s  %s\n",
+        "live bytes", "live blocks", "allocations", "allocated bytes",
+        "site");
+    for (i = 0; (i < count) && (i < top_n); i++) {
+        rv |= ez_sprintf_append(ezsp, "%16llu %12llu %12llu %16llu  ",
+            sites[i].live_bytes, sites[i].live_blocks,
+            sites[i].allocations, sites[i].allocated_bytes);
+        if (sites[i].file) {
+            rv |= ez_sprintf_append(ezsp, "%s(%d)\n",
+                sites[i].file, sites[i].line);
+        } else {
+            rv |= ez_sprintf_append(ezsp, "%p\n", sites[i].caller);
+        }
+    }
+    free(sites);
+
+    rv |= ez_sprintf_append(ezsp, "live blocks by size:\n%16s %12s %16s\n",
+        "size up to", "live blocks", "live bytes");
+    profile_lock(profile);
+    for (i = 0; i < MEM_PROFILE_SIZE_CLASSES; i++) {
+        if (0 == profile->class_live_blocks[i]) continue;
+        rv |= ez_sprintf_append(ezsp, "%16llu %12llu %16llu\n",
+            (1ULL << i) - 1, profile->class_live_blocks[i],
+            profile->class_live_bytes[i]);
+    }
+    profile_unlock(profile);
+
+    /* all errors are either ENOSPC or ENOMEM */
+    return rv ? (ezsp->growable ? ENOMEM : ENOSPC) : 0;
+}
+
+void
+mem_monitor_profile_dump (mem_monitor_t *mmp, FILE *fp, int top_n)
+{
+    ez_sprintf_t ezs;
+
+    if (ez_sprintf_init_growable(&ezs, 4096, 4, NULL)) return;
+    mem_monitor_profile_report(mmp, &ezs, top_n);
+    fputs(ezs.buffer, fp);
+    fflush(fp);
+    ez_sprintf_destroy(&ezs);
+}
+
+/******************************************************************************
+ *
+ * Allocation & freeing.
+ */
+
+#define USER_SIZE(total_size)   ((total_size) - (int) sizeof(mem_header_t))
+
 /*
  * An extra mem_header_t is inserted into the front
  * of all memory returrned to the user so we have all
  * the necessary information when the pointer gets freed.
  */
-void *
-mem_monitor_allocate (mem_monitor_t *mmp,
-        int size, bool initialize_to_zero)
+static inline void *
+allocate_engine (mem_monitor_t *mmp, int size, bool initialize_to_zero,
+    const char *file, int line, void *caller)
 {
     int total_size = size + sizeof(mem_header_t);
     mem_header_t *mhp;
     byte *block;
 
-    block = malloc(total_size);
+    block = block_allocate(mmp, total_size);
     if (block) {
         if (initialize_to_zero) memset(block, 0, total_size);
         mhp = (mem_header_t*) block;
         mhp->mmp = mmp;
         mhp->total_size = total_size;
+        mhp->site_tag = 0;
         if (mmp) {
-            mmp->bytes_used += total_size;
-            mmp->allocations++;
+            mem_monitor_account(mmp, total_size, 1, 0);
+            if (mmp->profile) {
+                mhp->site_tag =
+                    profile_block_add(mmp->profile, file, line, caller, size);
+            }
         }
         return &(mhp->data[0]);
     }
     return null;
 }
 
+void *
+mem_monitor_allocate (mem_monitor_t *mmp,
+        int size, bool initialize_to_zero)
+{
+    return
+        allocate_engine(mmp, size, initialize_to_zero,
+            NULL, 0, __builtin_return_address(0));
+}
+
+void *
+mem_monitor_allocate_site (mem_monitor_t *mmp, int size,
+    bool initialize_to_zero, const char *file, int line)
+{
+    return
+        allocate_engine(mmp, size, initialize_to_zero, file, line, NULL);
+}
+
 void
 mem_monitor_free (void *ptr)
 {
     mem_header_t *mhp;
+    mem_monitor_t *mmp;
 
     mhp = get_mem_header_ptr(ptr);
-    if (mhp->mmp) {
-        mhp->mmp->bytes_used -= mhp->total_size;
-        mhp->mmp->frees++;
+    mmp = mhp->mmp;
+    if (mmp) {
+        mem_monitor_account(mmp, - (long long) mhp->total_size, 0, 1);
+        if (mmp->profile && mhp->site_tag) {
+            profile_block_resize(mmp->profile, mhp->site_tag,
+                USER_SIZE(mhp->total_size), 0);
+        }
     }
-
-    free(mhp);
+    block_free(mmp, mhp, mhp->total_size);
 }
 
-void *
-mem_monitor_reallocate (mem_monitor_t *mmp,
-    void *ptr, int new_data_size,
-    bool initialize_to_zero)
+/*
+ * If 'initialize_to_zero' is set, only the newly added
+ * part of the memory (if it grew) is zeroed out.
+ * The block stays attributed to the site which allocated it.
+ */
+static void *
+reallocate_engine (mem_monitor_t *mmp,
+    void *ptr, int new_data_size, bool initialize_to_zero,
+    const char *file, int line, void *caller)
 {
     mem_header_t *mhp;
     int old_total_size, new_total_size;
-    byte *new_data;
+    byte *new_block;
 
     /* for a null pointer, this just becomes a new alloc */
     if (NULL == ptr) {
         return
-            mem_monitor_allocate(mmp, new_data_size, initialize_to_zero);
+            allocate_engine(mmp, new_data_size, initialize_to_zero,
+                file, line, caller);
     }
 
     /* record old stuff */
@@ -114,19 +644,46 @@ mem_monitor_reallocate (mem_monitor_t *mmp,
     new_total_size = new_data_size + sizeof(mem_header_t);
 
     /* get new memory */
-    new_data = realloc(mhp, new_total_size);
-    if (new_data) {
-        if (initialize_to_zero) memset(mhp, 0, new_total_size);
-        mmp->bytes_used -= old_total_size;
-        mmp->bytes_used += new_total_size;
-        mhp = (mem_header_t*) new_data;
-        mhp->mmp = mmp;
-        mhp->total_size = new_total_size;
-        return &(mhp->data[0]);
+    new_block = block_reallocate(mmp, mhp, old_total_size, new_total_size);
+
+    /* if realloc failed, nothing we can do, old memory is intact */
+    if (NULL == new_block) return null;
+
+    if (initialize_to_zero && (new_total_size > old_total_size)) {
+        memset(new_block + old_total_size, 0,
+            new_total_size - old_total_size);
+    }
+    mhp = (mem_header_t*) new_block;
+    mhp->total_size = new_total_size;
+    if (mmp) {
+        mem_monitor_account(mmp, new_total_size - old_total_size, 0, 0);
+        if (mmp->profile && mhp->site_tag) {
+            profile_block_resize(mmp->profile, mhp->site_tag,
+                USER_SIZE(old_total_size), new_data_size);
+        }
     }
 
-    /* if we are here, realloc failed, nothing we can do */
-    return null;
+    return &(mhp->data[0]);
+}
+
+void *
+mem_monitor_reallocate (mem_monitor_t *mmp,
+    void *ptr, int new_data_size,
+    bool initialize_to_zero)
+{
+    return
+        reallocate_engine(mmp, ptr, new_data_size, initialize_to_zero,
+            NULL, 0, __builtin_return_address(0));
+}
+
+void *
+mem_monitor_reallocate_site (mem_monitor_t *mmp,
+    void *ptr, int new_data_size, bool initialize_to_zero,
+    const char *file, int line)
+{
+    return
+        reallocate_engine(mmp, ptr, new_data_size, initialize_to_zero,
+            file, line, NULL);
 }
 
 #ifdef __cplusplus
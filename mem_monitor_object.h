@@ -30,14 +30,139 @@ extern "C" {
 #include <string.h>
 #include "common.h"
 
+/*
+ * How the counts of a mem monitor are kept up to date.
+ *
+ * MEM_MONITOR_UNSYNCHRONIZED is the default (a zeroed mem monitor) and
+ * the cheapest.  It is correct only if the mem monitor is never used
+ * by more than one thread at a time, which is the case for the private
+ * mem monitor of every object, since it is used under the object lock.
+ *
+ * A parent mem monitor shared by many objects, each used by different
+ * threads, must be either MEM_MONITOR_ATOMIC, where every count is
+ * updated atomically, or better MEM_MONITOR_SHARDED, where every thread
+ * counts into its own (cache line sized) shard with plain increments
+ * and the shards are only summed up when the counts are read.
+ * Threads beyond the first MEM_MONITOR_MAX_THREADS live threads all
+ * count atomically into one extra shard.
+ */
+#define MEM_MONITOR_UNSYNCHRONIZED          0
+#define MEM_MONITOR_ATOMIC                  1
+#define MEM_MONITOR_SHARDED                 2
+
+#define MEM_MONITOR_MAX_THREADS             64
+
+typedef struct mem_monitor_shard_s {
+
+    unsigned long long bytes_used;
+    unsigned long long allocations;
+    unsigned long long frees;
+
+    /* no two shards share a cache line */
+    unsigned long long padding [5];
+
+} mem_monitor_shard_t;
+
+/*
+ * Where a mem monitor gets its memory from.
+ *
+ * By default (a NULL allocator), it is malloc/realloc/free.  A mem
+ * monitor can instead be pointed at any other allocator, such as the
+ * pools & arenas in mem_allocators.h, and every object which uses it
+ * as its parent mem monitor will then allocate from there, without
+ * the object knowing anything about it.
+ *
+ * 'allocate' must return memory aligned to at least 8 bytes.  'free'
+ * & 'reallocate' are given the size the block was allocated (or last
+ * reallocated) with.  'reallocate' can be NULL, in which case a new
+ * block is allocated, the data copied & the old block freed.
+ *
+ * The allocator must be set before anything is allocated from the
+ * mem monitor and must stay valid until everything is freed.  It must
+ * also be thread safe if the mem monitor is used by many threads.
+ */
+typedef struct mem_allocator_s {
+
+    char *name;
+    void *context;
+
+    void *(*allocate)(void *context, int size);
+    void (*free)(void *context, void *block, int size);
+    void *(*reallocate)(void *context, void *block,
+        int old_size, int new_size);
+
+} mem_allocator_t;
+
+typedef struct mem_profile_s mem_profile_t;
+
 typedef struct mem_monitor_s {
 
+    /*
+     * Only valid as they are for the unsynchronized & atomic modes.
+     * Read them with the functions below, which work for all modes.
+     */
     unsigned long long bytes_used;
     unsigned long long allocations;
     unsigned long long frees;
 
+    int mode;
+
+    /* MEM_MONITOR_MAX_THREADS + 1 of them, only in the sharded mode */
+    mem_monitor_shard_t *shards;
+
+    /* NULL for malloc */
+    mem_allocator_t *allocator;
+
+    /* allocation site profile, NULL unless profiling */
+    mem_profile_t *profile;
+
 } mem_monitor_t;
 
+/*
+ * Initializes a mem monitor in one of the modes above.
+ * Only needed for modes other than the default.
+ * Returns 0, EINVAL or ENOMEM.
+ */
+extern int
+mem_monitor_init (mem_monitor_t *mmp, int mode);
+
+/*
+ * Points the mem monitor at an allocator, NULL for malloc.  Returns
+ * EBUSY if anything is currently allocated from the mem monitor.
+ */
+extern int
+mem_monitor_set_allocator (mem_monitor_t *mmp, mem_allocator_t *allocator);
+
+/*
+ * Accounts for memory which an object obtains by other means than the
+ * mem monitor (mmap for example) so that it still shows up in its
+ * memory usage.  A positive 'bytes' counts as an allocation, a
+ * negative one as a free.
+ */
+extern void
+mem_monitor_account_external (mem_monitor_t *mmp, long long bytes);
+
+/*
+ * Frees up what mem_monitor_init allocated.  The memory
+ * accounted for by the mem monitor is NOT freed.
+ */
+extern void
+mem_monitor_destroy (mem_monitor_t *mmp);
+
+/*
+ * Current counts.  In the atomic & sharded modes these are exact
+ * when no other thread is allocating or freeing at the same time,
+ * otherwise they may be off by those ongoing operations.
+ */
+extern unsigned long long
+mem_monitor_bytes_used (mem_monitor_t *mmp);
+
+extern unsigned long long
+mem_monitor_allocations (mem_monitor_t *mmp);
+
+extern unsigned long long
+mem_monitor_frees (mem_monitor_t *mmp);
+
 extern void *
 mem_monitor_allocate (mem_monitor_t *mmp, int size,
     bool initialize_to_zero);
@@ -49,6 +174,101 @@ mem_monitor_reallocate (mem_monitor_t *mmp,
 extern void
 mem_monitor_free (void *ptr);
 
+/*
+ * Same as above but the allocation is attributed to 'file' & 'line'
+ * when profiling.  The ones above attribute it to their caller's
+ * return address instead.
+ */
+extern void *
+mem_monitor_allocate_site (mem_monitor_t *mmp, int size,
+    bool initialize_to_zero, const char *file, int line);
+
+extern void *
+mem_monitor_reallocate_site (mem_monitor_t *mmp,
+    void *ptr, int newsize, bool initialize_to_zero,
+    const char *file, int line);
+
+/******************************************************************************
+ *
+ * Allocation site profiling.
+ *
+ * When profiling is started on a mem monitor, every block allocated
+ * from it is tagged (in the spare bytes of its hidden header, so
+ * blocks do not grow) with the site it was allocated from, and the
+ * live bytes & blocks of every site are kept up to date as blocks are
+ * reallocated & freed.  So at any time, it can be reported which sites
+ * (and therefore which objects) hold how much memory.  Live blocks are
+ * also kept by (power of 2) size class which, together with the per
+ * block header overhead, shows how fragmented the usage is.
+ *
+ * A site is the file & line of the MEM_MONITOR_ALLOC call if the code
+ * is compiled with -DMEM_MONITOR_PROFILING.  Otherwise, it is the return
+ * address of the function which called mem_monitor_allocate, which can
+ * be turned into a function & line with 'addr2line -f -e <program>'.
+ *
+ * When profiling is not started, the only cost is one extra test of
+ * the profile pointer for every allocation & free.  When it is, every
+ * allocation & free also takes a spin lock, so it is meant for finding
+ * out where the memory goes rather than for running all the time.
+ *
+ * Only blocks allocated after profiling started are profiled.
+ */
+
+/* how many distinct sites can be profiled in one mem monitor */
+#define MEM_PROFILE_MAX_SITES           4096
+
+/* size classes are powers of 2, up to 2^MEM_PROFILE_SIZE_CLASSES - 1 */
+#define MEM_PROFILE_SIZE_CLASSES        32
+
+typedef struct mem_profile_site_s {
+
+    const char *file;
+    int line;
+    void *caller;
+
+    /* currently allocated from this site */
+    unsigned long long live_bytes;
+    unsigned long long live_blocks;
+
+    /* ever allocated from this site since profiling started */
+    unsigned long long allocations;
+    unsigned long long allocated_bytes;
+
+} mem_profile_site_t;
+
+/*
+ * Starts profiling a mem monitor, returns 0, EBUSY if it already is
+ * or ENOMEM.  'stop' frees up the profile.  Neither may be called
+ * while the mem monitor is being used by another thread.
+ */
+extern int
+mem_monitor_profiling_start (mem_monitor_t *mmp);
+
+extern void
+mem_monitor_profiling_stop (mem_monitor_t *mmp);
+
+/*
+ * Copies up to 'max' sites, the ones with the most live bytes
+ * first, into 'sites' and returns how many were copied.
+ */
+extern int
+mem_monitor_profile_sites (mem_monitor_t *mmp,
+    mem_profile_site_t *sites, int max);
+
+/*
+ * Appends a report of the 'top_n' sites with the most live bytes
+ * and the live blocks per size class into 'ezsp'.  Returns 0 or the
+ * error of the ez_sprintf object (ENOSPC if it is not growable).
+ */
+struct ez_sprintf_s;
+extern int
+mem_monitor_profile_report (mem_monitor_t *mmp,
+    struct ez_sprintf_s *ezsp, int top_n);
+
+/* prints the same report */
+extern void
+mem_monitor_profile_dump (mem_monitor_t *mmp, FILE *fp, int top_n);
+
 #define MEM_MON_VARIABLES \
     mem_monitor_t mem_mon, *mem_mon_p
 
@@ -57,10 +277,36 @@ mem_monitor_free (void *ptr);
         objp->mem_mon.bytes_used = 0; \
         objp->mem_mon.allocations = 0; \
         objp->mem_mon.frees = 0; \
+        objp->mem_mon.mode = MEM_MONITOR_UNSYNCHRONIZED; \
+        objp->mem_mon.shards = NULL; \
+        objp->mem_mon.allocator = NULL; \
+        objp->mem_mon.profile = NULL; \
         objp->mem_mon_p = \
             parent_mem_monitor ? parent_mem_monitor : &objp->mem_mon; \
     } while (0)
 
+#ifdef MEM_MONITOR_PROFILING
+
+/* every allocation is attributed to the file & line it is made from */
+
+#define MEM_MONITOR_ALLOC(objp, size) \
+    mem_monitor_allocate_site(objp->mem_mon_p, size, false, \
+        __FILE__, __LINE__)
+
+#define MEM_MONITOR_ZALLOC(objp, size) \
+    mem_monitor_allocate_site(objp->mem_mon_p, size, true, \
+        __FILE__, __LINE__)
+
+#define MEM_MONITOR_REALLOC(objp, oldp, newsize) \
+    mem_monitor_reallocate_site(objp->mem_mon_p, oldp, newsize, false, \
+        __FILE__, __LINE__)
+
+#define MEM_MONITOR_ZREALLOC(objp, oldp, newsize) \
+    mem_monitor_reallocate_site(objp->mem_mon_p, oldp, newsize, true, \
+        __FILE__, __LINE__)
+
+#else /* !MEM_MONITOR_PROFILING */
+
 #define MEM_MONITOR_ALLOC(objp, size) \
     mem_monitor_allocate(objp->mem_mon_p, size, false)
 
@@ -73,13 +319,15 @@ mem_monitor_free (void *ptr);
 #define MEM_MONITOR_ZREALLOC(objp, oldp, newsize) \
     mem_monitor_reallocate(objp->mem_mon_p, oldp, newsize, true)
 
+#endif /* MEM_MONITOR_PROFILING */
+
 #define MEM_MONITOR_FREE(ptr) \
     if (ptr) mem_monitor_free(ptr)
 
 #define OBJECT_MEMORY_USAGE(objp, size_in_bytes, size_in_megabytes) \
     do { \
         size_in_bytes = ((unsigned long long int) (sizeof(*(objp)) + \
-            (objp)->mem_mon_p->bytes_used)); \
+            mem_monitor_bytes_used((objp)->mem_mon_p))); \
         size_in_megabytes = ((double) size_in_bytes / (double) (1024 * 1024)); \
     } while (0)
 
@@ -24,6 +24,14 @@
 *******************************************************************************
 ******************************************************************************/
 
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include "object_manager.h"
 
 #ifdef __cplusplus
@@ -45,15 +53,18 @@ debug_module_block_t om_debug = {
  *
  */
 
+/* no subtraction, since it overflows for far apart (such as INT_MIN) ids */
 static int
 compare_objects (void *o1, void *o2)
 {
-    int res;
+    object_t *obj1 = (object_t*) o1;
+    object_t *obj2 = (object_t*) o2;
 
-    res = ((object_t*) o1)->object_type - ((object_t*) o2)->object_type;
-    if (res) return res;
-    return 
-        ((object_t*) o1)->object_instance - ((object_t*) o2)->object_instance;
+    if (obj1->object_type != obj2->object_type)
+        return (obj1->object_type < obj2->object_type) ? -1 : 1;
+    if (obj1->object_instance != obj2->object_instance)
+        return (obj1->object_instance < obj2->object_instance) ? -1 : 1;
+    return 0;
 }
 
 static int
@@ -64,33 +75,277 @@ compare_attributes (void *aip1, void *aip2)
         ((attribute_t*) aip2)->attribute_id;
 }
 
-static inline object_t*
-get_object_pointer (object_manager_t *omp,
+/******************************************************************************
+ *
+ * lock free object lookup
+ *
+ */
+
+/*
+ * Freeing of whatever readers may still be looking at, once they cannot.
+ * If there is no memory to remember it, waits till then instead.
+ */
+static void
+om_retire (object_manager_t *omp, void *data,
+    destruction_handler_t dh_fptr, void *extra_arg)
+{
+    if (epoch_retire(&omp->epochs, data, dh_fptr, extra_arg)) {
+        epoch_synchronize(&omp->epochs);
+        dh_fptr(data, extra_arg);
+    }
+}
+
+/* a removed object is freed with its lookup node */
+static void
+object_free (void *obj, void *node)
+{
+    MEM_MONITOR_FREE(node);
+    MEM_MONITOR_FREE(obj);
+}
+
+static om_lookup_table_t *
+lookup_table_create (object_manager_t *omp, int n_buckets)
+{
+    om_lookup_table_t *table;
+
+    table = MEM_MONITOR_ZALLOC(omp, sizeof(om_lookup_table_t) +
+                (n_buckets * sizeof(om_lookup_node_t*)));
+    if (table) table->n_buckets = n_buckets;
+    return table;
+}
+
+/* frees a table & all its nodes but not the objects they point to */
+static void
+lookup_table_free (void *data, void *extra_arg)
+{
+    om_lookup_table_t *table = (om_lookup_table_t*) data;
+    om_lookup_node_t *node, *next;
+    int b;
+
+    for (b = 0; b < table->n_buckets; b++) {
+        for (node = table->buckets[b]; node; node = next) {
+            next = node->next;
+            MEM_MONITOR_FREE(node);
+        }
+    }
+    MEM_MONITOR_FREE(table);
+}
+
+static inline om_lookup_node_t * volatile *
+lookup_bucket (om_lookup_table_t *table,
     int object_type, int object_instance)
 {
-    object_t searched;
-    void *found;
+    unsigned long long int key;
 
-    searched.object_type = object_type;
-    searched.object_instance = object_instance;
-    if (0 == avl_tree_search(&omp->om_objects, &searched, &found)) {
-        return found;
+    key = ((unsigned long long int) ((unsigned int) object_type) << 32) |
+            (unsigned int) object_instance;
+    key *= 0x9E3779B97F4A7C15ULL;
+    return &table->buckets[(key >> 32) & (table->n_buckets - 1)];
+}
+
+/*
+ * Must be called either inside an epoch or with the lock held.
+ * The object found stays valid till the epoch is left.
+ */
+static inline object_t *
+lookup_find (object_manager_t *omp,
+    int object_type, int object_instance)
+{
+    om_lookup_table_t *table;
+    om_lookup_node_t *node;
+
+    table = __atomic_load_n(&omp->lookup, __ATOMIC_ACQUIRE);
+    node = __atomic_load_n(lookup_bucket(table, object_type, object_instance),
+                __ATOMIC_ACQUIRE);
+    while (node) {
+        if ((node->object_type == object_type) &&
+            (node->object_instance == object_instance)) {
+                return node->object;
+        }
+        node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    }
+    return NULL;
+}
+
+static om_lookup_node_t *
+lookup_node_create (object_manager_t *omp, object_t *obj)
+{
+    om_lookup_node_t *node;
+
+    node = MEM_MONITOR_ALLOC(omp, sizeof(om_lookup_node_t));
+    if (node) {
+        node->object_type = obj->object_type;
+        node->object_instance = obj->object_instance;
+        node->object = obj;
+    }
+    return node;
+}
+
+/*
+ * The bigger table is built aside & published in one store, readers
+ * still in the old one can finish there since it is freed later.
+ * If it cannot be built, chains simply get longer.
+ */
+static void
+lookup_grow (object_manager_t *omp)
+{
+    om_lookup_table_t *old = omp->lookup, *table;
+    om_lookup_node_t *node, *copy, * volatile *bucket;
+    int b;
+
+    table = lookup_table_create(omp, old->n_buckets * 2);
+    if (NULL == table) return;
+    for (b = 0; b < old->n_buckets; b++) {
+        for (node = old->buckets[b]; node; node = node->next) {
+            copy = lookup_node_create(omp, node->object);
+            if (NULL == copy) {
+                lookup_table_free(table, NULL);
+                return;
+            }
+            bucket = lookup_bucket(table,
+                        node->object_type, node->object_instance);
+            copy->next = *bucket;
+            *bucket = copy;
+        }
+    }
+    __atomic_store_n(&omp->lookup, table, __ATOMIC_RELEASE);
+    om_retire(omp, old, lookup_table_free, NULL);
+
+    /*
+     * old tables are big, free it now rather than leave it to whoever
+     * retires something next, which would pay for all of this growth
+     */
+    epoch_synchronize(&omp->epochs);
+}
+
+/* the object must be complete, readers may find it right away */
+static int
+lookup_insert (object_manager_t *omp, object_t *obj)
+{
+    om_lookup_node_t *node, * volatile *bucket;
+
+    if (omp->om_objects.n > (2 * omp->lookup->n_buckets)) lookup_grow(omp);
+    node = lookup_node_create(omp, obj);
+    if (NULL == node) return ENOMEM;
+    bucket = lookup_bucket(omp->lookup,
+                obj->object_type, obj->object_instance);
+    node->next = *bucket;
+    __atomic_store_n(bucket, node, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * Unlinks the node of the object, which is returned to be freed
+ * later.  Readers on the node can still move on from it.
+ */
+static om_lookup_node_t *
+lookup_remove (object_manager_t *omp, object_t *obj)
+{
+    om_lookup_node_t *node, * volatile *link;
+
+    link = lookup_bucket(omp->lookup, obj->object_type, obj->object_instance);
+    while ((node = *link)) {
+        if (node->object == obj) {
+            __atomic_store_n(link, node->next, __ATOMIC_RELEASE);
+            return node;
+        }
+        link = &node->next;
     }
     return NULL;
 }
 
+/*
+ * Writers bracket every change to the attributes of an object with
+ * these, so lock free readers can tell if they read a changing value.
+ */
+static inline void
+attribute_change_begin (object_t *obj)
+{
+    obj->attribute_sequence++;
+
+    /* odd sequence must be visible before any of the changes */
+    __sync_synchronize();
+}
+
+static inline void
+attribute_change_end (object_t *obj)
+{
+    __atomic_store_n(&obj->attribute_sequence,
+        obj->attribute_sequence + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Copies the value of an inlined attribute without any lock, retrying
+ * if it changes meanwhile.  Must be called inside an epoch.  Returns
+ * ENODATA if the object does not have the attribute & EAGAIN if it
+ * may only be found under the lock, since it may not be inlined.
+ */
+static int
+inline_attribute_read (object_t *obj, int attribute_id,
+    int *length, byte *value)
+{
+    inline_attribute_t *iap;
+    unsigned int sequence;
+    int i, n, rc;
+
+    while (1) {
+        sequence = __atomic_load_n(&obj->attribute_sequence,
+                        __ATOMIC_ACQUIRE);
+        if (sequence & 1) {
+            sched_yield();
+            continue;
+        }
+
+        /* what is read may be torn, so never trust it for bounds */
+        rc = obj->attributes.elements ? EAGAIN : ENODATA;
+        n = obj->n_inline_attributes;
+        if (n > OM_INLINE_ATTRIBUTES) n = OM_INLINE_ATTRIBUTES;
+        for (i = 0; i < n; i++) {
+            iap = &obj->inline_attributes[i];
+            if (iap->attribute_id != attribute_id) continue;
+            *length = iap->attribute_value_length;
+            if ((*length < 0) || (*length > OM_INLINE_VALUE_SIZE))
+                *length = 0;
+            memcpy(value, &iap->attribute_value_data [0], *length);
+            rc = 0;
+            break;
+        }
+
+        /* all of the reads must be done before checking again */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (sequence == obj->attribute_sequence) return rc;
+    }
+}
+
+/******************************************************************************
+ *
+ * general support functions, continued
+ *
+ */
+
+/* called with the lock held, so it can use the lock free lookup */
+static inline object_t*
+get_object_pointer (object_manager_t *omp,
+    int object_type, int object_instance)
+{
+    return
+        lookup_find(omp, object_type, object_instance);
+}
+
 static inline object_t*
 get_parent_pointer (object_t *obj)
 {
-    if (obj->parent.is_pointer) {
-        return
-            obj->parent.u.object_ptr;
-    }
+    object_t *parent;
+
+    /* parent may have been removed (& even created again) */
+    parent = handle_resolve(&obj->omp->object_handles,
+                obj->parent.object_handle);
+    if (parent) return parent;
         
     return
         get_object_pointer(obj->omp,
-            obj->parent.u.object_id.object_type,
-            obj->parent.u.object_id.object_instance);
+            obj->parent.object_id.object_type,
+            obj->parent.object_id.object_instance);
 }
 
 static attribute_t*
@@ -99,6 +354,8 @@ get_attribute_pointer (object_t *obj, int attribute_id, int *index)
     void *found;
     attribute_t searched;
 
+    /* index is not created till an attribute cannot be inlined */
+    if (NULL == obj->attributes.elements) return NULL;
     searched.attribute_id = attribute_id;
     if (index_obj_search(&obj->attributes, &searched, &found, index) == 0) {
         return found;
@@ -107,6 +364,18 @@ get_attribute_pointer (object_t *obj, int attribute_id, int *index)
     return NULL;
 }
 
+static inline_attribute_t*
+get_inline_attribute_pointer (object_t *obj, int attribute_id)
+{
+    int i;
+
+    for (i = 0; i < obj->n_inline_attributes; i++) {
+        if (obj->inline_attributes[i].attribute_id == attribute_id)
+            return &obj->inline_attributes[i];
+    }
+    return NULL;
+}
+
 static void
 attribute_free (void *ap, void *extra_arg)
 {
@@ -156,22 +425,100 @@ attribute_storage_create (object_manager_t *omp,
     return ap;
 }
 
+static void
+inline_attribute_set (inline_attribute_t *iap,
+    int attribute_id,
+    int attribute_length, byte *attribute_value)
+{
+    iap->attribute_id = attribute_id;
+    iap->attribute_value_length = attribute_length;
+    if (attribute_length > 0) {
+        bcopy(attribute_value, &iap->attribute_value_data [0],
+            attribute_length);
+    }
+}
+
+/*
+ * order of the inlined attributes does not matter,
+ * so the last one simply fills the gap
+ */
+static void
+inline_attribute_remove (object_t *obj, inline_attribute_t *iap)
+{
+    *iap = obj->inline_attributes[--obj->n_inline_attributes];
+}
+
+/*
+ * finds the value of an attribute wherever it is stored,
+ * returns false if the object does not have the attribute
+ */
+static boolean
+attribute_value_find (object_t *obj, int attribute_id,
+    int *length, byte **value)
+{
+    inline_attribute_t *iap;
+    attribute_t *ap;
+
+    iap = get_inline_attribute_pointer(obj, attribute_id);
+    if (iap) {
+        *length = iap->attribute_value_length;
+        *value = &iap->attribute_value_data [0];
+        return TRUE;
+    }
+    ap = get_attribute_pointer(obj, attribute_id, NULL);
+    if (ap) {
+        *length = ap->attribute_value_length;
+        *value = &ap->attribute_value_data [0];
+        return TRUE;
+    }
+    return FALSE;
+}
+
 /*
- * This function expects a >= 0 attribute_length and an appropriate
- * attribute_value pointer if the length is > 0.
+ * Stores the value of an attribute, without regard to any secondary
+ * indexes.  This function expects a >= 0 attribute_length and an
+ * appropriate attribute_value pointer if the length is > 0.
  */
 static int
-attribute_add_engine (object_manager_t *omp, object_t *obj,
+attribute_store_engine (object_manager_t *omp, object_t *obj,
     int attribute_id,
     int attribute_length, byte *attribute_value)
 {
     attribute_t *ap, *ap_new;
+    inline_attribute_t *iap;
     int rc, index;
 
     /* if the length is > 0, the data pointer can NOT be NULL */
     assert(attribute_length >= 0);
     if (attribute_length > 0) assert(attribute_value);
 
+    /*
+     * small values stay in (or go into) the object itself, as long as
+     * the attribute is not in the index already & there is room
+     */
+    iap = get_inline_attribute_pointer(obj, attribute_id);
+    if (attribute_length <= OM_INLINE_VALUE_SIZE) {
+        if (iap) {
+            inline_attribute_set(iap, attribute_id,
+                attribute_length, attribute_value);
+            return 0;
+        }
+        if ((obj->n_inline_attributes < OM_INLINE_ATTRIBUTES) &&
+            (NULL == get_attribute_pointer(obj, attribute_id, NULL))) {
+                inline_attribute_set(
+                    &obj->inline_attributes[obj->n_inline_attributes++],
+                    attribute_id, attribute_length, attribute_value);
+                return 0;
+        }
+    }
+
+    /* first attribute which could not be inlined creates the index */
+    if (NULL == obj->attributes.elements) {
+        rc = index_obj_init(&obj->attributes, FALSE, FALSE,
+                compare_attributes, 8, 8, omp->mem_mon_p);
+        if (rc) return rc;
+    }
+
     /*
      * In case we need to change the VALUE of the attribute later,
      * we stash away the index so we can directly change the pointer
@@ -202,6 +549,9 @@ attribute_add_engine (object_manager_t *omp, object_t *obj,
             return rc;
         }
 
+        /* if it was inlined before, it has grown too big for it */
+        if (iap) inline_attribute_remove(obj, iap);
+
         return 0;
     }
 
@@ -249,14 +599,20 @@ attribute_add_engine (object_manager_t *omp, object_t *obj,
 }
 
 static int
-obj_attribute_remove (object_t *obj, int attribute_id)
+attribute_delete_engine (object_t *obj, int attribute_id)
 {
     int rc;
     attribute_t *ap;
+    inline_attribute_t *iap;
 
+    iap = get_inline_attribute_pointer(obj, attribute_id);
+    if (iap) {
+        inline_attribute_remove(obj, iap);
+        return 0;
+    }
     ap = get_attribute_pointer(obj, attribute_id, NULL);
     if (ap) {
-        rc = index_obj_remove(&obj->attributes, ap, NULL);
+        rc = index_obj_remove(&obj->attributes, ap, NULL, 0);
         MEM_MONITOR_FREE(ap);
     } else {
         rc = ENODATA;
@@ -264,277 +620,755 @@ obj_attribute_remove (object_t *obj, int attribute_id)
     return rc;
 }
 
-/*
- * get object type and object instance values of an object.
+/******************************************************************************
+ *
+ * secondary attribute value indexes
+ *
  */
-static inline void
-get_ot_and_oi (object_representation_t *reprp,
-        int *otp, int *oip)
+
+typedef struct om_index_entry_s {
+    long long int value;
+    int object_instance;
+} om_index_entry_t;
+
+static int
+compare_index_entries (void *e1, void *e2)
 {
-    *otp = *oip = -1;
-    if (NULL == reprp) return;
-    if (reprp->is_pointer) {
-        *otp = reprp->u.object_ptr->object_type;
-        *oip = reprp->u.object_ptr->object_instance;
-    } else {
-        *otp = reprp->u.object_id.object_type;
-        *oip = reprp->u.object_id.object_instance;
-    }
+    om_index_entry_t *entry1 = (om_index_entry_t*) e1;
+    om_index_entry_t *entry2 = (om_index_entry_t*) e2;
+
+    if (entry1->value != entry2->value)
+        return (entry1->value < entry2->value) ? -1 : 1;
+    if (entry1->object_instance != entry2->object_instance)
+        return (entry1->object_instance < entry2->object_instance) ? -1 : 1;
+    return 0;
 }
 
-#if 0
 /*
- * This function traverses all children of 'root' recursively all
- * the way to the last children.  Note however that it does not use
- * actual recursion to do it, since in very deep trees, it would run
- * out of stack.  It does it in an iterative way.  It therefore does
- * not need any extra memory.
- *
- * Note that the traversal of root is EXCLUDED.  Only its children
- * are traversed (not the mother).
- *
- * Note that the 'current' value of the indexes must be all at 0 when
- * starting the traversal and must end with value 0 when the traversal
- * ends, so that they are ready for the next traversal.  Therefore, the
- * traversal continues till the very end, even though user function
- * may no longer be called due to an error it may have returned.
- *
- * Function return value is the first ever error value returned by the
- * user function while traversing the tree.
+ * only integer values are indexed, returns false if the value
+ * is not one of the integer sizes
  */
-static int
-object_children_traverse (object_manager_t *omp, object_t *root,
-        traverse_function_pointer tfn,
-        void *p0, void *p1, void *p2, void *p3, void *p4)
+static boolean
+attribute_integer_value (int length, byte *value, long long int *result)
 {
-    index_obj_t *idxp;
-    object_t *obj;
-    int failed = 0;
+    switch (length) {
+    case 1: *result = *((signed char*) value); return TRUE;
+    case 2: *result = *((short*) value); return TRUE;
+    case 4: *result = *((int*) value); return TRUE;
+    case 8: *result = *((long long int*) value); return TRUE;
+    }
+    return FALSE;
+}
 
-    if (NULL == root) return 0;
+static om_attribute_index_t *
+attribute_index_get (object_manager_t *omp,
+    int object_type, int attribute_id)
+{
+    om_attribute_index_t *aidx;
 
-    /*
-     * make sure that the user supplied traversal function
-     * cannot change anything in this object manager while
-     * the traversal is taking place.
-     */
-    omp->busy = TRUE;
+    for (aidx = omp->attribute_indexes; aidx; aidx = aidx->next) {
+        if ((aidx->object_type == object_type) &&
+            (aidx->attribute_id == attribute_id))
+                return aidx;
+    }
+    return NULL;
+}
 
-    obj = root;
-    idxp = &obj->children;
-    while (TRUE) {
+/*
+ * current integer value of the attribute of the
+ * object, false if it does not have an integer one
+ */
+static boolean
+attribute_indexed_value (object_t *obj, int attribute_id,
+    long long int *value)
+{
+    byte *data;
+    int length;
 
-        /* we apply the user function the very first time we enter it */
-        if ((0 == idxp->current) && (0 == failed) && (obj != root)) {
-            failed = tfn(omp, obj, p0, p1, p2, p3, p4);
-        }
+    return
+        attribute_value_find(obj, attribute_id, &length, &data) &&
+        attribute_integer_value(length, data, value);
+}
 
-        /* if it has any remaining children go down to it */
-        if (idxp->current < idxp->n) {
+static int
+attribute_index_insert (om_attribute_index_t *aidx,
+    int object_instance, long long int value)
+{
+    om_index_entry_t *entry;
+    void *exists;
+    int rc;
 
-            obj = idxp->elements[idxp->current++];
-            idxp = &obj->children;
+    entry = MEM_MONITOR_ALLOC((&aidx->entries), sizeof(om_index_entry_t));
+    if (NULL == entry) return ENOMEM;
+    entry->value = value;
+    entry->object_instance = object_instance;
+    rc = avl_tree_insert(&aidx->entries, entry, &exists, FALSE);
+    if (rc || exists) MEM_MONITOR_FREE(entry);
+    return rc;
+}
 
-            /* MUST do this here on first entry into the object */
-            idxp->current = 0;
+static void
+attribute_index_remove (om_attribute_index_t *aidx,
+    int object_instance, long long int value)
+{
+    om_index_entry_t searched;
+    void *removed;
 
-        /* all children of this object traversed, go back to the parent */
-        } else {
+    searched.value = value;
+    searched.object_instance = object_instance;
+    if (0 == avl_tree_remove(&aidx->entries, &searched, &removed)) {
+        MEM_MONITOR_FREE(removed);
+    }
+}
 
-            /* must also leave it clean as we move up back to the parent */
-            idxp->current = 0;
+static void
+index_entry_free (void *entry, void *extra_arg)
+{
+    MEM_MONITOR_FREE(entry);
+}
 
-            obj = get_parent_pointer(obj);
-            idxp = &obj->children;
+static void
+attribute_index_free (om_attribute_index_t *aidx)
+{
+    avl_tree_destroy(&aidx->entries, index_entry_free, NULL);
+    MEM_MONITOR_FREE(aidx);
+}
 
-            /* back at root and processed every child */
-            if ((obj == root) && (idxp->current >= idxp->n)) {
-                idxp->current = 0;
-                break;
-            }
+/*
+ * takes an object which is about to be removed
+ * out of all the indexes of its type
+ */
+static void
+attribute_indexes_forget_object (object_manager_t *omp, object_t *obj)
+{
+    om_attribute_index_t *aidx;
+    long long int value;
+
+    for (aidx = omp->attribute_indexes; aidx; aidx = aidx->next) {
+        if ((aidx->object_type == obj->object_type) &&
+            attribute_indexed_value(obj, aidx->attribute_id, &value)) {
+                attribute_index_remove(aidx, obj->object_instance, value);
         }
     }
-
-    /* ok traversal ended */
-    omp->busy = FALSE;
-
-    return failed;
 }
 
 /*
- * This function uses the same algorithm for traversing as above but 
- * for a very specific purpose of collecting all the children of an
- * object BUT EXCLUDING the root object itself.
- *
- * It returns all the child object pointers in a malloc'ed area to the
- * user, with the number returned in 'count'.  It expands itself using
- * realloc.  If realloc fails, then it will only return a subset of 
- * the children, as much as malloc'ed area allows.  Even if realloc
- * fails however, 'total' will always return how many total children
- * are below the object.  Basically, even if memory allocation fails,
- * the entire children will be traversed & counted, but cannot obviously 
- * all be passed up in a children pointer array.  Besides, since we MUST
- * clear the 'current' values on each children index object, we MUST
- * let the traversal finish completely, regardless of whether we were
- * able to store child object pointers along the way or not.
- *
- * 'enuf_memory' is set to false when malloc/realloc fails for the very
- * first time and after that, no attempt is made again to acquire any
- * memory any more, since once failed, it is very unlikely that immediately
- * consecutive requests will succeed.  First failure therefore is the
- * only & final failure.
- *
- * The caller is responsible for freeing this storage area returned
- * (Note that NULL may be returned, if also the initial malloc fails).
+ * first & last possible objects of a type,
+ * to range traverse the objects of only that type
  */
-static object_t **
-object_children_get (object_manager_t *omp, object_t *root,
-        int *count, int *total)
+static void
+object_type_bounds (int object_type, object_t *first, object_t *last)
 {
-    index_obj_t *idxp;
-    object_t *obj, **storage, **new;
-    int limit = 256;
-    bool enuf_memory = TRUE;
+    first->object_type = last->object_type = object_type;
+    first->object_instance = INT_MIN;
+    last->object_instance = INT_MAX;
+}
 
-    *count = *total = 0;
-    if (NULL == root) return NULL;
-    obj = root;
-    idxp = &obj->children;
-    storage = (object_t**) (malloc(limit * sizeof(object_t*)));
+static int
+index_object_tfn (void *utility_object, void *utility_node,
+    void *v_object, void *v_aidx,
+    void *p1, void *p2, void *p3)
+{
+    om_attribute_index_t *aidx = (om_attribute_index_t*) v_aidx;
+    object_t *obj = (object_t*) v_object;
+    long long int value;
 
-    /*
-     * we must traverse till the end, to find 'total' even
-     * if the memory allocation may have failed.
-     */
-    if (NULL == storage) {
-        ERROR(&om_debug, "malloc of %d pointers space failed\n", limit);
-        enuf_memory = FALSE;
+    if (attribute_indexed_value(obj, aidx->attribute_id, &value)) {
+        return
+            attribute_index_insert(aidx, obj->object_instance, value);
     }
+    return 0;
+}
 
-    while (TRUE) {
-
-        /* we want the children of the root, but EXCLUDING the root */
-        if ((0 == idxp->current) && (obj != root)) {
+/*
+ * state of an 'om_attribute_find' while the matching
+ * objects are collected into the user's array
+ */
+typedef struct om_find_state_s {
+    int object_type;
+    int attribute_id;
+    long long int low, high;
+    object_identifier_t *found;
+    int max_found;
+    int n_found;
+} om_find_state_t;
 
-            /* array limit reached, try & expand */
-            if ((*count >= limit) && enuf_memory) {
-                limit += 256;
-                new = (object_t**)
-                    realloc(storage, limit * sizeof(object_t*));
-                if (new) {
-                    storage = new;
-                } else {
-                    ERROR(&om_debug, "realloc of %d pointers space failed\n",
-                        limit);
-                    enuf_memory = FALSE;
-                }
-            }
+static void
+find_state_add (om_find_state_t *fsp, int object_instance)
+{
+    if (fsp->n_found < fsp->max_found) {
+        fsp->found[fsp->n_found].object_type = fsp->object_type;
+        fsp->found[fsp->n_found].object_instance = object_instance;
+    }
+    fsp->n_found++;
+}
 
-            /* as long as we have storage, record it and increment */
-            if (enuf_memory) {
-                storage[(*count)++] = obj;
-            }
+static int
+find_in_index_tfn (void *utility_object, void *utility_node,
+    void *v_entry, void *v_fsp,
+    void *p1, void *p2, void *p3)
+{
+    find_state_add((om_find_state_t*) v_fsp,
+        ((om_index_entry_t*) v_entry)->object_instance);
+    return 0;
+}
 
-            /* this is always incremented, counting total children */
-            (*total)++;
-        }
+static int
+find_in_objects_tfn (void *utility_object, void *utility_node,
+    void *v_object, void *v_fsp,
+    void *p1, void *p2, void *p3)
+{
+    om_find_state_t *fsp = (om_find_state_t*) v_fsp;
+    object_t *obj = (object_t*) v_object;
+    long long int value;
 
-        /* traverse down */
-        if (idxp->current < idxp->n) {
-            obj = idxp->elements[idxp->current++];
-            idxp = &obj->children;
-            idxp->current = 0;
-        /* all children of this object traversed, go back to the parent */
-        } else {
-            idxp->current = 0;
-            obj = get_parent_pointer(obj);
-            idxp = &obj->children;
-            if ((obj == root) && (idxp->current >= idxp->n)) {
-                idxp->current = 0;
-                break;
-            }
+    if (attribute_indexed_value(obj, fsp->attribute_id, &value) &&
+        (value >= fsp->low) && (value <= fsp->high)) {
+            find_state_add(fsp, obj->object_instance);
+    }
+    return 0;
+}
+
+/******************************************************************************
+ *
+ * object cursors
+ *
+ */
+
+static inline boolean
+object_in_cursor_range (om_cursor_t *cursor, object_t *obj)
+{
+    return
+        (obj->object_type == cursor->object_type) &&
+        (obj->object_instance >= cursor->low_instance) &&
+        (obj->object_instance <= cursor->high_instance);
+}
+
+static inline void
+object_identifier_copy (object_identifier_t *oid, object_t *obj)
+{
+    oid->object_type = obj->object_type;
+    oid->object_instance = obj->object_instance;
+}
+
+/*
+ * Adds or changes the value of an attribute, keeping
+ * the secondary index on it (if there is one) up to date.
+ */
+static int
+attribute_add_engine (object_manager_t *omp, object_t *obj,
+    int attribute_id,
+    int attribute_length, byte *attribute_value)
+{
+    om_attribute_index_t *aidx = NULL;
+    long long int old_value, new_value;
+    boolean was_indexed = FALSE;
+    int rc;
+
+    if (omp->attribute_indexes) {
+        aidx = attribute_index_get(omp, obj->object_type, attribute_id);
+        if (aidx) {
+            was_indexed =
+                attribute_indexed_value(obj, attribute_id, &old_value);
         }
     }
+    attribute_change_begin(obj);
+    rc = attribute_store_engine(omp, obj, attribute_id,
+            attribute_length, attribute_value);
+    attribute_change_end(obj);
+    if (rc || (NULL == aidx)) return rc;
+
+    if (was_indexed) {
+        attribute_index_remove(aidx, obj->object_instance, old_value);
+    }
+    if (attribute_integer_value(attribute_length, attribute_value,
+            &new_value)) {
+        rc = attribute_index_insert(aidx, obj->object_instance, new_value);
+    }
+    return rc;
+}
 
-    return storage;
+static int
+obj_attribute_remove (object_t *obj, int attribute_id)
+{
+    object_manager_t *omp = obj->omp;
+    om_attribute_index_t *aidx = NULL;
+    long long int value;
+    boolean was_indexed = FALSE;
+    int rc;
+
+    if (omp->attribute_indexes) {
+        aidx = attribute_index_get(omp, obj->object_type, attribute_id);
+        if (aidx) {
+            was_indexed = attribute_indexed_value(obj, attribute_id, &value);
+        }
+    }
+    attribute_change_begin(obj);
+    rc = attribute_delete_engine(obj, attribute_id);
+    attribute_change_end(obj);
+    if ((0 == rc) && was_indexed) {
+        attribute_index_remove(aidx, obj->object_instance, value);
+    }
+    return rc;
 }
-#endif
 
-#if 0
+/*
+ * get object type and object instance values of an object.
+ */
+static inline void
+get_ot_and_oi (object_representation_t *reprp,
+        int *otp, int *oip)
+{
+    *otp = *oip = -1;
+    if (NULL == reprp) return;
+    *otp = reprp->object_id.object_type;
+    *oip = reprp->object_id.object_instance;
+}
 
 /*
- * The 'leave_parent_consistent' is used for something very subtle.
- *
- * when we remove an object, we must leave the parent's
- * children in a consistent state.... except when we know
- * we are removing a whole bunch of sub children in a
- * big swoop. Since these objects will all be removed,
- * including the parent, we do not have to do the extra and 
- * useless effort of leaving their child/parent relationship 
- * consistent since we know the parent will also be eventually 
- * destroyed.
+ * This function traverses all children of 'root' recursively all
+ * the way to the last children.  Note however that it does not use
+ * actual recursion to do it, since in very deep trees, it would run
+ * out of stack.  It does it in an iterative way.  An object's own
+ * node in its parent's children ('child_handle') leads to its next
+ * sibling, and its parent handle back up, so it does not need any
+ * extra memory either and leaves nothing behind in the objects.
  *
- * Therefore ONLY the top object has to be kept consistent but 
- * all the children can simply be destroyed quickly.
+ * Note that the traversal of root is EXCLUDED.  Only its children
+ * are traversed (not the mother).
  *
- * This variable controls that.
+ * Function return value is the first ever error value returned by the
+ * user function, after which no more objects are traversed.
  */
-static void 
-om_object_remove_engine (object_t *obj,
-        boolean leave_parent_consistent,
-        boolean remove_all_children)
+static int
+object_children_traverse (object_manager_t *omp, object_t *root,
+        traverse_function_pointer tfn,
+        void *p0, void *p1, void *p2, void *p3, void *p4)
 {
-    void *removed_obj;
-    object_t **all_the_children;
-    object_manager_t *omp = obj->omp;
-    object_t *parent;
-    int child_count, total_children, i;
+    lifo_node_t *node;
+    object_t *obj, *child;
+    int failed;
 
-    /* take object out of the parent's children index if needed */
-    if (leave_parent_consistent) {
-        parent = get_parent_pointer(obj);
-        if (parent) {
-            index_obj_remove(&parent->children, obj, &removed_obj);
+    if (NULL == root) return 0;
+
+    /* 'node' always walks the children of 'obj' */
+    obj = root;
+    node = root->children.head;
+    while (TRUE) {
+
+        /* no more children here, carry on with the next sibling of 'obj' */
+        while (END_NODE(node)) {
+            if (obj == root) return 0;
+            node = obj->child_handle->next;
+            obj = get_parent_pointer(obj);
         }
+        child = (object_t*) node->data;
+        failed = tfn(omp, child, p0, p1, p2, p3, p4);
+        if (failed) return failed;
+
+        /* go down to its children first */
+        obj = child;
+        node = child->children.head;
     }
+    return 0;
+}
 
-    /* get rid of all children traversing iteratively */
-    if (remove_all_children) {
+/******************************************************************************
+ *
+ * Parallel traversal.
+ *
+ * Every thread goes depth first thru a private stack of objects whose
+ * children are yet to be traversed, which needs no locking at all.
+ * Other threads can only take work from its deque.  Whenever that
+ * deque is found empty, the thread moves the older half of its stack
+ * (the objects closest to the root, hence the biggest unexplored sub
+ * trees) into it.  A thread whose stack runs out first takes back
+ * whatever is left in its own deque, then steals half of the deque of
+ * another thread.
+ *
+ * 'pending' counts the objects pushed but not yet processed, so all
+ * threads are done when it drops to 0.  The children of an object are
+ * added to it in one go, but processed objects are only taken off it
+ * when the thread runs out of work.  It can only be too high meanwhile,
+ * never too low, so nobody stops early.
+ */
 
-        /* collect all children from every sub level into an array */
-        all_the_children = object_children_get(omp, obj,
-                &child_count, &total_children);
-        if (child_count != total_children) {
-            ERROR(&om_debug, "could only get %d children of %d "
-                " for object (%d, %d)\n",
-                child_count, total_children,
-                obj->object_type, obj->object_instance);
+typedef struct om_work_deque_s {
+    volatile int mtx;
+    object_t **objects;
+    int size;
+
+    /* looked at by thieves & the owner without the lock */
+    volatile int top, bottom;
+} om_work_deque_t;
+
+typedef struct om_traverse_worker_s om_traverse_worker_t;
+
+typedef struct om_parallel_traverse_s {
+    object_manager_t *omp;
+    object_t *root;
+    traverse_function_pointer tfn;
+    void *p0, *p1, *p2, *p3;
+    int n_threads;
+    om_traverse_worker_t *workers;
+    volatile long long int pending __attribute__((aligned(64)));
+    volatile int failed;
+} om_parallel_traverse_t;
+
+struct om_traverse_worker_s {
+    om_parallel_traverse_t *ptp;
+    int index;
+    pthread_t tid;
+    om_work_deque_t deque;
+
+    /* only ever touched by the owner, objects are from 'base' to 'n' */
+    object_t **stack;
+    int stack_size, base, n;
+
+    void *thread_data;
+} __attribute__((aligned(64)));
+
+static inline void
+deque_lock (om_work_deque_t *dq)
+{
+    while (__sync_lock_test_and_set(&dq->mtx, 1)) sched_yield();
+}
+
+static inline void
+deque_unlock (om_work_deque_t *dq)
+{
+    __sync_lock_release(&dq->mtx);
+}
+
+/* owner puts 'count' objects at the bottom */
+static int
+deque_push (om_work_deque_t *dq, object_t **objects, int count)
+{
+    object_t **grown;
+    int size;
+
+    deque_lock(dq);
+    if (dq->bottom + count > dq->size) {
+
+        /* taken ones leave space at the top, reclaim it first */
+        if (dq->top > 0) {
+            memmove(dq->objects, &dq->objects[dq->top],
+                (dq->bottom - dq->top) * sizeof(object_t*));
+            dq->bottom -= dq->top;
+            dq->top = 0;
+        }
+        for (size = dq->size ? dq->size : 256;
+            dq->bottom + count > size; size *= 2);
+        if (size > dq->size) {
+            grown = realloc(dq->objects, size * sizeof(object_t*));
+            if (NULL == grown) {
+                deque_unlock(dq);
+                return ENOMEM;
+            }
+            dq->objects = grown;
+            dq->size = size;
         }
+    }
+    memcpy(&dq->objects[dq->bottom], objects, count * sizeof(object_t*));
+    dq->bottom += count;
+    deque_unlock(dq);
+    return 0;
+}
+
+static int
+worker_stack_grow (om_traverse_worker_t *wp, int count)
+{
+    object_t **grown;
+    int size;
+
+    /* moved into the deque ones leave space at the base */
+    if (wp->base > 0) {
+        memmove(wp->stack, &wp->stack[wp->base],
+            (wp->n - wp->base) * sizeof(object_t*));
+        wp->n -= wp->base;
+        wp->base = 0;
+    }
+    for (size = wp->stack_size ? wp->stack_size : 256;
+        wp->n + count > size; size *= 2);
+    if (size > wp->stack_size) {
+        grown = realloc(wp->stack, size * sizeof(object_t*));
+        if (NULL == grown) return ENOMEM;
+        wp->stack = grown;
+        wp->stack_size = size;
+    }
+    return 0;
+}
+
+static inline int
+worker_push (om_traverse_worker_t *wp, object_t *obj)
+{
+    if ((wp->n >= wp->stack_size) && worker_stack_grow(wp, 1)) return ENOMEM;
+    wp->stack[wp->n++] = obj;
+    return 0;
+}
+
+/*
+ * Moves the oldest objects from the top of a deque onto the empty
+ * stack of 'wp', all of them or half.  Returns how many were moved.
+ */
+static int
+worker_take (om_traverse_worker_t *wp, om_work_deque_t *dq, boolean all)
+{
+    int count = 0;
+
+    /* not worth taking the lock for */
+    if (dq->bottom <= dq->top) return 0;
+    deque_lock(dq);
+    count = dq->bottom - dq->top;
+    if (!all) count = (count + 1) / 2;
+    if ((count > wp->stack_size) && worker_stack_grow(wp, count)) {
+        count = 0;
+    } else if (count > 0) {
+        memcpy(wp->stack, &dq->objects[dq->top], count * sizeof(object_t*));
+        dq->top += count;
+        if (dq->bottom == dq->top) dq->top = dq->bottom = 0;
+    }
+    deque_unlock(dq);
+    wp->n = count;
+    return count;
+}
+
+static int
+worker_refill (om_traverse_worker_t *wp)
+{
+    om_parallel_traverse_t *ptp = wp->ptp;
+    om_traverse_worker_t *victim;
+    int i;
 
-        /* simple delete each one from the array */
-        if (child_count && all_the_children) {
-            for (i = 0; i < child_count; i++) {
-                om_object_remove_engine(all_the_children[i], FALSE, FALSE);
+    wp->base = wp->n = 0;
+    if (worker_take(wp, &wp->deque, TRUE)) return 1;
+    for (i = 1; i < ptp->n_threads; i++) {
+        victim = &ptp->workers[(wp->index + i) % ptp->n_threads];
+        if (worker_take(wp, &victim->deque, FALSE)) return 1;
+    }
+    return 0;
+}
+
+/* gives the others something to take once they have taken everything */
+static inline void
+worker_share (om_traverse_worker_t *wp)
+{
+    int half = (wp->n - wp->base) / 2;
+
+    if ((half > 0) && (wp->deque.bottom == wp->deque.top) &&
+        (0 == deque_push(&wp->deque, &wp->stack[wp->base], half))) {
+            wp->base += half;
+    }
+}
+
+static void
+traverse_failed (om_parallel_traverse_t *ptp, int error)
+{
+    (void) __sync_bool_compare_and_swap(&ptp->failed, 0, error);
+}
+
+static void *
+om_traverse_worker (void *arg)
+{
+    om_traverse_worker_t *wp = (om_traverse_worker_t*) arg;
+    om_parallel_traverse_t *ptp = wp->ptp;
+    lifo_node_t *node;
+    object_t *obj;
+    long long int done = 0, pushed;
+    int rc;
+
+    while (1) {
+        if (wp->n == wp->base) {
+            if (done) {
+                __sync_fetch_and_sub(&ptp->pending, done);
+                done = 0;
+            }
+            if (!worker_refill(wp)) {
+                if (ptp->pending <= 0) break;
+                sched_yield();
+                continue;
             }
-            free(all_the_children);
+        }
+        obj = wp->stack[--wp->n];
+        done++;
+
+        /* after a failure, the rest is only drained */
+        if (ptp->failed) continue;
+        if (obj != ptp->root) {
+            rc = ptp->tfn(ptp->omp, obj, &wp->thread_data,
+                    ptp->p0, ptp->p1, ptp->p2, ptp->p3);
+            if (rc) {
+                traverse_failed(ptp, rc);
+                continue;
+            }
+        }
+        pushed = 0;
+        for (node = obj->children.head; !END_NODE(node); node = node->next) {
+            if (worker_push(wp, (object_t*) node->data)) {
+                traverse_failed(ptp, ENOMEM);
+                break;
+            }
+            pushed++;
+        }
+        if (pushed) {
+            __sync_fetch_and_add(&ptp->pending, pushed);
+            if (ptp->n_threads > 1) worker_share(wp);
         }
     }
+    return NULL;
+}
 
-    /* take object out of the main object index */
-    assert(0 == avl_tree_remove(&omp->om_objects, obj, &removed_obj));
-    assert(removed_obj == obj);
+static int
+om_traverse_parallel_engine (om_parallel_traverse_t *ptp,
+    om_reduce_function rfn)
+{
+    om_traverse_worker_t *wp;
+    int i, started;
+
+    /* each on its own cache lines, the owner keeps writing its stack */
+    if (posix_memalign((void**) &ptp->workers, 64,
+            ptp->n_threads * sizeof(om_traverse_worker_t)))
+        return ENOMEM;
+    memset(ptp->workers, 0, ptp->n_threads * sizeof(om_traverse_worker_t));
+    for (i = 0; i < ptp->n_threads; i++) {
+        ptp->workers[i].ptp = ptp;
+        ptp->workers[i].index = i;
+    }
+    ptp->pending = 1;
+    ptp->failed = 0;
+    if (worker_push(&ptp->workers[0], ptp->root)) {
+        free(ptp->workers);
+        return ENOMEM;
+    }
 
-    /* free up its index objects */
-    index_obj_destroy(&obj->children, NULL, NULL);
+    /* calling thread is worker 0, runs with fewer threads if it must */
+    for (started = 1; started < ptp->n_threads; started++) {
+        wp = &ptp->workers[started];
+        if (pthread_create(&wp->tid, NULL, om_traverse_worker, wp)) break;
+    }
+    om_traverse_worker(&ptp->workers[0]);
+    for (i = 1; i < started; i++) pthread_join(ptp->workers[i].tid, NULL);
+
+    for (i = 0; i < ptp->n_threads; i++) {
+        wp = &ptp->workers[i];
+        if (rfn) rfn(wp->thread_data, ptp->p0);
+        free(wp->deque.objects);
+        free(wp->stack);
+    }
+    free(ptp->workers);
 
-    /* free up and destroy all the attribute storage */
-    index_obj_destroy(&obj->attributes, attribute_free, NULL);
+    return ptp->failed;
+}
 
-    /* and blow it away */
-    mem_monitor_free(obj);
+/*
+ * Takes an object out of the children of its parent.  The lifo removes
+ * a node by copying the next one over it, so the sibling whose node was
+ * moved must be told where it is now or its 'child_handle' dangles.
+ */
+static void
+object_unlink_from_parent (object_manager_t *omp, object_t *obj)
+{
+    object_t *parent, *moved;
+
+    parent = handle_resolve(&omp->object_handles, obj->parent.object_handle);
+    if ((NULL == parent) || (NULL == obj->child_handle)) return;
+    lifo_remove_node(&parent->children, obj->child_handle);
+    moved = (object_t*) obj->child_handle->data;
+    if (moved) moved->child_handle = obj->child_handle;
+    obj->child_handle = NULL;
 }
 
-#endif
+/*
+ * Gets rid of everything an object owns & makes it unreachable thru
+ * anything except 'om_objects'.  Its handle is the last thing to go,
+ * since that is how its children find it.
+ */
+static void
+object_dismantle (object_manager_t *omp, object_t *obj)
+{
+    if (omp->attribute_indexes) attribute_indexes_forget_object(omp, obj);
+    lifo_destroy(&obj->children);
+    if (obj->attributes.elements) {
+        index_obj_destroy(&obj->attributes, attribute_free, NULL);
+    }
+    handle_remove(&omp->object_handles, obj->handle, NULL);
+    obj->handle = NULL_HANDLE;
+}
+
+/* live objects always have a handle, dismantled ones do not */
+static int
+object_is_dismantled (void *obj, void *arg)
+{
+    return NULL_HANDLE == ((object_t*) obj)->handle;
+}
+
+/* once out of 'om_objects', an object can be retired */
+static void
+object_retire (void *obj, void *omp)
+{
+    om_retire((object_manager_t*) omp, obj, object_free,
+        lookup_remove((object_manager_t*) omp, (object_t*) obj));
+}
+
+/* the whole object manager is going away, nobody can be reading */
+static void
+object_destroy (void *obj, void *omp)
+{
+    object_dismantle((object_manager_t*) omp, (object_t*) obj);
+    MEM_MONITOR_FREE(obj);
+}
+
+/*
+ * Removes an object & its whole sub tree.
+ *
+ * The sub tree is streamed in post order: go down thru the first
+ * children to a leaf, which is always the head of its parent's
+ * children, pop it off, dismantle it & carry on from the parent.
+ * So no array of the sub tree is ever needed, however big it is.
+ *
+ * Every object must also come out of 'om_objects'.  One at a time,
+ * each costs a rebalancing removal.  Once the sub tree turns out to
+ * be most of all the objects, the rest are only marked & taken out in
+ * one pass over 'om_objects' at the end, which rebuilds it once for
+ * all of them.  That pass looks at every object left too, so it only
+ * pays off when few are left.
+ */
+#define OM_BULK_REMOVAL_RATIO       2
+
+static int
+om_object_remove_engine (object_manager_t *omp, object_t *root)
+{
+    object_t *obj, *parent;
+    void *removed_obj;
+    int n_objects = avl_tree_size(&omp->om_objects);
+    int count = 0, removed = 0;
+
+    object_unlink_from_parent(omp, root);
+    obj = root;
+    while (1) {
+        while (!END_NODE(obj->children.head)) {
+            obj = (object_t*) obj->children.head->data;
+        }
+        parent = (obj == root) ? NULL :
+            handle_resolve(&omp->object_handles, obj->parent.object_handle);
+        if (parent) lifo_remove_node(&parent->children, parent->children.head);
+        object_dismantle(omp, obj);
+        if ((++count * OM_BULK_REMOVAL_RATIO) <= n_objects) {
+            assert(0 == avl_tree_remove(&omp->om_objects, obj, &removed_obj));
+            object_retire(obj, omp);
+            removed++;
+        }
+        if (obj == root) break;
+        obj = parent;
+    }
+
+    if (removed < count) {
+        removed += avl_tree_remove_matching(&omp->om_objects,
+                        object_is_dismantled, NULL, object_retire, omp);
+    }
+    assert(removed == count);
+    return count;
+}
 
 static object_t *
 om_object_create_engine (object_manager_t *omp,
@@ -586,26 +1420,42 @@ om_object_create_engine (object_manager_t *omp,
 
     /* ok, it does not already exist, fill the rest */
     obj->omp = omp;
+
+    /* no attributes yet, index is created only if they cannot be inlined */
+    obj->attribute_sequence = 0;
+    obj->n_inline_attributes = 0;
+    memset(&obj->attributes, 0, sizeof(index_obj_t));
+
+    if (handle_create(&omp->object_handles, obj, &obj->handle)) {
+        WARN(&om_debug, "no handle for object (%d, %d)\n",
+            object_type, object_instance);
+        assert(0 == avl_tree_remove(&omp->om_objects, obj, (void**) &exists));
+        MEM_MONITOR_FREE(obj);
+        return NULL;
+    }
+    if (lookup_insert(omp, obj)) {
+        WARN(&om_debug, "no lookup node for object (%d, %d)\n",
+            object_type, object_instance);
+        handle_remove(&omp->object_handles, obj->handle, NULL);
+        assert(0 == avl_tree_remove(&omp->om_objects, obj, (void**) &exists));
+        MEM_MONITOR_FREE(obj);
+        return NULL;
+    }
+    obj->parent.object_id.object_type = parent_object_type;
+    obj->parent.object_id.object_instance = parent_object_instance;
+    obj->parent.object_handle = NULL_HANDLE;
+    obj->child_handle = NULL;
     parent = get_object_pointer(omp,
                 parent_object_type, parent_object_instance);
     if (parent) {
-        obj->parent.is_pointer = TRUE;
-        obj->parent.u.object_ptr = parent;
+        obj->parent.object_handle = parent->handle;
         assert(0 == lifo_add_data(&parent->children, obj,
-                        &(obj->child_handle));
-    } else {
-        obj->parent.is_pointer = FALSE;
-        obj->parent.u.object_id.object_type = parent_object_type;
-        obj->parent.u.object_id.object_instance = parent_object_instance;
+                        &(obj->child_handle)));
     }
 
     /* initialize the children list */
     assert(0 == lifo_init(&obj->children, FALSE, FALSE, 0, memp));
 
-        /* initialize the attributes index */
-    assert(0 == index_obj_init(&obj->attributes, FALSE, FALSE,
-        compare_attributes, 8, 8, memp));
-
     TRACE(&om_debug, "object (%d, %d) created with parent (%d, %d)\n",
         object_type, object_instance,
         parent_object_type, parent_object_instance);
@@ -614,6 +1464,242 @@ om_object_create_engine (object_manager_t *omp,
     return obj;
 }
 
+/******************************************************************************
+ *
+ * Batched write transactions.
+ *
+ * Every operation applied is remembered in order, with whatever it
+ * replaced, so when one fails the ones before it are undone in the
+ * reverse order.  Undoing an attribute change only needs memory when
+ * the old value did not fit into the object, which is the only way
+ * undoing can fail.  Nothing else can be done about it at that point.
+ */
+
+static int
+compare_transaction_ops (const void *v1, const void *v2)
+{
+    const om_transaction_op_t *op1 = (const om_transaction_op_t*) v1;
+    const om_transaction_op_t *op2 = (const om_transaction_op_t*) v2;
+
+    if (op1->object_type != op2->object_type)
+        return (op1->object_type < op2->object_type) ? -1 : 1;
+    if (op1->object_instance != op2->object_instance)
+        return (op1->object_instance < op2->object_instance) ? -1 : 1;
+    return op1->sequence - op2->sequence;
+}
+
+/* true if the (sorted) transaction creates the object */
+static boolean
+transaction_creates (om_transaction_t *txp,
+    int object_type, int object_instance)
+{
+    om_transaction_op_t *op;
+    int low = 0, high = txp->n_ops, mid;
+
+    /* first op on the object, if any */
+    while (low < high) {
+        mid = (low + high) / 2;
+        op = &txp->ops[mid];
+        if ((op->object_type < object_type) ||
+            ((op->object_type == object_type) &&
+             (op->object_instance < object_instance))) {
+                low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    for (op = &txp->ops[low]; op < &txp->ops[txp->n_ops]; op++) {
+        if ((op->object_type != object_type) ||
+            (op->object_instance != object_instance)) break;
+        if (OM_OP_OBJECT_CREATE == op->op) return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Only the creation of an object which is created in the same failed
+ * transaction is undone, so everything done to it afterwards (children
+ * & attributes) has already been undone.
+ */
+static void
+object_creation_undo (object_manager_t *omp, object_t *obj)
+{
+    void *removed_obj;
+
+    object_unlink_from_parent(omp, obj);
+    avl_tree_remove(&omp->om_objects, obj, &removed_obj);
+    object_dismantle(omp, obj);
+    object_retire(obj, omp);
+}
+
+static int
+transaction_op_apply (object_manager_t *omp, om_transaction_op_t *op)
+{
+    object_t *obj;
+    byte *value;
+    int length;
+
+    if (OM_OP_OBJECT_CREATE == op->op) {
+        op->applied = TRUE;
+        obj = get_object_pointer(omp, op->object_type, op->object_instance);
+        op->created = om_object_create_engine(omp,
+                        op->parent_object_type, op->parent_object_instance,
+                        op->object_type, op->object_instance);
+        if (NULL == op->created) return EFAULT;
+
+        /* it already existed, nothing to undo */
+        if (obj) op->created = NULL;
+        return 0;
+    }
+
+    obj = get_object_pointer(omp, op->object_type, op->object_instance);
+    if (NULL == obj) return ENODATA;
+    op->had_value = attribute_value_find(obj, op->attribute_id,
+                        &length, &value);
+    if (op->had_value) {
+        op->old_value = &op->old_value_data [0];
+        if (length > OM_INLINE_VALUE_SIZE) {
+            op->old_value = MEM_MONITOR_ALLOC(omp, length);
+            if (NULL == op->old_value) return ENOMEM;
+        }
+        op->old_value_length = length;
+        if (length > 0) bcopy(value, op->old_value, length);
+    }
+
+    /* from here on, it may have changed something */
+    op->applied = TRUE;
+    if (OM_OP_ATTRIBUTE_ADD == op->op) {
+        return
+            attribute_add_engine(omp, obj, op->attribute_id,
+                op->attribute_value_length, op->attribute_value);
+    }
+    return obj_attribute_remove(obj, op->attribute_id);
+}
+
+/*
+ * A failed attribute operation may still have changed the value (its
+ * index may have failed), so it is undone too.  Restoring the value
+ * it replaced is harmless if it did not.
+ */
+static void
+transaction_op_undo (object_manager_t *omp, om_transaction_op_t *op)
+{
+    object_t *obj;
+
+    if (OM_OP_OBJECT_CREATE == op->op) {
+        if (op->created) object_creation_undo(omp, op->created);
+        return;
+    }
+    if (!op->applied) return;
+    obj = get_object_pointer(omp, op->object_type, op->object_instance);
+    if (NULL == obj) return;
+    if (op->had_value) {
+        attribute_add_engine(omp, obj, op->attribute_id,
+            op->old_value_length, op->old_value);
+    } else {
+        obj_attribute_remove(obj, op->attribute_id);
+    }
+}
+
+/*
+ * Creations are applied in sorted order, except the ones whose parent
+ * does not exist yet but is created by the transaction.  They wait
+ * for a later pass, after their parent.
+ */
+static int
+transaction_apply_creations (om_transaction_t *txp,
+    om_transaction_op_t **applied, int *n_applied)
+{
+    object_manager_t *omp = txp->omp;
+    om_transaction_op_t *op;
+    int i, rc, waiting, progress;
+
+    do {
+        waiting = progress = 0;
+        for (i = 0; i < txp->n_ops; i++) {
+            op = &txp->ops[i];
+            if ((op->op != OM_OP_OBJECT_CREATE) || op->applied) continue;
+            if ((NULL == get_object_pointer(omp,
+                    op->parent_object_type, op->parent_object_instance)) &&
+                transaction_creates(txp,
+                    op->parent_object_type, op->parent_object_instance)) {
+                        waiting++;
+                        continue;
+            }
+            applied[(*n_applied)++] = op;
+            rc = transaction_op_apply(omp, op);
+            if (rc) {
+                txp->failed_op = op->sequence;
+                return rc;
+            }
+            progress++;
+        }
+    } while (waiting && progress);
+
+    /* they are all waiting for each other */
+    return waiting ? EINVAL : 0;
+}
+
+static int
+transaction_apply_attributes (om_transaction_t *txp,
+    om_transaction_op_t **applied, int *n_applied)
+{
+    om_transaction_op_t *op;
+    int i, rc;
+
+    for (i = 0; i < txp->n_ops; i++) {
+        op = &txp->ops[i];
+        if (OM_OP_OBJECT_CREATE == op->op) continue;
+        applied[(*n_applied)++] = op;
+        rc = transaction_op_apply(txp->omp, op);
+        if (rc) {
+            txp->failed_op = op->sequence;
+            return rc;
+        }
+    }
+    return 0;
+}
+
+static void
+transaction_ops_clear (om_transaction_t *txp)
+{
+    om_transaction_op_t *op;
+    int i;
+
+    for (i = 0; i < txp->n_ops; i++) {
+        op = &txp->ops[i];
+        MEM_MONITOR_FREE(op->attribute_value);
+        if (op->old_value != &op->old_value_data [0]) {
+            MEM_MONITOR_FREE(op->old_value);
+        }
+    }
+    txp->n_ops = 0;
+}
+
+static om_transaction_op_t *
+transaction_op_stage (om_transaction_t *txp, int op_type,
+    int object_type, int object_instance)
+{
+    om_transaction_op_t *op;
+    int max_ops;
+
+    if (txp->n_ops >= txp->max_ops) {
+        max_ops = txp->max_ops ? (2 * txp->max_ops) : 64;
+        op = MEM_MONITOR_REALLOC(txp->omp, txp->ops,
+                max_ops * sizeof(om_transaction_op_t));
+        if (NULL == op) return NULL;
+        txp->ops = op;
+        txp->max_ops = max_ops;
+    }
+    op = &txp->ops[txp->n_ops];
+    memset(op, 0, sizeof(om_transaction_op_t));
+    op->op = op_type;
+    op->sequence = txp->n_ops++;
+    op->object_type = object_type;
+    op->object_instance = object_instance;
+    return op;
+}
+
 /*************** Public functions *********************************************/
 
 PUBLIC int
@@ -622,8 +1708,6 @@ om_init (object_manager_t *omp,
         int manager_id,
         mem_monitor_t *parent_mem_monitor)
 {
-    object_t *rootp;
-
     memset(omp, 0, sizeof(object_manager_t));
     MEM_MONITOR_SETUP(omp);
     LOCK_SETUP(omp);
@@ -634,13 +1718,21 @@ om_init (object_manager_t *omp,
     assert(0 == avl_tree_init(&omp->om_objects, FALSE, FALSE,
                 compare_objects, omp->mem_mon_p));
 
+    /* protected by the object manager lock, resolving needs no lock */
+    assert(0 == handle_table_init(&omp->object_handles, FALSE, 0,
+                omp->mem_mon_p));
+
+    /* changed under the lock too but read without it, in epochs */
+    assert(0 == epoch_manager_init(&omp->epochs, omp->mem_mon_p));
+    omp->lookup = lookup_table_create(omp, OM_LOOKUP_INITIAL_BUCKETS);
+    assert(omp->lookup != NULL);
+
     /* initialize root object as (0,0) with a NULL parent pointer */
     omp->root = om_object_create_engine(omp, -1, -1, 0, 0);
     assert(omp->root != NULL);
 
     /* root has no parent */
-    omp->root->parent.is_pointer = TRUE;
-    omp->root->parent->u.object_ptr = NULL;
+    omp->root->parent.object_handle = NULL_HANDLE;
     return 0;
 }
 
@@ -667,9 +1759,9 @@ om_object_exists (object_manager_t *omp,
 {
     boolean exists;
 
-    OBJ_READ_LOCK(omp);
-    exists = (NULL != get_object_pointer(omp, object_type, object_instance));
-    OBJ_READ_UNLOCK(omp);
+    epoch_enter(&omp->epochs);
+    exists = (NULL != lookup_find(omp, object_type, object_instance));
+    epoch_exit(&omp->epochs);
     return exists;
 }
 
@@ -695,6 +1787,70 @@ om_attribute_add (object_manager_t *omp,
     return failed;
 }
 
+PUBLIC bool
+om_attribute_exists (object_manager_t *omp,
+        int object_type, int object_instance,
+        int attribute_id)
+{
+    object_t *obj;
+    byte *value, copy [OM_INLINE_VALUE_SIZE];
+    int length, rc = ENODATA;
+    bool exists = FALSE;
+
+    /* most attributes are inlined & need no lock */
+    epoch_enter(&omp->epochs);
+    obj = lookup_find(omp, object_type, object_instance);
+    if (obj) rc = inline_attribute_read(obj, attribute_id, &length, copy);
+    epoch_exit(&omp->epochs);
+    if (rc != EAGAIN) return (0 == rc);
+
+    OBJ_READ_LOCK(omp);
+    obj = get_object_pointer(omp, object_type, object_instance);
+    if (obj) exists = attribute_value_find(obj, attribute_id, &length, &value);
+    OBJ_READ_UNLOCK(omp);
+    return exists;
+}
+
+PUBLIC int
+om_attribute_get (object_manager_t *omp,
+        int object_type, int object_instance,
+        int attribute_id,
+        int *returned_length, int max_length, byte *returned_value)
+{
+    object_t *obj;
+    byte *value, copy [OM_INLINE_VALUE_SIZE];
+    int length, failed = ENODATA;
+
+    /* most attributes are inlined & need no lock */
+    epoch_enter(&omp->epochs);
+    obj = lookup_find(omp, object_type, object_instance);
+    if (obj) failed = inline_attribute_read(obj, attribute_id, &length, copy);
+    epoch_exit(&omp->epochs);
+    if (0 == failed) {
+        if (length > max_length) return ENOSPC;
+        *returned_length = length;
+        if (length > 0) bcopy(copy, returned_value, length);
+        return 0;
+    }
+    if (failed != EAGAIN) return failed;
+
+    /* it is not inlined, object may have changed meanwhile so look again */
+    failed = 0;
+    OBJ_READ_LOCK(omp);
+    obj = get_object_pointer(omp, object_type, object_instance);
+    if ((NULL == obj) ||
+        !attribute_value_find(obj, attribute_id, &length, &value)) {
+            failed = ENODATA;
+    } else if (length > max_length) {
+        failed = ENOSPC;
+    } else {
+        *returned_length = length;
+        if (length > 0) bcopy(value, returned_value, length);
+    }
+    OBJ_READ_UNLOCK(omp);
+    return failed;
+}
+
 PUBLIC int
 om_attribute_remove (object_manager_t *omp,
         int object_type, int object_instance,
@@ -727,12 +1883,182 @@ om_object_remove (object_manager_t *omp,
         failed = ENODATA;
     } else {
         failed = 0;
-        om_object_remove_engine(obj, TRUE, TRUE);
+        om_object_remove_engine(omp, obj);
+    }
+    OBJ_WRITE_UNLOCK(omp);
+    return failed;
+}
+
+PUBLIC int
+om_cursor_next_batch (object_manager_t *omp, om_cursor_t *cursor,
+        object_identifier_t *batch, int max_batch, int *n_returned)
+{
+    object_t first, *obj;
+    avl_cursor_t ac;
+    int n = 0, failed;
+
+    *n_returned = 0;
+    if (max_batch <= 0) return EINVAL;
+    if (cursor->done) return ENODATA;
+
+    first.object_type = cursor->object_type;
+    first.object_instance = cursor->next_instance;
+
+    OBJ_READ_LOCK(omp);
+    failed = avl_cursor_seek(&omp->om_objects, &ac, &first, (void**) &obj);
+    while (!failed && (n < max_batch) && object_in_cursor_range(cursor, obj)) {
+        object_identifier_copy(&batch[n++], obj);
+        failed = avl_cursor_next(&ac, (void**) &obj);
+    }
+    OBJ_READ_UNLOCK(omp);
+
+    /* a batch which is not full means the end of the range is reached */
+    if ((n < max_batch) ||
+        (batch[n - 1].object_instance >= cursor->high_instance)) {
+            cursor->done = TRUE;
+    } else {
+        cursor->next_instance = batch[n - 1].object_instance + 1;
+    }
+    *n_returned = n;
+    return n ? 0 : ENODATA;
+}
+
+PUBLIC int
+om_cursor_prev_batch (object_manager_t *omp, om_cursor_t *cursor,
+        object_identifier_t *batch, int max_batch, int *n_returned)
+{
+    object_t position, *obj;
+    avl_cursor_t ac;
+    int n = 0, failed;
+
+    *n_returned = 0;
+    if (max_batch <= 0) return EINVAL;
+    if (cursor->low_instance > cursor->high_instance) return ENODATA;
+
+    /* past the end, the last object of the range is the first returned */
+    position.object_type = cursor->object_type;
+    position.object_instance =
+        cursor->done ? cursor->high_instance : cursor->next_instance;
+
+    OBJ_READ_LOCK(omp);
+    failed = avl_cursor_seek(&omp->om_objects, &ac, &position,
+                (void**) &obj);
+    if (failed) {
+        failed = avl_cursor_last(&omp->om_objects, &ac, (void**) &obj);
+    } else if (!cursor->done || compare_objects(obj, &position)) {
+        failed = avl_cursor_prev(&ac, (void**) &obj);
+    }
+    while (!failed && (n < max_batch) && object_in_cursor_range(cursor, obj)) {
+        object_identifier_copy(&batch[n++], obj);
+        failed = avl_cursor_prev(&ac, (void**) &obj);
+    }
+    OBJ_READ_UNLOCK(omp);
+
+    if (n) {
+        cursor->next_instance = batch[n - 1].object_instance;
+        cursor->done = FALSE;
+    }
+    *n_returned = n;
+    return n ? 0 : ENODATA;
+}
+
+PUBLIC int
+om_attribute_index_create (object_manager_t *omp,
+        int object_type, int attribute_id)
+{
+    om_attribute_index_t *aidx;
+    object_t first, last;
+    int failed;
+
+    OBJ_WRITE_LOCK(omp);
+    if (attribute_index_get(omp, object_type, attribute_id)) {
+        OBJ_WRITE_UNLOCK(omp);
+        return EEXIST;
+    }
+    aidx = MEM_MONITOR_ALLOC(omp, sizeof(om_attribute_index_t));
+    if (NULL == aidx) {
+        OBJ_WRITE_UNLOCK(omp);
+        return ENOMEM;
+    }
+    aidx->object_type = object_type;
+    aidx->attribute_id = attribute_id;
+    avl_tree_init(&aidx->entries, FALSE, FALSE,
+        compare_index_entries, omp->mem_mon_p);
+
+    /* index the objects which already exist */
+    object_type_bounds(object_type, &first, &last);
+    failed = avl_tree_range_traverse(&omp->om_objects, &first, &last,
+                index_object_tfn, aidx, NULL, NULL, NULL);
+    if (failed) {
+        attribute_index_free(aidx);
+    } else {
+        aidx->next = omp->attribute_indexes;
+        omp->attribute_indexes = aidx;
     }
     OBJ_WRITE_UNLOCK(omp);
     return failed;
 }
 
+PUBLIC int
+om_attribute_index_destroy (object_manager_t *omp,
+        int object_type, int attribute_id)
+{
+    om_attribute_index_t *aidx, **prevp;
+    int failed = ENODATA;
+
+    OBJ_WRITE_LOCK(omp);
+    for (prevp = &omp->attribute_indexes; (aidx = *prevp);
+         prevp = &aidx->next) {
+        if ((aidx->object_type == object_type) &&
+            (aidx->attribute_id == attribute_id)) {
+                *prevp = aidx->next;
+                attribute_index_free(aidx);
+                failed = 0;
+                break;
+        }
+    }
+    OBJ_WRITE_UNLOCK(omp);
+    return failed;
+}
+
+PUBLIC int
+om_attribute_find (object_manager_t *omp,
+        int object_type, int attribute_id,
+        long long int low, long long int high,
+        object_identifier_t *found, int max_found, int *n_found)
+{
+    om_attribute_index_t *aidx;
+    om_index_entry_t low_entry, high_entry;
+    object_t first, last;
+    om_find_state_t fs;
+
+    fs.object_type = object_type;
+    fs.attribute_id = attribute_id;
+    fs.low = low;
+    fs.high = high;
+    fs.found = found;
+    fs.max_found = max_found;
+    fs.n_found = 0;
+
+    OBJ_READ_LOCK(omp);
+    aidx = attribute_index_get(omp, object_type, attribute_id);
+    if (aidx) {
+        low_entry.value = low;
+        low_entry.object_instance = INT_MIN;
+        high_entry.value = high;
+        high_entry.object_instance = INT_MAX;
+        avl_tree_range_traverse(&aidx->entries, &low_entry, &high_entry,
+            find_in_index_tfn, &fs, NULL, NULL, NULL);
+    } else {
+        object_type_bounds(object_type, &first, &last);
+        avl_tree_range_traverse(&omp->om_objects, &first, &last,
+            find_in_objects_tfn, &fs, NULL, NULL, NULL);
+    }
+    OBJ_READ_UNLOCK(omp);
+    *n_found = fs.n_found;
+    return 0;
+}
+
 PUBLIC int
 om_parent_get (object_manager_t *omp,
         int object_type, int object_instance,
@@ -743,8 +2069,13 @@ om_parent_get (object_manager_t *omp,
 
     OBJ_READ_LOCK(omp);
     obj = get_object_pointer(omp, object_type, object_instance);
-    if (NULL == obj) failed = ENODATA;
-    get_ot_and_oi(&obj->parent, parent_object_type, parent_object_instance);
+    if (NULL == obj) {
+        failed = ENODATA;
+        get_ot_and_oi(NULL, parent_object_type, parent_object_instance);
+    } else {
+        get_ot_and_oi(&obj->parent,
+            parent_object_type, parent_object_instance);
+    }
     OBJ_READ_UNLOCK(omp);
     return failed;
 }
@@ -770,16 +2101,166 @@ om_traverse (object_manager_t *omp,
     return failed;
 }
 
+PUBLIC int
+om_traverse_parallel (object_manager_t *omp,
+        int object_type, int object_instance,
+        int n_threads,
+        traverse_function_pointer tfn, om_reduce_function rfn,
+        void *p0, void *p1, void *p2, void *p3)
+{
+    om_parallel_traverse_t pt;
+    int failed;
+
+    if ((n_threads < 1) || (n_threads > OM_MAX_TRAVERSE_THREADS) ||
+        (NULL == tfn)) return EINVAL;
+    pt.omp = omp;
+    pt.tfn = tfn;
+    pt.p0 = p0;
+    pt.p1 = p1;
+    pt.p2 = p2;
+    pt.p3 = p3;
+    pt.n_threads = n_threads;
+
+    /* any number of traversals can share the read lock */
+    OBJ_READ_LOCK(omp);
+    pt.root = get_object_pointer(omp, object_type, object_instance);
+    if (NULL == pt.root) {
+        failed = ENODATA;
+    } else {
+        failed = om_traverse_parallel_engine(&pt, rfn);
+    }
+    OBJ_READ_UNLOCK(omp);
+    return failed;
+}
+
+PUBLIC int
+om_transaction_init (om_transaction_t *txp, object_manager_t *omp)
+{
+    memset(txp, 0, sizeof(om_transaction_t));
+    txp->omp = omp;
+    txp->failed_op = -1;
+    return 0;
+}
+
+PUBLIC int
+om_transaction_object_create (om_transaction_t *txp,
+        int parent_object_type, int parent_object_instance,
+        int object_type, int object_instance)
+{
+    om_transaction_op_t *op;
+
+    op = transaction_op_stage(txp, OM_OP_OBJECT_CREATE,
+            object_type, object_instance);
+    if (NULL == op) return ENOMEM;
+    op->parent_object_type = parent_object_type;
+    op->parent_object_instance = parent_object_instance;
+    return 0;
+}
+
+PUBLIC int
+om_transaction_attribute_add (om_transaction_t *txp,
+        int object_type, int object_instance,
+        int attribute_id,
+        int attribute_value_length, byte *attribute_value)
+{
+    om_transaction_op_t *op;
+    byte *value = NULL;
+
+    if (attribute_value_length < 0) return EINVAL;
+    if (attribute_value_length > 0) {
+        value = MEM_MONITOR_ALLOC(txp->omp, attribute_value_length);
+        if (NULL == value) return ENOMEM;
+        bcopy(attribute_value, value, attribute_value_length);
+    }
+    op = transaction_op_stage(txp, OM_OP_ATTRIBUTE_ADD,
+            object_type, object_instance);
+    if (NULL == op) {
+        MEM_MONITOR_FREE(value);
+        return ENOMEM;
+    }
+    op->attribute_id = attribute_id;
+    op->attribute_value_length = attribute_value_length;
+    op->attribute_value = value;
+    return 0;
+}
+
+PUBLIC int
+om_transaction_attribute_remove (om_transaction_t *txp,
+        int object_type, int object_instance,
+        int attribute_id)
+{
+    om_transaction_op_t *op;
+
+    op = transaction_op_stage(txp, OM_OP_ATTRIBUTE_REMOVE,
+            object_type, object_instance);
+    if (NULL == op) return ENOMEM;
+    op->attribute_id = attribute_id;
+    return 0;
+}
+
+PUBLIC int
+om_transaction_commit (om_transaction_t *txp)
+{
+    object_manager_t *omp = txp->omp;
+    om_transaction_op_t **applied;
+    int n_applied = 0, failed;
+
+    txp->failed_op = -1;
+    if (0 == txp->n_ops) return 0;
+
+    /* allocated before locking, so undoing never needs any memory */
+    applied = MEM_MONITOR_ALLOC(omp,
+                txp->n_ops * sizeof(om_transaction_op_t*));
+    if (NULL == applied) {
+        transaction_ops_clear(txp);
+        return ENOMEM;
+    }
+    qsort(txp->ops, txp->n_ops, sizeof(om_transaction_op_t),
+        compare_transaction_ops);
+
+    OBJ_WRITE_LOCK(omp);
+    failed = transaction_apply_creations(txp, applied, &n_applied);
+    if (0 == failed) {
+        failed = transaction_apply_attributes(txp, applied, &n_applied);
+    }
+    if (failed) {
+        while (n_applied > 0) transaction_op_undo(omp, applied[--n_applied]);
+    }
+    OBJ_WRITE_UNLOCK(omp);
+
+    MEM_MONITOR_FREE(applied);
+    transaction_ops_clear(txp);
+    return failed;
+}
+
+PUBLIC void
+om_transaction_destroy (om_transaction_t *txp)
+{
+    transaction_ops_clear(txp);
+    MEM_MONITOR_FREE(txp->ops);
+    txp->ops = NULL;
+    txp->max_ops = 0;
+}
+
 PUBLIC void
 om_destroy (object_manager_t *omp)
 {
-    object_t *root = NULL;
+    om_attribute_index_t *aidx;
 
     OBJ_WRITE_LOCK(omp);
-    if (omp->om_objects.root_node != NULL) {
-        root = (object_t*) omp->om_objects.root_node->user_data;
-        om_object_remove_engine(root, FALSE, FALSE);
+    while ((aidx = omp->attribute_indexes)) {
+        omp->attribute_indexes = aidx->next;
+        attribute_index_free(aidx);
     }
+
+    /* every object goes at once, no need to keep any tree consistent */
+    avl_tree_destroy(&omp->om_objects, object_destroy, omp);
+    handle_table_destroy(&omp->object_handles);
+
+    /* nobody can be reading any more */
+    epoch_manager_destroy(&omp->epochs);
+    lookup_table_free(omp->lookup, NULL);
+    omp->lookup = NULL;
     OBJ_WRITE_UNLOCK(omp);
     LOCK_OBJ_DESTROY(omp);
 }
@@ -799,67 +2280,31 @@ static char *attribute_simple_value_acronym = "SAV";
 
 /************* Writing the object manager to a file functions *************/
 
+/*
+ * Every value is written out as a complex value (with a reference
+ * count of 1), whether it is inlined or not.  The simple value format
+ * is only ever read, for files written before values became plain
+ * byte sequences.
+ */
 static void
-om_write_one_attribute_simple_value (FILE *fp, attribute_value_t *avp)
-{
-    fprintf(fp, "\n    %s %d %lld",
-        attribute_simple_value_acronym,
-        avp->ref_count,
-        SIMPLE_ATTRIBUTE_VALUE(avp));
-
-}
-
-static void
-om_write_one_attribute_complex_value (FILE *fp, attribute_value_t *avp)
+om_write_one_attribute (FILE *fp, int attribute_id,
+    int attribute_value_length, byte *attribute_value)
 {
-    byte *bptr;
-    int i, len;
+    int i;
 
-    len = COMPLEX_ATTRIBUTE_VALUE_LENGTH(avp);
+    fprintf(fp, "\n  %s %d ", attribute_id_acronym, attribute_id);
     fprintf(fp, "\n    %s %d %d ",
-        attribute_complex_value_acronym, avp->ref_count, len);
-    bptr = COMPLEX_ATTRIBUTE_VALUE_PTR(avp);
-    for (i = 0; i < len; i++) {
-        fprintf(fp, "%d ", *bptr);
-        bptr++;
-    }
-}
-
-static void
-om_write_one_attribute_value (FILE *fp, attribute_value_t *avp)
-{
-    assert(avp->ref_count > 0);
-    if (ATTRIBUTE_VALUE_IS_SIMPLE(avp)) {
-        om_write_one_attribute_simple_value(fp, avp);
-    } else if (ATTRIBUTE_VALUE_IS_COMPLEX(avp)) {
-        om_write_one_attribute_complex_value(fp, avp);
-    } else {
-        FATAL_ERROR(&om_debug, "unknown attribute type 0x%x\n",
-            avp->attribute_flags);
+        attribute_complex_value_acronym, 1, attribute_value_length);
+    for (i = 0; i < attribute_value_length; i++) {
+        fprintf(fp, "%d ", attribute_value[i]);
     }
 }
 
 static void
-om_write_one_attribute (FILE *fp, void *vattr)
-{
-    attribute_t *attr = (attribute_t*) vattr;
-    attribute_value_t *avp;
-
-    fprintf(fp, "\n  %s %d ", attribute_id_acronym, attr->attribute_id);
-    avp = attr->avp_list;
-    while (avp) {
-        om_write_one_attribute_value(fp, avp);
-        avp = avp->next_avp;
-    }
-}
-
-static int
-om_write_one_object_tfn (void *utility_object, void *utility_node,
-        void *v_object, void *v_FILE, 
-        void *p1, void *p2, void *p3)
+om_write_one_object (FILE *fp, object_t *obj)
 {
-    object_t *obj = (object_t*) v_object;
-    FILE *fp = v_FILE;
+    inline_attribute_t *iap;
+    attribute_t *ap;
     int i;
     int pt, pi;
 
@@ -868,14 +2313,60 @@ om_write_one_object_tfn (void *utility_object, void *utility_node,
         object_acronym, 
         pt, pi,
         obj->object_type, obj->object_instance);
-    for (i = 0; i < obj->attributes.n; i++) {
-        om_write_one_attribute(fp, obj->attributes.elements[i]);
+    for (i = 0; i < obj->n_inline_attributes; i++) {
+        iap = &obj->inline_attributes[i];
+        om_write_one_attribute(fp, iap->attribute_id,
+            iap->attribute_value_length, &iap->attribute_value_data [0]);
+    }
+    if (obj->attributes.elements) {
+        for (i = 0; i < obj->attributes.n; i++) {
+            ap = (attribute_t*) obj->attributes.elements[i];
+            om_write_one_attribute(fp, ap->attribute_id,
+                ap->attribute_value_length, &ap->attribute_value_data [0]);
+        }
+    }
+}
+
+/*
+ * writes all the objects into an already opened file, the
+ * caller must make sure the objects cannot change meanwhile.
+ * The walk is done with a cursor since it only holds the read
+ * lock, and a morris traversal modifies the tree as it goes.
+ */
+static int
+om_write_objects (object_manager_t *omp, FILE *fp)
+{
+    avl_cursor_t cursor;
+    object_t *obj;
+    int failed;
+
+    for (failed = avl_cursor_first(&omp->om_objects, &cursor, (void**) &obj);
+        0 == failed; failed = avl_cursor_next(&cursor, (void**) &obj)) {
+            om_write_one_object(fp, obj);
     }
 
-    /* must return 0 to continue traversing */
+    /* close up the file */
+    fprintf(fp, "\n");
+    if (fflush(fp) || ferror(fp)) return EIO;
     return 0;
 }
 
+/*
+ * keeps the previous file as the backup, does not matter if these fail
+ */
+static void
+om_file_backup (char *om_name)
+{
+    char backup_om_name [TYPICAL_NAME_SIZE + 16];
+    char backup_om_tmp [TYPICAL_NAME_SIZE + 32];
+
+    sprintf(backup_om_name, "%s_BACKUP", om_name);
+    sprintf(backup_om_tmp, "%s_tmp", backup_om_name);
+    unlink(backup_om_tmp);
+    rename(backup_om_name, backup_om_tmp);
+    rename(om_name, backup_om_name);
+}
+
 /*
  * Write the object manager out to disk.
  *
@@ -928,33 +2419,20 @@ om_write (object_manager_t *omp)
 {
     FILE *fp;
     char om_name [TYPICAL_NAME_SIZE];
-    char backup_om_name [TYPICAL_NAME_SIZE];
-    char backup_om_tmp [TYPICAL_NAME_SIZE];
-    void *unused = NULL;    // shut the compiler up
+    int failed;
 
     OBJ_READ_LOCK(omp);
 
     sprintf(om_name, "om_%d", omp->manager_id);
-    sprintf(backup_om_name, "%s_BACKUP", om_name);
-    sprintf(backup_om_tmp, "%s_tmp", backup_om_name);
-
-    /* does not matter if these fail */
-    unlink(backup_om_tmp);
-    rename(backup_om_name, backup_om_tmp);
-    rename(om_name, backup_om_name);
+    om_file_backup(om_name);
 
     fp = fopen(om_name, "w");
     if (NULL == fp) {
         OBJ_READ_UNLOCK(omp);
         return -1;
     }
-    avl_tree_morris_traverse(&omp->om_objects, NULL, om_write_one_object_tfn,
-        fp, unused, unused, unused);
-
-    /* close up the file */
-    fprintf(fp, "\n");
-    fflush(fp);
-    fclose(fp);
+    failed = om_write_objects(omp, fp);
+    if (fclose(fp)) failed = EIO;
 
 #if 0 // error
     unlink(om_name);
@@ -963,9 +2441,593 @@ om_write (object_manager_t *omp)
 #endif
     OBJ_READ_UNLOCK(omp);
 
+    return failed;
+}
+
+/*
+ * The child only has the thread which forked it & a private copy of
+ * the memory as it was then, so it neither locks nor allocates from
+ * the object manager.  The file is written under a temporary name and
+ * renamed over the real one only when complete, so a snapshot which
+ * fails half way never replaces a good one.
+ */
+static void
+om_snapshot_child (object_manager_t *omp)
+{
+    FILE *fp;
+    char om_name [TYPICAL_NAME_SIZE];
+    char snapshot_name [TYPICAL_NAME_SIZE + 16];
+    int failed;
+
+    sprintf(om_name, "om_%d", omp->manager_id);
+    sprintf(snapshot_name, "%s_snapshot", om_name);
+    fp = fopen(snapshot_name, "w");
+    if (NULL == fp) _exit(1);
+    failed = om_write_objects(omp, fp);
+    if (fsync(fileno(fp))) failed = EIO;
+    if (fclose(fp)) failed = EIO;
+    if (failed) {
+        unlink(snapshot_name);
+        _exit(1);
+    }
+    om_file_backup(om_name);
+    _exit(rename(snapshot_name, om_name) ? 1 : 0);
+}
+
+PUBLIC int
+om_snapshot_start (object_manager_t *omp, om_snapshot_t *snapshot)
+{
+    pid_t pid;
+    int failed;
+
+    /* no writer can be half way thru a change while forking */
+    OBJ_READ_LOCK(omp);
+    pid = fork();
+    if (0 == pid) om_snapshot_child(omp);
+    failed = (pid < 0) ? errno : 0;
+    OBJ_READ_UNLOCK(omp);
+
+    if (failed) {
+        ERROR(&om_debug, "could not fork the snapshot writer (%d)\n", failed);
+        pid = 0;
+    }
+    snapshot->writer = pid;
+    return failed;
+}
+
+PUBLIC int
+om_snapshot_wait (om_snapshot_t *snapshot)
+{
+    int status;
+
+    if (snapshot->writer <= 0) return ECHILD;
+    while (waitpid(snapshot->writer, &status, 0) < 0) {
+        if (errno != EINTR) return errno;
+    }
+    snapshot->writer = 0;
+    if (WIFEXITED(status) && (0 == WEXITSTATUS(status))) return 0;
+    return EIO;
+}
+
+/******************************************************************************
+ *
+ * Sharing the object manager with other processes, see om_shared_t
+ */
+
+#define OM_SHARED_ALIGN(n)      (((n) + 7) & ~((om_offset_t) 7))
+
+static inline om_shared_image_t *
+om_shared_image (om_shared_header_t *header, int which)
+{
+    return (om_shared_image_t*) ((byte*) header +
+        OM_SHARED_ALIGN(sizeof(om_shared_header_t)) +
+        (which * header->image_size));
+}
+
+/*
+ * Readers take no lock, so anything they read from an image may be
+ * being written over at the same time.  No offset or count is ever
+ * trusted to stay within the image before being checked by this.
+ */
+static inline void *
+om_shared_at (om_shared_header_t *header, om_shared_image_t *image,
+    om_offset_t offset, om_offset_t length)
+{
+    if ((offset <= 0) || (length < 0) ||
+        (length > header->image_size) ||
+        (offset > header->image_size - length)) return NULL;
+    return (byte*) image + offset;
+}
+
+/* the record of an object in an image, NULL if it is not in it */
+static om_shared_object_t *
+om_shared_object_find (om_shared_header_t *header, om_shared_image_t *image,
+    int object_type, int object_instance)
+{
+    om_shared_object_t *records, *rec;
+    int n = image->n_objects;
+    int lo, hi, mid;
+
+    if (n <= 0) return NULL;
+    records = om_shared_at(header, image, image->objects,
+                (om_offset_t) n * sizeof(om_shared_object_t));
+    if (NULL == records) return NULL;
+    lo = 0;
+    hi = n - 1;
+    while (lo <= hi) {
+        mid = lo + ((hi - lo) / 2);
+        rec = &records[mid];
+        if ((rec->object_type == object_type) &&
+            (rec->object_instance == object_instance)) return rec;
+        if ((rec->object_type < object_type) ||
+            ((rec->object_type == object_type) &&
+             (rec->object_instance < object_instance))) {
+                lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return NULL;
+}
+
+static inline int
+object_attribute_count (object_t *obj)
+{
+    return obj->n_inline_attributes +
+        (obj->attributes.elements ? obj->attributes.n : 0);
+}
+
+/* the i th attribute of an object, the inlined ones first */
+static void
+object_attribute_at (object_t *obj, int i,
+    int *attribute_id, int *length, byte **value)
+{
+    inline_attribute_t *iap;
+    attribute_t *ap;
+
+    if (i < obj->n_inline_attributes) {
+        iap = &obj->inline_attributes[i];
+        *attribute_id = iap->attribute_id;
+        *length = iap->attribute_value_length;
+        *value = &iap->attribute_value_data [0];
+    } else {
+        ap = (attribute_t*)
+            obj->attributes.elements[i - obj->n_inline_attributes];
+        *attribute_id = ap->attribute_id;
+        *length = ap->attribute_value_length;
+        *value = &ap->attribute_value_data [0];
+    }
+}
+
+/* how big the image of the object manager would be */
+static om_offset_t
+om_shared_image_bytes (object_manager_t *omp)
+{
+    avl_cursor_t cursor;
+    object_t *obj;
+    om_offset_t size;
+    byte *value;
+    int i, id, length, failed;
+
+    size = OM_SHARED_ALIGN(sizeof(om_shared_image_t)) +
+        ((om_offset_t) omp->om_objects.n * sizeof(om_shared_object_t));
+    for (failed = avl_cursor_first(&omp->om_objects, &cursor, (void**) &obj);
+        0 == failed; failed = avl_cursor_next(&cursor, (void**) &obj)) {
+            for (i = 0; i < object_attribute_count(obj); i++) {
+                object_attribute_at(obj, i, &id, &length, &value);
+                size += sizeof(om_shared_attribute_t) +
+                    OM_SHARED_ALIGN(length);
+            }
+    }
+    return size;
+}
+
+/* attributes of an object are few, inlined ones are not in any order */
+static void
+om_shared_attributes_sort (om_shared_attribute_t *attributes, int n)
+{
+    om_shared_attribute_t moved;
+    int i, j;
+
+    for (i = 1; i < n; i++) {
+        moved = attributes[i];
+        for (j = i; (j > 0) &&
+            (attributes[j - 1].attribute_id > moved.attribute_id); j--) {
+                attributes[j] = attributes[j - 1];
+        }
+        attributes[j] = moved;
+    }
+}
+
+/*
+ * Writes the image of the object manager, which must fit.  The object
+ * records are written in the order of 'om_objects', with the attributes
+ * & values of every one following all the records.  Then they are
+ * linked to their parents in reverse order, so that prepending every
+ * child to the list of its parent leaves the lists in order too.
+ */
+static void
+om_shared_image_fill (om_shared_header_t *header, om_shared_image_t *image,
+    object_manager_t *omp)
+{
+    byte *base = (byte*) image;
+    om_shared_object_t *records, *rec, *parent;
+    om_shared_attribute_t *sap;
+    avl_cursor_t cursor;
+    object_t *obj;
+    om_offset_t next;
+    byte *value;
+    int n = 0, i, failed, pt, pi;
+
+    image->n_objects = omp->om_objects.n;
+    image->objects = OM_SHARED_ALIGN(sizeof(om_shared_image_t));
+    records = (om_shared_object_t*) (base + image->objects);
+    next = image->objects +
+        ((om_offset_t) image->n_objects * sizeof(om_shared_object_t));
+
+    for (failed = avl_cursor_first(&omp->om_objects, &cursor, (void**) &obj);
+        0 == failed; failed = avl_cursor_next(&cursor, (void**) &obj)) {
+            rec = &records[n++];
+            rec->object_type = obj->object_type;
+            rec->object_instance = obj->object_instance;
+            rec->parent = rec->first_child = rec->next_sibling = 0;
+            rec->n_children = 0;
+            rec->n_attributes = object_attribute_count(obj);
+            rec->attributes = rec->n_attributes ? next : 0;
+            sap = (om_shared_attribute_t*) (base + next);
+            next += rec->n_attributes * sizeof(om_shared_attribute_t);
+            for (i = 0; i < rec->n_attributes; i++) {
+                object_attribute_at(obj, i, &sap[i].attribute_id,
+                    &sap[i].attribute_value_length, &value);
+                sap[i].attribute_value = next;
+                if (sap[i].attribute_value_length > 0) {
+                    memcpy(base + next, value, sap[i].attribute_value_length);
+                }
+                next += OM_SHARED_ALIGN(sap[i].attribute_value_length);
+            }
+            om_shared_attributes_sort(sap, rec->n_attributes);
+    }
+    image->size = next;
+
+    for (failed = avl_cursor_last(&omp->om_objects, &cursor, (void**) &obj);
+        0 == failed; failed = avl_cursor_prev(&cursor, (void**) &obj)) {
+            rec = &records[--n];
+            get_ot_and_oi(&obj->parent, &pt, &pi);
+            parent = om_shared_object_find(header, image, pt, pi);
+            if (NULL == parent) continue;
+            rec->parent = (byte*) parent - base;
+            rec->next_sibling = parent->first_child;
+            parent->first_child = (byte*) rec - base;
+            parent->n_children++;
+    }
+}
+
+/*
+ * The image readers are not on is written, made the current one &
+ * left alone till the next publication.  So a reader which is still
+ * on it from before the previous publication needs to be held up for
+ * two whole publications to see its sequence change.
+ */
+PUBLIC int
+om_shared_publish (om_shared_t *shp, object_manager_t *omp)
+{
+    om_shared_header_t *header = shp->header;
+    om_shared_image_t *image;
+    int next;
+
+    if (!shp->writer) return EPERM;
+    grab_write_lock(&shp->publish_lock);
+    OBJ_READ_LOCK(omp);
+    if (om_shared_image_bytes(omp) > header->image_size) {
+        OBJ_READ_UNLOCK(omp);
+        release_write_lock(&shp->publish_lock);
+        return ENOSPC;
+    }
+    next = 1 - header->current;
+    image = om_shared_image(header, next);
+
+    image->sequence++;
+
+    /* odd sequence must be visible before any of the changes */
+    __sync_synchronize();
+    om_shared_image_fill(header, image, omp);
+    __atomic_store_n(&image->sequence, image->sequence + 1, __ATOMIC_RELEASE);
+
+    header->manager_id = omp->manager_id;
+    header->publications++;
+    __atomic_store_n(&header->current, next, __ATOMIC_RELEASE);
+    OBJ_READ_UNLOCK(omp);
+    release_write_lock(&shp->publish_lock);
+
+    return 0;
+}
+
+PUBLIC int
+om_shared_create (om_shared_t *shp, char *name, long long int image_size)
+{
+    om_shared_header_t *header;
+    size_t size;
+    void *segment;
+    int fd, failed = 0;
+
+    if ((image_size <= 0) || (strlen(name) >= TYPICAL_NAME_SIZE))
+        return EINVAL;
+    image_size = OM_SHARED_ALIGN(image_size);
+    size = OM_SHARED_ALIGN(sizeof(om_shared_header_t)) + (2 * image_size);
+
+    shm_unlink(name);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        failed = errno;
+        ERROR(&om_debug, "could not create segment %s (%d)\n", name, failed);
+        return failed;
+    }
+
+    /* comes all zeroes, so neither image has a sequence yet */
+    if (ftruncate(fd, size)) failed = errno;
+    segment = failed ? MAP_FAILED :
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if ((0 == failed) && (MAP_FAILED == segment)) failed = errno;
+    close(fd);
+    if (failed) {
+        ERROR(&om_debug, "could not map segment %s (%d)\n", name, failed);
+        shm_unlink(name);
+        return failed;
+    }
+
+    header = segment;
+    header->manager_id = -1;
+    header->image_size = image_size;
+    header->current = 0;
+    header->publications = 0;
+
+    /* a header is valid only once it has the magic */
+    __atomic_store_n(&header->magic, OM_SHARED_MAGIC, __ATOMIC_RELEASE);
+
+    strcpy(shp->name, name);
+    shp->writer = TRUE;
+    lock_obj_init(&shp->publish_lock);
+    shp->header = header;
+    shp->segment_size = size;
+    return 0;
+}
+
+PUBLIC int
+om_shared_attach (om_shared_t *shp, char *name)
+{
+    om_shared_header_t *header;
+    struct stat st;
+    void *segment;
+    int fd, failed = 0;
+
+    if (strlen(name) >= TYPICAL_NAME_SIZE) return EINVAL;
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return errno;
+    if (fstat(fd, &st)) failed = errno;
+    else if (st.st_size < (off_t) sizeof(om_shared_header_t)) failed = EINVAL;
+    segment = failed ? MAP_FAILED :
+        mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if ((0 == failed) && (MAP_FAILED == segment)) failed = errno;
+    close(fd);
+    if (failed) return failed;
+
+    header = segment;
+    if ((__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != OM_SHARED_MAGIC)
+        || (header->image_size <= 0) ||
+        (header->image_size > (st.st_size / 2)) ||
+        ((off_t) (OM_SHARED_ALIGN(sizeof(om_shared_header_t)) +
+            (2 * header->image_size)) > st.st_size)) {
+                munmap(segment, st.st_size);
+                return EINVAL;
+    }
+
+    strcpy(shp->name, name);
+    shp->writer = FALSE;
+    shp->header = header;
+    shp->segment_size = st.st_size;
     return 0;
 }
 
+PUBLIC void
+om_shared_detach (om_shared_t *shp)
+{
+    if (NULL == shp->header) return;
+    munmap(shp->header, shp->segment_size);
+    if (shp->writer) {
+        shm_unlink(shp->name);
+        lock_obj_destroy(&shp->publish_lock);
+    }
+    shp->header = NULL;
+    shp->segment_size = 0;
+}
+
+/*
+ * Returns the current image with its (even) sequence to read it at,
+ * or NULL if nothing is published yet.  What is read from it is only
+ * good if 'om_shared_read_end' says the sequence did not change.
+ */
+static om_shared_image_t *
+om_shared_read_begin (om_shared_t *shp, unsigned int *sequence)
+{
+    om_shared_header_t *header = shp->header;
+    om_shared_image_t *image;
+
+    while (1) {
+        image = om_shared_image(header,
+                    __atomic_load_n(&header->current, __ATOMIC_ACQUIRE) & 1);
+        *sequence = __atomic_load_n(&image->sequence, __ATOMIC_ACQUIRE);
+        if (0 == *sequence) return NULL;
+        if (0 == (*sequence & 1)) return image;
+        sched_yield();
+    }
+}
+
+static inline boolean
+om_shared_read_end (om_shared_image_t *image, unsigned int sequence)
+{
+    /* all of the reads must be done before checking again */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return sequence == image->sequence;
+}
+
+PUBLIC int
+om_shared_object_count (om_shared_t *shp)
+{
+    om_shared_image_t *image;
+    unsigned int sequence;
+    int n;
+
+    do {
+        image = om_shared_read_begin(shp, &sequence);
+        if (NULL == image) return 0;
+        n = image->n_objects;
+    } while (!om_shared_read_end(image, sequence));
+    return n;
+}
+
+PUBLIC bool
+om_shared_object_exists (om_shared_t *shp,
+        int object_type, int object_instance)
+{
+    om_shared_image_t *image;
+    unsigned int sequence;
+    bool found;
+
+    do {
+        image = om_shared_read_begin(shp, &sequence);
+        if (NULL == image) return false;
+        found = (NULL != om_shared_object_find(shp->header, image,
+                            object_type, object_instance));
+    } while (!om_shared_read_end(image, sequence));
+    return found;
+}
+
+PUBLIC int
+om_shared_parent_get (om_shared_t *shp,
+        int object_type, int object_instance,
+        int *parent_object_type, int *parent_object_instance)
+{
+    om_shared_image_t *image;
+    om_shared_object_t *rec, *parent;
+    unsigned int sequence;
+    int pt, pi, failed;
+
+    do {
+        image = om_shared_read_begin(shp, &sequence);
+        if (NULL == image) return EAGAIN;
+        failed = ENODATA;
+        pt = pi = -1;
+        rec = om_shared_object_find(shp->header, image,
+                object_type, object_instance);
+        if (rec) {
+            failed = 0;
+            parent = om_shared_at(shp->header, image, rec->parent,
+                        sizeof(om_shared_object_t));
+            if (parent) {
+                pt = parent->object_type;
+                pi = parent->object_instance;
+            }
+        }
+    } while (!om_shared_read_end(image, sequence));
+
+    if (0 == failed) {
+        *parent_object_type = pt;
+        *parent_object_instance = pi;
+    }
+    return failed;
+}
+
+PUBLIC int
+om_shared_attribute_get (om_shared_t *shp,
+        int object_type, int object_instance,
+        int attribute_id,
+        int *returned_length, int max_length, byte *returned_value)
+{
+    om_shared_image_t *image;
+    om_shared_object_t *rec;
+    om_shared_attribute_t *attributes, *sap;
+    unsigned int sequence;
+    byte *value;
+    int lo, hi, mid, n, length = 0, failed;
+
+    do {
+        image = om_shared_read_begin(shp, &sequence);
+        if (NULL == image) return EAGAIN;
+        failed = ENODATA;
+        rec = om_shared_object_find(shp->header, image,
+                object_type, object_instance);
+        n = rec ? rec->n_attributes : 0;
+        attributes = rec ?
+            om_shared_at(shp->header, image, rec->attributes,
+                (om_offset_t) n * sizeof(om_shared_attribute_t)) : NULL;
+        lo = 0;
+        hi = attributes ? (n - 1) : -1;
+        while (lo <= hi) {
+            mid = lo + ((hi - lo) / 2);
+            sap = &attributes[mid];
+            if (sap->attribute_id < attribute_id) {
+                lo = mid + 1;
+            } else if (sap->attribute_id > attribute_id) {
+                hi = mid - 1;
+            } else {
+                length = sap->attribute_value_length;
+                value = om_shared_at(shp->header, image,
+                            sap->attribute_value, length);
+                if (NULL == value) {
+                    failed = ENODATA;
+                } else if (length > max_length) {
+                    failed = ENOSPC;
+                } else {
+                    failed = 0;
+                    if (length > 0) memcpy(returned_value, value, length);
+                }
+                break;
+            }
+        }
+    } while (!om_shared_read_end(image, sequence));
+
+    if (0 == failed) *returned_length = length;
+    return failed;
+}
+
+PUBLIC int
+om_shared_children_get (om_shared_t *shp,
+        int object_type, int object_instance,
+        object_identifier_t *children, int max_children, int *n_children)
+{
+    om_shared_image_t *image;
+    om_shared_object_t *rec;
+    unsigned int sequence;
+    int n, failed;
+    om_offset_t limit =
+        shp->header->image_size / sizeof(om_shared_object_t);
+
+    do {
+        image = om_shared_read_begin(shp, &sequence);
+        if (NULL == image) return EAGAIN;
+        n = 0;
+        rec = om_shared_object_find(shp->header, image,
+                object_type, object_instance);
+        failed = rec ? 0 : ENODATA;
+
+        /* a torn list could be a loop, none is longer than what fits */
+        if (rec) rec = om_shared_at(shp->header, image, rec->first_child,
+                            sizeof(om_shared_object_t));
+        while (rec && (n < limit)) {
+            if (n < max_children) {
+                children[n].object_type = rec->object_type;
+                children[n].object_instance = rec->object_instance;
+            }
+            n++;
+            rec = om_shared_at(shp->header, image, rec->next_sibling,
+                        sizeof(om_shared_object_t));
+        }
+    } while (!om_shared_read_end(image, sequence));
+
+    *n_children = n;
+    return failed;
+}
+
 /*************** Reading back from a file functions ******************/
 
 static int
@@ -987,52 +3049,53 @@ load_object (object_manager_t *omp, FILE *fp,
 
 static int
 load_attribute_id (object_manager_t *omp, FILE *fp,
-    object_t *obj, attribute_t **aipp)
+    object_t *obj, int *aidp)
 {
-    int aid;
-
     /* we should NOT have a NULL object at this point */
     if (NULL == obj) return -1;
 
-    if (fscanf(fp, "%d", &aid) != 1)
-        return -1;
-    *aipp = obj_attribute_add(obj, aid);
-    if (NULL == *aipp)
+    if (fscanf(fp, "%d", aidp) != 1)
         return -1;
 
     return 0;
 }
 
+/*
+ * Values were once reference counted lists of integers & byte strings.
+ * Now an attribute has exactly one value, a byte sequence, so the
+ * reference count is only read past, and a simple value becomes the
+ * 8 byte integer it always was.  Of several values, the last one stays.
+ */
 static int
 load_attribute_simple_value (object_manager_t *omp, FILE *fp,
-    attribute_t *aip)
+    object_t *obj, int aid)
 {
     long long int value;
     int ref_count;
 
     /* we should NOT have a NULL attribute id at this point */
-    if (NULL == aip) return -1;
+    if ((NULL == obj) || (aid < 0)) return -1;
 
     if (fscanf(fp, " %d %lld", &ref_count, &value) != 2) return -1;
     return
-        attribute_simple_value_add(aip, value, ref_count-1);
-
-    return 0;
+        attribute_add_engine(omp, obj, aid,
+            sizeof(long long int), (byte*) &value);
 }
 
 static int
 load_attribute_complex_value (object_manager_t *omp, FILE *fp,
-    attribute_t *aip)
+    object_t *obj, int aid)
 {
     byte *value;
-    int i, len, ref_count;
+    int i, len, ref_count, data;
     int err;
 
     /* we should NOT have a NULL attribute id at this point */
-    if (NULL == aip) return -1;
+    if ((NULL == obj) || (aid < 0)) return -1;
 
     /* read ref count & length */
     if (fscanf(fp, "%d %d ", &ref_count, &len) != 2) return -1;
+    if (len < 0) return -1;
 
     /* allocate temp space */
     value = (byte*) malloc(len + 1);
@@ -1040,14 +3103,15 @@ load_attribute_complex_value (object_manager_t *omp, FILE *fp,
 
     /* read each data byte in */
     for (i = 0; i < len; i++) {
-        if (fscanf(fp, "%d", (int*) (&value[i])) != 1) {
+        if (fscanf(fp, "%d", &data) != 1) {
             free(value);
             return -1;
         }
+        value[i] = (byte) data;
     }
 
-    /* add complex value to the attribute */
-    err = attribute_complex_value_add(aip, value, len, ref_count-1);
+    /* add the value to the attribute */
+    err = attribute_add_engine(omp, obj, aid, len, value);
 
     /* free up temp storage */
     free(value);
@@ -1058,7 +3122,9 @@ load_attribute_complex_value (object_manager_t *omp, FILE *fp,
 
 /*
  * This function is called on every object and resolves its parent
- * pointer if it is not already in the form of a pointer.
+ * pointer if it is not already in the form of a pointer.  An object
+ * whose parent was not there yet when it was created, is not amongst
+ * the children of its parent yet either.
  */
 static int
 resolve_parent_tfn (void *utility_object, void *utility_node,
@@ -1070,13 +3136,15 @@ resolve_parent_tfn (void *utility_object, void *utility_node,
 
     omp = (object_manager_t*) v_omp;
     obj = (object_t*) user_data;
-    if (!(obj->parent.is_pointer)) {
+    if (NULL == handle_resolve(&omp->object_handles,
+                    obj->parent.object_handle)) {
         parent = get_object_pointer(omp,
-                    obj->parent.u.object_id.object_type,
-                    obj->parent.u.object_id.object_instance);
+                    obj->parent.object_id.object_type,
+                    obj->parent.object_id.object_instance);
         if (parent) {
-            obj->parent.is_pointer = TRUE;
-            obj->parent.u.object_ptr = parent;
+            obj->parent.object_handle = parent->handle;
+            if (lifo_add_data(&parent->children, obj, &obj->child_handle))
+                return ENOMEM;
         }
     }
     return 0;
@@ -1087,10 +3155,10 @@ om_resolve_all_parents (object_manager_t *omp)
 {
     void *unused = NULL;
 
-    avl_tree_morris_traverse(&omp->om_objects, NULL,
-        resolve_parent_tfn, omp, 
-        unused, unused, unused);
-    return 0;
+    return
+        avl_tree_morris_traverse(&omp->om_objects, NULL,
+            resolve_parent_tfn, omp,
+            unused, unused, unused);
 }
 
 PUBLIC int
@@ -1099,8 +3167,8 @@ om_read (int manager_id, object_manager_t *omp)
     char om_name [TYPICAL_NAME_SIZE];
     FILE *fp;
     int failed, count;
-    object_t *obj, *parent;
-    attribute_t *aip;
+    object_t *obj;
+    int aid;
     char string [TYPICAL_NAME_SIZE];
 
     sprintf(om_name, "om_%d", manager_id);
@@ -1112,8 +3180,8 @@ om_read (int manager_id, object_manager_t *omp)
         return -1;
     }
 
-    obj = parent = NULL;
-    aip = NULL;
+    obj = NULL;
+    aid = -1;
     failed = 0;
 
     while ((count = fscanf(fp, "%s", string)) != EOF) {
@@ -1122,22 +3190,23 @@ om_read (int manager_id, object_manager_t *omp)
         if (count != 1) continue;
 
         if (strcmp(string, object_acronym) == 0) {
+            aid = -1;
             if (load_object(omp, fp, &obj) != 0) {
                 failed = -1;
                 break;
             }
         } else if (strcmp(string, attribute_id_acronym) == 0) {
-            if (load_attribute_id(omp, fp, obj, &aip) != 0) {
+            if (load_attribute_id(omp, fp, obj, &aid) != 0) {
                 failed = -1;
                 break;
             }
         } else if (strcmp(string, attribute_simple_value_acronym) == 0) {
-            if (load_attribute_simple_value(omp, fp, aip) != 0) {
+            if (load_attribute_simple_value(omp, fp, obj, aid) != 0) {
                 failed = -1;
                 break;
             }
         } else if (strcmp(string, attribute_complex_value_acronym) == 0) {
-            if (load_attribute_complex_value(omp, fp, aip) != 0) {
+            if (load_attribute_complex_value(omp, fp, obj, aid) != 0) {
                 failed = -1;
                 break;
             }
@@ -74,6 +74,7 @@
 extern "C" {
 #endif
 
+#include <limits.h>
 #include "common.h"
 #include "debug_framework.h"
 #include "mem_monitor_object.h"
@@ -81,14 +82,20 @@ extern "C" {
 #include "avl_tree_object.h"
 #include "index_object.h"
 #include "lifo.h"
+#include "handle_table.h"
+#include "epoch_manager.h"
 #include "assert.h"
 
 #define TYPICAL_NAME_SIZE                       (64)
 
 typedef struct attribute_s attribute_t;
+typedef struct inline_attribute_s inline_attribute_t;
 typedef struct object_identifier_s object_identifier_t;
 typedef struct object_representation_s object_representation_t;
 typedef struct object_s object_t;
+typedef struct om_attribute_index_s om_attribute_index_t;
+typedef struct om_lookup_node_s om_lookup_node_t;
+typedef struct om_lookup_table_s om_lookup_table_t;
 typedef struct object_manager_s object_manager_t;
 
 /******************************************************************************
@@ -121,6 +128,25 @@ struct attribute_s {
     byte attribute_value_data [0];  /* the attribute value itself in bytes */
 };
 
+/*
+ * Most attributes are small integers.  Allocating an attribute_t for
+ * each, with its own memory header & an index entry pointing to it,
+ * scatters a typical object over a dozen cache lines.  So, the first
+ * OM_INLINE_ATTRIBUTES attributes whose values fit into
+ * OM_INLINE_VALUE_SIZE bytes are kept right inside the object instead.
+ * Only bigger values, or the ones which do not fit in there any more,
+ * go into the 'attributes' index of the object.  An attribute is only
+ * ever in one of the two places.
+ */
+#define OM_INLINE_ATTRIBUTES            8
+#define OM_INLINE_VALUE_SIZE            8
+
+struct inline_attribute_s {
+    int attribute_id;
+    int attribute_value_length;
+    byte attribute_value_data [OM_INLINE_VALUE_SIZE];
+};
+
 /******************************************************************************
  *
  * object related structures
@@ -139,20 +165,19 @@ struct object_identifier_s {
 };
 
 /*
- * Internal APIs mostly use pointers since they are more protected.
- * and pointers are safe to use.  So, this one type can be used both 
- * for user facing APIs as well as internal uses.
+ * Internal APIs refer to an object by its handle in the object
+ * manager's handle table rather than by a raw pointer.  A handle of
+ * an object which is removed simply stops resolving, so it can never
+ * point to freed memory.  The identifier is always kept too, so the
+ * object can still be found if it did not exist when the handle was
+ * to be obtained, or if it is removed & created again.
  */
 struct object_representation_s {
 
-    /* set if the representation is a pointer */
-    tinybool is_pointer;
+    object_identifier_t object_id;
 
-    /* which address type to use */
-    union {
-        object_identifier_t object_id;
-        object_t *object_ptr;
-    } u;
+    /* NULL_HANDLE if not (yet) known */
+    handle_t object_handle;
 
 };
 
@@ -169,6 +194,9 @@ struct object_s {
     int object_type;
     int object_instance;
 
+    /* how this object is referred to by others, see 'object_handles' */
+    handle_t handle;
+
     /*
      * Parent of this object.  If object is root, it has no parent.
      */ 
@@ -187,7 +215,19 @@ struct object_s {
     lifo_node_t *child_handle;
 
     /*
-     * All the attributes of this objectllows very fast retreival of
+     * Odd while the attributes of the object are being changed.  Lets
+     * readers copy an inline attribute without any lock & know if it
+     * changed while they were copying it, in which case they retry.
+     */
+    volatile unsigned int attribute_sequence;
+
+    /* small attributes, in no particular order */
+    int n_inline_attributes;
+    inline_attribute_t inline_attributes [OM_INLINE_ATTRIBUTES];
+
+    /*
+     * Rest of the attributes, created only when the first one which
+     * cannot be inlined is added.  This allows very fast retreival of
      * attributes altho they would be slower to insert & delete but
      * it is not expected to add/delete attributes to an object very
      * often.  The VALUE of an attribute may be changed but its existence
@@ -197,6 +237,283 @@ struct object_s {
 
 };
 
+/******************************************************************************
+ *
+ * lock free object lookup
+ *
+ */
+
+/*
+ * A hash table of all the objects by (type, instance), which mirrors
+ * 'om_objects' for readers which only need to find an object by its
+ * identifier.  Writers change it under the write lock of the object
+ * manager, as they do everything else, but readers go thru it without
+ * taking any lock, inside an epoch of the object manager.  Nodes are
+ * only ever published & unlinked by single pointer stores, and nothing
+ * unlinked (nodes, removed objects or the whole table when it grows)
+ * is freed until no reader can possibly be looking at it any more.
+ */
+struct om_lookup_node_s {
+    om_lookup_node_t * volatile next;
+    int object_type;
+    int object_instance;
+    object_t *object;
+};
+
+struct om_lookup_table_s {
+    int n_buckets;                  /* always a power of 2 */
+    om_lookup_node_t * volatile buckets [0];
+};
+
+#define OM_LOOKUP_INITIAL_BUCKETS       64
+
+/******************************************************************************
+ *
+ * secondary attribute value indexes
+ *
+ */
+
+/*
+ * Optional index of the values of one attribute of all the objects of
+ * one type, so that objects can be found by an attribute value without
+ * looking at every object.  Only integer values (1, 2, 4 or 8 bytes
+ * long) are indexed, which is what most attributes are.  Entries are
+ * sorted by value, then object instance, so ranges of values can be
+ * looked up as fast as single values.
+ *
+ * Every index is kept up to date as attributes are added, changed &
+ * removed and as objects are removed, so each costs a little on all
+ * of those operations for the objects of its type.
+ */
+struct om_attribute_index_s {
+
+    int object_type;
+    int attribute_id;
+
+    /* of (value, object instance) entries */
+    avl_tree_t entries;
+
+    om_attribute_index_t *next;
+};
+
+/******************************************************************************
+ *
+ * object cursors
+ *
+ */
+
+/*
+ * Enumerates the objects of one type whose instances are in a range,
+ * a batch at a time, forwards in increasing instance order or
+ * backwards in decreasing order.  Objects are kept sorted by (type,
+ * instance) so every batch is found in O(log n + k) without looking
+ * at any objects of other types.
+ *
+ * The cursor is a position between two instances.  A batch forwards
+ * returns the objects after it & one backwards the objects before it,
+ * each leaving the position after the last object returned.  So going
+ * back after going forward returns the last object again.
+ *
+ * The cursor holds no pointers into the object manager, only its
+ * position, so it is never invalidated & objects can be created or
+ * removed between batches.  Objects created behind the position are
+ * simply not seen by batches in the same direction.
+ */
+typedef struct om_cursor_s {
+
+    int object_type;
+    int low_instance;
+    int high_instance;
+
+    /* the position is just before this instance */
+    int next_instance;
+
+    /* set once the position is past the end of the range */
+    boolean done;
+
+} om_cursor_t;
+
+/******************************************************************************
+ *
+ * batched write transactions
+ *
+ */
+
+/*
+ * A transaction stages object creations & attribute changes without
+ * touching the object manager and then applies all of them under a
+ * single acquisition of the write lock.  Either all of them are
+ * applied or, if any one fails, the ones already applied are undone
+ * and the object manager is left as it was.
+ *
+ * Staged operations are sorted by object before they are applied, so
+ * consecutive inserts into the indexes are next to each other.  All
+ * creations are applied before any attribute change, the operations
+ * on the same object stay in the order they were staged and an object
+ * whose parent is created in the same transaction is created after it.
+ */
+#define OM_OP_OBJECT_CREATE             1
+#define OM_OP_ATTRIBUTE_ADD             2
+#define OM_OP_ATTRIBUTE_REMOVE          3
+
+typedef struct om_transaction_op_s {
+
+    int op;
+
+    /* order in which it was staged */
+    int sequence;
+
+    int object_type;
+    int object_instance;
+
+    /* OM_OP_OBJECT_CREATE only */
+    int parent_object_type;
+    int parent_object_instance;
+
+    /* attribute operations only, the value is owned by the transaction */
+    int attribute_id;
+    int attribute_value_length;
+    byte *attribute_value;
+
+    /* filled in while committing, to be able to undo it */
+    boolean applied;
+    object_t *created;
+    boolean had_value;
+    int old_value_length;
+    byte *old_value;
+    byte old_value_data [OM_INLINE_VALUE_SIZE];
+
+} om_transaction_op_t;
+
+typedef struct om_transaction_s {
+
+    object_manager_t *omp;
+
+    om_transaction_op_t *ops;
+    int n_ops;
+    int max_ops;
+
+    /* sequence of the operation which failed the last commit, or -1 */
+    int failed_op;
+
+} om_transaction_t;
+
+/******************************************************************************
+ *
+ * background snapshots
+ *
+ */
+
+typedef struct om_snapshot_s {
+
+    /* the child process writing the snapshot, 0 if none */
+    pid_t writer;
+
+} om_snapshot_t;
+
+/******************************************************************************
+ *
+ * sharing with other processes
+ *
+ */
+
+/*
+ * The objects, their links & their attributes can be published into a
+ * named shared memory segment, so that other processes can read them
+ * without each building its own copy of the object manager.
+ *
+ * What is published is an image, a flat copy of everything in which
+ * every link is an offset from the start of the image, since the
+ * segment is mapped at a different address in every process.  The
+ * object records are sorted by (type, instance), which makes them the
+ * index to find an object by, every object record links to its parent,
+ * first child & next sibling and to the sorted array of its attributes.
+ * An offset of 0 (the image header itself) means none.
+ *
+ * The segment has room for two images.  The one process which owns the
+ * object manager publishes into the one readers are not using & then
+ * switches the readers to it.  Readers take no lock at all.  Every image
+ * has a sequence number which is odd while it is being written, so a
+ * reader which happened to be reading an image while it was written
+ * over (it takes two publications during a single read) will know it
+ * & simply read again.
+ */
+typedef long long int om_offset_t;
+
+typedef struct om_shared_attribute_s {
+
+    int attribute_id;
+    int attribute_value_length;
+    om_offset_t attribute_value;
+
+} om_shared_attribute_t;
+
+typedef struct om_shared_object_s {
+
+    int object_type;
+    int object_instance;
+
+    om_offset_t parent;
+    om_offset_t first_child;
+    om_offset_t next_sibling;
+
+    /* sorted by attribute id */
+    om_offset_t attributes;
+    int n_attributes;
+
+    int n_children;
+
+} om_shared_object_t;
+
+typedef struct om_shared_image_s {
+
+    /* odd while the image is being written */
+    volatile unsigned int sequence;
+
+    int n_objects;
+
+    /* sorted by (type, instance) */
+    om_offset_t objects;
+
+    /* how much of the image is used */
+    om_offset_t size;
+
+} om_shared_image_t;
+
+#define OM_SHARED_MAGIC                 0x4f4d5348
+
+typedef struct om_shared_header_s {
+
+    unsigned int magic;
+
+    /* of the object manager last published */
+    int manager_id;
+
+    /* the two images follow the header, each this big */
+    om_offset_t image_size;
+
+    /* the image readers should be reading, 0 or 1 */
+    volatile int current;
+
+    unsigned long long int publications;
+
+} om_shared_header_t;
+
+typedef struct om_shared_s {
+
+    char name [TYPICAL_NAME_SIZE];
+
+    /* only the process which created the segment can publish into it */
+    boolean writer;
+
+    /* one publication at a time, they all flip the same 'current' */
+    lock_obj_t publish_lock;
+
+    om_shared_header_t *header;
+    size_t segment_size;
+
+} om_shared_t;
+
 /******************************************************************************
  *
  * object manager related structures
@@ -229,6 +546,19 @@ struct object_manager_s {
      */
     avl_tree_t om_objects;
 
+    /* every object has a handle in here, as long as it exists */
+    handle_table_t object_handles;
+
+    /*
+     * lock free lookup & the epochs of its readers, which also defer
+     * freeing the removed objects, so lock free readers are safe
+     */
+    om_lookup_table_t * volatile lookup;
+    epoch_manager_t epochs;
+
+    /* secondary indexes, usually none or very few */
+    om_attribute_index_t *attribute_indexes;
+
 }; 
 
 /************* User functions ************************************************/
@@ -259,6 +589,7 @@ om_object_create (object_manager_t *omp,
 
 /*
  * returns true if the specified object exists in the object manager.
+ * Takes no lock, so it never waits for & never delays any writer.
  */
 extern bool
 om_object_exists (object_manager_t *omp,
@@ -268,6 +599,57 @@ static inline int
 om_object_count (object_manager_t *omp)
 { return omp->om_objects.n; }
 
+/*
+ * positions the cursor at the start of the instance range
+ * 'low_instance' to 'high_instance' (inclusive) of 'object_type'
+ */
+static inline void
+om_cursor_init (om_cursor_t *cursor, int object_type,
+    int low_instance, int high_instance)
+{
+    cursor->object_type = object_type;
+    cursor->low_instance = cursor->next_instance = low_instance;
+    cursor->high_instance = high_instance;
+    cursor->done = (low_instance > high_instance);
+}
+
+/*
+ * positions the cursor at the first object of a type, to enumerate all
+ */
+static inline void
+om_cursor_init_type (om_cursor_t *cursor, int object_type)
+{ om_cursor_init(cursor, object_type, INT_MIN, INT_MAX); }
+
+/*
+ * Fills 'batch' with the identifiers of at most 'max_batch' of the next
+ * objects of the cursor & places how many into 'n_returned'.  Returns 0
+ * if at least one object was returned or ENODATA when there are no
+ * more objects in the range.
+ */
+extern int
+om_cursor_next_batch (object_manager_t *omp, om_cursor_t *cursor,
+    object_identifier_t *batch, int max_batch, int *n_returned);
+
+/*
+ * Same as above, backwards from the position of the cursor, so the
+ * batch is in decreasing instance order.
+ */
+extern int
+om_cursor_prev_batch (object_manager_t *omp, om_cursor_t *cursor,
+    object_identifier_t *batch, int max_batch, int *n_returned);
+
+/*
+ * moves the position of the cursor to just before 'instance', or to
+ * the nearest end of its range if 'instance' is outside of it
+ */
+static inline void
+om_cursor_seek (om_cursor_t *cursor, int instance)
+{
+    if (instance < cursor->low_instance) instance = cursor->low_instance;
+    cursor->next_instance = instance;
+    cursor->done = (instance > cursor->high_instance);
+}
+
 /*
  * add (modify if it already exists) an attribute (id) to an object.
  *
@@ -307,6 +689,9 @@ om_attribute_exists (object_manager_t *omp,
  * the attribute, then the operation will fail and an error will be
  * returned from the function.  Otherwise a successful copy will
  * be done and a 0 will be returned as the function value.
+ *
+ * Inlined attributes (see OM_INLINE_ATTRIBUTES) are read without
+ * taking any lock, only the others need the read lock.
  */
 extern int
 om_attribute_get (object_manager_t *omp,
@@ -324,6 +709,40 @@ om_attribute_remove (object_manager_t *omp,
     int object_type, int object_instance,
     int attribute_id);
 
+/*
+ * Starts indexing the values of attribute 'attribute_id' of all the
+ * objects of type 'object_type', including the already existing ones.
+ * Returns 0, EEXIST if there already is such an index or ENOMEM.
+ */
+extern int
+om_attribute_index_create (object_manager_t *omp,
+    int object_type, int attribute_id);
+
+/*
+ * Stops indexing, returns ENODATA if there was no such index.
+ */
+extern int
+om_attribute_index_destroy (object_manager_t *omp,
+    int object_type, int attribute_id);
+
+/*
+ * Finds the objects of type 'object_type' whose integer attribute
+ * 'attribute_id' is in the range 'low' to 'high' (both inclusive, so
+ * they are equal for an equality search).  At most 'max_found' of
+ * them are placed into 'found' and how many there are in total is
+ * returned in 'n_found'.
+ *
+ * With an index on the attribute, this is O(log n + k) & the objects
+ * are returned sorted by the value of the attribute.  Without one,
+ * every object of the type has to be looked at & they are returned
+ * sorted by their instance.
+ */
+extern int
+om_attribute_find (object_manager_t *omp,
+    int object_type, int attribute_id,
+    long long int low, long long int high,
+    object_identifier_t *found, int max_found, int *n_found);
+
 /*
  * get the parent type & instance of an object and
  * place them in the addresses respectively.
@@ -337,21 +756,22 @@ om_parent_get (object_manager_t *omp,
 
 /*
  * Destroys an object and all its children, including attributes,
- * values, everything.  Note that simply taking out the object from
- * the name search tree 'om_objects" and removing it from the parents'
- * children list is very fast and enough to achieve this.
- * The actual sub-tree will be completely isolated and will simply
- * be traversed to release all its sub objects/attributes in a separate
- * low priority thread in the back ground.
+ * values, everything.  The sub tree is taken apart leaf by leaf, in
+ * post order, without collecting it anywhere first, so removing a
+ * sub tree of any size needs no extra memory.  When it is most of
+ * the objects, 'om_objects' is rebuilt once rather than rebalanced
+ * for each removal.
  */
 extern int
 om_object_remove (object_manager_t *omp,
     int object_type, int object_instance);
 
 /*
- * traverses the object AND all its children applying the
- * function 'tfn' to all of them.  The parameters passed 
- * to the 'tfn' function will be:
+ * traverses all the children (all the way down, but NOT the
+ * object itself) of the specified object, depth first, in the
+ * calling thread, applying the function 'tfn' to all of them.
+ * Nothing is allocated and no state is kept in the objects.
+ * The parameters passed to the 'tfn' function will be:
  *
  *      param0: object manager pointer
  *      param1: the child pointer being traversed
@@ -361,8 +781,9 @@ om_object_remove (object_manager_t *omp,
  *      param5: p3
  *      param6: p4
  *
- * The return value is the first error encountered by 'tfn'.
- * 0 means no error was seen.
+ * The return value is the first error encountered by 'tfn',
+ * after which no more objects are traversed.  0 means no error
+ * was seen.
  */
 extern int
 om_traverse (object_manager_t *omp,
@@ -370,6 +791,94 @@ om_traverse (object_manager_t *omp,
     traverse_function_pointer tfn,
     void *p0, void *p1, void *p2, void *p3, void *p4);
 
+/*
+ * Called once for every thread of a parallel traversal, after all of
+ * them are done, with the thread's private data & 'p0' of the
+ * traversal.  The calls are made one after the other by the thread
+ * which started the traversal, so it can safely merge the results of
+ * the threads into 'p0' & free whatever the thread allocated.
+ */
+typedef void (*om_reduce_function)(void *thread_data, void *p0);
+
+#define OM_MAX_TRAVERSE_THREADS         64
+
+/*
+ * Traverses all the children (all the way down, but NOT the object
+ * itself) of the specified object with 'n_threads' threads (the
+ * calling thread being one of them), applying 'tfn' to every one.
+ * Subtrees are spread over the threads, which steal work from each
+ * other when they run out, so there is no order of any kind between
+ * the calls.  The parameters passed to the 'tfn' function will be:
+ *
+ *      param0: object manager pointer
+ *      param1: the child pointer being traversed
+ *      param2: address of a (void*) private to the calling thread,
+ *              NULL at the start, for 'tfn' to accumulate into
+ *      param3: p0
+ *      param4: p1
+ *      param5: p2
+ *      param6: p3
+ *
+ * Then 'rfn' (if not NULL) is called for the private data of every
+ * thread.  None of the state of the traversal is kept in the objects,
+ * so any number of traversals can run at the same time, although
+ * the object manager cannot be modified while any one is running.
+ *
+ * The return value is the first error returned by 'tfn', after which
+ * no more objects are traversed, ENOMEM or 0.
+ */
+extern int
+om_traverse_parallel (object_manager_t *omp,
+    int object_type, int object_instance,
+    int n_threads,
+    traverse_function_pointer tfn, om_reduce_function rfn,
+    void *p0, void *p1, void *p2, void *p3);
+
+/*
+ * Starts an empty transaction on the object manager.
+ */
+extern int
+om_transaction_init (om_transaction_t *txp, object_manager_t *omp);
+
+/*
+ * These stage an operation with the same arguments & semantics as
+ * om_object_create, om_attribute_add & om_attribute_remove.  Nothing
+ * is looked at or changed till the transaction is committed, so these
+ * can only fail with ENOMEM (or EINVAL for a negative length).
+ */
+extern int
+om_transaction_object_create (om_transaction_t *txp,
+    int parent_object_type, int parent_object_instance,
+    int object_type, int object_instance);
+
+extern int
+om_transaction_attribute_add (om_transaction_t *txp,
+    int object_type, int object_instance,
+    int attribute_id,
+    int attribute_value_length, byte *attribute_value);
+
+extern int
+om_transaction_attribute_remove (om_transaction_t *txp,
+    int object_type, int object_instance,
+    int attribute_id);
+
+/*
+ * Applies every staged operation, all under one write lock.  Returns 0
+ * if all succeeded.  Otherwise none of them is left applied and the
+ * error is whatever the failing operation would have returned on its
+ * own (with its sequence, starting from 0, in 'failed_op'), ENOMEM or
+ * EINVAL if the staged creations make a loop of parents.  Either way,
+ * the transaction is emptied & can be used again.
+ */
+extern int
+om_transaction_commit (om_transaction_t *txp);
+
+/*
+ * Drops whatever is staged without applying it.
+ */
+extern void
+om_transaction_destroy (om_transaction_t *txp);
+
 /*
  * destroys the entire object manager.  It cannot be used again
  * until re-initialised.
@@ -417,11 +926,102 @@ om_destroy (object_manager_t *omp);
  */
 
 /*
- * Writes out the object manager to a file.
+ * Writes out the object manager to a file.  No object can be changed
+ * till all of it is written.  Returns EIO if the file could not be
+ * fully written.
  */
 extern int
 om_write (object_manager_t *omp);
 
+/*
+ * Writes the same file as om_write but without holding off writers
+ * while doing it.  A child process is forked, which gets a copy on
+ * write image of the memory as it is at that point, and that child
+ * writes it out while the object manager keeps changing.  Writers are
+ * only held off while forking, which is proportional to the memory
+ * mapped but much faster than writing it out.  The file replaces the
+ * previous one only when it is fully written.
+ *
+ * Returns 0 or the error of fork.  If started, 'om_snapshot_wait'
+ * must be called (at any time later) to reap the child.
+ */
+extern int
+om_snapshot_start (object_manager_t *omp, om_snapshot_t *snapshot);
+
+/*
+ * Waits till the snapshot is written, returns 0 if it was or EIO.
+ */
+extern int
+om_snapshot_wait (om_snapshot_t *snapshot);
+
+/*
+ * Creates the named shared memory segment 'name' (a name as given to
+ * shm_open, such as "/om_29") with room for images of at most
+ * 'image_size' bytes, replacing any segment of the same name.  Nothing
+ * is in it till the first om_shared_publish.
+ */
+extern int
+om_shared_create (om_shared_t *shp, char *name, long long int image_size);
+
+/*
+ * Publishes the object manager as it is now, under its read lock, into
+ * a segment created by om_shared_create.  Readers see either all of the
+ * previous image or all of this one.  Returns 0 or ENOSPC if the image
+ * would be bigger than the size the segment was created with.  Threads
+ * publishing into the same segment take turns.
+ */
+extern int
+om_shared_publish (om_shared_t *shp, object_manager_t *omp);
+
+/*
+ * Maps a segment created by another process, read only.  Returns 0,
+ * the error of shm_open or mmap, or EINVAL if it is not a segment of
+ * an object manager.
+ */
+extern int
+om_shared_attach (om_shared_t *shp, char *name);
+
+/*
+ * Unmaps the segment.  If this is the process which created it, the
+ * name is also removed, so no other process can attach to it any more
+ * but the ones already attached keep reading the last image.
+ */
+extern void
+om_shared_detach (om_shared_t *shp);
+
+/*
+ * Same as their object manager counterparts but on the last published
+ * image, without any lock.  These return ENODATA for an object which
+ * does not exist & EAGAIN if nothing has been published yet.
+ */
+extern int
+om_shared_object_count (om_shared_t *shp);
+
+extern bool
+om_shared_object_exists (om_shared_t *shp,
+    int object_type, int object_instance);
+
+extern int
+om_shared_parent_get (om_shared_t *shp,
+    int object_type, int object_instance,
+    int *parent_object_type, int *parent_object_instance);
+
+extern int
+om_shared_attribute_get (om_shared_t *shp,
+    int object_type, int object_instance,
+    int attribute_id,
+    int *returned_length, int max_length, byte *returned_value);
+
+/*
+ * Places at most 'max_children' of the children of the object, sorted
+ * by (type, instance), into 'children' and how many it has in total
+ * into 'n_children'.
+ */
+extern int
+om_shared_children_get (om_shared_t *shp,
+    int object_type, int object_instance,
+    object_identifier_t *children, int max_children, int *n_children);
+
 /*
  * reads a object manager from a file
  */
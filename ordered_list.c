@@ -362,6 +362,63 @@ ordered_list_delete_node (ordered_list_t *listp,
     return failed;
 }
 
+/**************************** Cursors ****************************************/
+
+/* moves the cursor onto 'node' & hands out its user data */
+static int
+ordered_list_cursor_move (ordered_list_cursor_t *cursor,
+        ordered_list_node_t *node, void **user_data)
+{
+    if (endof_ordered_list(node)) node = NULL;
+    cursor->node = node;
+    safe_pointer_set(user_data, node ? node->user_data : NULL);
+    return node ? 0 : ENODATA;
+}
+
+PUBLIC int
+ordered_list_cursor_first (ordered_list_t *listp,
+        ordered_list_cursor_t *cursor, void **user_data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(listp);
+    cursor->listp = listp;
+    failed = ordered_list_cursor_move(cursor, listp->head, user_data);
+    OBJ_READ_UNLOCK(listp);
+    return failed;
+}
+
+PUBLIC int
+ordered_list_cursor_seek (ordered_list_t *listp,
+        ordered_list_cursor_t *cursor, void *key, void **user_data)
+{
+    ordered_list_node_t *node;
+    int failed;
+
+    OBJ_READ_LOCK(listp);
+    cursor->listp = listp;
+    node = listp->head;
+    while (not_endof_ordered_list(node) &&
+        (listp->cmpf(node->user_data, key) < 0)) {
+            node = node->next;
+    }
+    failed = ordered_list_cursor_move(cursor, node, user_data);
+    OBJ_READ_UNLOCK(listp);
+    return failed;
+}
+
+PUBLIC int
+ordered_list_cursor_next (ordered_list_cursor_t *cursor, void **user_data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(cursor->listp);
+    failed = ordered_list_cursor_move(cursor,
+                cursor->node ? cursor->node->next : NULL, user_data);
+    OBJ_READ_UNLOCK(cursor->listp);
+    return failed;
+}
+
 /**************************** Destroy ****************************************/ 
 
 PUBLIC void
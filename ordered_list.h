@@ -105,6 +105,26 @@ struct ordered_list_s {
 
 };
 
+/*
+ * A cursor walks the list one user data at a time in a loop of the
+ * caller's own.  There is no 'prev' since the list is singly linked &
+ * stepping back would mean walking from the head every time.
+ *
+ * A cursor simply points at a node.  Additions never move nodes, so
+ * a cursor stays valid thru them.  But a deletion copies the NEXT node
+ * over the deleted one & frees the next one (see below), so ANY
+ * deletion may free the node a cursor is on.  After any deletion, a
+ * cursor must be positioned again (first or seek) before being used.
+ * Every call takes the lock of the list by itself, nothing is held
+ * in between.
+ */
+typedef struct ordered_list_cursor_s {
+
+    ordered_list_t *listp;
+    ordered_list_node_t *node;
+
+} ordered_list_cursor_t;
+
 /*
  * We maintain an "end node" always in the list.  This is represented
  * by setting its 'next' AND data pointers both to the value of NULL.
@@ -200,6 +220,25 @@ extern int
 ordered_list_delete (ordered_list_t *listp, void *to_be_deleted,
         void **data_deleted);
 
+/*
+ * Cursor calls return 0 & place the user data the cursor moved onto
+ * into 'user_data', or return ENODATA (& set 'user_data' to NULL) when
+ * there is none.  Once past the end, 'next' keeps returning ENODATA.
+ *
+ * 'seek' positions the cursor on the first user data which is >= 'key'
+ * as decided by the compare function, 'key' need not be in the list.
+ */
+extern int
+ordered_list_cursor_first (ordered_list_t *listp,
+        ordered_list_cursor_t *cursor, void **user_data);
+
+extern int
+ordered_list_cursor_seek (ordered_list_t *listp,
+        ordered_list_cursor_t *cursor, void *key, void **user_data);
+
+extern int
+ordered_list_cursor_next (ordered_list_cursor_t *cursor, void **user_data);
+
 /*
  * Note that this destroys ONLY the contents of the object, NOT
  * the object itself, since it is not known whether this object
@@ -250,6 +250,98 @@ thread_unsafe_radix_tree_remove (radix_tree_t *rtp,
     return ENODATA;
 }
 
+/*
+ * Cursors walk the nodes in pre order, a node before its children &
+ * the children in the order of their nibbles.  Only nodes at the end
+ * of a whole key byte can carry user data & the root never does.
+ */
+
+/*
+ * the first node in pre order after the children of 'node' which
+ * come before 'nibble' (all of them if 'nibble' is past the last)
+ */
+static radix_tree_node_t *
+radix_tree_node_following (radix_tree_node_t *node, int nibble)
+{
+    while (node) {
+        for (; nibble < NTRIE_ALPHABET_SIZE; nibble++) {
+            if (node->children[nibble]) return node->children[nibble];
+        }
+
+        /* nothing left below, carry on after it in its parent */
+        nibble = node->value + 1;
+        node = node->parent;
+    }
+    return NULL;
+}
+
+/* the last node in pre order of the sub tree of 'node' */
+static radix_tree_node_t *
+radix_tree_node_last (radix_tree_node_t *node)
+{
+    int nibble;
+
+    while (node->n_children > 0) {
+        for (nibble = NTRIE_HI_VALUE; NULL == node->children[nibble];
+            nibble--);
+        node = node->children[nibble];
+    }
+    return node;
+}
+
+/* the node before 'node' in pre order, NULL before the root */
+static radix_tree_node_t *
+radix_tree_node_preceding (radix_tree_node_t *node)
+{
+    radix_tree_node_t *parent = node->parent;
+    int nibble;
+
+    if (NULL == parent) return NULL;
+    for (nibble = node->value - 1; nibble >= 0; nibble--) {
+        if (parent->children[nibble])
+            return radix_tree_node_last(parent->children[nibble]);
+    }
+    return parent;
+}
+
+/*
+ * moves the cursor onto 'node', or the first node after it
+ * (before it if not 'forward') which carries user data
+ */
+static int
+radix_tree_cursor_move (radix_tree_cursor_t *cursor,
+        radix_tree_node_t *node, boolean forward, void **data)
+{
+    while (node && (NULL == node->user_data)) {
+        node = forward ?
+            radix_tree_node_following(node, 0) :
+            radix_tree_node_preceding(node);
+    }
+    cursor->node = node;
+    safe_pointer_set(data, node ? node->user_data : NULL);
+    return node ? 0 : ENODATA;
+}
+
+/*
+ * The node of 'key' if it is in the tree.  If not, the first node
+ * after where it would be, which is found after the deepest node on
+ * the way down to it.
+ */
+static radix_tree_node_t *
+radix_tree_node_seek (radix_tree_t *rtp, byte *key, int key_length)
+{
+    radix_tree_node_t *node = &rtp->radix_tree_root;
+    int i, nibble;
+
+    for (i = 0; i < (2 * key_length); i++) {
+        nibble = (i & 1) ? HI_NIBBLE(key[i/2]) : LO_NIBBLE(key[i/2]);
+        if (NULL == node->children[nibble])
+            return radix_tree_node_following(node, nibble + 1);
+        node = node->children[nibble];
+    }
+    return node;
+}
+
 /**************************** Public *****************************************/
 
 PUBLIC int 
@@ -262,6 +354,7 @@ radix_tree_init (radix_tree_t *rtp,
     LOCK_SETUP(rtp);
     STATISTICS_SETUP(rtp);
 
+    rtp->should_not_be_modified = 0;
     rtp->node_count = 0;
     radix_tree_node_init(&rtp->radix_tree_root, 0);
 
@@ -386,6 +479,104 @@ radix_tree_traverse (radix_tree_t *rtp, traverse_function_pointer tfn,
     free(key);
 }
 
+PUBLIC int
+radix_tree_cursor_first (radix_tree_t *rtp, radix_tree_cursor_t *cursor,
+        void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(rtp);
+    cursor->rtp = rtp;
+    failed = radix_tree_cursor_move(cursor, &rtp->radix_tree_root,
+                TRUE, data);
+    OBJ_READ_UNLOCK(rtp);
+    return failed;
+}
+
+PUBLIC int
+radix_tree_cursor_last (radix_tree_t *rtp, radix_tree_cursor_t *cursor,
+        void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(rtp);
+    cursor->rtp = rtp;
+    failed = radix_tree_cursor_move(cursor,
+                radix_tree_node_last(&rtp->radix_tree_root), FALSE, data);
+    OBJ_READ_UNLOCK(rtp);
+    return failed;
+}
+
+PUBLIC int
+radix_tree_cursor_seek (radix_tree_t *rtp, radix_tree_cursor_t *cursor,
+        void *key, int key_length, void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(rtp);
+    cursor->rtp = rtp;
+    failed = radix_tree_cursor_move(cursor,
+                radix_tree_node_seek(rtp, key, key_length), TRUE, data);
+    OBJ_READ_UNLOCK(rtp);
+    return failed;
+}
+
+PUBLIC int
+radix_tree_cursor_next (radix_tree_cursor_t *cursor, void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(cursor->rtp);
+    failed = radix_tree_cursor_move(cursor,
+                cursor->node ? radix_tree_node_following(cursor->node, 0)
+                    : NULL, TRUE, data);
+    OBJ_READ_UNLOCK(cursor->rtp);
+    return failed;
+}
+
+PUBLIC int
+radix_tree_cursor_prev (radix_tree_cursor_t *cursor, void **data)
+{
+    int failed;
+
+    OBJ_READ_LOCK(cursor->rtp);
+    failed = radix_tree_cursor_move(cursor,
+                cursor->node ? radix_tree_node_preceding(cursor->node)
+                    : NULL, FALSE, data);
+    OBJ_READ_UNLOCK(cursor->rtp);
+    return failed;
+}
+
+/*
+ * Every key byte is two nodes deep, the one below holding its low
+ * nibble, so the key is put together backwards going up to the root.
+ */
+PUBLIC int
+radix_tree_cursor_key (radix_tree_cursor_t *cursor,
+        byte *key, int key_size, int *key_length)
+{
+    radix_tree_node_t *node;
+    int i, depth = 0;
+
+    *key_length = 0;
+    OBJ_READ_LOCK(cursor->rtp);
+    if (NULL == cursor->node) {
+        OBJ_READ_UNLOCK(cursor->rtp);
+        return ENODATA;
+    }
+    for (node = cursor->node; node->parent; node = node->parent) depth++;
+    if ((depth / 2) > key_size) {
+        OBJ_READ_UNLOCK(cursor->rtp);
+        return ENOSPC;
+    }
+    *key_length = i = depth / 2;
+    for (node = cursor->node; node->parent; node = node->parent->parent) {
+        key[--i] = (node->value << 4) | node->parent->value;
+    }
+    OBJ_READ_UNLOCK(cursor->rtp);
+    return 0;
+}
+
 PUBLIC void
 radix_tree_destroy (radix_tree_t *rtp)
 {
@@ -100,6 +100,28 @@ typedef struct radix_tree_s {
 
 } radix_tree_t;
 
+/*
+ * A cursor walks the tree one user data at a time, in either
+ * direction, in a loop of the caller's own.  The order is the order
+ * the tree keeps its keys in: byte by byte, each byte by its low
+ * nibble first & then its high nibble, with a key coming before the
+ * longer keys it is a prefix of.  So it is NOT the numerical order of
+ * multi byte keys or even of the bytes themselves.
+ *
+ * A cursor simply points at the node of its key.  Insertions never
+ * move nodes & removals only free the nodes of the removed key which
+ * no other key needs, so a cursor stays valid thru any change to the
+ * tree EXCEPT the removal of the key it is on.  It must be positioned
+ * again (first, last or seek) before being used after that.  Every
+ * call takes the lock of the tree by itself, nothing is held in between.
+ */
+typedef struct radix_tree_cursor_s {
+
+    radix_tree_t *rtp;
+    radix_tree_node_t *node;
+
+} radix_tree_cursor_t;
+
 extern int 
 radix_tree_init (radix_tree_t *ntp, 
         boolean make_it_thread_safe,
@@ -126,6 +148,41 @@ extern void
 radix_tree_traverse (radix_tree_t *ntp, traverse_function_pointer tfn,
         void *extra_arg_1, void *extra_arg_2);
 
+/*
+ * Cursor calls return 0 & place the user data the cursor moved onto
+ * into 'data', or return ENODATA (& set 'data' to NULL) when there is
+ * none.  Once past either end, 'next' & 'prev' keep returning ENODATA.
+ *
+ * 'seek' positions the cursor on the first key which is at or after
+ * 'key' in the order above, 'key' need not be in the tree.
+ */
+extern int
+radix_tree_cursor_first (radix_tree_t *ntp, radix_tree_cursor_t *cursor,
+        void **data);
+
+extern int
+radix_tree_cursor_last (radix_tree_t *ntp, radix_tree_cursor_t *cursor,
+        void **data);
+
+extern int
+radix_tree_cursor_seek (radix_tree_t *ntp, radix_tree_cursor_t *cursor,
+        void *key, int key_length, void **data);
+
+extern int
+radix_tree_cursor_next (radix_tree_cursor_t *cursor, void **data);
+
+extern int
+radix_tree_cursor_prev (radix_tree_cursor_t *cursor, void **data);
+
+/*
+ * Places the key the cursor is on into 'key' & its length in bytes
+ * into 'key_length'.  Returns ENODATA if the cursor is on nothing or
+ * ENOSPC if the key is longer than 'key_size' bytes.
+ */
+extern int
+radix_tree_cursor_key (radix_tree_cursor_t *cursor,
+        byte *key, int key_size, int *key_length);
+
 extern void 
 radix_tree_destroy (radix_tree_t *ntp);
 
@@ -0,0 +1,517 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "slab_allocator.h"
+#include "thread_slots.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* class index of a slab holding one big block */
+#define SLAB_BIG_BLOCK          (-1)
+
+struct slab_s {
+
+    slab_allocator_t *allocator;
+
+    /* in the list of all slabs */
+    slab_t *next, *prev;
+
+    /* in the available list of its class */
+    slab_t *next_available, *prev_available;
+    boolean is_available;
+
+    /* freed blocks, linked thru their first 8 bytes */
+    void *free_blocks;
+
+    int class_index;
+
+    /* blocks handed out (including the ones in thread caches) */
+    int n_used;
+
+    /* blocks carved so far, the rest has never been touched */
+    int n_carved;
+
+    /* how much is mmap'ed */
+    long long int size;
+};
+
+/* blocks start here, keeping them 16 byte aligned */
+#define SLAB_HEADER_SIZE        ((int) ((sizeof(slab_t) + 15) & ~15))
+
+#define SLAB_OF(block) \
+    ((slab_t*) (((unsigned long long int) (block)) & \
+        ~((unsigned long long int) SLAB_SIZE - 1)))
+
+#define SLAB_BLOCK(slab, index) \
+    (((byte*) (slab)) + SLAB_HEADER_SIZE + \
+        ((index) * (slab)->allocator->classes[(slab)->class_index].block_size))
+
+struct slab_thread_cache_s {
+
+    int counts [SLAB_CLASSES];
+    void *blocks [SLAB_CLASSES][SLAB_CACHE_MAX_BLOCKS];
+};
+
+/*
+ * size class of a block of 'size' bytes (1 .. SLAB_MAX_BLOCK_SIZE):
+ * 16 byte steps up to 64, then 4 classes per power of 2.
+ */
+static inline int
+slab_class_index (int size)
+{
+    unsigned int s = (unsigned int) (size - 1);
+    int msb;
+
+    if (size <= 64) return (int) (s >> 4);
+    msb = 31 - __builtin_clz(s);
+    return
+        4 + ((msb - 6) * 4) + (int) ((s >> (msb - 2)) & 3);
+}
+
+static inline int
+slab_class_size (int index)
+{
+    int base;
+
+    if (index < 4) return (index + 1) * 16;
+    base = 64 << ((index - 4) / 4);
+    return base + (((index - 4) % 4) + 1) * (base / 4);
+}
+
+/******************************************************************************
+ *
+ * Thread slots, the index of a thread into the caches of every slab
+ * allocator.  Assigned at the first allocation of a thread & recycled
+ * when it exits.  SLAB_MAX_THREADS means the thread has no cache.
+ */
+
+#define SLAB_SLOT_UNASSIGNED        (SLAB_MAX_THREADS + 1)
+
+static __thread int slab_thread_slot = SLAB_SLOT_UNASSIGNED;
+
+static thread_slots_t slab_thread_slots =
+    THREAD_SLOTS_INITIALIZER(SLAB_MAX_THREADS);
+
+static int
+slab_thread_slot_assign (void)
+{
+    slab_thread_slot = thread_slot_assign(&slab_thread_slots);
+    return slab_thread_slot;
+}
+
+/******************************************************************************
+ *
+ * Slabs
+ */
+
+/*
+ * mmaps 'size' bytes on a SLAB_SIZE boundary by mapping a slab
+ * more and unmapping what is before & after the boundary
+ */
+static slab_t *
+slab_map (slab_allocator_t *sap, long long int size)
+{
+    byte *block, *aligned;
+    long long int extra;
+
+    block = mmap(NULL, size + SLAB_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED) return NULL;
+    aligned = (byte*) SLAB_OF(block + SLAB_SIZE - 1);
+    extra = aligned - block;
+    if (extra) munmap(block, extra);
+    extra = SLAB_SIZE - extra;
+    if (extra) munmap(aligned + size, extra);
+
+    mem_monitor_account_external(sap->mem_mon_p, size);
+    sap->bytes_mapped += size;
+    sap->n_slabs++;
+
+    return (slab_t*) aligned;
+}
+
+static void
+slab_unmap (slab_allocator_t *sap, slab_t *slab)
+{
+    long long int size = slab->size;
+
+    if (slab->next) slab->next->prev = slab->prev;
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        sap->slabs = slab->next;
+    }
+    if (slab->class_index == SLAB_BIG_BLOCK) sap->n_big_blocks--;
+    sap->bytes_mapped -= size;
+    sap->n_slabs--;
+    munmap(slab, size);
+    mem_monitor_account_external(sap->mem_mon_p, -size);
+}
+
+static slab_t *
+thread_unsafe_slab_create (slab_allocator_t *sap,
+    int class_index, long long int size)
+{
+    slab_t *slab = slab_map(sap, size);
+
+    if (NULL == slab) return NULL;
+    slab->allocator = sap;
+    slab->class_index = class_index;
+    slab->size = size;
+    slab->prev = NULL;
+    slab->next = sap->slabs;
+    if (sap->slabs) sap->slabs->prev = slab;
+    sap->slabs = slab;
+
+    return slab;
+}
+
+static void
+slab_available_add (slab_class_t *cls, slab_t *slab)
+{
+    slab->prev_available = NULL;
+    slab->next_available = cls->available;
+    if (cls->available) cls->available->prev_available = slab;
+    cls->available = slab;
+    slab->is_available = true;
+}
+
+static void
+slab_available_remove (slab_class_t *cls, slab_t *slab)
+{
+    if (slab->next_available) {
+        slab->next_available->prev_available = slab->prev_available;
+    }
+    if (slab->prev_available) {
+        slab->prev_available->next_available = slab->next_available;
+    } else {
+        cls->available = slab->next_available;
+    }
+    slab->is_available = false;
+}
+
+/*
+ * takes a block of the class from the first available
+ * slab, creating a new slab if none is available
+ */
+static void *
+thread_unsafe_slab_block_pop (slab_allocator_t *sap, int class_index)
+{
+    slab_class_t *cls = &sap->classes[class_index];
+    slab_t *slab = cls->available;
+    void *block;
+
+    if (NULL == slab) {
+        slab = thread_unsafe_slab_create(sap, class_index, SLAB_SIZE);
+        if (NULL == slab) return NULL;
+        slab_available_add(cls, slab);
+    }
+    if (slab->free_blocks) {
+        block = slab->free_blocks;
+        slab->free_blocks = *((void**) block);
+    } else {
+        block = SLAB_BLOCK(slab, slab->n_carved);
+        slab->n_carved++;
+    }
+    if (++slab->n_used == cls->blocks_per_slab) {
+        slab_available_remove(cls, slab);
+    }
+
+    return block;
+}
+
+static void
+thread_unsafe_slab_block_push (slab_allocator_t *sap, void *block)
+{
+    slab_t *slab = SLAB_OF(block);
+
+    *((void**) block) = slab->free_blocks;
+    slab->free_blocks = block;
+    slab->n_used--;
+    if (!slab->is_available) {
+        slab_available_add(&sap->classes[slab->class_index], slab);
+    }
+}
+
+/*
+ * cache of the calling thread, created at its first allocation.
+ * NULL if the allocator is not thread safe or the thread has no slot.
+ */
+static inline slab_thread_cache_t *
+slab_thread_cache (slab_allocator_t *sap)
+{
+    int slot = slab_thread_slot;
+    slab_thread_cache_t *cache;
+
+    if (NULL == sap->lock) return NULL;
+    if (slot == SLAB_SLOT_UNASSIGNED) slot = slab_thread_slot_assign();
+    if (slot >= SLAB_MAX_THREADS) return NULL;
+    cache = sap->caches[slot];
+    if (cache) return cache;
+
+    OBJ_WRITE_LOCK(sap);
+    cache = sap->caches[slot] =
+        MEM_MONITOR_ZALLOC(sap, sizeof(slab_thread_cache_t));
+    OBJ_WRITE_UNLOCK(sap);
+
+    return cache;
+}
+
+/* moves half of what a cache may hold to or from the slabs */
+static void *
+slab_cache_refill (slab_allocator_t *sap, slab_thread_cache_t *cache,
+    int class_index)
+{
+    int n = sap->classes[class_index].cache_limit / 2;
+    void *block;
+
+    OBJ_WRITE_LOCK(sap);
+    block = thread_unsafe_slab_block_pop(sap, class_index);
+    while (block && (cache->counts[class_index] < n)) {
+        cache->blocks[class_index][cache->counts[class_index]] =
+            thread_unsafe_slab_block_pop(sap, class_index);
+        if (NULL == cache->blocks[class_index][cache->counts[class_index]])
+            break;
+        cache->counts[class_index]++;
+    }
+    OBJ_WRITE_UNLOCK(sap);
+
+    return block;
+}
+
+static void
+slab_cache_drain (slab_allocator_t *sap, slab_thread_cache_t *cache,
+    int class_index, int keep)
+{
+    OBJ_WRITE_LOCK(sap);
+    while (cache->counts[class_index] > keep) {
+        thread_unsafe_slab_block_push(sap,
+            cache->blocks[class_index][--cache->counts[class_index]]);
+    }
+    OBJ_WRITE_UNLOCK(sap);
+}
+
+static void *
+slab_big_block_allocate (slab_allocator_t *sap, int size)
+{
+    long long int map_size = SLAB_HEADER_SIZE + (long long int) size;
+    slab_t *slab;
+
+    map_size = (map_size + 4095) & ~4095LL;
+    OBJ_WRITE_LOCK(sap);
+    slab = thread_unsafe_slab_create(sap, SLAB_BIG_BLOCK, map_size);
+    if (slab) {
+        slab->n_used = 1;
+        sap->n_big_blocks++;
+    }
+    OBJ_WRITE_UNLOCK(sap);
+
+    return slab ? ((byte*) slab) + SLAB_HEADER_SIZE : NULL;
+}
+
+/***************************** 80 column separator ****************************/
+
+PUBLIC int
+slab_allocator_init (slab_allocator_t *sap,
+    boolean make_it_thread_safe,
+    mem_monitor_t *parent_mem_monitor)
+{
+    slab_class_t *cls;
+    int c;
+
+    memset(sap, 0, sizeof(slab_allocator_t));
+    MEM_MONITOR_SETUP(sap);
+    LOCK_SETUP(sap);
+    for (c = 0; c < SLAB_CLASSES; c++) {
+        cls = &sap->classes[c];
+        cls->block_size = slab_class_size(c);
+        cls->blocks_per_slab =
+            (SLAB_SIZE - SLAB_HEADER_SIZE) / cls->block_size;
+        cls->cache_limit = SLAB_CACHE_MAX_BYTES / cls->block_size;
+        if (cls->cache_limit > SLAB_CACHE_MAX_BLOCKS)
+            cls->cache_limit = SLAB_CACHE_MAX_BLOCKS;
+        if (cls->cache_limit < 2) cls->cache_limit = 2;
+    }
+
+    return 0;
+}
+
+PUBLIC void *
+slab_allocate (slab_allocator_t *sap, int size)
+{
+    slab_thread_cache_t *cache;
+    void *block;
+    int c;
+
+    if (size < 0) return NULL;
+    if (size > SLAB_MAX_BLOCK_SIZE) return slab_big_block_allocate(sap, size);
+    c = slab_class_index(size ? size : 1);
+
+    cache = slab_thread_cache(sap);
+    if (cache) {
+        if (cache->counts[c] > 0) return cache->blocks[c][--cache->counts[c]];
+        return slab_cache_refill(sap, cache, c);
+    }
+
+    OBJ_WRITE_LOCK(sap);
+    block = thread_unsafe_slab_block_pop(sap, c);
+    OBJ_WRITE_UNLOCK(sap);
+
+    return block;
+}
+
+PUBLIC void
+slab_free (void *block)
+{
+    slab_t *slab;
+    slab_allocator_t *sap;
+    slab_thread_cache_t *cache;
+    int c;
+
+    if (NULL == block) return;
+    slab = SLAB_OF(block);
+    sap = slab->allocator;
+    c = slab->class_index;
+
+    if (c == SLAB_BIG_BLOCK) {
+        OBJ_WRITE_LOCK(sap);
+        slab_unmap(sap, slab);
+        OBJ_WRITE_UNLOCK(sap);
+        return;
+    }
+
+    cache = slab_thread_cache(sap);
+    if (cache) {
+        if (cache->counts[c] >= sap->classes[c].cache_limit) {
+            slab_cache_drain(sap, cache, c, sap->classes[c].cache_limit / 2);
+        }
+        cache->blocks[c][cache->counts[c]++] = block;
+        return;
+    }
+
+    OBJ_WRITE_LOCK(sap);
+    thread_unsafe_slab_block_push(sap, block);
+    OBJ_WRITE_UNLOCK(sap);
+}
+
+PUBLIC int
+slab_block_size (void *block)
+{
+    slab_t *slab = SLAB_OF(block);
+
+    if (slab->class_index == SLAB_BIG_BLOCK)
+        return (int) (slab->size - SLAB_HEADER_SIZE);
+    return slab->allocator->classes[slab->class_index].block_size;
+}
+
+PUBLIC void *
+slab_reallocate (slab_allocator_t *sap, void *block, int size)
+{
+    void *new_block;
+    int old_size;
+
+    if (NULL == block) return slab_allocate(sap, size);
+    old_size = slab_block_size(block);
+
+    /* still fits & does not waste more than half of it */
+    if ((size <= old_size) && (size > (old_size / 2))) return block;
+
+    new_block = slab_allocate(sap, size);
+    if (new_block) {
+        memcpy(new_block, block, (size < old_size) ? size : old_size);
+        slab_free(block);
+    }
+    return new_block;
+}
+
+PUBLIC void
+slab_allocator_flush_thread_cache (slab_allocator_t *sap)
+{
+    int slot = slab_thread_slot;
+    int c;
+
+    if ((slot >= SLAB_MAX_THREADS) || (NULL == sap->caches[slot])) return;
+    for (c = 0; c < SLAB_CLASSES; c++) {
+        slab_cache_drain(sap, sap->caches[slot], c, 0);
+    }
+}
+
+PUBLIC int
+slab_allocator_trim (slab_allocator_t *sap)
+{
+    slab_t *slab, *next;
+    int c, trimmed = 0;
+
+    slab_allocator_flush_thread_cache(sap);
+    OBJ_WRITE_LOCK(sap);
+    for (c = 0; c < SLAB_CLASSES; c++) {
+        for (slab = sap->classes[c].available; slab; slab = next) {
+            next = slab->next_available;
+            if (slab->n_used == 0) {
+                slab_available_remove(&sap->classes[c], slab);
+                slab_unmap(sap, slab);
+                trimmed++;
+            }
+        }
+    }
+    OBJ_WRITE_UNLOCK(sap);
+
+    return trimmed;
+}
+
+PUBLIC void
+slab_allocator_destroy (slab_allocator_t *sap)
+{
+    int slot;
+
+    OBJ_WRITE_LOCK(sap);
+    while (sap->slabs) slab_unmap(sap, sap->slabs);
+    for (slot = 0; slot < SLAB_MAX_THREADS; slot++) {
+        if (sap->caches[slot]) MEM_MONITOR_FREE(sap->caches[slot]);
+    }
+    OBJ_WRITE_UNLOCK(sap);
+    LOCK_OBJ_DESTROY(sap);
+    memset(sap, 0, sizeof(*sap));
+}
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
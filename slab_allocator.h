@@ -0,0 +1,195 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** General purpose size class (slab) allocator.
+**
+** A chunk manager serves one fixed size only and a buffer manager needs
+** all its sizes & counts up front, preallocates all of it and can never
+** grow.  A slab allocator serves any size, grows as needed and gives
+** memory back to the OS when asked to, like 'chunk_manager_trim'.
+**
+** Requested sizes are rounded up to one of SLAB_CLASSES size classes.
+** Classes are 16 bytes apart up to 64 bytes and four per doubling
+** after that (80, 96, 112, 128, 160, 192 .. 32K), so at most 25% of
+** a block is ever wasted.  Every class carves its blocks out of slabs,
+** SLAB_SIZE blocks of memory mmap'ed on a SLAB_SIZE boundary.  Freeing
+** a block therefore needs neither its size nor its allocator: masking
+** the address finds the slab header, which has both.  Slabs are carved
+** lazily, so pages of a slab which are never used are never touched.
+** Blocks bigger than SLAB_MAX_BLOCK_SIZE get a slab of their own.
+**
+** If thread safe, every thread keeps a small cache of blocks per class.
+** Most allocations & frees are served from there without any locking;
+** the shared slabs are locked only to move a batch of blocks into or
+** out of a cache.  A thread which exits leaves its cache to the next
+** thread which starts up.  Blocks sitting in the caches of OTHER threads
+** keep their slabs from being trimmed.
+**
+** Empty slabs are NOT given back to the OS automatically, since they
+** are likely to be needed again.  Call 'slab_allocator_trim' for that.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#ifndef __SLAB_ALLOCATOR_H__
+#define __SLAB_ALLOCATOR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "common.h"
+#include "mem_monitor_object.h"
+#include "lock_object.h"
+
+#define SLAB_SIZE                   (256 * 1024)
+#define SLAB_MAX_BLOCK_SIZE         (32 * 1024)
+#define SLAB_CLASSES                40
+
+/* threads beyond this many use the shared slabs directly */
+#define SLAB_MAX_THREADS            64
+
+/* how many blocks & bytes a thread may cache per class */
+#define SLAB_CACHE_MAX_BLOCKS       64
+#define SLAB_CACHE_MAX_BYTES        (64 * 1024)
+
+typedef struct slab_s slab_t;
+typedef struct slab_thread_cache_s slab_thread_cache_t;
+
+typedef struct slab_class_s {
+
+    int block_size;
+    int blocks_per_slab;
+
+    /* how many blocks of this class a thread may cache */
+    int cache_limit;
+
+    /* slabs which still have free (or never carved) blocks */
+    slab_t *available;
+
+} slab_class_t;
+
+typedef struct slab_allocator_s {
+
+    MEM_MON_VARIABLES;
+    LOCK_VARIABLES;
+
+    slab_class_t classes [SLAB_CLASSES];
+
+    /* every slab, including the ones of big blocks */
+    slab_t *slabs;
+
+    /* per thread caches, only when thread safe */
+    slab_thread_cache_t *caches [SLAB_MAX_THREADS];
+
+    /* statistics */
+    unsigned long long int bytes_mapped;
+    int n_slabs;
+    int n_big_blocks;
+
+} slab_allocator_t;
+
+/*
+ * No memory is mapped until the first allocation.
+ * Always returns 0.
+ */
+extern int
+slab_allocator_init (slab_allocator_t *sap,
+    boolean make_it_thread_safe,
+    mem_monitor_t *parent_mem_monitor);
+
+/*
+ * Returns a 16 byte aligned block of at least 'size'
+ * bytes, or NULL if 'size' is negative or out of memory.
+ */
+extern void *
+slab_allocate (slab_allocator_t *sap, int size);
+
+/*
+ * 'block' must have been returned by 'slab_allocate' or
+ * 'slab_reallocate' of any slab allocator.  NULL is ignored.
+ */
+extern void
+slab_free (void *block);
+
+/*
+ * Same semantics as realloc.  The block stays where it is
+ * if it still is in the right size class.
+ */
+extern void *
+slab_reallocate (slab_allocator_t *sap, void *block, int size);
+
+/* how many bytes of the block can actually be used */
+extern int
+slab_block_size (void *block);
+
+/*
+ * Gives the blocks cached by the calling thread back to the slabs.
+ * A thread which will not be using the allocator for a long time
+ * can call this so its cached blocks can be trimmed.
+ */
+extern void
+slab_allocator_flush_thread_cache (slab_allocator_t *sap);
+
+/*
+ * Flushes the cache of the calling thread and gives every slab
+ * none of whose blocks are in use back to the OS.
+ * Returns how many slabs were given back.
+ */
+extern int
+slab_allocator_trim (slab_allocator_t *sap);
+
+/*
+ * Gives all the memory back to the OS.  Every block
+ * allocated from the allocator becomes invalid.
+ */
+extern void
+slab_allocator_destroy (slab_allocator_t *sap);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+#endif // __SLAB_ALLOCATOR_H__
+
@@ -117,6 +117,205 @@ traverse_test (void)
     printf("ok\n");
 }
 
+static int
+rangefn (void *utility, void *node, void *data,
+        void *p0, void *p1, void *p2, void *p3)
+{
+    int **expected = (int**) p0;
+
+    if (data != *expected) {
+        printf("ERROR, range expected %p got %p\n", *expected, data);
+        return EINVAL;
+    }
+    /* only the even ones are in the tree */
+    (*expected) += 2;
+    return 0;
+}
+
+/*
+ * ranges must visit exactly the data within them, in order, even if
+ * the bounds themselves are not in the tree
+ */
+static void
+range_test (void)
+{
+    avl_tree_t tree;
+    int *expected;
+    int i;
+
+    avl_tree_init(&tree, false, false, int_compare, NULL);
+    for (i = 0; i < 1000; i += 2) {
+        avl_tree_insert(&tree, &data[i], NULL, false);
+    }
+
+    printf("range traversing .. ");
+    expected = &data[100];
+    if (avl_tree_range_traverse(&tree, &data[100], &data[200], rangefn,
+            &expected, null, null, null) || (expected != &data[202])) {
+        printf("ERROR, bounds in the tree\n");
+    }
+    expected = &data[102];
+    if (avl_tree_range_traverse(&tree, &data[101], &data[199], rangefn,
+            &expected, null, null, null) || (expected != &data[200])) {
+        printf("ERROR, bounds not in the tree\n");
+    }
+    expected = &data[0];
+    if (avl_tree_range_traverse(&tree, NULL, NULL, rangefn,
+            &expected, null, null, null) || (expected != &data[1000])) {
+        printf("ERROR, unbounded range\n");
+    }
+    expected = &data[0];
+    avl_tree_range_traverse(&tree, &data[2000], NULL, rangefn,
+        &expected, null, null, null);
+    if (expected != &data[0]) printf("ERROR, empty range\n");
+    printf("ok\n\n");
+
+    avl_tree_destroy(&tree, NULL, NULL);
+}
+
+/*
+ * cursors must walk the same data in both directions, seek to where
+ * a missing key would be & survive the removal of other data
+ */
+static void
+cursor_test (void)
+{
+    avl_tree_t tree;
+    avl_cursor_t cursor;
+    void *found;
+    int *expected;
+    int i, rv, failed = 0;
+
+    avl_tree_init(&tree, false, false, int_compare, NULL);
+    printf("cursors .. ");
+    if ((avl_cursor_first(&tree, &cursor, &found) != ENODATA) || found) {
+        printf("ERROR, cursor found something in an empty tree\n");
+        failed++;
+    }
+    for (i = 0; i < 1000; i += 2) {
+        avl_tree_insert(&tree, &data[i], NULL, false);
+    }
+
+    expected = &data[0];
+    for (rv = avl_cursor_first(&tree, &cursor, &found); rv == 0;
+        rv = avl_cursor_next(&cursor, &found)) {
+            if (found != expected) failed++;
+            expected += 2;
+    }
+    if ((expected != &data[1000]) ||
+        (avl_cursor_prev(&cursor, &found) != ENODATA)) {
+            printf("ERROR, forward walk\n");
+            failed++;
+    }
+    i = 998;
+    for (rv = avl_cursor_last(&tree, &cursor, &found); rv == 0;
+        rv = avl_cursor_prev(&cursor, &found)) {
+            if (found != &data[i]) failed++;
+            i -= 2;
+    }
+    if (i != -2) {
+        printf("ERROR, backward walk\n");
+        failed++;
+    }
+
+    if (avl_cursor_seek(&tree, &cursor, &data[101], &found) ||
+        (found != &data[102]) ||
+        avl_cursor_prev(&cursor, &found) || (found != &data[100]) ||
+        (avl_cursor_seek(&tree, &cursor, &data[999], &found) != ENODATA)) {
+            printf("ERROR, seek\n");
+            failed++;
+    }
+
+    /* removing everything around it must not disturb the cursor */
+    avl_cursor_seek(&tree, &cursor, &data[500], &found);
+    for (i = 400; i < 600; i += 2) {
+        if (i != 500) avl_tree_remove(&tree, &data[i], &found);
+    }
+    if (avl_cursor_next(&cursor, &found) || (found != &data[600]) ||
+        avl_cursor_prev(&cursor, &found) || (found != &data[500]) ||
+        avl_cursor_prev(&cursor, &found) || (found != &data[398])) {
+            printf("ERROR, cursor lost after removals\n");
+            failed++;
+    }
+    printf("%s\n\n", failed ? "FAILED" : "ok");
+
+    avl_tree_destroy(&tree, NULL, NULL);
+}
+
+static int
+every_third (void *p, void *unused)
+{
+    return (((int*) p - &data[0]) % 3) == 0;
+}
+
+/* returns the height, or -1 if the subtree is not a valid avl tree */
+static int
+check_subtree (avl_node_t *node, avl_node_t *parent)
+{
+    int left, right;
+
+    if (NULL == node) return 0;
+    if (node->parent != parent) return -1;
+    if (node->left && (int_compare(node->left->user_data,
+            node->user_data) >= 0)) return -1;
+    if (node->right && (int_compare(node->right->user_data,
+            node->user_data) <= 0)) return -1;
+    left = check_subtree(node->left, node);
+    right = check_subtree(node->right, node);
+    if ((left < 0) || (right < 0)) return -1;
+    if (node->balance != (right - left)) return -1;
+    if ((node->balance < -1) || (node->balance > 1)) return -1;
+    return 1 + ((left > right) ? left : right);
+}
+
+/*
+ * removing many at once must leave a valid, balanced tree
+ * of exactly the rest, which keeps working as a tree
+ */
+static void
+remove_matching_test (void)
+{
+    avl_tree_t tree;
+    timer_obj_t tmr;
+    void *found;
+    int i, n = 1000000, failed = 0;
+
+    avl_tree_init(&tree, false, false, int_compare, NULL);
+    for (i = 0; i < n; i++) avl_tree_insert(&tree, &data[i], NULL, false);
+
+    printf("removing every third of %d in one go .. ", n);
+    fflush(stdout);
+    timer_start(&tmr);
+    i = avl_tree_remove_matching(&tree, every_third, NULL, NULL, NULL);
+    timer_end(&tmr);
+    if ((i != (n + 2) / 3) || (tree.n != n - i)) {
+        printf("ERROR, removed %d, %d left\n", i, tree.n);
+        failed++;
+    }
+    if (check_subtree(tree.root_node, NULL) < 0) {
+        printf("ERROR, tree is not a valid avl tree\n");
+        failed++;
+    }
+    for (i = 0; i < n; i++) {
+        if ((avl_tree_search(&tree, &data[i], &found) == 0) !=
+            !every_third(&data[i], NULL)) failed++;
+    }
+
+    /* & it must keep working as any other tree */
+    for (i = 0; i < n; i += 3) avl_tree_insert(&tree, &data[i], NULL, false);
+    for (i = 1; i < n; i += 3) avl_tree_remove(&tree, &data[i], &found);
+    if ((check_subtree(tree.root_node, NULL) < 0) ||
+        (tree.n != n - ((n + 1) / 3))) {
+            printf("ERROR, tree broken after changing it\n");
+            failed++;
+    }
+    printf("%s\n", failed ? "FAILED" : "ok");
+    timer_report(&tmr, n, NULL);
+    printf("\n");
+
+    avl_tree_destroy(&tree, NULL, NULL);
+}
+
 #if 0
 
 void perform_avl_tree_test (avl_tree_t *avlt, int use_odd_numbers)
@@ -276,6 +475,9 @@ int main (argc, argv)
 int argc;
 char *argv [];
 {
+    range_test();
+    cursor_test();
+    remove_matching_test();
     traverse_test();
     return 0;
 
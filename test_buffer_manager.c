@@ -0,0 +1,202 @@
+
+#include <stdio.h>
+#include "buffer_manager.h"
+
+#define INITIAL         10
+#define MAX             50
+
+mem_monitor_t mm;
+buffer_manager_t bm;
+int failed = 0;
+
+void check_stats (int pool, unsigned long long int hits,
+    unsigned long long int fallthroughs, unsigned long long int failures)
+{
+    buffer_pool_stats_t stats;
+
+    buffer_manager_pool_statistics(&bm, pool, &stats);
+    if ((stats.hits != hits) || (stats.fallthroughs != fallthroughs) ||
+        (stats.failures != failures)) {
+            printf("pool %d: %llu hits, %llu fallthroughs, %llu failures, "
+                "expected %llu, %llu, %llu\n", pool, stats.hits,
+                stats.fallthroughs, stats.failures,
+                hits, fallthroughs, failures);
+            failed++;
+    }
+}
+
+/*
+ * an exhausted fixed pool passes requests on to the
+ * bigger pools, and then they fail
+ */
+void test_fixed (void)
+{
+    size_count_tuple_t tuples [] = { { 64, INITIAL }, { 128, 2 }, { -1, -1 } };
+    void *buffers [INITIAL + 3];
+    int i;
+
+    buffer_manager_initialize(&bm, false, tuples, &mm);
+    for (i = 0; i < INITIAL + 3; i++) buffers[i] = buffer_allocate(&bm, 64);
+    if ((NULL == buffers[INITIAL + 1]) || (NULL != buffers[INITIAL + 2])) {
+        printf("fixed pools did not run out as expected\n");
+        failed++;
+    }
+    check_stats(0, INITIAL, 2, 1);
+    if (buffer_allocate(&bm, 129) || buffer_allocate(&bm, -1)) {
+        printf("buffer bigger than the biggest pool allocated\n");
+        failed++;
+    }
+    for (i = 0; i < INITIAL + 2; i++) buffer_free(buffers[i]);
+    buffer_manager_destroy(&bm);
+}
+
+void test_growable (void)
+{
+    buffer_pool_spec_t specs [] = {
+        { 64, INITIAL, MAX }, { 1000, 1, 0 }, { -1, -1, -1 } };
+    unsigned char *buffers [MAX + 1];
+    int i, released, expected [] = { 0, 2, 1, 1, 0 };
+
+    buffer_manager_initialize_growable(&bm, true, specs, &mm);
+    for (i = 0; i <= MAX; i++) {
+        buffers[i] = buffer_allocate(&bm, 1 + (i % 64));
+        if (buffers[i]) memset(buffers[i], i, 1 + (i % 64));
+    }
+    if ((bm.pools[0].buffer_count != MAX) || (bm.pools[0].in_use != MAX)) {
+        printf("pool grew to %d buffers with %d in use, expected %d\n",
+            bm.pools[0].buffer_count, bm.pools[0].in_use, MAX);
+        failed++;
+    }
+    check_stats(0, MAX, 1, 0);
+    if (!buffer_manager_owns(&bm, buffers[MAX - 1]) ||
+        !buffer_manager_owns(&bm, buffers[MAX]) ||
+        buffer_manager_owns(&bm, &i)) {
+            printf("buffer ownership is wrong\n");
+            failed++;
+    }
+    for (i = 0; i <= MAX; i++) {
+        if (buffers[i][i % 64] != (unsigned char) i) {
+            printf("buffer %d was overwritten\n", i);
+            failed++;
+        }
+        buffer_free(buffers[i]);
+    }
+
+    /* the high water mark decays, giving the blocks back gradually */
+    for (i = 0; i < (int) (sizeof(expected) / sizeof(int)); i++) {
+        released = buffer_manager_trim(&bm);
+        if (released != expected[i]) {
+            printf("trim %d gave back %d blocks, expected %d\n",
+                i, released, expected[i]);
+            failed++;
+        }
+    }
+    buffer_manager_report(&bm, stdout);
+    if (bm.pools[0].buffer_count != INITIAL) {
+        printf("pool was trimmed to %d buffers, expected %d\n",
+            bm.pools[0].buffer_count, INITIAL);
+        failed++;
+    }
+
+    /* still works after being trimmed */
+    buffers[0] = buffer_allocate(&bm, 64);
+    if (NULL == buffers[0]) {
+        printf("allocation failed after a trim\n");
+        failed++;
+    }
+    buffer_free(buffers[0]);
+    buffer_manager_destroy(&bm);
+}
+
+/*
+ * views share the storage until the last one is released,
+ * and writing needs a private copy if it is shared
+ */
+void test_msgbuf (void)
+{
+    size_count_tuple_t tuples [] = { { 256, 2 }, { -1, -1 } };
+    msgbuf_t mb, clone, slice;
+    byte *p;
+
+    buffer_manager_initialize(&bm, true, tuples, &mm);
+    if (msgbuf_allocate(&bm, &mb, 32, 1000) != ENOMEM ||
+        msgbuf_allocate(&bm, &mb, 32, 100)) {
+            printf("message buffer allocation is wrong\n");
+            failed++;
+            return;
+    }
+    if ((msgbuf_headroom(&mb) != 32) ||
+        (msgbuf_tailroom(&mb) != 256 - 32 - (int) sizeof(msgbuf_storage_t))) {
+            printf("headroom %d & tailroom %d are wrong\n",
+                msgbuf_headroom(&mb), msgbuf_tailroom(&mb));
+            failed++;
+    }
+    memcpy(msgbuf_append(&mb, 10), "0123456789", 10);
+    memcpy(msgbuf_prepend(&mb, 2), "HH", 2);
+    if ((mb.length != 12) || memcmp(mb.data, "HH0123456789", 12) ||
+        msgbuf_prepend(&mb, 31) || msgbuf_append(&mb, 1000)) {
+            printf("prepending & appending are wrong\n");
+            failed++;
+    }
+
+    msgbuf_clone(&clone, &mb);
+    if (msgbuf_slice(&slice, &mb, 2, 11) != EINVAL ||
+        msgbuf_slice(&slice, &mb, 2, 10) ||
+        memcmp(slice.data, "0123456789", 10) || (mb.storage->refcount != 3)) {
+            printf("slicing is wrong\n");
+            failed++;
+    }
+
+    /* shared storage cannot be grown into */
+    if (msgbuf_prepend(&clone, 1) || msgbuf_append(&clone, 1) ||
+        (clone.length != mb.length)) {
+            printf("growing a shared storage is wrong\n");
+            failed++;
+    }
+
+    /* writing into the clone must not change the others */
+    msgbuf_unshare(&clone);
+    if (NULL == msgbuf_append(&clone, 0)) {
+        printf("growing an unshared storage is wrong\n");
+        failed++;
+    }
+    p = msgbuf_trim_front(&clone, 2);
+    p[0] = 'X';
+    if ((clone.storage == mb.storage) || (mb.storage->refcount != 2) ||
+        (mb.data[2] != '0') || memcmp(clone.data, "X123456789", 10) ||
+        (msgbuf_headroom(&clone) != msgbuf_headroom(&mb) + 2)) {
+            printf("unsharing is wrong\n");
+            failed++;
+    }
+
+    /* the storage goes only when the last view does */
+    msgbuf_release(&mb);
+    msgbuf_release(&clone);
+    if (bm.pools[0].in_use != 1 || memcmp(slice.data, "0123456789", 10)) {
+        printf("storage was released while still viewed\n");
+        failed++;
+    }
+    msgbuf_release(&slice);
+    msgbuf_release(&slice);
+    if (bm.pools[0].in_use != 0) {
+        printf("storage was not released\n");
+        failed++;
+    }
+    buffer_manager_destroy(&bm);
+}
+
+int main (int argc, char *argv[])
+{
+    mem_monitor_init(&mm, MEM_MONITOR_UNSYNCHRONIZED);
+    test_fixed();
+    test_growable();
+    test_msgbuf();
+    if (mem_monitor_bytes_used(&mm)) {
+        printf("%llu bytes leaked\n", mem_monitor_bytes_used(&mm));
+        failed++;
+    }
+    mem_monitor_destroy(&mm);
+
+    printf("\n%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
@@ -4,6 +4,8 @@
 #define CHUNK_SIZE              150
 #define MAX_CHUNKS              1024
 #define LOOP                    (1024 * 1024)
+#define RANDOM_CHUNKS           (2 * 1024 * 1024)
+#define RANDOM_STEPS            (8 * 1024 * 1024)
 
 unsigned char *chunks [MAX_CHUNKS];
 chunk_manager_t cmgr;
@@ -17,6 +19,66 @@ timer_obj_t tp;
     #define freeup(ptr)         chunk_free(ptr)
 #endif /* USE_MALLOC */
 
+#ifndef USE_MALLOC
+
+/*
+ * Links RANDOM_CHUNKS chunks into a randomly ordered ring and walks
+ * it, which is what the nodes of a big tree look like to the TLB.
+ * Reports the average cost of reaching a chunk with the given options.
+ */
+int random_access_test (char *name, int options)
+{
+    static void **ring [RANDOM_CHUNKS];
+    chunk_manager_t rcmgr;
+    void **cp;
+    long long int i, j;
+    timer_obj_t rtp;
+
+    if (chunk_manager_init_with_options(&rcmgr, false, CHUNK_SIZE,
+            MAX_CHUNKS_PER_GROUP, options, NULL)) {
+        printf("%s: chunk_manager_init_with_options failed\n", name);
+        return -1;
+    }
+    for (i = 0; i < RANDOM_CHUNKS; i++) {
+        ring[i] = chunk_alloc(&rcmgr);
+        if (NULL == ring[i]) {
+            printf("%s: chunk alloc failed at %lld\n", name, i);
+            chunk_manager_destroy(&rcmgr);
+            return -1;
+        }
+    }
+
+    /* shuffle & link */
+    srandom(1);
+    for (i = RANDOM_CHUNKS - 1; i > 0; i--) {
+        j = random() % (i + 1);
+        cp = ring[i];
+        ring[i] = ring[j];
+        ring[j] = cp;
+    }
+    for (i = 0; i < RANDOM_CHUNKS; i++) {
+        *ring[i] = ring[(i + 1) % RANDOM_CHUNKS];
+    }
+
+    cp = ring[0];
+    timer_start(&rtp);
+    for (i = 0; i < RANDOM_STEPS; i++) cp = *cp;
+    timer_end(&rtp);
+    printf("%-12s %6.2lf nsecs per random chunk access (%p)\n", name,
+        (double) timer_delay_nsecs(&rtp) / RANDOM_STEPS, (void*) cp);
+
+    for (i = 0; i < RANDOM_CHUNKS; i++) chunk_free(ring[i]);
+    if (chunk_manager_trim(&rcmgr) < 1) {
+        printf("%s: nothing trimmed\n", name);
+        chunk_manager_destroy(&rcmgr);
+        return -1;
+    }
+    chunk_manager_destroy(&rcmgr);
+    return 0;
+}
+
+#endif /* USE_MALLOC */
+
 int main (int argc, char *argv[])
 {
     int i, j;
@@ -79,6 +141,16 @@ int main (int argc, char *argv[])
     printf("3: trimmed %d groups\n", trim);
     trim = chunk_manager_trim(&cmgr);
     printf("4: trimmed %d groups\n", trim);
+
+    printf("started random access test\n");
+    if (random_access_test("plain", 0) ||
+        random_access_test("huge pages", CHUNK_MANAGER_HUGE_PAGES) ||
+        random_access_test("hugetlb", CHUNK_MANAGER_HUGETLB) ||
+        random_access_test("numa", CHUNK_MANAGER_NUMA) ||
+        random_access_test("numa + huge",
+            CHUNK_MANAGER_NUMA | CHUNK_MANAGER_HUGE_PAGES)) {
+                return -1;
+    }
 #endif
     return 0;
 } 
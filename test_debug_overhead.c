@@ -1,24 +1,118 @@
 
 #include <unistd.h>
+#include <pthread.h>
 #include "timer_object.h"
 #include "debug_framework.h"
 
-#define TEST			0
-#define EXECUTE_ITERATIONS	((long long int) 10000000)
-#define CHECK_ITERATIONS	(1500 * EXECUTE_ITERATIONS)
+#define CHECK_ITERATIONS        ((long long int) 100000000)
+#define REPORT_ITERATIONS       ((long long int) 1000000)
+#define MAX_THREADS             8
 
+/*
+ * The reporting thread cannot format as fast as the threads fill their
+ * rings, so they would mostly be timing dropped records.  Instead every
+ * thread writes at most what its ring holds in a round, the rings are
+ * drained by stopping between rounds, and there are enough rounds.
+ */
+#define RING_RECORDS            (16 * 1024)
+#define RING_ROUNDS             16
+
+debug_module_block_t test_debug;
 timer_obj_t tmr;
+pthread_barrier_t round_start, round_end;
+long long int report_iterations;
+int report_rounds;
 
-void do_nothing (char *message)
+/*
+ * Every round is started & ended by all the threads & the main thread
+ * together, so that the main thread can drain the rings in between.
+ * The first of several rounds only warms up the rings & is not timed.
+ */
+void *reporting_thread (void *arg)
 {
+    timer_obj_t t;
+    long long int i, nsecs = 0;
+    double *per_msg = (double*) arg;
+    int r, timed = 0;
+
+    for (r = 0; r < report_rounds; r++) {
+        pthread_barrier_wait(&round_start);
+        timer_start(&t);
+        for (i = 0; i < report_iterations; i++) {
+            TRACE(&test_debug, "message %lld from %s, value %d\n",
+                i, "thread", (int) (i & 0xFF));
+        }
+        timer_end(&t);
+        if ((r > 0) || (1 == report_rounds)) {
+            nsecs += timer_delay_nsecs(&t);
+            timed++;
+        }
+        pthread_barrier_wait(&round_end);
+    }
+    *per_msg = (double) nsecs / (double) (report_iterations * timed);
+
+    return NULL;
+}
+
+/*
+ * returns the average nano seconds per message seen by each thread,
+ * the messages going into the rings if 'rounds' is more than 1
+ */
+double report_with_threads (int n_threads, long long int iterations,
+    int rounds)
+{
+    pthread_t tids [MAX_THREADS];
+    double per_msg [MAX_THREADS], total = 0;
+    int i, r;
+
+    report_iterations = iterations;
+    report_rounds = rounds;
+    pthread_barrier_init(&round_start, NULL, n_threads + 1);
+    pthread_barrier_init(&round_end, NULL, n_threads + 1);
+    for (i = 0; i < n_threads; i++) {
+        pthread_create(&tids[i], NULL, reporting_thread, &per_msg[i]);
+    }
+    for (r = 0; r < rounds; r++) {
+        if ((rounds > 1) && debug_ring_start(stderr, RING_RECORDS)) {
+            printf("debug_ring_start failed\n");
+            exit(-1);
+        }
+        pthread_barrier_wait(&round_start);
+        pthread_barrier_wait(&round_end);
+        if (rounds > 1) debug_ring_stop();
+    }
+    for (i = 0; i < n_threads; i++) {
+        pthread_join(tids[i], NULL);
+        total += per_msg[i];
+    }
+    pthread_barrier_destroy(&round_start);
+    pthread_barrier_destroy(&round_end);
+    return total / n_threads;
 }
 
 int main (int argc, char *argv[])
 {
     volatile long long int i;
-    double loop_overhead, total_overhead;
+    double loop_overhead, total_overhead, sync_ns, ring_ns;
+    unsigned long long int dropped;
+    int n;
 
-    debug_init();
+    /* all the output goes to the bit bucket, we are measuring the cost */
+    if (NULL == freopen("/dev/null", "w", stderr)) {
+        printf("cannot redirect stderr to /dev/null\n");
+        return -1;
+    }
+
+    debug_module_block_init(&test_debug, true, ERROR_DEBUG_LEVEL,
+        "TEST", NULL);
+
+#ifdef DEBUG_STATIC_TRACEPOINTS_ENABLED
+    printf("\ncall sites are statically patched NOPs/JMPs");
+#else
+    printf("\ncall sites check the module level at run time");
+#endif
+    printf(", compile time minimum level is %d\n",
+        DEBUG_COMPILE_TIME_MINIMUM_LEVEL);
 
     /* First measure the overhead of the for loop alone */
     printf("\nmeasuring the overhead of the for loop ...\n");
@@ -28,31 +122,30 @@ int main (int argc, char *argv[])
     timer_end(&tmr);
     timer_report(&tmr, CHECK_ITERATIONS, &loop_overhead);
 
-    printf("\ncalculating how much overhead is taken to only CHECK debug framework\n");
-    debug_module_set_minimum_reporting_level(TEST, ERROR_LEVEL);
+    printf("\nmeasuring the overhead of a DISABLED call site ...\n");
     timer_start(&tmr);
     for (i = 0; i < CHECK_ITERATIONS; i++) {
-	    DEBUG(TEST, "should NEVER be printed");
+        TRACE(&test_debug, "should NEVER be reported %lld\n", i);
     }
     timer_end(&tmr);
-    printf("overhead of simply CHECKING debug framework\n");
     timer_report(&tmr, CHECK_ITERATIONS, &total_overhead);
-    printf("exact overhead of debug checking: %.4lf nano seconds\n",
-	total_overhead - loop_overhead);
+    printf("exact overhead of a disabled call site: %.4lf nano seconds\n",
+        total_overhead - loop_overhead);
 
-    /* Now measure the overhead of reporting with an empty function */
-    printf("\ncalculating how much overhead is taken to execute framework\n");
-    debug_module_set_reporting_function(TEST, do_nothing);
-    debug_module_set_minimum_reporting_level(TEST, DEBUG_LEVEL);
-    timer_start(&tmr);
-    for (i = 0; i < EXECUTE_ITERATIONS; i++) {
-	    DEBUG(TEST, "should NEVER be printed");
+    /* now every message is reported */
+    debug_module_block_set_level(&test_debug, TRACE_DEBUG_LEVEL);
+    printf("\n%8s %18s %18s %12s\n",
+        "threads", "sync ns/msg", "ring ns/msg", "ring drops");
+    for (n = 1; n <= MAX_THREADS; n <<= 1) {
+
+        sync_ns = report_with_threads(n, REPORT_ITERATIONS, 1);
+
+        dropped = debug_ring_dropped_count();
+        ring_ns = report_with_threads(n, RING_RECORDS, RING_ROUNDS + 1);
+        dropped = debug_ring_dropped_count() - dropped;
+
+        printf("%8d %18.3lf %18.3lf %12llu\n", n, sync_ns, ring_ns, dropped);
     }
-    timer_end(&tmr);
-    printf("overhead of executing the debug framework\n");
-    timer_report(&tmr, EXECUTE_ITERATIONS, NULL);
 
     return 0;
 }
-
-
@@ -0,0 +1,220 @@
+
+#include <pthread.h>
+#include <unistd.h>
+#include "timer_object.h"
+#include "debug_framework.h"
+
+#define TRACE_FILE          "/tmp/test_debug_trace.bin"
+#define ITERATIONS          ((long long int) 200000)
+#define THREADS             4
+
+debug_module_block_t test_debug;
+volatile int start_threads = 0;
+volatile int stop_threads = 0;
+
+void *tracing_thread (void *arg)
+{
+    long long int i;
+    double *per_msg = (double*) arg;
+    timer_obj_t t;
+
+    while (start_threads == 0);
+    timer_start(&t);
+    for (i = 0; i < ITERATIONS; i++) {
+        TRACE(&test_debug, "message %lld from %s, value %d\n",
+            i, "thread", (int) (i & 0xFF));
+    }
+    timer_end(&t);
+    *per_msg = (double) timer_delay_nsecs(&t) / (double) ITERATIONS;
+
+    return NULL;
+}
+
+/* keeps tracing till told to stop, counting what it traced */
+void *stopped_thread (void *arg)
+{
+    long long int *sent = (long long int*) arg;
+
+    while (start_threads == 0);
+    while (!stop_threads) {
+        TRACE(&test_debug, "message %lld\n", *sent);
+        (*sent)++;
+    }
+    return NULL;
+}
+
+/*
+ * every decoded message must be exactly what printf would have printed
+ */
+int check_message (const char *decoded, const char *expected)
+{
+    const char *msg = strstr(decoded, "<main>: ");
+
+    if (msg && (0 == strcmp(msg + 8, expected))) return 0;
+    printf("expected '%s' but decoded '%s'\n", expected, decoded);
+    return 1;
+}
+
+int main (int argc, char *argv[])
+{
+    pthread_t tids [THREADS];
+    double per_msg [THREADS], total = 0;
+    unsigned long long int dropped;
+    long long int decoded = 0, printed, total_sent;
+    long long int sent [THREADS];
+    int saved_stderr;
+    char line [1024], expected [1024];
+    int i, failed = 0;
+    FILE *fp;
+
+    debug_module_block_init(&test_debug, true, TRACE_DEBUG_LEVEL,
+        "TEST", NULL);
+
+    /* messages with all sorts of arguments must decode correctly */
+    printf("\nchecking decoded messages ...\n");
+    if (debug_trace_start(TRACE_FILE, 64 * 1024)) {
+        printf("debug_trace_start failed\n");
+        return -1;
+    }
+    TRACE(&test_debug, "plain message\n");
+    TRACE(&test_debug, "%d %u %x %ld %lld %hhd\n",
+        -1, 2u, 0xbeef, -3L, 1LL << 40, (char) 7);
+    INFO(&test_debug, "%s and %s, %s\n", "first", "second", (char*) NULL);
+    WARN(&test_debug, "%8.3f %e %*d|%-*s|\n", 3.14159, 1e-10, 6, 42, 5, "ab");
+    TRACE(&test_debug, "100%% %c\n", 'x');
+    failed = debug_trace_stop();
+    if (failed) {
+        printf("debug_trace_stop failed: %s\n", strerror(failed));
+        return -1;
+    }
+
+    fp = tmpfile();
+    failed = debug_trace_decode(TRACE_FILE, fp);
+    if (failed) {
+        printf("debug_trace_decode failed: %s\n", strerror(failed));
+        return -1;
+    }
+    rewind(fp);
+    for (i = 0; i < 5; i++) {
+        if (NULL == fgets(line, sizeof(line), fp)) {
+            printf("decoded only %d messages out of 5\n", i);
+            return -1;
+        }
+        switch (i) {
+        case 0: sprintf(expected, "plain message\n"); break;
+        case 1: sprintf(expected, "%d %u %x %ld %lld %hhd\n",
+                    -1, 2u, 0xbeef, -3L, 1LL << 40, (char) 7); break;
+        case 2: sprintf(expected, "%s and %s, %s\n",
+                    "first", "second", "(null)"); break;
+        case 3: sprintf(expected, "%8.3f %e %*d|%-*s|\n",
+                    3.14159, 1e-10, 6, 42, 5, "ab"); break;
+        case 4: sprintf(expected, "100%% %c\n", 'x'); break;
+        }
+        failed += check_message(line, expected);
+    }
+    fclose(fp);
+    if (failed) return -1;
+    printf("all decoded messages are correct\n");
+
+    /* now the cost & the volume of tracing from many threads */
+    printf("\ntracing %lld messages from each of %d threads ...\n",
+        ITERATIONS, THREADS);
+    dropped = debug_ring_dropped_count();
+    if (debug_trace_start(TRACE_FILE, 64 * 1024)) {
+        printf("debug_trace_start failed\n");
+        return -1;
+    }
+    for (i = 0; i < THREADS; i++) {
+        pthread_create(&tids[i], NULL, tracing_thread, &per_msg[i]);
+    }
+    start_threads = 1;
+    for (i = 0; i < THREADS; i++) {
+        pthread_join(tids[i], NULL);
+        total += per_msg[i];
+    }
+    if (debug_trace_stop()) {
+        printf("debug_trace_stop failed\n");
+        return -1;
+    }
+    dropped = debug_ring_dropped_count() - dropped;
+
+    fp = tmpfile();
+    if (debug_trace_decode(TRACE_FILE, fp)) {
+        printf("debug_trace_decode failed\n");
+        return -1;
+    }
+    rewind(fp);
+    while (fgets(line, sizeof(line), fp)) decoded++;
+    fclose(fp);
+
+    printf("%.3lf nano seconds per message, %llu dropped, %lld decoded\n",
+        total / THREADS, dropped, decoded);
+    if ((decoded + (long long int) dropped) != (ITERATIONS * THREADS)) {
+        printf("decoded + dropped messages do NOT add up\n");
+        return -1;
+    }
+
+    /*
+     * stop while the threads are still tracing, every message must
+     * end up either in the trace, dropped or printed to stderr
+     */
+    printf("\nstopping the trace while %d threads are tracing ...\n",
+        THREADS);
+    fflush(stdout);
+    fp = tmpfile();
+    saved_stderr = dup(2);
+    dup2(fileno(fp), 2);
+    start_threads = 0;
+    dropped = debug_ring_dropped_count();
+    if (debug_trace_start(TRACE_FILE, 64 * 1024)) {
+        printf("debug_trace_start failed\n");
+        return -1;
+    }
+    for (i = 0; i < THREADS; i++) {
+        sent[i] = 0;
+        pthread_create(&tids[i], NULL, stopped_thread, &sent[i]);
+    }
+    start_threads = 1;
+    nano_seconds_sleep(SEC_TO_NSEC_FACTOR / 50);
+    failed = debug_trace_stop();
+    nano_seconds_sleep(SEC_TO_NSEC_FACTOR / 1000);
+    stop_threads = 1;
+    total_sent = 0;
+    for (i = 0; i < THREADS; i++) {
+        pthread_join(tids[i], NULL);
+        total_sent += sent[i];
+    }
+    fflush(stderr);
+    dup2(saved_stderr, 2);
+    close(saved_stderr);
+    if (failed) {
+        printf("debug_trace_stop failed\n");
+        return -1;
+    }
+    dropped = debug_ring_dropped_count() - dropped;
+
+    printed = 0;
+    rewind(fp);
+    while (fgets(line, sizeof(line), fp)) printed++;
+    fclose(fp);
+
+    decoded = 0;
+    fp = tmpfile();
+    if (debug_trace_decode(TRACE_FILE, fp)) {
+        printf("debug_trace_decode failed\n");
+        return -1;
+    }
+    rewind(fp);
+    while (fgets(line, sizeof(line), fp)) decoded++;
+    fclose(fp);
+
+    printf("%lld sent, %lld decoded, %llu dropped, %lld printed\n",
+        total_sent, decoded, dropped, printed);
+    if ((decoded + (long long int) dropped + printed) != total_sent) {
+        printf("messages were lost when the trace stopped\n");
+        return -1;
+    }
+    unlink(TRACE_FILE);
+
+    return 0;
+}
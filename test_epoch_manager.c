@@ -0,0 +1,200 @@
+
+#include <stdio.h>
+#include <pthread.h>
+#include "timer_object.h"
+#include "lock_object.h"
+#include "epoch_manager.h"
+
+#define READERS         4
+#define UPDATES         200000
+#define MAGIC           0x5AFE5AFE
+#define DEAD            0xDEADDEAD
+
+typedef struct version_s {
+    volatile unsigned int magic;
+    long long int value;
+} version_t;
+
+epoch_manager_t epochs;
+lock_obj_t lock;
+version_t * volatile current;
+volatile int stop_threads = 0;
+volatile long long int destroyed = 0;
+histogram_t read_hist, write_hist;
+
+static void
+version_destroy (void *data, void *extra_arg)
+{
+    version_t *vp = (version_t*) data;
+
+    /* a reader seeing this has read freed memory */
+    vp->magic = DEAD;
+    free(vp);
+    __sync_fetch_and_add(&destroyed, 1);
+}
+
+static version_t *
+version_create (long long int value)
+{
+    version_t *vp = malloc(sizeof(version_t));
+
+    vp->magic = MAGIC;
+    vp->value = value;
+    return vp;
+}
+
+/*
+ * readers must never see a destroyed version & the
+ * values they see must never go back in time
+ */
+void *reading_thread (void *arg)
+{
+    int use_epochs = (int) ((long) arg);
+    long long int errors = 0, last = 0;
+    version_t *vp;
+    cycles_t start;
+
+    while (stop_threads == 0) {
+        start = cycles_now();
+        if (use_epochs) {
+            epoch_enter(&epochs);
+            epoch_enter(&epochs);
+            vp = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+            epoch_exit(&epochs);
+            if ((vp->magic != MAGIC) || (vp->value < last)) errors++;
+            last = vp->value;
+            epoch_exit(&epochs);
+        } else {
+            grab_read_lock(&lock);
+            vp = current;
+            if ((vp->magic != MAGIC) || (vp->value < last)) errors++;
+            last = vp->value;
+            release_read_lock(&lock);
+        }
+        histogram_record(&read_hist, cycles_now() - start);
+    }
+    return (void*) errors;
+}
+
+/*
+ * replaces the current version UPDATES times, while the readers
+ * keep reading it, either under the lock or in an epoch
+ */
+int mixed_test (char *name, int use_epochs)
+{
+    pthread_t tids [READERS];
+    version_t *old;
+    cycles_t start;
+    void *errors;
+    int t, i, failed = 0;
+
+    histogram_init(&read_hist, "read", 1);
+    histogram_init(&write_hist, "write", 1);
+    epoch_manager_init(&epochs, NULL);
+    lock_obj_init(&lock);
+    destroyed = 0;
+    current = version_create(0);
+
+    stop_threads = 0;
+    for (t = 0; t < READERS; t++) {
+        pthread_create(&tids[t], NULL, reading_thread,
+            (void*) ((long) use_epochs));
+    }
+    for (i = 1; i <= UPDATES; i++) {
+        start = cycles_now();
+        if (use_epochs) {
+            old = current;
+            __atomic_store_n(&current, version_create(i), __ATOMIC_RELEASE);
+            epoch_retire(&epochs, old, version_destroy, NULL);
+        } else {
+            grab_write_lock(&lock);
+            old = current;
+            current = version_create(i);
+            release_write_lock(&lock);
+            version_destroy(old, NULL);
+        }
+        histogram_record(&write_hist, cycles_now() - start);
+    }
+    stop_threads = 1;
+    for (t = 0; t < READERS; t++) {
+        pthread_join(tids[t], &errors);
+        if (errors) {
+            printf("%s: reader %d saw %lld bad versions\n", name, t,
+                (long long int) errors);
+            failed++;
+        }
+    }
+
+    if (use_epochs) {
+        printf("%s: %llu epoch advances, %lld of %d versions destroyed "
+            "before synchronizing\n", name, epochs.advances,
+            destroyed, UPDATES);
+        epoch_synchronize(&epochs);
+        if ((destroyed != UPDATES) || epochs.n_retired ||
+            (epochs.reclamations != UPDATES)) {
+                printf("%s: only %lld versions destroyed\n", name, destroyed);
+                failed++;
+        }
+    }
+    histogram_report(&read_hist);
+    histogram_report(&write_hist);
+    printf("%-8s %s\n\n", name, failed ? "FAILED" : "passed");
+
+    epoch_manager_destroy(&epochs);
+    free(current);
+    histogram_destroy(&read_hist);
+    histogram_destroy(&write_hist);
+
+    return failed;
+}
+
+/*
+ * nothing retired can be destroyed while a reader is in
+ */
+int test_blocking_reader (void)
+{
+    int failed = 0;
+
+    epoch_manager_init(&epochs, NULL);
+    destroyed = 0;
+    epoch_enter(&epochs);
+    epoch_retire(&epochs, version_create(1), version_destroy, NULL);
+    epoch_reclaim(&epochs);
+    epoch_reclaim(&epochs);
+    epoch_reclaim(&epochs);
+    if (destroyed) {
+        printf("destroyed while a reader is still in\n");
+        failed++;
+    }
+    epoch_exit(&epochs);
+    epoch_synchronize(&epochs);
+    if (destroyed != 1) {
+        printf("not destroyed after the reader left\n");
+        failed++;
+    }
+
+    /* destroy must get rid of whatever is left */
+    epoch_enter(&epochs);
+    epoch_retire(&epochs, version_create(2), version_destroy, NULL);
+    epoch_exit(&epochs);
+    epoch_manager_destroy(&epochs);
+    if (destroyed != 2) {
+        printf("destroy left retired data behind\n");
+        failed++;
+    }
+    printf("%-8s %s\n\n", "blocking", failed ? "FAILED" : "passed");
+
+    return failed;
+}
+
+int main (int argc, char *argv[])
+{
+    int failed = 0;
+
+    failed += test_blocking_reader();
+    failed += mixed_test("rwlock", 0);
+    failed += mixed_test("epoch", 1);
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
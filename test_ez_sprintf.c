@@ -0,0 +1,118 @@
+
+#include <stdio.h>
+#include <limits.h>
+#include "ez_sprintf.h"
+
+int failed = 0;
+
+void check (ez_sprintf_t *ezsp, char *expected, char *what)
+{
+    if (strcmp(ezsp->buffer, expected) ||
+        (ezsp->write_idx != (int) strlen(expected)) ||
+        (ezsp->remaining_size != ezsp->max_size - ezsp->write_idx)) {
+            printf("%s: got <%s>, expected <%s>\n",
+                what, ezsp->buffer, expected);
+            failed++;
+    }
+    ez_sprintf_reset(ezsp);
+}
+
+/*
+ * every typed append must produce exactly what snprintf would
+ */
+void check_typed (ez_sprintf_t *ezsp)
+{
+    long long int ints [] = { 0, 1, -1, 9, 10, 99, 100, -12345, 1234567890123LL,
+        LLONG_MAX, LLONG_MIN };
+    char expected [256];
+    int i, width;
+
+    for (i = 0; i < (int) (sizeof(ints) / sizeof(ints[0])); i++) {
+        for (width = 0; width <= 24; width += 6) {
+            ez_sprintf_append_int(ezsp, ints[i], width);
+            snprintf(expected, sizeof(expected), "%*lld", width, ints[i]);
+            check(ezsp, expected, "int");
+            ez_sprintf_append_uint(ezsp, ints[i], width);
+            snprintf(expected, sizeof(expected), "%*llu", width,
+                (unsigned long long int) ints[i]);
+            check(ezsp, expected, "uint");
+            ez_sprintf_append_hex(ezsp, ints[i], width);
+            snprintf(expected, sizeof(expected), "%0*llx", width,
+                (unsigned long long int) ints[i]);
+            check(ezsp, expected, "hex");
+        }
+    }
+
+    ez_sprintf_append_pointer(ezsp, ezsp);
+    snprintf(expected, sizeof(expected), "%p", (void*) ezsp);
+    check(ezsp, expected, "pointer");
+    ez_sprintf_append_pointer(ezsp, NULL);
+    check(ezsp, "0x0", "null pointer");
+
+    ez_sprintf_append_string(ezsp, "abc");
+    ez_sprintf_append_padding(ezsp, '.', 3);
+    ez_sprintf_append_bytes(ezsp, "xyz123", 3);
+    ez_sprintf_append(ezsp, "%d", 42);
+    check(ezsp, "abc...xyz42", "mixed");
+
+    ez_sprintf_incr_indent(ezsp, 0);
+    ez_sprintf_incr_indent(ezsp, 0);
+    ez_sprintf_indent(ezsp);
+    ez_sprintf_append_string(ezsp, "x");
+    check(ezsp, "        x", "indent");
+}
+
+int main (int argc, char *argv[])
+{
+    ez_sprintf_t ezs;
+    char buffer [32];
+    mem_monitor_t mm;
+    int i, rv;
+
+    /* external buffer */
+    ez_sprintf_init_with_external_buffer(&ezs, buffer, sizeof(buffer), 4);
+    check_typed(&ezs);
+
+    /* nothing is written past the end of an external buffer */
+    for (i = 0; i < 10; i++) ez_sprintf_append_string(&ezs, "abc");
+    if ((ez_sprintf_append_string(&ezs, "abc") != ENOSPC) ||
+        (ezs.write_idx != 24)) {
+            printf("typed append did not fail cleanly when full\n");
+            failed++;
+    }
+    ez_sprintf_reset(&ezs);
+    rv = ez_sprintf_append(&ezs, "%s%s", "0123456789012345", "0123456789");
+    if ((rv != ENOSPC) || (ezs.write_idx != 23) ||
+        (strlen(ezs.buffer) != 23)) {
+            printf("formatted append did not truncate when full\n");
+            failed++;
+    }
+
+    /* growable buffer */
+    memset(&mm, 0, sizeof(mm));
+    if (ez_sprintf_init_growable(&ezs, 0, 4, &mm)) {
+        printf("growable init failed\n");
+        return -1;
+    }
+    check_typed(&ezs);
+    for (i = 0; i < 100000; i++) {
+        ez_sprintf_append_int(&ezs, i, 6);
+        ez_sprintf_append(&ezs, " %s\n", "formatted");
+    }
+    if (ezs.write_idx != 100000 * 17) {
+        printf("growable buffer holds %d bytes\n", ezs.write_idx);
+        failed++;
+    }
+    if ((mm.bytes_used == 0) || (mm.allocations != 1)) {
+        printf("growable buffer is not accounted for\n");
+        failed++;
+    }
+    ez_sprintf_destroy(&ezs);
+    if (mm.bytes_used != 0) {
+        printf("%llu bytes leaked\n", mm.bytes_used);
+        failed++;
+    }
+
+    printf("\n%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
@@ -0,0 +1,166 @@
+
+#include <stdio.h>
+#include <pthread.h>
+#include "timer_object.h"
+#include "handle_table.h"
+
+#define THREADS         4
+#define HANDLES         200000
+#define STABLE          1000
+
+handle_table_t table;
+long long int objects [HANDLES];
+volatile int stop_threads = 0;
+
+/*
+ * resolves the handles created before the table started
+ * growing, which must keep resolving while it grows
+ */
+void *resolving_thread (void *arg)
+{
+    handle_t *handles = (handle_t*) arg;
+    long long int errors = 0;
+    int i;
+
+    while (stop_threads == 0) {
+        for (i = 0; i < STABLE; i++) {
+            if (handle_resolve(&table, handles[i]) != &objects[i]) errors++;
+        }
+    }
+    return (void*) errors;
+}
+
+/*
+ * removed handles must never resolve again,
+ * even after their entries are reused
+ */
+int test_stale (void)
+{
+    handle_t h1, h2, h3;
+    void *p;
+    int failed = 0;
+
+    handle_table_init(&table, false, 0, NULL);
+    if ((handle_create(&table, NULL, &h1) != EINVAL) ||
+        (h1 != NULL_HANDLE)) {
+            printf("NULL pointer accepted\n");
+            failed++;
+    }
+    handle_create(&table, &objects[0], &h1);
+    handle_create(&table, &objects[1], &h2);
+    if ((handle_resolve(&table, h1) != &objects[0]) ||
+        (handle_resolve(&table, h2) != &objects[1]) ||
+        handle_resolve(&table, NULL_HANDLE) ||
+        handle_resolve(&table, HANDLE_MAKE(5000, 1))) {
+            printf("handles resolve wrong\n");
+            failed++;
+    }
+    if (handle_remove(&table, h1, &p) || (p != &objects[0]) ||
+        (handle_remove(&table, h1, &p) != ENODATA) ||
+        handle_resolve(&table, h1)) {
+            printf("removed handle still resolves\n");
+            failed++;
+    }
+
+    /* the entry of h1 is reused but h1 must stay dead */
+    handle_create(&table, &objects[2], &h3);
+    if ((HANDLE_INDEX(h3) != HANDLE_INDEX(h1)) || (h3 == h1) ||
+        handle_resolve(&table, h1) ||
+        (handle_resolve(&table, h3) != &objects[2]) ||
+        (table.n_handles != 2)) {
+            printf("reused entry resolves a stale handle\n");
+            failed++;
+    }
+    handle_table_destroy(&table);
+
+    /* a limited table */
+    handle_table_init(&table, false, 3, NULL);
+    handle_create(&table, &objects[0], &h1);
+    handle_create(&table, &objects[0], &h2);
+    handle_create(&table, &objects[0], &h3);
+    if (handle_create(&table, &objects[0], &h1) != ENOSPC) {
+        printf("limit of the table not respected\n");
+        failed++;
+    }
+    handle_remove(&table, h2, NULL);
+    if (handle_create(&table, &objects[0], &h1)) {
+        printf("freed entry not reused\n");
+        failed++;
+    }
+    handle_table_destroy(&table);
+    printf("%-10s %s\n", "stale", failed ? "FAILED" : "passed");
+
+    return failed;
+}
+
+/*
+ * handles must keep resolving, without any locks,
+ * while the table grows & other handles come & go
+ */
+int test_growth (void)
+{
+    static handle_t handles [HANDLES];
+    pthread_t tids [THREADS];
+    mem_monitor_t mm;
+    timer_obj_t tmr;
+    void *errors;
+    int t, i, failed = 0;
+
+    memset(&mm, 0, sizeof(mm));
+    handle_table_init(&table, true, 0, &mm);
+    for (i = 0; i < STABLE; i++) {
+        handle_create(&table, &objects[i], &handles[i]);
+    }
+    stop_threads = 0;
+    for (t = 0; t < THREADS; t++) {
+        pthread_create(&tids[t], NULL, resolving_thread, handles);
+    }
+
+    timer_start(&tmr);
+    for (i = STABLE; i < HANDLES; i++) {
+        if (handle_create(&table, &objects[i], &handles[i])) failed++;
+        if (i & 1) handle_remove(&table, handles[i - 1], NULL);
+    }
+    timer_end(&tmr);
+    stop_threads = 1;
+    for (t = 0; t < THREADS; t++) {
+        pthread_join(tids[t], &errors);
+        if (errors) {
+            printf("thread %d: %lld wrong resolutions\n", t,
+                (long long int) errors);
+            failed++;
+        }
+    }
+    printf("%.2lf nsecs per create (& half as many removes)\n",
+        (double) timer_delay_nsecs(&tmr) / (HANDLES - STABLE));
+
+    for (i = STABLE; i < HANDLES; i++) {
+        if (handle_resolve(&table, handles[i]) !=
+            ((i & 1) ? &objects[i] : NULL)) failed++;
+    }
+    timer_start(&tmr);
+    for (i = 0; i < HANDLES; i++) handle_resolve(&table, handles[i]);
+    timer_end(&tmr);
+    printf("%.2lf nsecs per resolve\n",
+        (double) timer_delay_nsecs(&tmr) / HANDLES);
+
+    handle_table_destroy(&table);
+    if (mm.bytes_used != 0) {
+        printf("%llu bytes leaked\n", mm.bytes_used);
+        failed++;
+    }
+    printf("%-10s %s\n", "growth", failed ? "FAILED" : "passed");
+
+    return failed;
+}
+
+int main (int argc, char *argv[])
+{
+    int failed = 0;
+
+    failed += test_stale();
+    failed += test_growth();
+
+    printf("\n%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
@@ -0,0 +1,131 @@
+
+#include <stdio.h>
+#include <pthread.h>
+#include "timer_object.h"
+
+#define VALUES          100000
+#define THREADS         8
+#define ITERATIONS      ((long long int) 10000000)
+
+histogram_t values, merged, sleeps, costs;
+volatile int start_threads = 0;
+
+void *recording_thread (void *arg)
+{
+    unsigned long long int v;
+
+    while (start_threads == 0);
+    for (v = 1; v <= VALUES; v++) histogram_record(&values, v);
+    return NULL;
+}
+
+/*
+ * the percentiles of 1 .. VALUES must be within the bucket precision
+ */
+int check_percentile (histogram_t *hp, double percentile)
+{
+    unsigned long long int value = histogram_percentile(hp, percentile);
+    double expected = (percentile / 100.0) * VALUES;
+    double error = ((double) value - expected) / expected;
+
+    if ((error < 0) || (error > (1.0 / HISTOGRAM_SUB_BUCKETS))) {
+        printf("p%.1lf is %llu, expected %.0lf\n", percentile, value, expected);
+        return 1;
+    }
+    return 0;
+}
+
+int main (int argc, char *argv[])
+{
+    pthread_t tids [THREADS];
+    long long int i;
+    cycles_t start;
+    timer_obj_t tmr;
+    double per_op;
+    int failed = 0;
+
+    printf("\n%.3lf cycles per nano second\n", timer_cycles_per_nsec());
+
+    /* single thread */
+    histogram_init(&values, "1 thread", 0);
+    for (i = 1; i <= VALUES; i++) histogram_record(&values, i);
+    histogram_report(&values);
+    failed += check_percentile(&values, 50);
+    failed += check_percentile(&values, 99);
+    failed += check_percentile(&values, 99.9);
+    if ((histogram_percentile(&values, 0) != 1) ||
+        (histogram_percentile(&values, 100) != VALUES)) {
+            printf("min/max percentiles are wrong\n");
+            failed++;
+    }
+
+    /* many threads all recording into their own shards */
+    histogram_reset(&values);
+    values.name = "8 threads";
+    for (i = 0; i < THREADS; i++) {
+        pthread_create(&tids[i], NULL, recording_thread, NULL);
+    }
+    start_threads = 1;
+    for (i = 0; i < THREADS; i++) pthread_join(tids[i], NULL);
+    histogram_report(&values);
+    if (histogram_count(&values) != (THREADS * VALUES)) {
+        printf("count is %llu, expected %d\n",
+            histogram_count(&values), THREADS * VALUES);
+        failed++;
+    }
+    failed += check_percentile(&values, 50);
+    failed += check_percentile(&values, 99);
+
+    /* merging */
+    histogram_init(&merged, "merged", 0);
+    histogram_record(&merged, VALUES);
+    histogram_merge(&merged, &values);
+    histogram_report(&merged);
+    if (histogram_count(&merged) != ((THREADS * VALUES) + 1)) {
+        printf("merged count is wrong\n");
+        failed++;
+    }
+
+    /* cycles are reported in nano seconds */
+    histogram_init(&sleeps, "1 msec sleeps", 1);
+    for (i = 0; i < 20; i++) {
+        start = cycles_now();
+        nano_seconds_sleep(1000000);
+        histogram_record(&sleeps, cycles_now() - start);
+    }
+    histogram_report(&sleeps);
+    if (0 == histogram_merge(&merged, &sleeps)) {
+        printf("merging cycles into values must fail\n");
+        failed++;
+    }
+    if ((histogram_percentile(&sleeps, 50) < 1000000) ||
+        (histogram_percentile(&sleeps, 50) > 100000000)) {
+            printf("sleep times are not in nano seconds\n");
+            failed++;
+    }
+
+    /* and what it costs to time & record an operation */
+    histogram_init(&costs, "record cost", 1);
+    timer_start(&tmr);
+    for (i = 0; i < ITERATIONS; i++) {
+        start = cycles_now();
+        histogram_record(&costs, cycles_now() - start);
+    }
+    timer_end(&tmr);
+    per_op = (double) timer_delay_nsecs(&tmr) / (double) ITERATIONS;
+    histogram_report(&costs);
+    printf("timing & recording one operation takes %.3lf nano seconds\n",
+        per_op);
+
+    histogram_destroy(&values);
+    histogram_destroy(&merged);
+    histogram_destroy(&sleeps);
+    histogram_destroy(&costs);
+
+    if (failed) {
+        printf("%d histogram checks FAILED\n", failed);
+        return -1;
+    }
+    printf("all histogram checks passed\n");
+    return 0;
+}
@@ -36,6 +36,7 @@ int main (int argc, char *argv[])
 {
     register int i;
     index_obj_t index;
+    index_obj_cursor_t cursor;
     void *ip1;
     void *exists;
     Data *datp;
@@ -80,7 +81,7 @@ printf("SEARCHING DATA\n");
         for (i = 0; i < MAX_SZ; i++) {
             searched.first = searched.second = i;
             ip1 = &searched;
-            if (index_obj_search(&index, ip1, &exists) == 0) {
+            if (index_obj_search(&index, ip1, &exists, NULL) == 0) {
                 datp = exists;
                 if ((searched.first != datp->first) ||
                     (searched.second != datp->second)) {
@@ -98,6 +99,34 @@ printf("SEARCHING DATA\n");
     timer_end(&timr);
     timer_report(&timr, count, NULL);
 
+    printf ("\n\n\n");
+printf("WALKING DATA BY CURSOR\n");
+    count = 0;
+    timer_start(&timr);
+    for (i = index_obj_cursor_first(&index, &cursor, &exists); i == 0;
+        i = index_obj_cursor_next(&cursor, &exists)) {
+            datp = exists;
+            if (datp != &data[count]) {
+                printf("cursor expected (%lld, %lld), found (%d, %d)\n",
+                    count, count, datp->first, datp->second);
+            }
+            count++;
+    }
+    timer_end(&timr);
+    if (count != MAX_SZ) printf("cursor walked %lld of %d\n", count, MAX_SZ);
+    timer_report(&timr, count, NULL);
+
+    /* and back, from where a missing entry would be */
+    searched.first = 100;
+    searched.second = 99;
+    if (index_obj_cursor_seek(&index, &cursor, &searched, &exists) ||
+        (exists != &data[100]) ||
+        index_obj_cursor_prev(&cursor, &exists) || (exists != &data[99]) ||
+        (index_obj_cursor_seek(&index, &cursor, &hidata, &exists)
+            != ENODATA)) {
+                printf("cursor seek failed\n");
+    }
+
     printf ("\n\n\n");
 printf ("BEST CASE INSERT/DELETE for %d entries\n", MAX_SZ);
     count = 0;
@@ -112,7 +141,7 @@ printf ("BEST CASE INSERT/DELETE for %d entries\n", MAX_SZ);
         if (NULL != exists) {
             fprintf(stderr, "hidata should NOT exist but it does\n");
         }
-        if (index_obj_remove(&index, ip1, &removed) != 0) {
+        if (index_obj_remove(&index, ip1, &removed, 0) != 0) {
             printf("could not remove hidata %d %d",
                 hidata.first, hidata.second);
         }
@@ -135,7 +164,7 @@ printf ("WORST CASE INSERT/DELETE for %d entries\n", MAX_SZ);
             printf("could not insert lodata %d %d",
                 lodata.first, lodata.second);
         }
-        if (index_obj_remove(&index, ip1, &removed) != 0) {
+        if (index_obj_remove(&index, ip1, &removed, 0) != 0) {
             printf("could not remove hidata %d %d",
                 lodata.first, lodata.second);
         }
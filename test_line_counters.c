@@ -0,0 +1,111 @@
+
+#include <stdio.h>
+#include <pthread.h>
+#include "timer_object.h"
+#include "line_counters.h"
+
+#define THREADS         8
+#define HOT_HITS        100000
+#define WARM_HITS       1000
+#define ITERATIONS      ((long long int) 100000000)
+
+volatile int start_threads = 0;
+
+void hot_line (void) { LINE_COUNTER_HIT(); }
+void warm_line (void) { LINE_COUNTER_HIT(); }
+void cold_line (void) { LINE_COUNTER_HIT(); }
+
+void *hitting_thread (void *arg)
+{
+    int i;
+
+    while (start_threads == 0);
+    for (i = 0; i < HOT_HITS; i++) hot_line();
+    for (i = 0; i < WARM_HITS; i++) warm_line();
+    cold_line();
+    return NULL;
+}
+
+/*
+ * the lines must be reported hottest first, with the exact hit counts
+ */
+int check_totals (unsigned long long int threads)
+{
+    line_counter_total_t totals [8];
+    int n = line_counters_collect(totals, 8);
+
+    if ((n != 3) ||
+        (totals[0].hits != threads * HOT_HITS) ||
+        (totals[1].hits != threads * WARM_HITS) ||
+        (totals[2].hits != threads) ||
+        strcmp(totals[0].site->function_name, "hot_line") ||
+        strcmp(totals[1].site->function_name, "warm_line") ||
+        strcmp(totals[2].site->function_name, "cold_line")) {
+            printf("collected %d lines, expected 3 with %llu hits max\n",
+                n, threads * HOT_HITS);
+            line_counters_dump(stdout, 8);
+            return 1;
+    }
+    return 0;
+}
+
+int main (int argc, char *argv[])
+{
+    pthread_t tids [THREADS];
+    line_counter_total_t top;
+    long long int i;
+    timer_obj_t tmr;
+    double loop_overhead, per_hit;
+    int failed = 0;
+
+    /* counts of threads which exited must not be lost */
+    for (i = 0; i < THREADS; i++) {
+        pthread_create(&tids[i], NULL, hitting_thread, NULL);
+    }
+    start_threads = 1;
+    for (i = 0; i < THREADS; i++) pthread_join(tids[i], NULL);
+    failed += check_totals(THREADS);
+    line_counters_dump(stdout, 3);
+
+    /* collecting again must give the same counts */
+    failed += check_totals(THREADS);
+
+    /* only the hits after a reset must be counted */
+    line_counters_reset();
+    if (line_counters_collect(&top, 1) != 0) {
+        printf("hits seen after a reset\n");
+        failed++;
+    }
+    start_threads = 0;
+    pthread_create(&tids[0], NULL, hitting_thread, NULL);
+    start_threads = 1;
+    pthread_join(tids[0], NULL);
+    failed += check_totals(1);
+
+    /* the periodic aggregator */
+    if (line_counters_aggregator_start(stdout, 2, 50) != 0) {
+        printf("aggregator could not be started\n");
+        failed++;
+    }
+    nano_seconds_sleep(120 * 1000000);
+    line_counters_aggregator_stop();
+
+    /* cost of a hit */
+    timer_start(&tmr);
+    for (i = 0; i < ITERATIONS; i++) __asm__ __volatile__ ("");
+    timer_end(&tmr);
+    timer_report(&tmr, ITERATIONS, &loop_overhead);
+    timer_start(&tmr);
+    for (i = 0; i < ITERATIONS; i++) LINE_COUNTER_HIT();
+    timer_end(&tmr);
+    timer_report(&tmr, ITERATIONS, &per_hit);
+    printf("a hit costs %.4lf nano seconds\n", per_hit - loop_overhead);
+    if ((line_counters_collect(&top, 1) != 1) ||
+        (top.hits != (unsigned long long int) ITERATIONS)) {
+            printf("hits of the timing loop are wrong\n");
+            failed++;
+    }
+
+    printf("\n%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
@@ -0,0 +1,169 @@
+
+#include <stdio.h>
+#include "timer_object.h"
+#include "avl_tree_object.h"
+#include "mem_allocators.h"
+
+#define KEYS            200000
+
+mem_monitor_t mm;
+mem_allocator_t allocator;
+chunk_manager_t chunks;
+buffer_manager_t buffers;
+mem_arena_t arena, huge_arena;
+
+size_count_tuple_t pools [] = {
+    { 64, 50000 }, { 256, 1000 }, { -1, -1 }
+};
+
+static int
+compare_keys (void *k1, void *k2)
+{
+    return
+        integer_from_pointer(k1) - integer_from_pointer(k2);
+}
+
+/*
+ * an avl tree given the mem monitor as its parent must
+ * work the same and account for everything it allocates
+ */
+int test_tree (char *name)
+{
+    avl_tree_t tree;
+    timer_obj_t tmr;
+    void *found;
+    long long int i;
+    int failed = 0;
+
+    timer_start(&tmr);
+    avl_tree_init(&tree, false, false, compare_keys, &mm);
+    for (i = 1; i <= KEYS; i++) {
+        if (avl_tree_insert(&tree, pointer_from_integer(i), &found, false)) {
+            failed++;
+        }
+    }
+    for (i = 1; i <= KEYS; i++) {
+        if (avl_tree_search(&tree, pointer_from_integer(i), &found) ||
+            (found != pointer_from_integer(i))) {
+                failed++;
+        }
+    }
+    if (mem_monitor_allocations(&mm) < KEYS) {
+        printf("%s: only %llu allocations for %d nodes\n",
+            name, mem_monitor_allocations(&mm), KEYS);
+        failed++;
+    }
+    for (i = 1; i <= KEYS; i++) {
+        if (avl_tree_remove(&tree, pointer_from_integer(i), &found)) {
+            failed++;
+        }
+    }
+    avl_tree_destroy(&tree, NULL, NULL);
+    timer_end(&tmr);
+    if (mem_monitor_bytes_used(&mm) != 0) {
+        printf("%s: %llu bytes still in use\n",
+            name, mem_monitor_bytes_used(&mm));
+        failed++;
+    }
+    printf("%-16s %8.2lf nsecs per key, %s\n", name,
+        (double) timer_delay_nsecs(&tmr) / KEYS,
+        failed ? "FAILED" : "passed");
+
+    return failed;
+}
+
+/*
+ * reallocation must keep the data, whether the
+ * block is moved between allocators or not
+ */
+int test_realloc (char *name)
+{
+    int *block = NULL;
+    int size, i, failed = 0;
+
+    for (size = 1; size <= 4096; size *= 2) {
+        block = mem_monitor_reallocate(&mm, block, size * sizeof(int), false);
+        if (NULL == block) {
+            printf("%s: reallocation to %d ints failed\n", name, size);
+            return 1;
+        }
+        for (i = 0; i < size / 2; i++) {
+            if (block[i] != i) failed++;
+        }
+        for (i = size / 2; i < size; i++) block[i] = i;
+    }
+    mem_monitor_free(block);
+    if (failed || mem_monitor_bytes_used(&mm)) {
+        printf("%s: reallocation lost data\n", name);
+        failed++;
+    }
+    return failed;
+}
+
+int test_allocator (char *name, mem_allocator_t *ap)
+{
+    int failed;
+
+    mem_monitor_init(&mm, MEM_MONITOR_UNSYNCHRONIZED);
+    if (mem_monitor_set_allocator(&mm, ap)) {
+        printf("%s: could not set allocator\n", name);
+        return 1;
+    }
+    failed = test_tree(name);
+    failed += test_realloc(name);
+
+    /* cannot be changed while something is allocated */
+    mem_monitor_free(mem_monitor_allocate(&mm, 8, false));
+    mem_monitor_allocate(&mm, 8, false);
+    if (mem_monitor_set_allocator(&mm, NULL) != EBUSY) {
+        printf("%s: allocator changed while in use\n", name);
+        failed++;
+    }
+    mem_monitor_destroy(&mm);
+
+    return failed;
+}
+
+int main (int argc, char *argv[])
+{
+    void *p1, *p2;
+    int failed = 0;
+
+    failed += test_allocator("malloc", NULL);
+
+    chunk_manager_init(&chunks, false, 64, 1024, NULL);
+    mem_allocator_chunk_manager_init(&allocator, &chunks);
+    failed += test_allocator("chunk manager", &allocator);
+    chunk_manager_destroy(&chunks);
+
+    /* pools are too small for all the keys, rest goes to malloc */
+    buffer_manager_initialize(&buffers, false, pools, NULL);
+    mem_allocator_buffer_manager_init(&allocator, &buffers);
+    failed += test_allocator("buffer manager", &allocator);
+    buffer_manager_destroy(&buffers);
+
+    mem_arena_init(&arena, false, 64 * 1024, false);
+    mem_allocator_arena_init(&allocator, &arena);
+    failed += test_allocator("arena", &allocator);
+
+    /* the last block grows in place */
+    p1 = mem_arena_allocate(&arena, 24);
+    p2 = allocator.reallocate(&arena, p1, 24, 1000);
+    if (p1 != p2) {
+        printf("arena did not grow the last block in place\n");
+        failed++;
+    }
+    printf("arena: %llu bytes carved from %llu bytes mapped\n",
+        arena.bytes_carved, arena.bytes_mapped);
+    mem_arena_destroy(&arena);
+
+    mem_arena_init(&huge_arena, false, 0, true);
+    mem_allocator_arena_init(&allocator, &huge_arena);
+    failed += test_allocator("huge page arena", &allocator);
+    printf("huge page arena: %d of the regions got explicit huge pages\n",
+        huge_arena.huge_page_regions);
+    mem_arena_destroy(&huge_arena);
+
+    printf("\n%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
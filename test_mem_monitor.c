@@ -0,0 +1,186 @@
+
+#include <stdio.h>
+#include <pthread.h>
+#include "mem_monitor_object.h"
+#include "ez_sprintf.h"
+
+/* more threads than shards, so the shared shard is used too */
+#define THREADS         (MEM_MONITOR_MAX_THREADS + 16)
+#define ALLOCATIONS     20000
+#define KEPT            100
+#define SIZE            24
+
+mem_monitor_t mm;
+volatile int start_threads = 0;
+
+/*
+ * allocates & frees a lot but keeps KEPT blocks,
+ * which are freed by the main thread later
+ */
+void *allocating_thread (void *arg)
+{
+    void **kept = (void**) arg;
+    void *p;
+    int i;
+
+    while (start_threads == 0);
+    for (i = 0; i < ALLOCATIONS; i++) {
+        p = mem_monitor_allocate(&mm, SIZE, (i & 1));
+        if (i < KEPT) {
+            kept[i] = mem_monitor_reallocate(&mm, p, 2 * SIZE, true);
+        } else {
+            mem_monitor_free(p);
+        }
+    }
+    return NULL;
+}
+
+int check (char *name, unsigned long long bytes_per_block,
+    unsigned long long allocations, unsigned long long frees,
+    unsigned long long blocks)
+{
+    if ((mem_monitor_allocations(&mm) != allocations) ||
+        (mem_monitor_frees(&mm) != frees) ||
+        (mem_monitor_bytes_used(&mm) != blocks * bytes_per_block)) {
+            printf("%s: %llu allocations, %llu frees, %llu bytes, "
+                "expected %llu, %llu, %llu\n", name,
+                mem_monitor_allocations(&mm), mem_monitor_frees(&mm),
+                mem_monitor_bytes_used(&mm), allocations, frees,
+                blocks * bytes_per_block);
+            return 1;
+    }
+    return 0;
+}
+
+int test_mode (char *name, int mode)
+{
+    static void *kept [THREADS][KEPT];
+    pthread_t tids [THREADS];
+    unsigned long long total = (unsigned long long) THREADS * ALLOCATIONS;
+    unsigned long long bytes_per_block;
+    int t, i, failed = 0;
+    void *p;
+
+    if (mem_monitor_init(&mm, mode)) {
+        printf("%s: mem_monitor_init failed\n", name);
+        return 1;
+    }
+
+    /* the size of the header is not known here, measure it */
+    p = mem_monitor_allocate(&mm, 2 * SIZE, false);
+    bytes_per_block = mem_monitor_bytes_used(&mm);
+    mem_monitor_free(p);
+
+    start_threads = 0;
+    for (t = 0; t < THREADS; t++) {
+        pthread_create(&tids[t], NULL, allocating_thread, kept[t]);
+    }
+    start_threads = 1;
+    for (t = 0; t < THREADS; t++) pthread_join(tids[t], NULL);
+    failed += check(name, bytes_per_block,
+        total + 1, total + 1 - (THREADS * KEPT), THREADS * KEPT);
+
+    for (t = 0; t < THREADS; t++) {
+        for (i = 0; i < KEPT; i++) mem_monitor_free(kept[t][i]);
+    }
+    failed += check(name, bytes_per_block, total + 1, total + 1, 0);
+
+    mem_monitor_destroy(&mm);
+    printf("%-8s %s\n", name, failed ? "FAILED" : "passed");
+
+    return failed;
+}
+
+/* two distinct allocation sites, by return address */
+__attribute__((noinline)) void *big_site (void)
+{ return mem_monitor_allocate(&mm, 1000, false); }
+
+__attribute__((noinline)) void *small_site (void)
+{ return mem_monitor_allocate(&mm, 10, false); }
+
+int test_profiling (void)
+{
+    mem_profile_site_t sites [4];
+    void *big [10], *small [100], *p;
+    char buffer [64];
+    ez_sprintf_t ezs;
+    int i, n, failed = 0;
+
+    mem_monitor_init(&mm, MEM_MONITOR_SHARDED);
+
+    /* not profiled */
+    p = mem_monitor_allocate(&mm, 50, false);
+
+    if (mem_monitor_profiling_start(&mm) ||
+        (mem_monitor_profiling_start(&mm) != EBUSY)) {
+            printf("profiling could not be started\n");
+            return 1;
+    }
+    for (i = 0; i < 10; i++) big[i] = big_site();
+    for (i = 0; i < 100; i++) small[i] = small_site();
+    for (i = 50; i < 100; i++) mem_monitor_free(small[i]);
+    mem_monitor_free(p);
+    p = mem_monitor_allocate_site(&mm, 3000, false, __FILE__, __LINE__);
+    p = mem_monitor_reallocate(&mm, p, 5000, false);
+
+    n = mem_monitor_profile_sites(&mm, sites, 4);
+    if ((n != 3) ||
+        (sites[0].live_bytes != 10000) || (sites[0].live_blocks != 10) ||
+        (sites[1].live_bytes != 5000) || (sites[1].live_blocks != 1) ||
+        strcmp(sites[1].file, __FILE__) ||
+        (sites[2].live_bytes != 500) || (sites[2].live_blocks != 50) ||
+        (sites[2].allocations != 100) || (sites[2].allocated_bytes != 1000)) {
+            printf("profiled sites are wrong\n");
+            mem_monitor_profile_dump(&mm, stdout, 4);
+            failed++;
+    }
+    mem_monitor_profile_dump(&mm, stdout, 4);
+
+    /* report must not overflow a small buffer */
+    ez_sprintf_init_with_external_buffer(&ezs, buffer, sizeof(buffer), 4);
+    if (mem_monitor_profile_report(&mm, &ezs, 4) != ENOSPC) {
+        printf("report did not fail on a small buffer\n");
+        failed++;
+    }
+
+    for (i = 0; i < 10; i++) mem_monitor_free(big[i]);
+    for (i = 0; i < 50; i++) mem_monitor_free(small[i]);
+    mem_monitor_free(p);
+    n = mem_monitor_profile_sites(&mm, sites, 4);
+    for (i = 0; i < n; i++) {
+        if (sites[i].live_bytes || sites[i].live_blocks) {
+            printf("site %d still has live blocks\n", i);
+            failed++;
+        }
+    }
+    mem_monitor_profiling_stop(&mm);
+    mem_monitor_destroy(&mm);
+    printf("%-8s %s\n", "profiled", failed ? "FAILED" : "passed");
+
+    return failed;
+}
+
+int main (int argc, char *argv[])
+{
+    int failed = 0;
+
+    /* all zeroes must be a valid, unsynchronized mem monitor */
+    memset(&mm, 0, sizeof(mm));
+    mem_monitor_free(mem_monitor_allocate(&mm, SIZE, true));
+    if ((mem_monitor_allocations(&mm) != 1) || (mem_monitor_frees(&mm) != 1) ||
+        (mem_monitor_bytes_used(&mm) != 0)) {
+            printf("zeroed mem monitor does not count\n");
+            failed++;
+    }
+    if (mem_monitor_init(&mm, 17) != EINVAL) {
+        printf("invalid mode accepted\n");
+        failed++;
+    }
+
+    failed += test_mode("atomic", MEM_MONITOR_ATOMIC);
+    failed += test_mode("sharded", MEM_MONITOR_SHARDED);
+    failed += test_profiling();
+
+    printf("\n%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
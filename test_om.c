@@ -1,6 +1,19 @@
 
 #include "object_manager.h"
 #include <sys/resource.h>
+#include <sys/wait.h>
+
+#define OBJECTS                 2000
+#define BATCH                   64
+
+/* objects published to reader processes, while they keep changing */
+#define SHARED_PARENTS          100
+#define SHARED_OBJECTS          10000
+#define SHARED_READERS          2
+#define SHARED_PUBLICATIONS     10
+#define SHARED_LABEL_SIZE       16
+#define SHARED_PUBLISHERS       2
+#define SHARED_PUBLISHER_ROUNDS 200
 
 void
 make_object (object_manager_t *omp,
@@ -42,12 +55,18 @@ add_attributes (object_manager_t *omp, int type, int instance)
     int i;
     char complex_value[50];
 
-    return;
     for (i = 0; i < 5; i++) {
-        om_attribute_simple_value_add(omp, type, instance, i, i, 2);
+        if (om_attribute_add(omp, type, instance, i,
+                sizeof(int), (byte*) &i)) {
+            ERROR(&om_debug, "adding attribute %d to (%d, %d) failed\n",
+                i, type, instance);
+        }
         sprintf(complex_value, "cav %d", i);
-        om_attribute_complex_value_add(omp, type, instance, i,
-            (byte*) complex_value, strlen(complex_value) + 1, 2);
+        if (om_attribute_add(omp, type, instance, 100 + i,
+                strlen(complex_value) + 1, (byte*) complex_value)) {
+            ERROR(&om_debug, "adding attribute %d to (%d, %d) failed\n",
+                100 + i, type, instance);
+        }
     }
 }
 
@@ -58,30 +77,421 @@ int traverse (void *utility, void *node,
 
     printf("(%d, %d) ", obj->object_type, obj->object_instance);
     fflush(stdout);
+    (*((int*) p0))++;
     return 0;
 }
 
+int
+check_traverse (object_manager_t *omp, int type, int instance, int expected)
+{
+    int count = 0;
+
+    printf("objects under %d, %d:\n", type, instance);
+    if (om_traverse(omp, type, instance, traverse,
+            &count, NULL, NULL, NULL, NULL)) {
+        printf("\ntraversal failed\n");
+        return 1;
+    }
+    printf("\n%d objects (expected %d)\n\n", count, expected);
+    return count != expected;
+}
+
+/*
+ * makes OBJECTS objects of 'type' under the root, attribute 0 of each
+ * being its instance
+ */
+int
+make_objects (object_manager_t *omp, int type)
+{
+    int instance;
+
+    for (instance = 1; instance <= OBJECTS; instance++) {
+        if (om_object_create(omp, 0, 0, type, instance) ||
+            om_attribute_add(omp, type, instance, 0,
+                sizeof(instance), (byte*) &instance)) return 1;
+    }
+    return 0;
+}
+
+/* a failing transaction must leave everything as it was */
+int
+check_transaction (object_manager_t *omp, int type)
+{
+    om_transaction_t transaction;
+    int value = -1, length, errors = 0;
+
+    om_transaction_init(&transaction, omp);
+    om_transaction_object_create(&transaction, type, 1, type, OBJECTS + 1);
+    om_transaction_attribute_add(&transaction, type, 1, 0,
+        sizeof(value), (byte*) &value);
+    om_transaction_attribute_remove(&transaction, type, 1, 99);
+    if ((om_transaction_commit(&transaction) != ENODATA) ||
+        (transaction.failed_op != 2) ||
+        om_object_exists(omp, type, OBJECTS + 1) ||
+        om_attribute_get(omp, type, 1, 0, &length, sizeof(value),
+            (byte*) &value) || (value != 1)) {
+                printf("failed transaction was not undone\n");
+                errors++;
+    }
+    om_transaction_destroy(&transaction);
+    return errors;
+}
+
+/* enumerates every object of 'type' in batches, forwards & back again */
+int
+check_cursor (object_manager_t *omp, int type)
+{
+    object_identifier_t batch [BATCH];
+    om_cursor_t cursor;
+    int i, length, instance = 0, errors = 0;
+
+    om_cursor_init_type(&cursor, type);
+    while (0 == om_cursor_next_batch(omp, &cursor, batch, BATCH, &length)) {
+        for (i = 0; i < length; i++) {
+            if ((batch[i].object_type != type) ||
+                (batch[i].object_instance != ++instance)) errors++;
+        }
+    }
+    if (instance != OBJECTS) errors++;
+
+    /* from the end where the forward batches stopped */
+    while (0 == om_cursor_prev_batch(omp, &cursor, batch, BATCH, &length)) {
+        for (i = 0; i < length; i++) {
+            if ((batch[i].object_type != type) ||
+                (batch[i].object_instance != instance--)) errors++;
+        }
+    }
+    if (instance != 0) errors++;
+    if (errors) printf("cursor of type %d went wrong %d times\n",
+        type, errors);
+    return errors;
+}
+
+/*
+ * attribute 0 of every object of 'type' is its instance, so a value
+ * finds exactly that object, by looking at all of them or by index
+ */
+int
+check_find (object_manager_t *omp, int type)
+{
+    object_identifier_t found [BATCH];
+    int i, value, n_found, errors = 0;
+
+    for (i = 0; i < 2; i++) {
+        if (i && om_attribute_index_create(omp, type, 0)) {
+            printf("could not create the index of type %d\n", type);
+            return errors + 1;
+        }
+        for (value = 1; value <= OBJECTS; value += 7) {
+            if (om_attribute_find(omp, type, 0, value, value,
+                    found, BATCH, &n_found) || (n_found != 1) ||
+                (found[0].object_type != type) ||
+                (found[0].object_instance != value)) errors++;
+        }
+        if (om_attribute_find(omp, type, 0, 100, 100 + BATCH - 1,
+                found, BATCH, &n_found) || (n_found != BATCH)) errors++;
+        for (value = 0; value < n_found; value++) {
+            if (found[value].object_instance != 100 + value) errors++;
+        }
+        if (om_attribute_find(omp, type, 0, OBJECTS + 1, OBJECTS + 10,
+                found, BATCH, &n_found) || n_found) errors++;
+        printf("finding by value %s: %s\n",
+            i ? "with an index" : "without an index",
+            errors ? "FAILED" : "ok");
+    }
+    return errors;
+}
+
+int
+parallel_count_tfn (void *omp, void *object, void *thread_data,
+        void *p0, void *p1, void *p2, void *p3)
+{
+    long long int **counter = (long long int**) thread_data;
+
+    if (NULL == *counter) {
+        *counter = calloc(1, sizeof(long long int));
+        if (NULL == *counter) return ENOMEM;
+    }
+    (**counter)++;
+    return 0;
+}
+
+void
+parallel_count_reduce (void *thread_data, void *total)
+{
+    if (thread_data) {
+        *((long long int*) total) += *((long long int*) thread_data);
+        free(thread_data);
+    }
+}
+
+/* every object but the root, whatever the number of threads */
+int
+check_parallel_traverse (object_manager_t *omp)
+{
+    long long int count;
+    int n_threads, errors = 0;
+
+    for (n_threads = 1; n_threads <= 4; n_threads *= 2) {
+        count = 0;
+        if (om_traverse_parallel(omp, 0, 0, n_threads,
+                parallel_count_tfn, parallel_count_reduce,
+                &count, NULL, NULL, NULL) ||
+            (count != om_object_count(omp) - 1)) {
+                printf("%d threads traversed %lld of %d objects\n",
+                    n_threads, count, om_object_count(omp) - 1);
+                errors++;
+        }
+    }
+    printf("parallel traversals: %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+/* a snapshot read back must have every object & attribute */
+int
+check_snapshot (object_manager_t *omp, int type)
+{
+    object_manager_t loaded;
+    om_snapshot_t snapshot;
+    char name [TYPICAL_NAME_SIZE];
+    int instance, value, length, errors = 0;
+
+    if (om_snapshot_start(omp, &snapshot) || om_snapshot_wait(&snapshot) ||
+        om_read(omp->manager_id, &loaded)) {
+            printf("could not write & read back a snapshot\n");
+            return 1;
+    }
+    if (om_object_count(&loaded) != om_object_count(omp)) errors++;
+    for (instance = 1; instance <= OBJECTS; instance++) {
+        if (om_attribute_get(&loaded, type, instance, 0, &length,
+                sizeof(value), (byte*) &value) || (value != instance))
+            errors++;
+    }
+    if (om_attribute_get(&loaded, 40, 1, 103, &length, sizeof(name),
+            (byte*) name) || strcmp(name, "cav 3")) errors++;
+    om_destroy(&loaded);
+    sprintf(name, "om_%d", omp->manager_id);
+    unlink(name);
+    strcat(name, "_BACKUP");
+    unlink(name);
+    printf("snapshot read back: %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+/* (1, 0) has 17 objects under it, all of which must go with it */
+int
+check_subtree_remove (object_manager_t *omp)
+{
+    int before = om_object_count(omp), errors = 0;
+    long long int count = 0;
+
+    if (om_object_remove(omp, 1, 0) ||
+        (om_object_count(omp) != before - 18) ||
+        om_object_exists(omp, 1, 0) ||
+        om_object_exists(omp, 50, 2) ||
+        om_object_exists(omp, 500, 9) ||
+        !om_object_exists(omp, 2, 0) ||
+        !om_object_exists(omp, 100, 1)) errors++;
+
+    /* & the rest must still be reachable from the root */
+    if (om_traverse_parallel(omp, 0, 0, 2,
+            parallel_count_tfn, parallel_count_reduce,
+            &count, NULL, NULL, NULL) ||
+        (count != om_object_count(omp) - 1)) errors++;
+    printf("sub tree removal: %s\n", errors ? "FAILED" : "ok");
+    return errors;
+}
+
+/*
+ * The value of every shared object is its instance plus SHARED_OBJECTS
+ * times the publication it is from.  A reader must never see a value
+ * of any other form (a torn read) nor see the publications go back.
+ * Returns the number of errors it saw.
+ */
+int
+shared_reader (char *name)
+{
+    object_identifier_t children [SHARED_OBJECTS / SHARED_PARENTS];
+    char label [SHARED_LABEL_SIZE], expected [SHARED_LABEL_SIZE];
+    om_shared_t shared;
+    int i, j, n, pt, pi, value, length, latest = 0, errors = 0;
+
+    if (om_shared_attach(&shared, name)) return 1;
+    while (latest < SHARED_PUBLICATIONS - 1) {
+        for (i = 1; i <= SHARED_OBJECTS; i++) {
+            if (om_shared_attribute_get(&shared, 2, i, 0, &length,
+                    sizeof(value), (byte*) &value) ||
+                ((value - i) % SHARED_OBJECTS) ||
+                (((value - i) / SHARED_OBJECTS) < latest)) {
+                    errors++;
+            } else {
+                latest = (value - i) / SHARED_OBJECTS;
+            }
+            if (om_shared_parent_get(&shared, 2, i, &pt, &pi) ||
+                (pt != 1) || (pi != (i % SHARED_PARENTS) + 1)) errors++;
+            if (i > SHARED_PARENTS) continue;
+
+            /* the parents, with labels too big to be inlined */
+            sprintf(expected, "parent %d", i);
+            if (om_shared_attribute_get(&shared, 1, i, 1, &length,
+                    sizeof(label), (byte*) label) ||
+                strcmp(label, expected)) errors++;
+            if (om_shared_children_get(&shared, 1, i, children,
+                    SHARED_OBJECTS / SHARED_PARENTS, &n) ||
+                (n != SHARED_OBJECTS / SHARED_PARENTS)) errors++;
+            for (j = 0; j < n; j++) {
+                if ((children[j].object_type != 2) ||
+                    ((children[j].object_instance % SHARED_PARENTS) + 1
+                        != i) ||
+                    (j && (children[j].object_instance <=
+                        children[j - 1].object_instance))) errors++;
+            }
+        }
+    }
+    om_shared_detach(&shared);
+    return errors;
+}
+
+typedef struct shared_publisher_s {
+    om_shared_t *shp;
+    object_manager_t *omp;
+    int failed;
+} shared_publisher_t;
+
+void *
+shared_publisher (void *arg)
+{
+    shared_publisher_t *spp = (shared_publisher_t*) arg;
+    int g;
+
+    for (g = 0; g < SHARED_PUBLISHER_ROUNDS; g++) {
+        if (om_shared_publish(spp->shp, spp->omp)) spp->failed++;
+    }
+    return NULL;
+}
+
+/*
+ * Threads publishing into the same segment at the same time must not
+ * lose publications nor leave the current image half written.
+ */
+int
+check_shared_publishers (om_shared_t *shp, object_manager_t *omp)
+{
+    pthread_t tids [SHARED_PUBLISHERS];
+    shared_publisher_t publishers [SHARED_PUBLISHERS];
+    unsigned long long int before = shp->header->publications;
+    int p, i, value, length, failed = 0;
+
+    for (p = 0; p < SHARED_PUBLISHERS; p++) {
+        publishers[p].shp = shp;
+        publishers[p].omp = omp;
+        publishers[p].failed = 0;
+        pthread_create(&tids[p], NULL, shared_publisher, &publishers[p]);
+    }
+    for (p = 0; p < SHARED_PUBLISHERS; p++) {
+        pthread_join(tids[p], NULL);
+        failed += publishers[p].failed;
+    }
+    if (shp->header->publications - before !=
+        (SHARED_PUBLISHERS * SHARED_PUBLISHER_ROUNDS)) failed++;
+    for (i = 1; i <= SHARED_OBJECTS; i++) {
+        if (om_shared_attribute_get(shp, 2, i, 0, &length,
+                sizeof(value), (byte*) &value) ||
+            (value != i + ((SHARED_PUBLICATIONS - 1) * SHARED_OBJECTS)))
+                failed++;
+    }
+    printf("%d threads publishing together: %s\n", SHARED_PUBLISHERS,
+        failed ? "FAILED" : "ok");
+    return failed;
+}
+
+/*
+ * Publishes an object manager of its own into shared memory, for a few
+ * reader processes to read while it keeps changing it & publishing it
+ * again, to see that they never see anything half published.
+ */
+int
+check_shared (void)
+{
+    object_manager_t om;
+    char name [TYPICAL_NAME_SIZE], label [SHARED_LABEL_SIZE];
+    pid_t readers [SHARED_READERS];
+    om_shared_t shared;
+    int r, g, i, value, status, failed = 0;
+
+    om_init(&om, true, 2, NULL);
+    for (i = 1; i <= SHARED_PARENTS; i++) {
+        om_object_create(&om, 0, 0, 1, i);
+        memset(label, 0, sizeof(label));
+        sprintf(label, "parent %d", i);
+        om_attribute_add(&om, 1, i, 1, sizeof(label), (byte*) label);
+    }
+    for (i = 1; i <= SHARED_OBJECTS; i++) {
+        om_object_create(&om, 1, (i % SHARED_PARENTS) + 1, 2, i);
+        om_attribute_add(&om, 2, i, 0, sizeof(i), (byte*) &i);
+    }
+
+    sprintf(name, "/test_om_%d", getpid());
+    if (om_shared_create(&shared, name, SHARED_OBJECTS * 256LL) ||
+        om_shared_publish(&shared, &om)) {
+            printf("could not share the object manager\n");
+            om_destroy(&om);
+            return 1;
+    }
+    fflush(stdout);
+    for (r = 0; r < SHARED_READERS; r++) {
+        readers[r] = fork();
+        if (0 == readers[r]) _exit(shared_reader(name) ? 1 : 0);
+    }
+    for (g = 1; g < SHARED_PUBLICATIONS; g++) {
+        for (i = 1; i <= SHARED_OBJECTS; i++) {
+            value = i + (g * SHARED_OBJECTS);
+            om_attribute_add(&om, 2, i, 0, sizeof(value), (byte*) &value);
+        }
+        if (om_shared_publish(&shared, &om)) failed++;
+    }
+    for (r = 0; r < SHARED_READERS; r++) {
+        if ((readers[r] < 0) || (waitpid(readers[r], &status, 0) < 0) ||
+            !WIFEXITED(status) || WEXITSTATUS(status)) failed++;
+    }
+    printf("%d readers of %d publications: %s\n", SHARED_READERS,
+        SHARED_PUBLICATIONS, failed ? "FAILED" : "ok");
+    failed += check_shared_publishers(&shared, &om);
+    om_shared_detach(&shared);
+    om_destroy(&om);
+    return failed;
+}
+
 int
 main (int argc, char *argv [])
 {
     object_manager_t om;
+    int errors = 0;
 
     printf("size of one object is %ld bytes\n", sizeof(object_t));
     om_init(&om, true, 1, NULL);
     make_tree(&om);
+    add_attributes(&om, 1, 0);
+    add_attributes(&om, 40, 1);
 
-    printf("objects under 0, 0:\n");
-    om_traverse(&om, 0, 0, traverse, NULL, NULL, NULL, NULL, NULL);
-    printf("\n\n");
-
-    printf("objects under 1, 0:\n");
-    om_traverse(&om, 1, 0, traverse, NULL, NULL, NULL, NULL, NULL);
-    printf("\n\n");
+    errors += check_traverse(&om, 0, 0, 24);
+    errors += check_traverse(&om, 1, 0, 17);
+    errors += check_traverse(&om, 40, 1, 10);
+    errors += check_traverse(&om, 500, 3, 0);
 
-    printf("objects under 40, 1:\n");
-    om_traverse(&om, 40, 1, traverse, NULL, NULL, NULL, NULL, NULL);
-    printf("\n\n");
+    if (make_objects(&om, 1000)) {
+        printf("could not make the objects\n");
+        errors++;
+    }
+    errors += check_transaction(&om, 1000);
+    errors += check_cursor(&om, 1000);
+    errors += check_find(&om, 1000);
+    errors += check_parallel_traverse(&om);
+    errors += check_snapshot(&om, 1000);
+    errors += check_subtree_remove(&om);
+    errors += check_shared();
 
-    return 0;
+    om_destroy(&om);
+    printf("%s\n", errors ? "FAILED" : "PASSED");
+    return errors ? 1 : 0;
 }
-
@@ -0,0 +1,153 @@
+
+#include "object_manager.h"
+
+#define MANAGER_ID          77
+#define FANOUT              5
+#define LEVELS              4
+
+/*
+ * deeper objects get smaller types, so they are written out, & read
+ * back, before their parents are
+ */
+#define TYPE(level)         (100 - (level))
+
+/*
+ * Builds a tree of FANOUT children per object, LEVELS deep, under
+ * the root.  Every object gets an integer attribute & a string one,
+ * long enough to not be inlined.
+ */
+static int
+make_tree (object_manager_t *omp)
+{
+    int level, i, n_parents, instance, parent_type;
+    char value [64];
+    int created = 0;
+
+    n_parents = 1;
+    parent_type = 0;
+    for (level = 1; level <= LEVELS; level++) {
+        for (instance = 0; instance < n_parents * FANOUT; instance++) {
+            if (om_object_create(omp,
+                    parent_type, (level == 1) ? 0 : instance / FANOUT,
+                    TYPE(level), instance)) {
+                return -1;
+            }
+            created++;
+            if (om_attribute_add(omp, TYPE(level), instance, 1,
+                    sizeof(int), (byte*) &instance)) {
+                return -1;
+            }
+            i = sprintf(value, "object (%d, %d) string value",
+                    TYPE(level), instance);
+            if (om_attribute_add(omp, TYPE(level), instance, 2,
+                    i + 1, (byte*) value)) {
+                return -1;
+            }
+        }
+        n_parents *= FANOUT;
+        parent_type = TYPE(level);
+    }
+    return created;
+}
+
+static int
+count_tfn (void *utility, void *node,
+        void *p0, void *p1, void *p2, void *p3, void *p4)
+{
+    (*((int*) p0))++;
+    return 0;
+}
+
+static int
+count_under (object_manager_t *omp, int type, int instance)
+{
+    int count = 0;
+
+    if (om_traverse(omp, type, instance, count_tfn,
+            &count, NULL, NULL, NULL, NULL)) return -1;
+    return count;
+}
+
+/* compares every object, its parent & its attributes */
+static int
+compare (object_manager_t *om1, object_manager_t *om2)
+{
+    int level, instance, n, errors = 0;
+    int pt1, pi1, pt2, pi2, len1, len2;
+    byte v1 [64], v2 [64];
+    int id;
+
+    n = 1;
+    for (level = 1; level <= LEVELS; level++) {
+        n *= FANOUT;
+        for (instance = 0; instance < n; instance++) {
+            if (om_parent_get(om2, TYPE(level), instance, &pt2, &pi2)) {
+                printf("(%d, %d) not read back\n", TYPE(level), instance);
+                errors++;
+                continue;
+            }
+            om_parent_get(om1, TYPE(level), instance, &pt1, &pi1);
+            if ((pt1 != pt2) || (pi1 != pi2)) {
+                printf("(%d, %d) parent (%d, %d) read back as (%d, %d)\n",
+                    TYPE(level), instance, pt1, pi1, pt2, pi2);
+                errors++;
+            }
+            for (id = 1; id <= 2; id++) {
+                om_attribute_get(om1, TYPE(level), instance, id,
+                    &len1, 64, v1);
+                if (om_attribute_get(om2, TYPE(level), instance, id,
+                        &len2, 64, v2) ||
+                    (len1 != len2) || memcmp(v1, v2, len1)) {
+                        printf("(%d, %d) attribute %d differs\n",
+                            TYPE(level), instance, id);
+                        errors++;
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+int
+main (int argc, char *argv [])
+{
+    object_manager_t om, loaded;
+    char name [TYPICAL_NAME_SIZE];
+    int created, errors = 0;
+
+    om_init(&om, true, MANAGER_ID, NULL);
+    created = make_tree(&om);
+    if (created < 0) {
+        printf("could not build the object manager\n");
+        return 1;
+    }
+    if (om_write(&om)) {
+        printf("om_write failed\n");
+        return 1;
+    }
+    if (om_read(MANAGER_ID, &loaded)) {
+        printf("om_read failed\n");
+        return 1;
+    }
+
+    /* root is there in both as well */
+    printf("written %d objects, read back %d\n",
+        om_object_count(&om), om_object_count(&loaded));
+    if (om_object_count(&om) != om_object_count(&loaded)) errors++;
+
+    /* children must have been linked up, whatever order they were read in */
+    printf("traversed %d objects, read back %d\n",
+        count_under(&om, 0, 0), count_under(&loaded, 0, 0));
+    if (count_under(&loaded, 0, 0) != created) errors++;
+    errors += compare(&om, &loaded);
+
+    om_destroy(&om);
+    om_destroy(&loaded);
+    sprintf(name, "om_%d", MANAGER_ID);
+    unlink(name);
+    strcat(name, "_BACKUP");
+    unlink(name);
+
+    printf("%s\n", errors ? "FAILED" : "PASSED");
+    return errors ? 1 : 0;
+}
@@ -17,6 +17,8 @@ int main (int argc, char *argv[])
     double megabytes;
     int *present_data;
     int key_size = sizeof(int);
+    radix_tree_cursor_t cursor;
+    int key, key_length;
 
     for (i = 0; i < MAX_DATA; i++) array[i] = i;
 
@@ -66,6 +68,23 @@ int main (int argc, char *argv[])
     printf("successfully found %d valid entries out of a total of %d entries\n",
         valid, total);
 
+    /* every key once, & the cursor must rebuild each key from the tree */
+    printf("\nWALKING RADIX TREE BY CURSOR\n");
+    total = valid = 0;
+    timer_start(&timr);
+    for (failed = radix_tree_cursor_first(&radix_tree_obj, &cursor,
+            (void**) &present_data); failed == 0;
+        failed = radix_tree_cursor_next(&cursor, (void**) &present_data)) {
+            total++;
+            if ((radix_tree_cursor_key(&cursor, (byte*) &key, sizeof(key),
+                    &key_length) == 0) &&
+                (key_length == key_size) && (key == *present_data)) valid++;
+    }
+    timer_end(&timr);
+    timer_report(&timr, total, NULL);
+    printf("walked %d valid entries out of a total of %d entries\n",
+        valid, total);
+
     return 0;
 }
 
@@ -0,0 +1,276 @@
+
+#include <stdio.h>
+#include <pthread.h>
+#include "timer_object.h"
+#include "slab_allocator.h"
+
+#define THREADS         8
+#define BLOCKS          4096
+#define ROUNDS          200
+#define BURST           64
+#define TIMED_OPS       (4 * 1024 * 1024)
+
+mem_monitor_t mm;
+slab_allocator_t slabs;
+volatile int start_threads = 0;
+
+/* sizes weighted towards small blocks, like most real users */
+static inline int
+random_size (unsigned int *seed)
+{
+    int r = rand_r(seed);
+
+    if (r & 1) return 1 + (r >> 1) % 128;
+    if (r & 2) return 1 + (r >> 2) % 2048;
+    return 1 + (r >> 2) % (2 * SLAB_MAX_BLOCK_SIZE);
+}
+
+static void
+fill (unsigned char *block, int size, int pattern)
+{
+    memset(block, pattern, size);
+}
+
+static int
+intact (unsigned char *block, int size, int pattern)
+{
+    int i;
+
+    for (i = 0; i < size; i++) {
+        if (block[i] != (unsigned char) pattern) return 0;
+    }
+    return 1;
+}
+
+/*
+ * every size must fit its class, which must
+ * never waste more than a quarter of a block
+ */
+int test_sizes (void)
+{
+    void *block;
+    int size, usable, failed = 0;
+
+    slab_allocator_init(&slabs, false, &mm);
+    for (size = 0; size <= SLAB_MAX_BLOCK_SIZE + 100; size++) {
+        block = slab_allocate(&slabs, size);
+        usable = block ? slab_block_size(block) : 0;
+        if ((NULL == block) || (usable < size) ||
+            ((size > 64) && (usable > size + (size / 4) + 16)) ||
+            (((unsigned long long int) block) & 15)) {
+                printf("size %d got block %p of %d bytes\n",
+                    size, block, usable);
+                failed++;
+        }
+        slab_free(block);
+    }
+    if (NULL != slab_allocate(&slabs, -1)) {
+        printf("negative size allocated\n");
+        failed++;
+    }
+    if (slab_allocator_trim(&slabs) < 1 || slabs.n_slabs ||
+        mem_monitor_bytes_used(&mm)) {
+            printf("%d slabs, %llu bytes left after a trim\n",
+                slabs.n_slabs, mem_monitor_bytes_used(&mm));
+            failed++;
+    }
+    slab_allocator_destroy(&slabs);
+
+    return failed;
+}
+
+/*
+ * reallocating must keep the data & the block must
+ * stay where it is as long as it fits its class
+ */
+int test_realloc (void)
+{
+    unsigned char *block, *bigger;
+    int size, failed = 0;
+
+    slab_allocator_init(&slabs, false, &mm);
+    block = slab_reallocate(&slabs, NULL, 100);
+    fill(block, 100, 100);
+    if (slab_reallocate(&slabs, block, 110) != block) {
+        printf("block moved although it fits its class\n");
+        failed++;
+    }
+    for (size = 100; size < 4 * SLAB_MAX_BLOCK_SIZE; size *= 3) {
+        bigger = slab_reallocate(&slabs, block, size * 3);
+        if ((NULL == bigger) || !intact(bigger, size, 100)) {
+            printf("reallocation to %d bytes lost data\n", size * 3);
+            failed++;
+            break;
+        }
+        block = bigger;
+        fill(block, size * 3, 100);
+    }
+    slab_free(block);
+    slab_allocator_destroy(&slabs);
+    if (mem_monitor_bytes_used(&mm)) {
+        printf("%llu bytes left after destroy\n", mem_monitor_bytes_used(&mm));
+        failed++;
+    }
+
+    return failed;
+}
+
+/*
+ * All threads allocate & free random sizes.  Half the blocks
+ * are handed over to be freed by the next thread, so blocks
+ * go back into the caches of threads which did not allocate them.
+ */
+typedef struct handover_s {
+    unsigned char * volatile blocks [BLOCKS];
+    volatile int sizes [BLOCKS];
+    volatile int ready;
+} handover_t;
+
+handover_t handovers [THREADS];
+volatile int thread_failures = 0;
+
+void *allocating_thread (void *arg)
+{
+    int t = (int) ((long) arg);
+    handover_t *mine = &handovers[t];
+    handover_t *next = &handovers[(t + 1) % THREADS];
+    unsigned char *blocks [BLOCKS];
+    int sizes [BLOCKS];
+    unsigned int seed = t + 1;
+    int i, r;
+
+    while (start_threads == 0);
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < BLOCKS; i++) {
+            sizes[i] = random_size(&seed) / 4;
+            blocks[i] = slab_allocate(&slabs, sizes[i]);
+            fill(blocks[i], sizes[i], t);
+        }
+        for (i = 0; i < BLOCKS; i += 2) {
+            if (!intact(blocks[i], sizes[i], t))
+                __sync_fetch_and_add(&thread_failures, 1);
+            slab_free(blocks[i]);
+        }
+        if (r == ROUNDS - 1) {
+            for (i = 1; i < BLOCKS; i += 2) {
+                mine->blocks[i] = blocks[i];
+                mine->sizes[i] = sizes[i];
+            }
+            __sync_synchronize();
+            mine->ready = 1;
+        } else {
+            for (i = 1; i < BLOCKS; i += 2) slab_free(blocks[i]);
+        }
+    }
+
+    /* free what the next thread handed over */
+    while (next->ready == 0);
+    for (i = 1; i < BLOCKS; i += 2) {
+        if (!intact(next->blocks[i], next->sizes[i], (t + 1) % THREADS))
+            __sync_fetch_and_add(&thread_failures, 1);
+        slab_free(next->blocks[i]);
+    }
+
+    return NULL;
+}
+
+int test_threads (void)
+{
+    pthread_t tids [THREADS];
+    long t;
+    int failed = 0;
+
+    slab_allocator_init(&slabs, true, &mm);
+    for (t = 0; t < THREADS; t++) {
+        pthread_create(&tids[t], NULL, allocating_thread, (void*) t);
+    }
+    start_threads = 1;
+    for (t = 0; t < THREADS; t++) pthread_join(tids[t], NULL);
+    if (thread_failures) {
+        printf("%d blocks were corrupted\n", thread_failures);
+        failed++;
+    }
+    printf("%d threads: %d slabs, %llu bytes mapped\n",
+        THREADS, slabs.n_slabs, slabs.bytes_mapped);
+    slab_allocator_destroy(&slabs);
+    if (mem_monitor_bytes_used(&mm)) {
+        printf("%llu bytes left after destroy\n", mem_monitor_bytes_used(&mm));
+        failed++;
+    }
+
+    return failed;
+}
+
+/*
+ * bursts of mixed sizes allocated & freed,
+ * compared to the same with glibc malloc
+ */
+double timed_bursts (boolean use_malloc)
+{
+    void *blocks [BURST];
+    int sizes [BURST];
+    unsigned int seed = 1;
+    timer_obj_t tmr;
+    int i, b;
+
+    for (b = 0; b < BURST; b++) sizes[b] = random_size(&seed) / 8;
+    timer_start(&tmr);
+    for (i = 0; i < TIMED_OPS; i += BURST) {
+        for (b = 0; b < BURST; b++) {
+            blocks[b] = use_malloc ?
+                malloc(sizes[b]) : slab_allocate(&slabs, sizes[b]);
+            *((char*) blocks[b]) = 0;
+        }
+        while (b-- > 0) {
+            if (use_malloc) free(blocks[b]); else slab_free(blocks[b]);
+        }
+    }
+    timer_end(&tmr);
+
+    return (double) timer_delay_nsecs(&tmr) / TIMED_OPS;
+}
+
+void *timed_thread (void *arg)
+{
+    *((double*) arg) = timed_bursts((boolean) (*((double*) arg) != 0));
+    return NULL;
+}
+
+void compare_to_malloc (void)
+{
+    pthread_t tids [THREADS];
+    double results [THREADS], totals [2];
+    int t, m;
+
+    slab_allocator_init(&slabs, true, NULL);
+    for (m = 0; m <= 1; m++) {
+        for (t = 0; t < THREADS; t++) {
+            results[t] = m;
+            pthread_create(&tids[t], NULL, timed_thread, &results[t]);
+        }
+        for (t = 0; t < THREADS; t++) pthread_join(tids[t], NULL);
+        for (t = 1; t < THREADS; t++) results[0] += results[t];
+        totals[m] = results[0];
+    }
+    printf("%d threads, %.2lf nsecs per slab allocation/free, "
+        "%.2lf for malloc\n", THREADS,
+        totals[0] / THREADS, totals[1] / THREADS);
+    printf("1 thread,  %.2lf nsecs per slab allocation/free, "
+        "%.2lf for malloc\n", timed_bursts(false), timed_bursts(true));
+    slab_allocator_destroy(&slabs);
+}
+
+int main (int argc, char *argv[])
+{
+    int failed = 0;
+
+    mem_monitor_init(&mm, MEM_MONITOR_ATOMIC);
+    failed += test_sizes();
+    failed += test_realloc();
+    failed += test_threads();
+    compare_to_malloc();
+    mem_monitor_destroy(&mm);
+
+    printf("\n%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
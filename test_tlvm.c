@@ -37,6 +37,57 @@ int tlvs_verify (tlvm_t *tlvmp)
     return 0;
 }
 
+/*
+ * builds tlvs straight into a message buffer, prepends a header into
+ * its headroom and hands a tlv value over, all without copying
+ */
+int msgbuf_test (void)
+{
+    size_count_tuple_t tuples [] = { { 4096, 4 }, { -1, -1 } };
+    buffer_manager_t bm;
+    msgbuf_t mb, value;
+    tlvm_t tlvm;
+    byte *header;
+    int i, j;
+
+    buffer_manager_initialize(&bm, false, tuples, NULL);
+    msgbuf_allocate(&bm, &mb, 16, 1024);
+    if (tlvm_attach_msgbuf(&tlvm, &mb)) return -1;
+    for (i = 0; i < 10; i++) {
+        for (j = 0; j < DATASIZE; j++) data[j] = i;
+        if (tlvm_append(&tlvm, (unsigned int) i, DATASIZE, &data[0]))
+            return -1;
+    }
+    if (tlvm_msgbuf_commit(&tlvm, &mb) ||
+        (mb.length != (10 * (8 + DATASIZE)) + 4)) {
+            printf("committed %d bytes into the message buffer\n", mb.length);
+            return -1;
+    }
+    header = msgbuf_prepend(&mb, 8);
+    if (NULL == header) return -1;
+    memset(header, 0xEE, 8);
+
+    /* the receiver strips the header & parses in place */
+    msgbuf_trim_front(&mb, 8);
+    tlvm_attach(&tlvm, mb.data, mb.length, false);
+    if (tlvm_parse(&tlvm) || (tlvm.n_tlvs != 10) || tlvs_verify(&tlvm))
+        return -1;
+    if (tlvm_msgbuf_value(&mb, &tlvm.tlvs[3], &value) ||
+        (value.length != DATASIZE) || (value.data != tlvm.tlvs[3].value)) {
+            printf("tlv value slice is wrong\n");
+            return -1;
+    }
+    tlvm_detach(&tlvm);
+
+    /* the slice keeps the storage alive after the message is released */
+    msgbuf_release(&mb);
+    if ((value.storage->refcount != 1) || (value.data[0] != 3)) return -1;
+    msgbuf_release(&value);
+    buffer_manager_destroy(&bm);
+
+    return 0;
+}
+
 int main (int argc, char *argv[])
 {
     tlvm_t tlvm;
@@ -93,6 +144,14 @@ int main (int argc, char *argv[])
         fflush(stdout);
 
     }
+    tlvm_detach(&tlvm);
+
+    printf("building into a message buffer .. ");
+    if (msgbuf_test()) {
+        printf("FAILED\n");
+        return -1;
+    }
+    printf("OK\n");
     return 0;
 }
 
@@ -0,0 +1,113 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Thread slots, see thread_slots.h
+**
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#include <sched.h>
+#include "thread_slots.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline void
+thread_slots_lock (thread_slots_t *tsp)
+{
+    while (__sync_lock_test_and_set(&tsp->mtx, 1)) sched_yield();
+}
+
+static inline void
+thread_slots_unlock (thread_slots_t *tsp)
+{
+    __sync_lock_release(&tsp->mtx);
+}
+
+/* called with the address of the slot in 'owners' as the thread exits */
+static void
+thread_slot_release (void *arg)
+{
+    thread_slots_t **owner = (thread_slots_t**) arg;
+    thread_slots_t *tsp = *owner;
+
+    thread_slots_lock(tsp);
+    tsp->free_slots[tsp->free_slot_count++] = (int) (owner - tsp->owners);
+    thread_slots_unlock(tsp);
+}
+
+PUBLIC int
+thread_slot_assign (thread_slots_t *tsp)
+{
+    int slot = tsp->max_slots;
+
+    thread_slots_lock(tsp);
+    if (!tsp->key_created) {
+        if (pthread_key_create(&tsp->key, thread_slot_release)) {
+            thread_slots_unlock(tsp);
+            return slot;
+        }
+        tsp->key_created = true;
+    }
+    if (tsp->free_slot_count > 0) {
+        slot = tsp->free_slots[--tsp->free_slot_count];
+    } else if (tsp->next_unused_slot < tsp->max_slots) {
+        slot = tsp->next_unused_slot++;
+    }
+    if (slot < tsp->max_slots) tsp->owners[slot] = tsp;
+    thread_slots_unlock(tsp);
+
+    if (slot < tsp->max_slots) {
+        pthread_setspecific(tsp->key, &tsp->owners[slot]);
+    }
+
+    return slot;
+}
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
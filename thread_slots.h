@@ -0,0 +1,121 @@
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Author: Cihangir Metin Akyol, gee.akyol@gmail.com, gee_akyol@yahoo.com
+** Copyright: Cihangir Metin Akyol, April 2014 -> ....
+**
+** All this code has been personally developed by and belongs to 
+** Mr. Cihangir Metin Akyol.  It has been developed in his own 
+** personal time using his own personal resources.  Therefore,
+** it is NOT owned by any establishment, group, company or 
+** consortium.  It is the sole property and work of the named
+** individual.
+**
+** It CAN be used by ANYONE or ANY company for ANY purpose as long 
+** as ownership and/or patent claims are NOT made to it by ANYONE
+** or ANY ENTITY.
+**
+** It ALWAYS is and WILL remain the sole property of Cihangir Metin Akyol.
+**
+** For proper indentation/viewing, regardless of which editor is being used,
+** no tabs are used, ONLY spaces are used and the width of lines never
+** exceed 80 characters.  This way, every text editor/terminal should
+** display the code properly.  If modifying, please stick to this
+** convention.
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+/******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+**
+** Thread slots.
+**
+** Per thread state (counters, caches, epochs) is kept in a small array
+** indexed by a slot number private to each thread, rather than in
+** thread local storage, so that another thread can go thru all of it.
+** A slot is assigned to a thread the first time it needs one & is
+** given back when the thread exits, to be reused by a later thread.
+** Every user has its own set of slots, usually a static one:
+**
+**      static thread_slots_t my_slots = THREAD_SLOTS_INITIALIZER(64);
+**      static __thread int my_slot = -1;
+**
+**      if (my_slot < 0) my_slot = thread_slot_assign(&my_slots);
+**
+** Once all the slots are in use, 'thread_slot_assign' returns the
+** maximum given to THREAD_SLOTS_INITIALIZER, which the user must then
+** handle in some other (slower, shared) way.
+**
+**
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+*******************************************************************************
+******************************************************************************/
+
+#ifndef __THREAD_SLOTS_H__
+#define __THREAD_SLOTS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include "common.h"
+
+/* most slots any set can have */
+#define THREAD_SLOTS_MAX                256
+
+typedef struct thread_slots_s thread_slots_t;
+
+struct thread_slots_s {
+
+    /* protects everything below, only taken when threads come & go */
+    volatile int mtx;
+
+    /* slots are 0 to max_slots - 1 */
+    int max_slots;
+
+    /* slots given back by exiting threads & the never used ones */
+    int free_slots [THREAD_SLOTS_MAX];
+    int free_slot_count;
+    int next_unused_slot;
+
+    /*
+     * What every thread holding a slot has in 'key' is the address
+     * of its slot in here, which all point back at this set.  That is
+     * how the destructor, which is only given that, finds both.
+     */
+    thread_slots_t *owners [THREAD_SLOTS_MAX];
+
+    boolean key_created;
+    pthread_key_t key;
+};
+
+#define THREAD_SLOTS_INITIALIZER(max)     { .max_slots = ((max) < THREAD_SLOTS_MAX) ? (max) : THREAD_SLOTS_MAX }
+
+/*
+ * Assigns a free slot to the calling thread, which gets it back when
+ * the thread exits.  Returns the slot, or 'max_slots' if they are all
+ * in use.  A thread must only call this once, & cache the result.
+ */
+extern int
+thread_slot_assign (thread_slots_t *tsp);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+#endif /* __THREAD_SLOTS_H__ */
+
@@ -39,7 +39,13 @@
 ******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 #include "timer_object.h"
+#include "thread_slots.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -67,6 +73,324 @@ timer_report (timer_obj_t *tp, long long int iterations,
     }
 }
 
+/******************************************************************************
+ *
+ * Cheap time source calibration.
+ */
+
+#define CYCLES_CALIBRATION_NSECS        (20 * 1000000LL)
+
+static double cycles_per_nsec = 0;
+static pthread_once_t cycles_calibration_once = PTHREAD_ONCE_INIT;
+
+static void
+timer_cycles_calibrate (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    nano_seconds_t t0, t1;
+    cycles_t c0, c1;
+
+    t0 = time_now();
+    c0 = cycles_now();
+    nano_seconds_sleep(CYCLES_CALIBRATION_NSECS);
+    t1 = time_now();
+    c1 = cycles_now();
+    if ((t1 > t0) && (c1 > c0)) {
+        cycles_per_nsec = (double) (c1 - c0) / (double) (t1 - t0);
+        return;
+    }
+#endif
+    cycles_per_nsec = 1.0;
+}
+
+PUBLIC double
+timer_cycles_per_nsec (void)
+{
+    if (cycles_per_nsec <= 0) {
+        pthread_once(&cycles_calibration_once, timer_cycles_calibrate);
+    }
+    return cycles_per_nsec;
+}
+
+/******************************************************************************
+ *
+ * Latency histograms.
+ */
+
+__thread int histogram_thread_index = HISTOGRAM_THREAD_INDEX_UNASSIGNED;
+
+static thread_slots_t histogram_thread_slots =
+    THREAD_SLOTS_INITIALIZER(HISTOGRAM_MAX_THREADS);
+
+static void
+histogram_thread_index_assign (void)
+{
+    histogram_thread_index = thread_slot_assign(&histogram_thread_slots);
+}
+
+static void
+histogram_shard_init (histogram_shard_t *sp)
+{
+    memset(sp, 0, sizeof(histogram_shard_t));
+    sp->min = ULLONG_MAX;
+}
+
+/*
+ * Highest value which falls into the same bucket as 'index'.
+ */
+static unsigned long long int
+histogram_bucket_highest (int index)
+{
+    int shift;
+
+    if (index < HISTOGRAM_SUB_BUCKETS) return index;
+    shift = (index >> HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    return
+        (((unsigned long long int) (HISTOGRAM_SUB_BUCKETS +
+            (index & (HISTOGRAM_SUB_BUCKETS - 1)))) << shift) +
+        ((1ULL << shift) - 1);
+}
+
+static inline void
+atomic_min_update (unsigned long long int *min, unsigned long long int value)
+{
+    unsigned long long int old;
+
+    while ((old = *min) > value) {
+        if (__sync_bool_compare_and_swap(min, old, value)) break;
+    }
+}
+
+static inline void
+atomic_max_update (unsigned long long int *max, unsigned long long int value)
+{
+    unsigned long long int old;
+
+    while ((old = *max) < value) {
+        if (__sync_bool_compare_and_swap(max, old, value)) break;
+    }
+}
+
+static void
+histogram_shard_atomic_add (histogram_shard_t *dst, histogram_shard_t *src)
+{
+    int i;
+
+    if (0 == src->count) return;
+    __sync_fetch_and_add(&dst->count, src->count);
+    __sync_fetch_and_add(&dst->sum, src->sum);
+    atomic_min_update(&dst->min, src->min);
+    atomic_max_update(&dst->max, src->max);
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (src->buckets[i])
+            __sync_fetch_and_add(&dst->buckets[i], src->buckets[i]);
+    }
+}
+
+/*
+ * adds up all the shards into 'total'
+ */
+static void
+histogram_total (histogram_t *hp, histogram_shard_t *total)
+{
+    histogram_shard_t *sp;
+    int s, i;
+
+    *total = hp->common;
+    for (s = 0; s < HISTOGRAM_MAX_THREADS; s++) {
+        if (NULL == (sp = hp->shards[s])) continue;
+        if (0 == sp->count) continue;
+        total->count += sp->count;
+        total->sum += sp->sum;
+        if (sp->min < total->min) total->min = sp->min;
+        if (sp->max > total->max) total->max = sp->max;
+        for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            total->buckets[i] += sp->buckets[i];
+        }
+    }
+}
+
+static unsigned long long int
+histogram_total_percentile (histogram_shard_t *total, double percentile)
+{
+    unsigned long long int target, seen, value;
+    int i;
+
+    if (0 == total->count) return 0;
+    if (percentile < 0) percentile = 0;
+    if (percentile > 100) percentile = 100;
+    target = (unsigned long long int)
+        (((percentile / 100.0) * (double) total->count) + 0.5);
+    if (target < 1) target = 1;
+    if (target > total->count) target = total->count;
+
+    value = total->max;
+    seen = 0;
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += total->buckets[i];
+        if (seen >= target) {
+            value = histogram_bucket_highest(i);
+            break;
+        }
+    }
+    if (value < total->min) value = total->min;
+    if (value > total->max) value = total->max;
+
+    return value;
+}
+
+static inline unsigned long long int
+histogram_value (histogram_t *hp, unsigned long long int value)
+{
+    if (hp->values_are_cycles) return cycles_to_nsecs(value);
+    return value;
+}
+
+PUBLIC void
+histogram_record_slow (histogram_t *hp, unsigned long long int value)
+{
+    histogram_shard_t *sp;
+
+    if (histogram_thread_index == HISTOGRAM_THREAD_INDEX_UNASSIGNED) {
+        histogram_thread_index_assign();
+    }
+    if (histogram_thread_index < HISTOGRAM_MAX_THREADS) {
+
+        /*
+         * The shard may already be there, left by an exited thread which
+         * had the same index.  If not, only this thread can create it.
+         */
+        sp = hp->shards[histogram_thread_index];
+        if (NULL == sp) {
+            sp = malloc(sizeof(histogram_shard_t));
+            if (sp) {
+                histogram_shard_init(sp);
+                __sync_synchronize();
+                hp->shards[histogram_thread_index] = sp;
+            }
+        }
+        if (sp) {
+            histogram_record(hp, value);
+            return;
+        }
+    }
+
+    /* no shard of its own, use the common one */
+    __sync_fetch_and_add(&hp->common.count, 1);
+    __sync_fetch_and_add(&hp->common.sum, value);
+    atomic_min_update(&hp->common.min, value);
+    atomic_max_update(&hp->common.max, value);
+    __sync_fetch_and_add(&hp->common.buckets[histogram_bucket_index(value)], 1);
+}
+
+PUBLIC int
+histogram_init (histogram_t *hp, char *name, int values_are_cycles)
+{
+    memset(hp, 0, sizeof(histogram_t));
+    hp->name = name;
+    hp->values_are_cycles = values_are_cycles;
+    histogram_shard_init(&hp->common);
+
+    /* do not let the calibration delay land on the first recording */
+    if (values_are_cycles) timer_cycles_per_nsec();
+
+    return 0;
+}
+
+PUBLIC void
+histogram_reset (histogram_t *hp)
+{
+    int s;
+
+    histogram_shard_init(&hp->common);
+    for (s = 0; s < HISTOGRAM_MAX_THREADS; s++) {
+        if (hp->shards[s]) histogram_shard_init(hp->shards[s]);
+    }
+}
+
+PUBLIC int
+histogram_merge (histogram_t *dst, histogram_t *src)
+{
+    histogram_shard_t *total;
+
+    if ((NULL == dst) || (NULL == src) || (dst == src)) return EINVAL;
+    if (dst->values_are_cycles != src->values_are_cycles) return EINVAL;
+    total = malloc(sizeof(histogram_shard_t));
+    if (NULL == total) return ENOMEM;
+    histogram_total(src, total);
+    histogram_shard_atomic_add(&dst->common, total);
+    free(total);
+
+    return 0;
+}
+
+PUBLIC unsigned long long int
+histogram_count (histogram_t *hp)
+{
+    unsigned long long int count = hp->common.count;
+    int s;
+
+    for (s = 0; s < HISTOGRAM_MAX_THREADS; s++) {
+        if (hp->shards[s]) count += hp->shards[s]->count;
+    }
+    return count;
+}
+
+PUBLIC unsigned long long int
+histogram_percentile (histogram_t *hp, double percentile)
+{
+    histogram_shard_t *total;
+    unsigned long long int value;
+
+    total = malloc(sizeof(histogram_shard_t));
+    if (NULL == total) return 0;
+    histogram_total(hp, total);
+    value = histogram_value(hp, histogram_total_percentile(total, percentile));
+    free(total);
+
+    return value;
+}
+
+PUBLIC void
+histogram_report (histogram_t *hp)
+{
+    histogram_shard_t *total;
+
+    total = malloc(sizeof(histogram_shard_t));
+    if (NULL == total) return;
+    histogram_total(hp, total);
+    printf("%s: %llu samples", hp->name ? hp->name : "histogram", total->count);
+    if (total->count) {
+        printf(", %s: min %llu avg %.1lf p50 %llu p90 %llu p99 %llu "
+            "p99.9 %llu max %llu",
+            hp->values_are_cycles ? "nsecs" : "values",
+            histogram_value(hp, total->min),
+            hp->values_are_cycles ?
+                ((double) total->sum / timer_cycles_per_nsec()) /
+                    (double) total->count :
+                (double) total->sum / (double) total->count,
+            histogram_value(hp, histogram_total_percentile(total, 50)),
+            histogram_value(hp, histogram_total_percentile(total, 90)),
+            histogram_value(hp, histogram_total_percentile(total, 99)),
+            histogram_value(hp, histogram_total_percentile(total, 99.9)),
+            histogram_value(hp, total->max));
+    }
+    printf("\n");
+    free(total);
+}
+
+PUBLIC void
+histogram_destroy (histogram_t *hp)
+{
+    int s;
+
+    for (s = 0; s < HISTOGRAM_MAX_THREADS; s++) {
+        free(hp->shards[s]);
+        hp->shards[s] = NULL;
+    }
+    histogram_shard_init(&hp->common);
+}
+
 #ifdef __cplusplus
 } // extern C
 #endif 
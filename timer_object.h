@@ -122,6 +122,185 @@ extern
 void timer_report (timer_obj_t *tp, long long int iterations,
     double *returned_per_iteration_time_in_nsecs);
 
+/******************************************************************************
+ *
+ * Cheap time source.
+ *
+ * On x86, reads the time stamp counter directly, which costs a few
+ * nano seconds compared to the system call like cost of clock_gettime.
+ * It assumes an invariant time stamp counter (all modern x86 cpus) and
+ * is NOT serializing, so it is only meant to time operations which
+ * take more than a few tens of nano seconds.  On other platforms,
+ * it simply is 'time_now'.
+ *
+ * Cycles are converted to nano seconds by the ratio measured against
+ * CLOCK_MONOTONIC the first time 'timer_cycles_per_nsec' is called.
+ */
+
+typedef unsigned long long int cycles_t;
+
+static inline cycles_t
+cycles_now (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int lo, hi;
+
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((cycles_t) hi << 32) | lo;
+#else
+    return time_now();
+#endif
+}
+
+/*
+ * how many cycles elapse in one nano second, calibrated only once
+ */
+extern double
+timer_cycles_per_nsec (void);
+
+static inline nano_seconds_t
+cycles_to_nsecs (cycles_t cycles)
+{
+    return (nano_seconds_t) ((double) cycles / timer_cycles_per_nsec());
+}
+
+/******************************************************************************
+ *
+ * Latency histograms.
+ *
+ * A log bucketed (HDR style) histogram of 64 bit values.  Every power
+ * of 2 range is split into 2^HISTOGRAM_SUB_BUCKET_BITS equal buckets,
+ * so every recorded value is kept with a relative error of at most
+ * 1/2^HISTOGRAM_SUB_BUCKET_BITS (about 3%), regardless of how big it is.
+ * Values below 2^HISTOGRAM_SUB_BUCKET_BITS are kept exactly.
+ *
+ * Recording is lock free and does not use any atomic operations either:
+ * every thread records into its own shard of the histogram.  The shards
+ * are summed up only when percentiles are asked for.  A thread beyond
+ * the first HISTOGRAM_MAX_THREADS live threads records into a shared
+ * shard with atomic operations, which is slower but still correct.
+ *
+ * If the histogram is initialized to hold cycles (as obtained by
+ * 'cycles_now'), all the values reported are converted to nano seconds.
+ *
+ * Typical use is:
+ *
+ *      cycles_t start = cycles_now();
+ *      avl_tree_search(...);
+ *      histogram_record(&hist, cycles_now() - start);
+ */
+
+#define HISTOGRAM_SUB_BUCKET_BITS       5
+#define HISTOGRAM_SUB_BUCKETS           (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS \
+    ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+#define HISTOGRAM_MAX_THREADS           256
+
+typedef struct histogram_shard_s {
+
+    unsigned long long int count;
+    unsigned long long int sum;
+    unsigned long long int min;
+    unsigned long long int max;
+    unsigned long long int buckets [HISTOGRAM_BUCKETS];
+
+} histogram_shard_t;
+
+typedef struct histogram_s {
+
+    char *name;
+    int values_are_cycles;
+
+    /* shared shard for the overflow threads & merges */
+    histogram_shard_t common;
+
+    /* indexed by the thread index, allocated at first recording */
+    histogram_shard_t * volatile shards [HISTOGRAM_MAX_THREADS];
+
+} histogram_t;
+
+/*
+ * Index of the calling thread into the shards, assigned the first
+ * time a thread records anything and recycled when the thread exits.
+ * HISTOGRAM_MAX_THREADS means the thread uses the common shard.
+ */
+#define HISTOGRAM_THREAD_INDEX_UNASSIGNED       (HISTOGRAM_MAX_THREADS + 1)
+extern __thread int histogram_thread_index;
+
+static inline int
+histogram_bucket_index (unsigned long long int value)
+{
+    int msb;
+
+    if (value < HISTOGRAM_SUB_BUCKETS) return (int) value;
+    msb = 63 - __builtin_clzll(value);
+    return
+        ((msb - HISTOGRAM_SUB_BUCKET_BITS + 1) << HISTOGRAM_SUB_BUCKET_BITS) +
+        (int) (value >> (msb - HISTOGRAM_SUB_BUCKET_BITS)) -
+        HISTOGRAM_SUB_BUCKETS;
+}
+
+/* PRIVATE, used by 'histogram_record' when the fast path fails */
+extern void
+histogram_record_slow (histogram_t *hp, unsigned long long int value);
+
+static inline void
+histogram_record (histogram_t *hp, unsigned long long int value)
+{
+    histogram_shard_t *sp;
+
+    if ((histogram_thread_index < HISTOGRAM_MAX_THREADS) &&
+        (sp = hp->shards[histogram_thread_index])) {
+            sp->count++;
+            sp->sum += value;
+            if (value < sp->min) sp->min = value;
+            if (value > sp->max) sp->max = value;
+            sp->buckets[histogram_bucket_index(value)]++;
+            return;
+    }
+    histogram_record_slow(hp, value);
+}
+
+extern int
+histogram_init (histogram_t *hp, char *name, int values_are_cycles);
+
+/*
+ * Clears all recorded values.  Must not be called while
+ * any other thread is recording into the histogram.
+ */
+extern void
+histogram_reset (histogram_t *hp);
+
+/*
+ * Adds everything recorded in 'src' into 'dst'.  Both histograms
+ * must be holding the same type of values (cycles or not).
+ */
+extern int
+histogram_merge (histogram_t *dst, histogram_t *src);
+
+/*
+ * total number of values recorded
+ */
+extern unsigned long long int
+histogram_count (histogram_t *hp);
+
+/*
+ * Returns the value below or at which 'percentile' (0 to 100) percent
+ * of the recorded values are (in nano seconds if values are cycles).
+ * Returns 0 if nothing is recorded.
+ */
+extern unsigned long long int
+histogram_percentile (histogram_t *hp, double percentile);
+
+/*
+ * prints the count, min, average, p50, p90, p99, p99.9 & max
+ */
+extern void
+histogram_report (histogram_t *hp);
+
+extern void
+histogram_destroy (histogram_t *hp);
+
 #ifdef __cplusplus
 } // extern C
 #endif 
@@ -70,7 +70,7 @@ tlvm_parse_engine (tlvm_t *tlvmp, boolean store_the_tlvs)
          * get type, while checking it does not 
          * go past the end of the buffer.
          */
-        if ((bptr + sizeof(type)) >= past_the_end) return ENOSPC;
+        if ((bptr + sizeof(type)) > past_the_end) return ENOSPC;
         copy_bytes(bptr, &type, sizeof(type));
         type = ntohl(type);
 
@@ -84,7 +84,7 @@ tlvm_parse_engine (tlvm_t *tlvmp, boolean store_the_tlvs)
          * get length, while checking it does not
          * go past the end of the buffer.
          */
-        if (bptr + sizeof(length) >= past_the_end) return ENOSPC;
+        if (bptr + sizeof(length) > past_the_end) return ENOSPC;
         copy_bytes(bptr, &length, sizeof(length));
         length = ntohl(length);
 
@@ -92,6 +92,9 @@ tlvm_parse_engine (tlvm_t *tlvmp, boolean store_the_tlvs)
         if ((length <= 0) || (length > MAX_TLV_VALUE_BYTES)) return EINVAL;
         bptr += sizeof(length);
 
+        /* the value must be all in the buffer too */
+        if (bptr + length > past_the_end) return ENOSPC;
+
         /*
          * Add this newly parsed tlv to the end of the tlvs array by
          * expanding the array by one extra tlv structure using realloc.
@@ -233,6 +236,35 @@ tlvm_detach (tlvm_t *tlvmp)
     tlvm_reset(tlvmp);
 }
 
+PUBLIC int
+tlvm_attach_msgbuf (tlvm_t *tlvmp, msgbuf_t *mb)
+{
+    if (msgbuf_is_shared(mb)) return EBUSY;
+    return
+        tlvm_attach(tlvmp, mb->data + mb->length, msgbuf_tailroom(mb), false);
+}
+
+PUBLIC int
+tlvm_msgbuf_commit (tlvm_t *tlvmp, msgbuf_t *mb)
+{
+    int built = tlvmp->idx;
+
+    /* the end marker is not counted in 'idx' but is needed */
+    if (tlvmp->n_tlvs > 0) built += sizeof(unsigned int);
+    if (tlvmp->buffer != (mb->data + mb->length)) return EINVAL;
+    if (NULL == msgbuf_append(mb, built)) return ENOSPC;
+    tlvm_detach(tlvmp);
+
+    return 0;
+}
+
+PUBLIC int
+tlvm_msgbuf_value (msgbuf_t *mb, one_tlv_t *tlv, msgbuf_t *value)
+{
+    return
+        msgbuf_slice(value, mb, (int) (tlv->value - mb->data), tlv->length);
+}
+
 
 
 
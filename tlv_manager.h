@@ -56,6 +56,7 @@
 #define __TLV_MANAGER_H__
 
 #include "common.h"
+#include "buffer_manager.h"
 
 /*
  * max allowed length in bytes of the value part of a tlv.
@@ -177,5 +178,27 @@ tlvm_reset_to_append (tlvm_t *tlvmp);
 extern void
 tlvm_detach (tlvm_t *tlvmp);
 
+/*
+ * Attaches the tlv manager to the tailroom of a message buffer so
+ * that the tlvs are built right where they will be sent from, and
+ * headers can later be prepended into the headroom without copying.
+ * Once all the tlvs are appended, 'tlvm_msgbuf_commit' adds them
+ * (with the end marker) to the data of the message buffer.
+ * EBUSY is returned if the message buffer is shared.
+ */
+extern int
+tlvm_attach_msgbuf (tlvm_t *tlvmp, msgbuf_t *mb);
+
+extern int
+tlvm_msgbuf_commit (tlvm_t *tlvmp, msgbuf_t *mb);
+
+/*
+ * 'value' becomes a view of the value of 'tlv', which must have been
+ * parsed from the data of 'mb', so it can be handed over to another
+ * consumer without copying it.  Returns 0 or EINVAL.
+ */
+extern int
+tlvm_msgbuf_value (msgbuf_t *mb, one_tlv_t *tlv, msgbuf_t *value);
+
 #endif /* __TLV_MANAGER_H__ */
 